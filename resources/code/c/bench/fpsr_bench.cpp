@@ -0,0 +1,935 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_bench.cpp
+ * @brief Google Benchmark suite for the C implementation of FPS-R.
+ * @details Measures throughput of portable_rand(), fpsr_sm() and fpsr_qs() and of
+ * every batched / SIMD / threaded path built on them. Each benchmark reports
+ * `items_per_second` (evaluations per second) and `s_per_eval` (seconds per
+ * evaluation, shown as e.g. "3.2n" for 3.2 ns).
+ *
+ * Parameter regimes:
+ *  - SM with short holds (a change almost every frame) and long holds.
+ *  - QS with explicit durations, and with a low baseWaveFreq and durations < 1
+ *    so the default-duration paths are exercised.
+ *  - Scalar calls versus the batch, range, segment, cursor, table, curve file,
+ *    next-change, Q16.16, multi-channel, result board, 64-bit frame, SoA and
+ *    bake entry points, and each bake path against the planner's choice.
+ *  - The Houdini wrangles' per-point pattern against the VEX-dialect batches.
+ *  - SIMD kernels once per ISA the CPU supports, and bakes at 1 thread and at
+ *    every online CPU.
+ *
+ * Build (from resources/code/c):
+ *   cc -O2 -c fpsr_algorithms.c fpsr_simd.c fpsr_bake.c fpsr_curve.c fpsr_fixed.c fpsr_query.c fpsr_graph.c fpsr_board.c \
+ *       fpsr_frame64.c fpsr_planner.c fpsr_vex.c
+ *   c++ -O2 -std=c++17 bench/fpsr_bench.cpp fpsr_algorithms.o fpsr_simd.o fpsr_bake.o fpsr_curve.o fpsr_fixed.o fpsr_query.o \
+ *       fpsr_graph.o fpsr_board.o fpsr_frame64.o fpsr_planner.o fpsr_vex.o \
+ *       -lbenchmark -lpthread -lm -o fpsr_bench
+ *
+ * Gate regressions against the throughput targets in fpsr_bench_baseline.json
+ * (see fpsr_bench_compare.py, which exits 1 on a regression):
+ *   ./fpsr_bench --benchmark_repetitions=3 --benchmark_report_aggregates_only=true \
+ *       --benchmark_format=json --benchmark_out=fpsr_bench.json
+ *   python bench/fpsr_bench_compare.py fpsr_bench.json
+ * The targets are machine-specific; record them on the gating machine with --update.
+ */
+
+ #include <benchmark/benchmark.h>
+
+ #include <cmath>
+ #include <cstdlib>
+ #include <string>
+ #include <vector>
+
+ #include <unistd.h> // For close() and unlink()
+
+ #include "../fpsr_algorithms.h"
+
+ namespace {
+
+ // Frames per benchmark iteration; large enough to amortise loop overhead, small enough to stay in L2.
+ constexpr int kFrames = 4096;
+
+ // Reports evaluations per second and seconds per evaluation (printed with an SI prefix, e.g. "3.2n").
+ void set_eval_counters(benchmark::State& state, double evalsPerIteration)
+ {
+     state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * evalsPerIteration));
+     state.counters["s_per_eval"] = benchmark::Counter(
+         evalsPerIteration, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+ }
+
+ struct SmRegime {
+     const char* name;
+     int minHold, maxHold, reseedInterval, seedInner, seedOuter;
+ };
+
+ const SmRegime kSmRegimes[] = {
+     { "short_hold", 1, 3, 5, -41, 23 },     // Degenerate: changes almost every frame.
+     { "sample", 16, 24, 9, -41, 23 },       // The sample parameters from fpsr_algorithms.c.
+     { "long_hold", 200, 400, 97, -41, 23 }, // Long holds: segments and range shine.
+ };
+
+ struct QsRegime {
+     const char* name;
+     float baseWaveFreq, stream2FreqMult;
+     int quantLevelsMinMax[2], streamsOffset[2];
+     int streamSwitchDur, stream1QuantDur, stream2QuantDur;
+ };
+
+ const QsRegime kQsRegimes[] = {
+     { "sample", 0.012f, 3.1f, { 12, 22 }, { 0, 76 }, 24, 16, 20 },
+     { "default_durations", 0.0007f, -1.0f, { 12, 22 }, { 0, 76 }, 0, 0, 0 }, // Low frequency, every default path.
+ };
+
+ std::vector<int> make_seeds(size_t n)
+ {
+     std::vector<int> seeds(n);
+     unsigned x = 12345u;
+     for (auto& s : seeds) {
+         x = x * 1664525u + 1013904223u;
+         s = static_cast<int>(x >> 4) - (1 << 27);
+     }
+     return seeds;
+ }
+
+ const char* isa_name(fpsr_simd_isa isa)
+ {
+     switch (isa) {
+     case FPSR_ISA_NEON: return "neon";
+     case FPSR_ISA_AVX2: return "avx2";
+     case FPSR_ISA_AVX512: return "avx512";
+     default: return "scalar";
+     }
+ }
+
+
+ /******************************************************************************/
+ /* portable_rand                                                              */
+ /******************************************************************************/
+
+ void BM_portable_rand(benchmark::State& state)
+ {
+     std::vector<int> seeds = make_seeds(kFrames);
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int s : seeds) { acc += portable_rand(s); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_portable_rand_hash(benchmark::State& state)
+ {
+     std::vector<int> seeds = make_seeds(kFrames);
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int s : seeds) { acc += portable_rand_hash(s); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_portable_rand_batch(benchmark::State& state, fpsr_simd_isa isa, fpsr_rand_mode mode)
+ {
+     fpsr_simd_set_isa(isa);
+     std::vector<int> seeds = make_seeds(kFrames);
+     std::vector<float> out(kFrames);
+     for (auto _ : state) {
+         portable_rand_batch(seeds.data(), out.data(), out.size(), mode);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+
+ /******************************************************************************/
+ /* Stacked Modulo                                                             */
+ /******************************************************************************/
+
+ void BM_fpsr_sm(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) {
+             acc += fpsr_sm(f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // The pre-_ex change detection: two full calls per frame.
+ void BM_fpsr_sm_changed_twice(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         int changes = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             float v = fpsr_sm(f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             float prev = fpsr_sm(f - 1, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             changes += (v != prev);
+         }
+         benchmark::DoNotOptimize(changes);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_sm_ex(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         int changes = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             int changed = 0;
+             fpsr_sm_ex(f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter, &changed, nullptr);
+             changes += changed;
+         }
+         benchmark::DoNotOptimize(changes);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_sm_cursor_forward(benchmark::State& state, SmRegime p)
+ {
+     fpsr_sm_cursor cursor;
+     fpsr_sm_cursor_init(&cursor, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) { acc += fpsr_sm_cursor_eval(&cursor, f); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // Timeline scrubbing: a random walk of -3 .. +4 frames per query.
+ void BM_fpsr_sm_cursor_scrub(benchmark::State& state, SmRegime p)
+ {
+     std::vector<int> frames = make_seeds(kFrames);
+     int f = 0;
+     for (auto& frame : frames) {
+         f += (frame & 7) - 3;
+         frame = f;
+     }
+     fpsr_sm_cursor cursor;
+     fpsr_sm_cursor_init(&cursor, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int frame : frames) { acc += fpsr_sm_cursor_eval(&cursor, frame); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // A scheduler that sleeps from change to change; reported per frame covered.
+ void BM_fpsr_sm_next_change(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         int wakeups = 0;
+         for (int f = 0; f < kFrames; ++wakeups) {
+             f = fpsr_sm_next_change(f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         benchmark::DoNotOptimize(wakeups);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_sm_batch(benchmark::State& state, SmRegime p)
+ {
+     std::vector<int> frames = make_seeds(kFrames);
+     std::vector<float> out(kFrames);
+     for (auto _ : state) {
+         fpsr_sm_batch(frames.data(), out.data(), out.size(), p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_sm_range(benchmark::State& state, SmRegime p)
+ {
+     std::vector<float> out(kFrames);
+     for (auto _ : state) {
+         fpsr_sm_range(0, out.size(), out.data(), p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // The 64-bit range at epoch-millisecond frames, against fpsr_sm/range near frame 0.
+ constexpr long long kEpochMillis = 1760000000000LL;
+
+ void BM_fpsr_sm64_range(benchmark::State& state, SmRegime p)
+ {
+     std::vector<float> out(kFrames);
+     for (auto _ : state) {
+         fpsr_sm64_range(kEpochMillis, out.size(), out.data(), p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // Frames covered per second when baking through the segment iterator.
+ void BM_fpsr_sm_segments(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         fpsr_sm_segment_iter it;
+         fpsr_sm_segment seg;
+         fpsr_sm_segments_begin(&it, 0, kFrames - 1, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         float acc = 0.0f;
+         while (fpsr_sm_segments_next(&it, &seg)) { acc += seg.value; }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // Frames searched per query; long enough that the value index pays off.
+ constexpr int kQueryFrames = 1 << 20;
+
+ // Frames searched per second by "where is the value above 0.9" over kQueryFrames.
+ void BM_fpsr_sm_query_value(benchmark::State& state, SmRegime p)
+ {
+     fpsr_sm_params params = { p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter };
+     for (auto _ : state) {
+         benchmark::DoNotOptimize(fpsr_sm_query_value(&params, 0, kQueryFrames - 1, FPSR_QUERY_GREATER, 0.9f, nullptr, 0));
+     }
+     set_eval_counters(state, kQueryFrames);
+ }
+
+ // As BM_fpsr_sm_query_value(), answered from a prebuilt fpsr_value_index.
+ void BM_fpsr_sm_index_query(benchmark::State& state, SmRegime p)
+ {
+     fpsr_sm_params params = { p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter };
+     fpsr_value_index index;
+     if (fpsr_sm_index_build(&index, &params, 0, kQueryFrames - 1) != 0) {
+         state.SkipWithError("fpsr_sm_index_build failed");
+         return;
+     }
+     for (auto _ : state) {
+         benchmark::DoNotOptimize(fpsr_value_index_query(&index, 0, kQueryFrames - 1, FPSR_QUERY_GREATER, 0.9f, nullptr, 0));
+     }
+     fpsr_value_index_free(&index);
+     set_eval_counters(state, kQueryFrames);
+ }
+
+ void BM_portable_rand_hash_sm(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) {
+             acc += fpsr_sm_backend(FPSR_BACKEND_HASH, f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // The integer-only Q16.16 build; on a desktop CPU this mostly shows the cost of the float emulation.
+ void BM_fpsr_sm_q16(benchmark::State& state, SmRegime p)
+ {
+     for (auto _ : state) {
+         int32_t acc = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             acc += fpsr_sm_q16(f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // One frame across kFrames instances laid out as structure-of-arrays.
+ void BM_fpsr_sm_eval_soa(benchmark::State& state, SmRegime p, fpsr_simd_isa isa)
+ {
+     fpsr_simd_set_isa(isa);
+     std::vector<int> minHold(kFrames, p.minHold), maxHold(kFrames, p.maxHold), reseed(kFrames, p.reseedInterval);
+     std::vector<int> seedInner(kFrames), seedOuter(kFrames);
+     for (int i = 0; i < kFrames; ++i) { seedInner[i] = p.seedInner + i; seedOuter[i] = p.seedOuter + 7 * i; }
+     fpsr_sm_soa soa = { minHold.data(), maxHold.data(), reseed.data(), seedInner.data(), seedOuter.data() };
+     std::vector<float> out(kFrames);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_sm_eval_soa(&soa, out.size(), frame++, out.data(), FPSR_RAND_EXACT);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+
+ /******************************************************************************/
+ /* Quantised Switching                                                        */
+ /******************************************************************************/
+
+ void BM_fpsr_qs(benchmark::State& state, QsRegime p)
+ {
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) {
+             acc += fpsr_qs(f, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                            p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+         }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_eval(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) { acc += fpsr_qs_eval(&plan, f); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs64_range(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     std::vector<float> out(kFrames);
+     for (auto _ : state) {
+         fpsr_qs64_range(&plan, kEpochMillis, out.size(), out.data());
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_q16_eval(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     fpsr_qs_q16_plan fixed;
+     fpsr_qs_q16_plan_from(&fixed, &plan);
+     for (auto _ : state) {
+         int32_t acc = 0;
+         for (int f = 0; f < kFrames; ++f) { acc += fpsr_qs_q16_eval(&fixed, f); }
+         benchmark::DoNotOptimize(acc);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_ex(benchmark::State& state, QsRegime p)
+ {
+     for (auto _ : state) {
+         int changes = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             int changed = 0;
+             fpsr_qs_ex(f, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                        p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur, &changed, nullptr);
+             changes += changed;
+         }
+         benchmark::DoNotOptimize(changes);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_table(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     fpsr_qs_table table;
+     if (fpsr_qs_table_build(&table, &plan, 0, kFrames - 1) != 0) {
+         state.SkipWithError("fpsr_qs_table_build failed");
+         return;
+     }
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) { acc += fpsr_qs_table_eval(&table, f); }
+         benchmark::DoNotOptimize(acc);
+     }
+     fpsr_qs_table_free(&table);
+     set_eval_counters(state, kFrames);
+ }
+
+ // Playback of one QS channel from a memory-mapped curve file.
+ void BM_fpsr_curve_value_at(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     char path[] = "/tmp/fpsr_bench_XXXXXX";
+     int fd = mkstemp(path);
+     if (fd < 0) { state.SkipWithError("mkstemp failed"); return; }
+     close(fd);
+     fpsr_curve_writer* writer = fpsr_curve_writer_open(path);
+     bool written = writer != nullptr && fpsr_curve_writer_add_qs(writer, &plan, 0, kFrames - 1) == 0;
+     written = fpsr_curve_writer_close(writer) == 0 && written;
+     fpsr_curve_file* file = written ? fpsr_curve_open(path, FPSR_CURVE_VERIFY_SEGMENTS) : nullptr;
+     unlink(path); // The mapping outlives the name.
+     if (file == nullptr) { state.SkipWithError("curve file bake failed"); return; }
+     for (auto _ : state) {
+         float acc = 0.0f;
+         for (int f = 0; f < kFrames; ++f) { acc += fpsr_curve_value_at(file, 0, f); }
+         benchmark::DoNotOptimize(acc);
+     }
+     fpsr_curve_close(file);
+     set_eval_counters(state, kFrames);
+ }
+
+ // As BM_fpsr_sm_next_change().
+ void BM_fpsr_qs_next_change(benchmark::State& state, QsRegime p)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, p.baseWaveFreq, p.stream2FreqMult, p.quantLevelsMinMax, p.streamsOffset,
+                       p.streamSwitchDur, p.stream1QuantDur, p.stream2QuantDur);
+     for (auto _ : state) {
+         int wakeups = 0;
+         for (int f = 0; f < kFrames; ++wakeups) { f = fpsr_qs_plan_next_change(&plan, f); }
+         benchmark::DoNotOptimize(wakeups);
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_eval_soa(benchmark::State& state, QsRegime p, fpsr_simd_isa isa)
+ {
+     fpsr_simd_set_isa(isa);
+     std::vector<float> freq(kFrames, p.baseWaveFreq), mult(kFrames, p.stream2FreqMult);
+     std::vector<int> qmin(kFrames, p.quantLevelsMinMax[0]), qmax(kFrames, p.quantLevelsMinMax[1]);
+     std::vector<int> off1(kFrames), off2(kFrames);
+     std::vector<int> sw(kFrames, p.streamSwitchDur), d1(kFrames, p.stream1QuantDur), d2(kFrames, p.stream2QuantDur);
+     for (int i = 0; i < kFrames; ++i) { off1[i] = p.streamsOffset[0] + i; off2[i] = p.streamsOffset[1] + 3 * i; }
+     fpsr_qs_soa soa = { freq.data(), mult.data(), qmin.data(), qmax.data(), off1.data(), off2.data(),
+                         sw.data(), d1.data(), d2.data() };
+     std::vector<float> out(kFrames);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_qs_eval_soa(&soa, out.size(), frame++, out.data(), FPSR_RAND_EXACT);
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+
+ /******************************************************************************/
+ /* Threaded bake                                                              */
+ /******************************************************************************/
+
+ // A character rig: kRigChannels channels in kRigGroups groups that share everything but seedOuter / streamsOffset.
+ constexpr size_t kRigChannels = 200;
+ constexpr int kRigGroups = 8;
+
+ void rig_sm_params(std::vector<fpsr_sm_params>& params)
+ {
+     params.resize(kRigChannels);
+     for (size_t i = 0; i < kRigChannels; ++i) {
+         int g = (int)i % kRigGroups;
+         params[i] = { 4 + g, 20 + g, 48, 13 * g, 17 * (int)i };
+     }
+ }
+
+ void rig_qs_plans(std::vector<fpsr_qs_plan>& plans)
+ {
+     plans.resize(kRigChannels);
+     const int levels[2] = { 4, 12 };
+     for (size_t i = 0; i < kRigChannels; ++i) {
+         const int offsets[2] = { 3 * (int)i, 5 * (int)i };
+         fpsr_qs_plan_init(&plans[i], 0.05f, -1.0f, levels, offsets, 24 + 8 * ((int)i % kRigGroups), 16, 20);
+     }
+ }
+
+ // The rig evaluated one channel at a time, as the baseline for the *_channels benchmarks.
+ void BM_fpsr_sm_rig_loop(benchmark::State& state)
+ {
+     std::vector<fpsr_sm_params> params;
+     rig_sm_params(params);
+     std::vector<float> out(kRigChannels);
+     int frame = 0;
+     for (auto _ : state) {
+         for (size_t i = 0; i < kRigChannels; ++i) {
+             const fpsr_sm_params& p = params[i];
+             out[i] = fpsr_sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         ++frame;
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kRigChannels);
+ }
+
+ void BM_fpsr_sm_channels(benchmark::State& state)
+ {
+     std::vector<fpsr_sm_params> params;
+     rig_sm_params(params);
+     fpsr_sm_channels channels;
+     if (fpsr_sm_channels_init(&channels, params.data(), params.size()) != 0) {
+         state.SkipWithError("fpsr_sm_channels_init failed");
+         return;
+     }
+     std::vector<float> out(kRigChannels);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_sm_channels_eval(&channels, frame++, out.data());
+         benchmark::ClobberMemory();
+     }
+     fpsr_sm_channels_free(&channels);
+     set_eval_counters(state, kRigChannels);
+ }
+
+ // A layered rig from FPSR_Tech.md: QS jitters the frame an SM reads, and the same QS is mixed
+ // back in on top. Outputs: the mix and the SM it drives.
+ const fpsr_sm_params kLayeredSm = { 16, 24, 9, -41, 23 };
+ const QsRegime& layered_qs() { return kQsRegimes[0]; }
+
+ void BM_fpsr_layered_nested_calls(benchmark::State& state)
+ {
+     const QsRegime& q = layered_qs();
+     const fpsr_sm_params& p = kLayeredSm;
+     std::vector<float> out(2 * kFrames);
+     for (auto _ : state) {
+         for (int f = 0; f < kFrames; ++f) {
+             float jitter = fpsr_qs(f, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                                    q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+             float sm = fpsr_sm(f + static_cast<int>(std::floor(jitter * 20.0)), p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             float layer = fpsr_qs(f, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                                   q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+             out[f] = 0.5f * sm + 0.5f * layer;
+             out[kFrames + f] = sm;
+         }
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kFrames);
+ }
+
+ // The same rig as an fpsr_graph: the shared QS is built twice but evaluated once.
+ void BM_fpsr_layered_graph(benchmark::State& state)
+ {
+     const QsRegime& q = layered_qs();
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(&plan, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                       q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+     fpsr_graph* graph = fpsr_graph_create();
+     int frame = fpsr_graph_frame(graph, 0);
+     int jitter = fpsr_graph_remap(graph, fpsr_graph_qs(graph, frame, &plan), 0.0, 1.0, 0.0, 20.0);
+     int sm = fpsr_graph_sm(graph, fpsr_graph_combine(graph, FPSR_COMBINE_ADD, frame, jitter), &kLayeredSm);
+     int layer = fpsr_graph_qs(graph, frame, &plan);
+     int half = fpsr_graph_constant(graph, 0.5);
+     int mix = fpsr_graph_combine(graph, FPSR_COMBINE_ADD,
+         fpsr_graph_combine(graph, FPSR_COMBINE_MUL, sm, half), fpsr_graph_combine(graph, FPSR_COMBINE_MUL, layer, half));
+     const int outputs[2] = { mix, sm };
+     fpsr_program* program = fpsr_program_compile(graph, outputs, 2);
+     fpsr_graph_destroy(graph);
+     if (program == nullptr) {
+         state.SkipWithError("fpsr_program_compile failed");
+         return;
+     }
+     std::vector<float> out(2 * kFrames);
+     for (auto _ : state) {
+         fpsr_program_eval(program, 0, kFrames, out.data(), kFrames);
+         benchmark::ClobberMemory();
+     }
+     fpsr_program_destroy(program);
+     set_eval_counters(state, kFrames);
+ }
+
+ void BM_fpsr_qs_rig_loop(benchmark::State& state)
+ {
+     std::vector<fpsr_qs_plan> plans;
+     rig_qs_plans(plans);
+     std::vector<float> out(kRigChannels);
+     int frame = 0;
+     for (auto _ : state) {
+         for (size_t i = 0; i < kRigChannels; ++i) { out[i] = fpsr_qs_eval(&plans[i], frame); }
+         ++frame;
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, kRigChannels);
+ }
+
+ void BM_fpsr_qs_channels(benchmark::State& state)
+ {
+     std::vector<fpsr_qs_plan> plans;
+     rig_qs_plans(plans);
+     fpsr_qs_channels channels;
+     if (fpsr_qs_channels_init(&channels, plans.data(), plans.size()) != 0) {
+         state.SkipWithError("fpsr_qs_channels_init failed");
+         return;
+     }
+     std::vector<float> out(kRigChannels);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_qs_channels_eval(&channels, frame++, out.data());
+         benchmark::ClobberMemory();
+     }
+     fpsr_qs_channels_free(&channels);
+     set_eval_counters(state, kRigChannels);
+ }
+
+ // One reader's cost per tick for both rigs on a board, against rig/channels recomputing them per thread.
+ void BM_fpsr_board_read(benchmark::State& state)
+ {
+     std::vector<fpsr_sm_params> params;
+     std::vector<fpsr_qs_plan> plans;
+     rig_sm_params(params);
+     rig_qs_plans(plans);
+     fpsr_board* board = fpsr_board_create(params.data(), params.size(), plans.data(), plans.size());
+     if (board == nullptr) {
+         state.SkipWithError("fpsr_board_create failed");
+         return;
+     }
+     std::vector<float> out(2 * kRigChannels);
+     fpsr_board_publish(board, 100);
+     for (auto _ : state) {
+         benchmark::DoNotOptimize(fpsr_board_read(board, 100, 0, out.size(), out.data()));
+         benchmark::ClobberMemory();
+     }
+     fpsr_board_destroy(board);
+     set_eval_counters(state, 2 * kRigChannels);
+ }
+
+ // A point cloud as the Houdini wrangles see it: shared timing parameters, per-point offsets.
+ constexpr int kPoints = 1024;
+
+ // What a wrangle does per point: the snippet's function at @Frame and @Frame - 1, for @changed.
+ void BM_fpsr_vex_sm_wrangle(benchmark::State& state)
+ {
+     int frame = 0;
+     for (auto _ : state) {
+         int changed = 0;
+         for (int i = 0; i < kPoints; ++i) {
+             float value = fpsr_vex_sm(frame, 16, 24, 9, -41 + i, 23 + 7 * i);
+             changed += value != fpsr_vex_sm(frame - 1, 16, 24, 9, -41 + i, 23 + 7 * i);
+         }
+         benchmark::DoNotOptimize(changed);
+         ++frame;
+     }
+     set_eval_counters(state, kPoints);
+ }
+
+ void BM_fpsr_vex_sm_soa(benchmark::State& state)
+ {
+     std::vector<int> minHold(kPoints, 16), maxHold(kPoints, 24), reseed(kPoints, 9), seedInner(kPoints), seedOuter(kPoints);
+     for (int i = 0; i < kPoints; ++i) { seedInner[i] = -41 + i; seedOuter[i] = 23 + 7 * i; }
+     fpsr_sm_soa soa = { minHold.data(), maxHold.data(), reseed.data(), seedInner.data(), seedOuter.data() };
+     std::vector<float> out(kPoints);
+     std::vector<int> changed(kPoints);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_vex_sm_soa(&soa, kPoints, frame, frame - 1, out.data(), changed.data());
+         benchmark::ClobberMemory();
+         ++frame;
+     }
+     set_eval_counters(state, kPoints);
+ }
+
+ void BM_fpsr_vex_qs_wrangle(benchmark::State& state)
+ {
+     const int levels[2] = { 12, 22 };
+     int frame = 0;
+     for (auto _ : state) {
+         int changed = 0;
+         for (int i = 0; i < kPoints; ++i) {
+             const int offsets[2] = { i, 76 + 3 * i };
+             float value = fpsr_vex_qs(frame, 0.012f, 3.1f, levels, offsets, 24, 16, 20);
+             changed += value != fpsr_vex_qs(frame - 1, 0.012f, 3.1f, levels, offsets, 24, 16, 20);
+         }
+         benchmark::DoNotOptimize(changed);
+         ++frame;
+     }
+     set_eval_counters(state, kPoints);
+ }
+
+ void BM_fpsr_vex_qs_soa(benchmark::State& state)
+ {
+     std::vector<float> freq(kPoints, 0.012f), mult(kPoints, 3.1f);
+     std::vector<int> levelMin(kPoints, 12), levelMax(kPoints, 22), offset1(kPoints), offset2(kPoints);
+     std::vector<int> switchDur(kPoints, 24), quant1(kPoints, 16), quant2(kPoints, 20);
+     for (int i = 0; i < kPoints; ++i) { offset1[i] = i; offset2[i] = 76 + 3 * i; }
+     fpsr_qs_soa soa = {
+         freq.data(), mult.data(), levelMin.data(), levelMax.data(), offset1.data(), offset2.data(),
+         switchDur.data(), quant1.data(), quant2.data(),
+     };
+     std::vector<float> out(kPoints);
+     std::vector<int> changed(kPoints);
+     int frame = 0;
+     for (auto _ : state) {
+         fpsr_vex_qs_soa(&soa, kPoints, frame, frame - 1, out.data(), changed.data());
+         benchmark::ClobberMemory();
+         ++frame;
+     }
+     set_eval_counters(state, kPoints);
+ }
+
+ constexpr size_t kBakeInstances = 2048;
+ constexpr size_t kBakeFrames = 1024;
+
+ void BM_fpsr_bake_sm(benchmark::State& state, int threads)
+ {
+     fpsr_thread_pool* pool = fpsr_thread_pool_create(threads);
+     std::vector<fpsr_sm_params> params(kBakeInstances);
+     for (size_t i = 0; i < kBakeInstances; ++i) { params[i] = { 16, 24, 9, -41 + (int)i, 23 + 3 * (int)i }; }
+     std::vector<float> out(kBakeInstances * kBakeFrames);
+     for (auto _ : state) {
+         fpsr_bake_sm(pool, params.data(), kBakeInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         benchmark::ClobberMemory();
+     }
+     state.counters["threads"] = fpsr_thread_pool_size(pool);
+     fpsr_thread_pool_destroy(pool);
+     set_eval_counters(state, double(kBakeInstances * kBakeFrames));
+ }
+
+ void BM_fpsr_bake_qs(benchmark::State& state, int threads)
+ {
+     fpsr_thread_pool* pool = fpsr_thread_pool_create(threads);
+     std::vector<fpsr_qs_plan> plans(kBakeInstances);
+     const int levels[2] = { 12, 22 };
+     for (size_t i = 0; i < kBakeInstances; ++i) {
+         const int offsets[2] = { (int)i, 76 + (int)i };
+         fpsr_qs_plan_init(&plans[i], 0.012f, 3.1f, levels, offsets, 24, 16, 20);
+     }
+     std::vector<float> out(kBakeInstances * kBakeFrames);
+     for (auto _ : state) {
+         fpsr_bake_qs(pool, plans.data(), kBakeInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         benchmark::ClobberMemory();
+     }
+     state.counters["threads"] = fpsr_thread_pool_size(pool);
+     fpsr_thread_pool_destroy(pool);
+     set_eval_counters(state, double(kBakeInstances * kBakeFrames));
+ }
+
+ // Single-threaded bakes along one path, or along fpsr_bake_*_auto()'s with kAutoPath. `calm` selects long holds / slow waves.
+ constexpr int kAutoPath = FPSR_PATH_COUNT;
+ constexpr size_t kPathInstances = 256;
+
+ void BM_fpsr_bake_sm_path(benchmark::State& state, int path, bool calm)
+ {
+     std::vector<fpsr_sm_params> params(kPathInstances);
+     for (size_t i = 0; i < kPathInstances; ++i) {
+         params[i] = calm ? fpsr_sm_params{ 200, 400, 97, -41 + (int)i, 23 + 3 * (int)i }
+                          : fpsr_sm_params{ 1, 3, 5, -41 + (int)i, 23 + 3 * (int)i };
+     }
+     std::vector<float> out(kPathInstances * kBakeFrames);
+     for (auto _ : state) {
+         if (path == kAutoPath) {
+             fpsr_bake_sm_auto(nullptr, nullptr, params.data(), kPathInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         } else {
+             fpsr_bake_sm_path(nullptr, (fpsr_bake_path)path, params.data(), kPathInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         }
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, double(kPathInstances * kBakeFrames));
+ }
+
+ void BM_fpsr_bake_qs_path(benchmark::State& state, int path, bool calm)
+ {
+     std::vector<fpsr_qs_plan> plans(kPathInstances);
+     const int levels[2] = { 12, 22 };
+     for (size_t i = 0; i < kPathInstances; ++i) {
+         const int offsets[2] = { (int)i, 76 + (int)i };
+         if (calm) {
+             fpsr_qs_plan_init(&plans[i], 0.0007f, -1.0f, levels, offsets, 0, 0, 0);
+         } else {
+             fpsr_qs_plan_init(&plans[i], 0.2f, 3.1f, levels, offsets, 24, 16, 20);
+         }
+     }
+     std::vector<float> out(kPathInstances * kBakeFrames);
+     for (auto _ : state) {
+         if (path == kAutoPath) {
+             fpsr_bake_qs_auto(nullptr, nullptr, plans.data(), kPathInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         } else {
+             fpsr_bake_qs_path(nullptr, (fpsr_bake_path)path, plans.data(), kPathInstances, 0, kBakeFrames, out.data(), kBakeFrames);
+         }
+         benchmark::ClobberMemory();
+     }
+     set_eval_counters(state, double(kPathInstances * kBakeFrames));
+ }
+
+ void register_benchmarks()
+ {
+     benchmark::RegisterBenchmark("portable_rand/scalar", BM_portable_rand);
+     benchmark::RegisterBenchmark("portable_rand/hash", BM_portable_rand_hash);
+     for (int i = FPSR_ISA_SCALAR; i <= FPSR_ISA_AVX512; ++i) {
+         fpsr_simd_isa isa = static_cast<fpsr_simd_isa>(i);
+         if (!fpsr_simd_isa_supported(isa)) { continue; }
+         std::string n = std::string("portable_rand_batch/") + isa_name(isa);
+         benchmark::RegisterBenchmark((n + "/exact").c_str(), BM_portable_rand_batch, isa, FPSR_RAND_EXACT);
+         benchmark::RegisterBenchmark((n + "/approx").c_str(), BM_portable_rand_batch, isa, FPSR_RAND_APPROX);
+     }
+
+     for (const SmRegime& p : kSmRegimes) {
+         std::string n = std::string("/") + p.name;
+         benchmark::RegisterBenchmark(("fpsr_sm/scalar" + n).c_str(), BM_fpsr_sm, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/hash_backend" + n).c_str(), BM_portable_rand_hash_sm, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/q16" + n).c_str(), BM_fpsr_sm_q16, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/changed_two_calls" + n).c_str(), BM_fpsr_sm_changed_twice, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/ex" + n).c_str(), BM_fpsr_sm_ex, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/next_change" + n).c_str(), BM_fpsr_sm_next_change, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/batch" + n).c_str(), BM_fpsr_sm_batch, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/range" + n).c_str(), BM_fpsr_sm_range, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/range64" + n).c_str(), BM_fpsr_sm64_range, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/segments" + n).c_str(), BM_fpsr_sm_segments, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/query_value" + n).c_str(), BM_fpsr_sm_query_value, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/index_query" + n).c_str(), BM_fpsr_sm_index_query, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/cursor_forward" + n).c_str(), BM_fpsr_sm_cursor_forward, p);
+         benchmark::RegisterBenchmark(("fpsr_sm/cursor_scrub" + n).c_str(), BM_fpsr_sm_cursor_scrub, p);
+         for (int i = FPSR_ISA_SCALAR; i <= FPSR_ISA_AVX512; ++i) {
+             fpsr_simd_isa isa = static_cast<fpsr_simd_isa>(i);
+             if (!fpsr_simd_isa_supported(isa)) { continue; }
+             benchmark::RegisterBenchmark(("fpsr_sm/soa/" + std::string(isa_name(isa)) + n).c_str(), BM_fpsr_sm_eval_soa, p, isa);
+         }
+     }
+
+     for (const QsRegime& p : kQsRegimes) {
+         std::string n = std::string("/") + p.name;
+         benchmark::RegisterBenchmark(("fpsr_qs/scalar" + n).c_str(), BM_fpsr_qs, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/plan" + n).c_str(), BM_fpsr_qs_eval, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/range64" + n).c_str(), BM_fpsr_qs64_range, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/q16" + n).c_str(), BM_fpsr_qs_q16_eval, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/ex" + n).c_str(), BM_fpsr_qs_ex, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/table" + n).c_str(), BM_fpsr_qs_table, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/curve" + n).c_str(), BM_fpsr_curve_value_at, p);
+         benchmark::RegisterBenchmark(("fpsr_qs/next_change" + n).c_str(), BM_fpsr_qs_next_change, p);
+         for (int i = FPSR_ISA_SCALAR; i <= FPSR_ISA_AVX512; ++i) {
+             fpsr_simd_isa isa = static_cast<fpsr_simd_isa>(i);
+             if (!fpsr_simd_isa_supported(isa)) { continue; }
+             benchmark::RegisterBenchmark(("fpsr_qs/soa/" + std::string(isa_name(isa)) + n).c_str(), BM_fpsr_qs_eval_soa, p, isa);
+         }
+     }
+
+     benchmark::RegisterBenchmark("fpsr_sm/rig/loop", BM_fpsr_sm_rig_loop);
+     benchmark::RegisterBenchmark("fpsr_sm/rig/channels", BM_fpsr_sm_channels);
+     benchmark::RegisterBenchmark("fpsr_qs/rig/loop", BM_fpsr_qs_rig_loop);
+     benchmark::RegisterBenchmark("fpsr_qs/rig/channels", BM_fpsr_qs_channels);
+     benchmark::RegisterBenchmark("fpsr_board/rig/read", BM_fpsr_board_read);
+     benchmark::RegisterBenchmark("fpsr_vex/sm/wrangle", BM_fpsr_vex_sm_wrangle);
+     benchmark::RegisterBenchmark("fpsr_vex/sm/soa_changed", BM_fpsr_vex_sm_soa);
+     benchmark::RegisterBenchmark("fpsr_vex/qs/wrangle", BM_fpsr_vex_qs_wrangle);
+     benchmark::RegisterBenchmark("fpsr_vex/qs/soa_changed", BM_fpsr_vex_qs_soa);
+     benchmark::RegisterBenchmark("fpsr_graph/layered/nested_calls", BM_fpsr_layered_nested_calls);
+     benchmark::RegisterBenchmark("fpsr_graph/layered/program", BM_fpsr_layered_graph);
+
+     benchmark::RegisterBenchmark("fpsr_bake_sm/threads:1", BM_fpsr_bake_sm, 1)->UseRealTime();
+     benchmark::RegisterBenchmark("fpsr_bake_sm/threads:all", BM_fpsr_bake_sm, 0)->UseRealTime();
+     benchmark::RegisterBenchmark("fpsr_bake_qs/threads:1", BM_fpsr_bake_qs, 1)->UseRealTime();
+     benchmark::RegisterBenchmark("fpsr_bake_qs/threads:all", BM_fpsr_bake_qs, 0)->UseRealTime();
+
+     const struct { const char* name; int path; } smPaths[] = {
+         { "scalar", FPSR_PATH_SCALAR }, { "range", FPSR_PATH_RANGE }, { "segments", FPSR_PATH_SEGMENTS },
+         { "simd", FPSR_PATH_SIMD }, { "auto", kAutoPath },
+     };
+     const struct { const char* name; int path; } qsPaths[] = {
+         { "scalar", FPSR_PATH_SCALAR }, { "segments", FPSR_PATH_SEGMENTS }, { "table", FPSR_PATH_TABLE },
+         { "simd", FPSR_PATH_SIMD }, { "auto", kAutoPath },
+     };
+     for (bool calm : { false, true }) {
+         const std::string regime = calm ? "/calm/" : "/busy/";
+         for (const auto& p : smPaths) {
+             benchmark::RegisterBenchmark(("fpsr_bake_sm/path" + regime + p.name).c_str(), BM_fpsr_bake_sm_path, p.path, calm);
+         }
+         for (const auto& p : qsPaths) {
+             benchmark::RegisterBenchmark(("fpsr_bake_qs/path" + regime + p.name).c_str(), BM_fpsr_bake_qs_path, p.path, calm);
+         }
+     }
+ }
+
+ } // namespace
+
+ int main(int argc, char** argv)
+ {
+     register_benchmarks();
+     benchmark::Initialize(&argc, argv);
+     if (benchmark::ReportUnrecognizedArguments(argc, argv)) { return 1; }
+     benchmark::RunSpecifiedBenchmarks();
+     benchmark::Shutdown();
+     return 0;
+ }
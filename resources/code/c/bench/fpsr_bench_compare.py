@@ -0,0 +1,128 @@
+# SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+'''
+file: fpsr_bench_compare.py
+brief: Gates fpsr_bench results against the throughput targets in fpsr_bench_baseline.json.
+details:
+    The baseline holds the items_per_second of every fpsr_bench benchmark, recorded on one
+    machine, and a threshold. --update records the slowest of several runs, so the targets are
+    throughputs the machine reaches every time rather than on a good run. A run fails when any
+    benchmark in the baseline is missing from it or falls below (1 - threshold) times its
+    baseline throughput. Benchmarks the baseline does not know are listed but never fail. Runs
+    with repetitions are compared on their median; without repetitions, on the mean of their
+    entries.
+
+    Throughput only means something on the machine that recorded it: the checked-in baseline
+    is the slowest of four runs on a shared 1-CPU 2.1 GHz x86-64 AVX-512 VM (see its "machine"
+    field). Single benchmarks there varied by up to 30% between runs, so it gates at 30%. Record
+    a new baseline, with --update and a tighter --threshold, on the quiet machine that gates
+    deployments before relying on it there.
+
+    ./fpsr_bench --benchmark_repetitions=3 --benchmark_report_aggregates_only=true \\
+        --benchmark_format=json --benchmark_out=run.json
+    python fpsr_bench_compare.py run.json [--baseline FILE] [--threshold 0.15] [--filter TEXT]
+    python fpsr_bench_compare.py run1.json run2.json ... --update    rewrite the baseline
+'''
+
+import argparse
+import json
+import os
+import sys
+
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'fpsr_bench_baseline.json')
+DEFAULT_THRESHOLD = 0.15  # Fractional drop in items_per_second that counts as a regression.
+
+
+def read_run(path):
+    '''Returns ({benchmark: items_per_second}, context) from Google Benchmark's JSON output.'''
+    with open(path) as f:
+        run = json.load(f)
+    medians, samples = {}, {}
+    for b in run.get('benchmarks', []):
+        if 'items_per_second' not in b or b.get('error_occurred'):
+            continue
+        name = b.get('run_name', b['name'])
+        if b.get('run_type') == 'aggregate':
+            if b.get('aggregate_name') == 'median':
+                medians[name] = b['items_per_second']
+        else:
+            samples.setdefault(name, []).append(b['items_per_second'])
+    rates = {name: sum(v) / len(v) for name, v in samples.items()}
+    rates.update(medians)
+    return rates, run.get('context', {})
+
+
+def describe_machine(context):
+    return '%s CPU(s) at %s MHz, %s build of Google Benchmark, recorded %s' % (
+        context.get('num_cpus', '?'), context.get('mhz_per_cpu', '?'),
+        context.get('library_build_type', '?'), context.get('date', '?'))
+
+
+def update(run_paths, baseline_path, threshold):
+    rates, context = read_run(run_paths[0])
+    for path in run_paths[1:]:
+        more, _ = read_run(path)
+        rates = {name: min(rate, more[name]) for name, rate in rates.items() if name in more}
+    if not rates:
+        print('%s has no items_per_second to record' % ', '.join(run_paths))
+        return 1
+    baseline = {
+        'machine': describe_machine(context),
+        'threshold': threshold,
+        'items_per_second': {name: round(rates[name], 1) for name in sorted(rates)},
+    }
+    with open(baseline_path, 'w') as f:
+        json.dump(baseline, f, indent=1)
+        f.write('\n')
+    print('recorded %d benchmarks from %d run(s) in %s' % (len(rates), len(run_paths), baseline_path))
+    return 0
+
+
+def compare(run_path, baseline_path, threshold, name_filter):
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    if threshold is None:
+        threshold = baseline.get('threshold', DEFAULT_THRESHOLD)
+    rates, context = read_run(run_path)
+    print('baseline: %s' % baseline.get('machine', '?'))
+    print('this run: %s' % describe_machine(context))
+
+    failed = 0
+    for name, want in sorted(baseline['items_per_second'].items()):
+        if name_filter and name_filter not in name:
+            continue
+        got = rates.get(name)
+        if got is None:
+            print('MISSING %-44s' % name)
+            failed += 1
+            continue
+        change = got / want - 1.0
+        status = 'SLOWER ' if change < -threshold else 'ok     '
+        failed += status == 'SLOWER '
+        print('%s %-44s %12.4g/s  baseline %12.4g/s  %+6.1f%%' % (status, name, got, want, 100.0 * change))
+    for name in sorted(set(rates) - set(baseline['items_per_second'])):
+        if not name_filter or name_filter in name:
+            print('new     %-44s %12.4g/s' % (name, rates[name]))
+
+    print('%d regressed or missing beyond %.0f%%' % (failed, 100.0 * threshold))
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[2])
+    parser.add_argument('run', nargs='+', help='JSON written by fpsr_bench --benchmark_format=json')
+    parser.add_argument('--baseline', default=DEFAULT_BASELINE)
+    parser.add_argument('--threshold', type=float, default=None,
+                        help='allowed fractional drop (default: the baseline\'s, else %g)' % DEFAULT_THRESHOLD)
+    parser.add_argument('--filter', default='', help='only compare benchmarks whose name contains this')
+    parser.add_argument('--update', action='store_true', help='rewrite the baseline from the slowest of these runs')
+    args = parser.parse_args()
+    if args.update:
+        return update(args.run, args.baseline, DEFAULT_THRESHOLD if args.threshold is None else args.threshold)
+    if len(args.run) != 1:
+        parser.error('compare one run at a time')
+    return compare(args.run[0], args.baseline, args.threshold, args.filter)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,1897 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_conformance.cpp
+ * @brief Checks the FPS-R backends against the golden corpus in fpsr_golden.txt.
+ * @details The corpus holds 1024 SM and 1024 QS parameter sets, each evaluated
+ * over 2048 consecutive frames with both random backends: 8 Mi (frame, params)
+ * → value tuples. Each row stores its parameters and the CRC-32 (as in
+ * fpsr_curve.c) of its values as little-endian float32, which keeps the file
+ * small. Any implementation can rebuild the tuples from the parameters and
+ * compare checksums (python/fpsr_conformance.py does this for fpsr_native).
+ *
+ * Cases come in groups of 32 that share a start frame, so the SoA, bake and
+ * multi-channel paths see mixed parameters in one call. The start frames cover
+ * 0, moderate, ±2^24 (where (float)seed stops being exact), large, and
+ * INT_MIN / INT_MAX-adjacent windows where offset + frame wraps; the
+ * parameters include every default and clamp branch. Every implementation sums
+ * seeds and offsets with frames in unsigned arithmetic, so the wrapped values
+ * are defined and do not depend on the compiler; a -fsanitize=undefined build
+ * of the runner reports nothing.
+ *
+ * The runner first checks the reference functions (fpsr_sm(), fpsr_qs() and
+ * their FPSR_BACKEND_HASH variants) against the checksums, then compares every
+ * other path frame by frame with them. Exact paths must match every bit; the
+ * paths that are approximate by design (FPSR_RAND_APPROX and the fixed-point QS
+ * sine) only report how many values differ. The fixed-point paths are
+ * compared with floor(reference · 65536); build everything with
+ * -DFPSR_FIXED_APPROX to report the approximate fixed-point SM instead.
+ *
+ * Paths the corpus rows cannot drive are cross-checked afterwards at the same
+ * start frames and seeds: the compile-time templates of fpsr_algorithms.hpp,
+ * for a fixed set of configurations, against fpsr_sm() / fpsr_qs(), and the
+ * batch entry points of the VEX dialect (fpsr_vex.c), values and `changed`,
+ * against its scalar functions. The time-inverse queries (fpsr_query.c) are
+ * compared with a frame-by-frame scan for every op, including truncated
+ * output, over the corpus windows and windows ending at INT_MAX and starting
+ * at INT_MIN. The 64-bit frame functions (fpsr_frame64.c) are compared with
+ * the int API wherever their seeds lie within range, and their range paths
+ * with their pointwise functions, out to the ±FPSR_FRAME64_LIMIT clamps, as
+ * is fpsr_sm_range() across its clamp at INT_MAX. The auto bakes are run
+ * up to INT_MAX and must reject a range one frame past it; so must the
+ * context bakes, without leaving anything allocated. The result board
+ * (fpsr_board.c) is read by three threads while a fourth publishes, and every
+ * value they copy out is compared with the reference, so a torn slot or a read
+ * mixing two ticks shows up as a mismatch. Not covered here: the VEX
+ * dialect against Houdini's own output (it is only checked against itself),
+ * and the NEON path off ARM.
+ *
+ * Build (from resources/code/c):
+ *   cc -O2 -c fpsr_algorithms.c fpsr_simd.c fpsr_bake.c fpsr_curve.c fpsr_fixed.c fpsr_context.c \
+ *       fpsr_graph.c fpsr_board.c fpsr_planner.c fpsr_query.c fpsr_frame64.c fpsr_vex.c
+ *   c++ -O2 -std=c++20 conformance/fpsr_conformance.cpp fpsr_algorithms.o fpsr_simd.o fpsr_bake.o \
+ *       fpsr_curve.o fpsr_fixed.o fpsr_context.o fpsr_graph.o fpsr_board.o fpsr_planner.o \
+ *       fpsr_query.o fpsr_frame64.o fpsr_vex.o -lpthread -lm -o fpsr_conformance
+ * (-std=c++17 leaves out the fpsr_events.hpp checks.)
+ *
+ * Under ThreadSanitizer, build every object above and the runner with
+ * -O1 -g -fsanitize=thread instead of -O2, then run
+ *   ./fpsr_conformance --quick --filter board.threads
+ * gcc warns that TSan does not support atomic_thread_fence. Every field the
+ * board shares is atomic, so TSan still reports any plain data race, but it
+ * does not model the fences' ordering and may miss a reordering they guard
+ * against; the value comparison is what catches a torn read.
+ *
+ * Usage:
+ *   fpsr_conformance [--golden FILE] [--quick] [--filter TEXT]
+ *   fpsr_conformance --dump sm|qs CASE     print the case's tuples, for ports without a C toolchain
+ *   fpsr_conformance --generate            rewrite the corpus from this build's reference
+ * Only regenerate when the reference output is meant to change. Exits 0 when every exact check passes.
+ */
+
+ #include <atomic>
+ #include <chrono>
+ #include <cinttypes>
+ #include <climits>
+ #include <cmath>
+ #include <cstddef>
+ #include <cstdio>
+ #include <cstdlib>
+ #include <cstring>
+ #include <optional>
+ #include <string>
+ #include <thread>
+ #include <vector>
+
+ #include <unistd.h> // For close() and unlink()
+
+ #include "../fpsr_algorithms.h"
+ #include "../../cpp/fpsr_algorithms.hpp"
+ #if __cplusplus >= 202002L
+ #include "../../cpp/fpsr_events.hpp"
+ #endif
+
+ namespace {
+
+ constexpr int kCases = 1024;   // Per algorithm.
+ constexpr int kGroupSize = 32; // Cases sharing a start frame.
+ constexpr int kGroups = kCases / kGroupSize;
+ constexpr int kFrames = 2048;  // Per case.
+ constexpr int kQuickGroups = 8; // One group of each start-frame class.
+ constexpr const char* kDefaultGolden = "conformance/fpsr_golden.txt";
+
+ struct SmCase {
+     int startFrame;
+     fpsr_sm_params p;
+     uint32_t crc[2]; // Per fpsr_rand_backend.
+ };
+
+ struct QsCase {
+     int startFrame;
+     float baseWaveFreq, stream2FreqMult;
+     int quantLevelsMinMax[2], streamsOffset[2];
+     int streamSwitchDur, stream1QuantDur, stream2QuantDur;
+     uint32_t crc[2];
+
+     fpsr_qs_plan plan(fpsr_rand_backend backend) const
+     {
+         fpsr_qs_plan plan;
+         fpsr_qs_plan_init(&plan, baseWaveFreq, stream2FreqMult, quantLevelsMinMax, streamsOffset,
+                           streamSwitchDur, stream1QuantDur, stream2QuantDur);
+         plan.randBackend = backend;
+         return plan;
+     }
+ };
+
+ struct Corpus {
+     std::vector<SmCase> sm;
+     std::vector<QsCase> qs;
+ };
+
+ /******************************************************************************/
+ /* Corpus generation and file format                                          */
+ /******************************************************************************/
+
+ // CRC-32 (IEEE 802.3, reflected), the checksum fpsr_curve.c and zlib.crc32() use.
+ uint32_t crc32_floats(const float* values, size_t n)
+ {
+     static uint32_t table[256];
+     if (table[1] == 0) {
+         for (uint32_t i = 0; i < 256; ++i) {
+             uint32_t c = i;
+             for (int k = 0; k < 8; ++k) { c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+             table[i] = c;
+         }
+     }
+     uint32_t crc = ~0u;
+     for (size_t i = 0; i < n; ++i) {
+         uint32_t bits;
+         std::memcpy(&bits, &values[i], sizeof(bits));
+         for (int b = 0; b < 4; ++b) { crc = table[(crc ^ (bits >> (8 * b))) & 0xFFu] ^ (crc >> 8); }
+     }
+     return ~crc;
+ }
+
+ uint32_t float_bits(float f)
+ {
+     uint32_t bits;
+     std::memcpy(&bits, &f, sizeof(bits));
+     return bits;
+ }
+
+ float bits_float(uint32_t bits)
+ {
+     float f;
+     std::memcpy(&f, &bits, sizeof(f));
+     return f;
+ }
+
+ // Deterministic parameter source for --generate (lowbias32 steps).
+ struct Draw {
+     uint32_t state;
+
+     uint32_t next()
+     {
+         uint32_t x = state += 0x9E3779B9u;
+         x ^= x >> 16; x *= 0x7FEB352Du; x ^= x >> 15; x *= 0x846CA68Bu; x ^= x >> 16;
+         return x;
+     }
+     int range(int lo, int hi)
+     {
+         uint32_t span = static_cast<uint32_t>(hi) - static_cast<uint32_t>(lo) + 1u;
+         return static_cast<int>(static_cast<uint32_t>(lo) + next() % span);
+     }
+     bool chance(uint32_t percent) { return next() % 100u < percent; }
+     float uniform(float lo, float hi) { return lo + static_cast<float>(next() >> 8) * (1.0f / 16777216.0f) * (hi - lo); }
+     int seed() { return chance(50) ? range(-1000, 1000) : static_cast<int>(next()); }
+ };
+
+ // Start frame of a group; the class cycles every kQuickGroups groups.
+ int group_start_frame(Draw& d, int group)
+ {
+     switch (group % kQuickGroups) {
+         case 0: return (group == 0) ? 0 : d.range(-kFrames, kFrames);
+         case 1: return d.range(-100000, 100000);
+         case 2: return (d.chance(50) ? 1 : -1) * ((1 << 24) + d.range(-kFrames, kFrames));
+         case 3: return d.range(-(1 << 30), 1 << 30);
+         case 4: return INT_MAX - (kFrames - 1) - d.range(0, kFrames);
+         case 5: return INT_MIN + d.range(0, kFrames);
+         case 6: return -d.range(1, 1 << 20);
+         default: return d.range(1 << 20, 1 << 28);
+     }
+ }
+
+ void generate_cases(Corpus& corpus)
+ {
+     Draw d{ 0x46505352u }; // "FPSR"
+     corpus.sm.resize(kCases);
+     corpus.qs.resize(kCases);
+     for (int g = 0; g < kGroups; ++g) {
+         int smStart = group_start_frame(d, g);
+         int qsStart = group_start_frame(d, g);
+         for (int c = g * kGroupSize; c < (g + 1) * kGroupSize; ++c) {
+             SmCase& s = corpus.sm[c];
+             s.startFrame = smStart;
+             s.p.minHold = d.chance(10) ? d.range(-5, 0) : d.chance(60) ? d.range(1, 32) : d.range(33, 400);
+             s.p.maxHold = d.chance(10) ? s.p.minHold - d.range(0, 10) : s.p.minHold + d.range(0, 600);
+             s.p.reseedInterval = d.chance(10) ? d.range(-5, 0) : d.chance(50) ? d.range(1, 40) : d.range(41, 2000);
+             s.p.seedInner = d.seed();
+             s.p.seedOuter = d.seed();
+
+             QsCase& q = corpus.qs[c];
+             q.startFrame = qsStart;
+             bool negativeFreq = d.chance(5);
+             q.baseWaveFreq = d.chance(15) ? d.uniform(1e-4f, 1e-3f) : d.chance(70) ? d.uniform(1e-3f, 0.1f) : d.uniform(0.1f, 4.0f);
+             if (negativeFreq) { q.baseWaveFreq = -q.baseWaveFreq; }
+             q.stream2FreqMult = d.chance(20) ? -1.0f : d.uniform(0.25f, 8.0f);
+             for (int k = 0; k < 2; ++k) {
+                 q.quantLevelsMinMax[k] = d.chance(10) ? d.range(-3, 0) : d.range(1, 64);
+                 q.streamsOffset[k] = d.chance(50) ? d.range(-500, 500) : static_cast<int>(d.next());
+             }
+             // Durations < 1 take the frequency-derived defaults, which need a positive frequency.
+             int* durations[3] = { &q.streamSwitchDur, &q.stream1QuantDur, &q.stream2QuantDur };
+             for (int* dur : durations) {
+                 *dur = (!negativeFreq && d.chance(20)) ? d.range(-3, 0) : d.range(1, 300);
+             }
+         }
+     }
+ }
+
+ int write_corpus(const Corpus& corpus, const char* path)
+ {
+     FILE* f = std::fopen(path, "w");
+     if (f == nullptr) { return -1; }
+     std::fprintf(f, "# FPS-R golden corpus, version 1. Generated by conformance/fpsr_conformance.cpp --generate.\n");
+     std::fprintf(f, "# Each row covers frames startFrame .. startFrame + frames - 1; crcSin / crcHash are the CRC-32 of\n");
+     std::fprintf(f, "# the values as little-endian float32 with FPSR_BACKEND_SIN / FPSR_BACKEND_HASH. Floats are bit patterns.\n");
+     std::fprintf(f, "# sm case startFrame frames minHold maxHold reseedInterval seedInner seedOuter crcSin crcHash\n");
+     std::fprintf(f, "# qs case startFrame frames baseWaveFreq stream2FreqMult quantLevelMin quantLevelMax stream1Offset stream2Offset"
+                     " streamSwitchDur stream1QuantDur stream2QuantDur crcSin crcHash\n");
+     for (int c = 0; c < kCases; ++c) {
+         const SmCase& s = corpus.sm[c];
+         std::fprintf(f, "sm %d %d %d %d %d %d %d %d %08" PRIx32 " %08" PRIx32 "\n", c, s.startFrame, kFrames,
+                      s.p.minHold, s.p.maxHold, s.p.reseedInterval, s.p.seedInner, s.p.seedOuter, s.crc[0], s.crc[1]);
+     }
+     for (int c = 0; c < kCases; ++c) {
+         const QsCase& q = corpus.qs[c];
+         std::fprintf(f, "qs %d %d %d %08" PRIx32 " %08" PRIx32 " %d %d %d %d %d %d %d %08" PRIx32 " %08" PRIx32 "\n",
+                      c, q.startFrame, kFrames, float_bits(q.baseWaveFreq), float_bits(q.stream2FreqMult),
+                      q.quantLevelsMinMax[0], q.quantLevelsMinMax[1], q.streamsOffset[0], q.streamsOffset[1],
+                      q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur, q.crc[0], q.crc[1]);
+     }
+     return (std::fclose(f) == 0) ? 0 : -1;
+ }
+
+ int read_corpus(Corpus& corpus, const char* path)
+ {
+     FILE* f = std::fopen(path, "r");
+     if (f == nullptr) { return -1; }
+     corpus.sm.assign(kCases, SmCase{});
+     corpus.qs.assign(kCases, QsCase{});
+     std::vector<char> seen(2 * kCases, 0);
+     char line[512];
+     int ok = 1;
+     while (ok && std::fgets(line, sizeof(line), f) != nullptr) {
+         if (line[0] == '#' || line[0] == '\n') { continue; }
+         int c = -1, frames = 0;
+         if (std::strncmp(line, "sm ", 3) == 0) {
+             SmCase s;
+             ok = std::sscanf(line + 3, "%d %d %d %d %d %d %d %d %" SCNx32 " %" SCNx32, &c, &s.startFrame, &frames,
+                              &s.p.minHold, &s.p.maxHold, &s.p.reseedInterval, &s.p.seedInner, &s.p.seedOuter,
+                              &s.crc[0], &s.crc[1]) == 10;
+             ok = ok && c >= 0 && c < kCases && frames == kFrames && !seen[c];
+             if (ok) { corpus.sm[c] = s; seen[c] = 1; }
+         } else if (std::strncmp(line, "qs ", 3) == 0) {
+             QsCase q;
+             uint32_t freq, mult;
+             ok = std::sscanf(line + 3, "%d %d %d %" SCNx32 " %" SCNx32 " %d %d %d %d %d %d %d %" SCNx32 " %" SCNx32,
+                              &c, &q.startFrame, &frames, &freq, &mult,
+                              &q.quantLevelsMinMax[0], &q.quantLevelsMinMax[1], &q.streamsOffset[0], &q.streamsOffset[1],
+                              &q.streamSwitchDur, &q.stream1QuantDur, &q.stream2QuantDur, &q.crc[0], &q.crc[1]) == 14;
+             ok = ok && c >= 0 && c < kCases && frames == kFrames && !seen[kCases + c];
+             if (ok) {
+                 q.baseWaveFreq = bits_float(freq);
+                 q.stream2FreqMult = bits_float(mult);
+                 corpus.qs[c] = q;
+                 seen[kCases + c] = 1;
+             }
+         } else {
+             ok = 0;
+         }
+     }
+     std::fclose(f);
+     for (char s : seen) { ok = ok && s; }
+     return ok ? 0 : -1;
+ }
+
+ /******************************************************************************/
+ /* Backends                                                                   */
+ /******************************************************************************/
+
+ // Writes out[i * kFrames + f] for the group's cases i and frames startFrame + f; false on an error.
+ template <typename Case>
+ using Run = bool (*)(const Case* group, float* out);
+
+ // Backends that run with whatever ISA fpsr_simd.c picked.
+ constexpr std::optional<fpsr_simd_isa> kAnyIsa = std::nullopt;
+
+ // Instances of the first SoA call; the rest go through a second call, so the SIMD tails run too.
+ constexpr int kSoaSplit = 27;
+
+ // fpsr_fixed.c built with FPSR_FIXED_APPROX no longer rounds the SM hold as floats do.
+ #ifdef FPSR_FIXED_APPROX
+ #define FPSR_SM_Q16_EXPECT Expect::Q16Approx
+ #else
+ #define FPSR_SM_Q16_EXPECT Expect::Q16
+ #endif
+
+ enum class Expect {
+     Exact,     // Every bit equal to the reference.
+     Q16,       // q / 65536 equal to floor(reference · 65536) / 65536 for every value.
+     Approx,    // Reported only: approximate by design.
+     Q16Approx  // Q16, reported only.
+ };
+
+ struct SmBackend {
+     const char* name;
+     fpsr_rand_backend rand;
+     Expect expect;
+     Run<SmCase> run;
+     std::optional<fpsr_simd_isa> isa; // Forced for the SIMD paths; kAnyIsa otherwise.
+ };
+
+ struct QsBackend {
+     const char* name;
+     fpsr_rand_backend rand;
+     Expect expect;
+     Run<QsCase> run;
+     std::optional<fpsr_simd_isa> isa;
+ };
+
+ // --- SM ---
+
+ template <fpsr_rand_backend B>
+ bool sm_reference(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         for (int f = 0; f < kFrames; ++f) {
+             out[i * kFrames + f] = (B == FPSR_BACKEND_SIN)
+                 ? fpsr_sm(g[i].startFrame + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter)
+                 : fpsr_sm_backend(B, g[i].startFrame + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+     }
+     return true;
+ }
+
+ bool sm_batch(const SmCase* g, float* out)
+ {
+     std::vector<int> frames(kFrames);
+     std::vector<float> rev(kFrames);
+     for (int i = 0; i < kGroupSize; ++i) {
+         // Reversed, so nothing relies on ascending frames.
+         for (int f = 0; f < kFrames; ++f) { frames[f] = g[i].startFrame + (kFrames - 1 - f); }
+         const fpsr_sm_params& p = g[i].p;
+         fpsr_sm_batch(frames.data(), rev.data(), kFrames, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         for (int f = 0; f < kFrames; ++f) { out[i * kFrames + f] = rev[kFrames - 1 - f]; }
+     }
+     return true;
+ }
+
+ bool sm_range(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         fpsr_sm_range(g[i].startFrame, kFrames, out + i * kFrames, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+     }
+     return true;
+ }
+
+ bool sm_segments(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         fpsr_sm_segment_iter it;
+         fpsr_sm_segment seg;
+         int start = g[i].startFrame;
+         long long covered = start;
+         fpsr_sm_segments_begin(&it, start, start + (kFrames - 1), p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         while (fpsr_sm_segments_next(&it, &seg)) {
+             if (seg.startFrame != covered || seg.endFrame < seg.startFrame) { return false; }
+             for (long long f = seg.startFrame; f <= seg.endFrame; ++f) { out[i * kFrames + (f - start)] = seg.value; }
+             covered = static_cast<long long>(seg.endFrame) + 1;
+         }
+         if (covered != static_cast<long long>(start) + kFrames) { return false; }
+     }
+     return true;
+ }
+
+ template <bool Reverse>
+ bool sm_cursor(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         fpsr_sm_cursor cursor;
+         fpsr_sm_cursor_init(&cursor, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         for (int k = 0; k < kFrames; ++k) {
+             int f = Reverse ? kFrames - 1 - k : k;
+             out[i * kFrames + f] = fpsr_sm_cursor_eval(&cursor, g[i].startFrame + f);
+         }
+     }
+     return true;
+ }
+
+ // fpsr_sm_ex(), with `changed` and `framesUntilChange` checked against the values themselves.
+ bool sm_ex(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         float* o = out + i * kFrames;
+         int untilChange = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             int changed, until;
+             int frame = g[i].startFrame + f;
+             o[f] = fpsr_sm_ex(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter, &changed, &until);
+             if (f > 0 && (changed != (float_bits(o[f]) != float_bits(o[f - 1])) || (!changed && until != untilChange - 1))) { return false; }
+             untilChange = until;
+         }
+     }
+     return true;
+ }
+
+ // Fills each run up to fpsr_sm_next_change() with its first value.
+ bool sm_next_change(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         int f = 0;
+         while (f < kFrames) {
+             int frame = g[i].startFrame + f;
+             float v = fpsr_sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             long long next = (frame == INT_MAX) ? 1LL + INT_MAX
+                 : fpsr_sm_next_change(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             if (next <= frame) { return false; }
+             long long end = next - g[i].startFrame;
+             for (; f < kFrames && f < end; ++f) { out[i * kFrames + f] = v; }
+         }
+     }
+     return true;
+ }
+
+ template <fpsr_rand_mode Mode>
+ bool sm_soa(const SmCase* g, float* out)
+ {
+     int minHold[kGroupSize], maxHold[kGroupSize], reseed[kGroupSize], inner[kGroupSize], outer[kGroupSize];
+     for (int i = 0; i < kGroupSize; ++i) {
+         minHold[i] = g[i].p.minHold; maxHold[i] = g[i].p.maxHold; reseed[i] = g[i].p.reseedInterval;
+         inner[i] = g[i].p.seedInner; outer[i] = g[i].p.seedOuter;
+     }
+     fpsr_sm_soa soa = { minHold, maxHold, reseed, inner, outer };
+     fpsr_sm_soa tail = { minHold + kSoaSplit, maxHold + kSoaSplit, reseed + kSoaSplit, inner + kSoaSplit, outer + kSoaSplit };
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_sm_eval_soa(&soa, kSoaSplit, g[0].startFrame + f, column, Mode);
+         fpsr_sm_eval_soa(&tail, kGroupSize - kSoaSplit, g[0].startFrame + f, column + kSoaSplit, Mode);
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     return true;
+ }
+
+ std::vector<fpsr_sm_params> sm_params(const SmCase* g)
+ {
+     std::vector<fpsr_sm_params> params(kGroupSize);
+     for (int i = 0; i < kGroupSize; ++i) { params[i] = g[i].p; }
+     return params;
+ }
+
+ bool sm_bake(const SmCase* g, float* out)
+ {
+     static fpsr_thread_pool* pool = fpsr_thread_pool_create(0);
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     return fpsr_bake_sm(pool, params.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+ }
+
+ // One bake path, or fpsr_bake_*_auto() for kAutoPath.
+ constexpr int kAutoPath = FPSR_PATH_COUNT;
+
+ template <int Path>
+ bool sm_bake_path(const SmCase* g, float* out)
+ {
+     static fpsr_thread_pool* pool = fpsr_thread_pool_create(0);
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     if (Path == kAutoPath) {
+         return fpsr_bake_sm_auto(pool, nullptr, params.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+     }
+     return fpsr_bake_sm_path(pool, (fpsr_bake_path)Path, params.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+ }
+
+ bool sm_channels(const SmCase* g, float* out)
+ {
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     fpsr_sm_channels channels;
+     if (fpsr_sm_channels_init(&channels, params.data(), kGroupSize) != 0) { return false; }
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_sm_channels_eval(&channels, g[0].startFrame + f, column);
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     fpsr_sm_channels_free(&channels);
+     return true;
+ }
+
+ // An arena big enough for a group's context and a few frames of output; reused by every case.
+ fpsr_arena* conformance_arena()
+ {
+     static std::vector<std::max_align_t> block((fpsr_context_memory(kGroupSize, kGroupSize) + 64 * 1024) / sizeof(std::max_align_t) + 1);
+     static fpsr_arena arena;
+     fpsr_arena_init(&arena, block.data(), block.size() * sizeof(std::max_align_t));
+     return &arena;
+ }
+
+ // Publishes each frame to the board and reads the group back; a read that misses the board fails.
+ bool read_board(fpsr_board* board, int startFrame, float* out)
+ {
+     bool ok = board != nullptr;
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames && ok; ++f) {
+         fpsr_board_publish(board, startFrame + f);
+         ok = fpsr_board_read(board, startFrame + f, 0, kGroupSize, column) == 0;
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     fpsr_board_destroy(board);
+     return ok;
+ }
+
+ bool sm_board(const SmCase* g, float* out)
+ {
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     return read_board(fpsr_board_create(params.data(), kGroupSize, nullptr, 0), g[0].startFrame, out);
+ }
+
+ // A graph node for the frame: the frame node itself (range paths), or frame + 0.25, which
+ // floors to the same frame through the driven, per-frame paths.
+ int graph_frame_input(fpsr_graph* graph, bool driven)
+ {
+     int frame = fpsr_graph_frame(graph, 0);
+     return driven ? fpsr_graph_combine(graph, FPSR_COMBINE_ADD, frame, fpsr_graph_constant(graph, 0.25)) : frame;
+ }
+
+ // Compiles one output per case and evaluates the group's frames.
+ bool run_graph(fpsr_graph* graph, const std::vector<int>& outputs, int startFrame, float* out)
+ {
+     fpsr_program* program = fpsr_program_compile(graph, outputs.data(), outputs.size());
+     bool ok = program != nullptr && fpsr_program_eval(program, startFrame, kFrames, out, kFrames) == 0;
+     fpsr_program_destroy(program);
+     fpsr_graph_destroy(graph);
+     return ok;
+ }
+
+ template <bool Driven>
+ bool sm_graph(const SmCase* g, float* out)
+ {
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     fpsr_graph* graph = fpsr_graph_create();
+     int frame = graph_frame_input(graph, Driven);
+     std::vector<int> outputs;
+     for (const fpsr_sm_params& p : params) { outputs.push_back(fpsr_graph_sm(graph, frame, &p)); }
+     return run_graph(graph, outputs, g[0].startFrame, out);
+ }
+
+ template <bool Segments>
+ bool sm_context(const SmCase* g, float* out)
+ {
+     std::vector<fpsr_sm_params> params = sm_params(g);
+     fpsr_context ctx;
+     if (fpsr_context_init(&ctx, conformance_arena(), params.data(), kGroupSize, nullptr, 0) != 0) { return false; }
+     for (int f = 0; f < kFrames && !Segments; ++f) {
+         fpsr_context_begin_frame(&ctx);
+         const float* column = fpsr_context_eval_sm(&ctx, g[0].startFrame + f);
+         if (column == nullptr) { return false; }
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     for (int i = 0; i < kGroupSize && Segments; ++i) {
+         fpsr_context_begin_frame(&ctx);
+         size_t count = 0;
+         const fpsr_sm_segment* seg = fpsr_context_sm_segments(&ctx, i, g[0].startFrame, g[0].startFrame + (kFrames - 1), &count);
+         if (seg == nullptr) { return false; }
+         for (size_t k = 0; k < count; ++k) {
+             for (long long f = seg[k].startFrame; f <= seg[k].endFrame; ++f) { out[i * kFrames + (f - g[0].startFrame)] = seg[k].value; }
+         }
+     }
+     return true;
+ }
+
+ // Writes a scratch curve file, hands it to `read`, and removes it.
+ template <typename Add, typename Read>
+ bool with_curve_file(Add add, Read read)
+ {
+     const char* tmp = std::getenv("TMPDIR");
+     std::string path = std::string((tmp != nullptr && *tmp != '\0') ? tmp : "/tmp") + "/fpsr_conformance_XXXXXX";
+     int fd = mkstemp(&path[0]);
+     if (fd < 0) { return false; }
+     close(fd);
+     fpsr_curve_writer* writer = fpsr_curve_writer_open(path.c_str());
+     bool ok = writer != nullptr && add(writer);
+     ok = fpsr_curve_writer_close(writer) == 0 && ok;
+     fpsr_curve_file* file = ok ? fpsr_curve_open(path.c_str(), FPSR_CURVE_VERIFY_SEGMENTS) : nullptr;
+     ok = file != nullptr && read(file);
+     fpsr_curve_close(file);
+     unlink(path.c_str());
+     return ok;
+ }
+
+ bool sm_curve(const SmCase* g, float* out)
+ {
+     return with_curve_file(
+         [&](fpsr_curve_writer* w) {
+             for (int i = 0; i < kGroupSize; ++i) {
+                 if (fpsr_curve_writer_add_sm(w, &g[i].p, g[i].startFrame, g[i].startFrame + (kFrames - 1)) != i) { return false; }
+             }
+             return true;
+         },
+         [&](fpsr_curve_file* file) {
+             for (int i = 0; i < kGroupSize; ++i) {
+                 for (int f = 0; f < kFrames; ++f) { out[i * kFrames + f] = fpsr_curve_value_at(file, i, g[i].startFrame + f); }
+             }
+             return true;
+         });
+ }
+
+ bool sm_q16(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         for (int f = 0; f < kFrames; ++f) {
+             fpsr_q16 q = fpsr_sm_q16(g[i].startFrame + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             out[i * kFrames + f] = static_cast<float>(q) / FPSR_Q16_ONE;
+         }
+     }
+     return true;
+ }
+
+ bool sm_cpp(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const fpsr_sm_params& p = g[i].p;
+         fpsr::StackedModuloRuntime sm(p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = g[i].startFrame + f;
+             out[i * kFrames + f] = sm(frame);
+             if (float_bits(out[i * kFrames + f]) != float_bits(fpsr::sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter))) {
+                 return false;
+             }
+         }
+     }
+     return true;
+ }
+
+ #if __cplusplus >= 202002L
+ // Rebuilds the values from fpsr::changes(): the frame before each change holds the previous value.
+ template <typename Source>
+ bool fill_from_changes(const Source& source, int startFrame, float* o)
+ {
+     int last = startFrame + (kFrames - 1);
+     long long f = startFrame;
+     bool first = true;
+     float held = 0.0f;
+     for (fpsr::Change c : fpsr::changes(source, startFrame, last)) {
+         if (first != (c.frame == startFrame) || c.frame < f) { return false; }
+         for (; f < c.frame; ++f) { o[f - startFrame] = held; }
+         held = c.value;
+         first = false;
+     }
+     for (; f <= last; ++f) { o[f - startFrame] = held; }
+     return !first;
+ }
+
+ bool sm_events(const SmCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         if (!fill_from_changes(g[i].p, g[i].startFrame, out + i * kFrames)) { return false; }
+     }
+     return true;
+ }
+ #endif
+
+ const SmBackend kSmBackends[] = {
+     { "c.sm_batch", FPSR_BACKEND_SIN, Expect::Exact, sm_batch, kAnyIsa },
+     { "c.sm_range", FPSR_BACKEND_SIN, Expect::Exact, sm_range, kAnyIsa },
+     { "c.sm_segments", FPSR_BACKEND_SIN, Expect::Exact, sm_segments, kAnyIsa },
+     { "c.sm_cursor", FPSR_BACKEND_SIN, Expect::Exact, sm_cursor<false>, kAnyIsa },
+     { "c.sm_cursor_reverse", FPSR_BACKEND_SIN, Expect::Exact, sm_cursor<true>, kAnyIsa },
+     { "c.sm_ex", FPSR_BACKEND_SIN, Expect::Exact, sm_ex, kAnyIsa },
+     { "c.sm_next_change", FPSR_BACKEND_SIN, Expect::Exact, sm_next_change, kAnyIsa },
+     { "simd.sm_eval_soa.scalar", FPSR_BACKEND_SIN, Expect::Exact, sm_soa<FPSR_RAND_EXACT>, FPSR_ISA_SCALAR },
+     { "simd.sm_eval_soa.neon", FPSR_BACKEND_SIN, Expect::Exact, sm_soa<FPSR_RAND_EXACT>, FPSR_ISA_NEON },
+     { "simd.sm_eval_soa.avx2", FPSR_BACKEND_SIN, Expect::Exact, sm_soa<FPSR_RAND_EXACT>, FPSR_ISA_AVX2 },
+     { "simd.sm_eval_soa.avx512", FPSR_BACKEND_SIN, Expect::Exact, sm_soa<FPSR_RAND_EXACT>, FPSR_ISA_AVX512 },
+     { "simd.sm_eval_soa.approx", FPSR_BACKEND_SIN, Expect::Approx, sm_soa<FPSR_RAND_APPROX>, FPSR_ISA_SCALAR },
+     { "bake.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_bake, kAnyIsa },
+     { "bake.sm_scalar", FPSR_BACKEND_SIN, Expect::Exact, sm_bake_path<FPSR_PATH_SCALAR>, kAnyIsa },
+     { "bake.sm_segments", FPSR_BACKEND_SIN, Expect::Exact, sm_bake_path<FPSR_PATH_SEGMENTS>, kAnyIsa },
+     { "bake.sm_simd", FPSR_BACKEND_SIN, Expect::Exact, sm_bake_path<FPSR_PATH_SIMD>, kAnyIsa },
+     { "bake.sm_auto", FPSR_BACKEND_SIN, Expect::Exact, sm_bake_path<kAutoPath>, kAnyIsa },
+     { "channels.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_channels, kAnyIsa },
+     { "context.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_context<false>, kAnyIsa },
+     { "context.sm_segments", FPSR_BACKEND_SIN, Expect::Exact, sm_context<true>, kAnyIsa },
+     { "board.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_board, kAnyIsa },
+     { "graph.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_graph<false>, kAnyIsa },
+     { "graph.sm_driven", FPSR_BACKEND_SIN, Expect::Exact, sm_graph<true>, kAnyIsa },
+     { "curve.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_curve, kAnyIsa },
+     { "cpp.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_cpp, kAnyIsa },
+ #if __cplusplus >= 202002L
+     { "cpp.events.sm", FPSR_BACKEND_SIN, Expect::Exact, sm_events, kAnyIsa },
+ #endif
+     { "fixed.sm_q16", FPSR_BACKEND_HASH, FPSR_SM_Q16_EXPECT, sm_q16, kAnyIsa },
+ };
+
+ // --- QS ---
+
+ template <fpsr_rand_backend B>
+ bool qs_reference(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const QsCase& q = g[i];
+         for (int f = 0; f < kFrames; ++f) {
+             out[i * kFrames + f] = (B == FPSR_BACKEND_SIN)
+                 ? fpsr_qs(q.startFrame + f, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                           q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur)
+                 : fpsr_qs_backend(B, q.startFrame + f, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                                   q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+         }
+     }
+     return true;
+ }
+
+ template <fpsr_rand_backend B>
+ bool qs_plan(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         fpsr_qs_plan plan = g[i].plan(B);
+         for (int f = 0; f < kFrames; ++f) { out[i * kFrames + f] = fpsr_qs_eval(&plan, g[i].startFrame + f); }
+     }
+     return true;
+ }
+
+ // fpsr_qs_ex() and fpsr_qs_plan_eval_ex(), with `changed` and `framesUntilChange` checked as for sm_ex().
+ bool qs_ex(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const QsCase& q = g[i];
+         fpsr_qs_plan plan = q.plan(FPSR_BACKEND_SIN);
+         float* o = out + i * kFrames;
+         int untilChange = 0;
+         for (int f = 0; f < kFrames; ++f) {
+             int changed, until, planChanged, planUntil;
+             int frame = q.startFrame + f;
+             o[f] = fpsr_qs_ex(frame, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                               q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur, &changed, &until);
+             float planValue = fpsr_qs_plan_eval_ex(&plan, frame, &planChanged, &planUntil);
+             if (float_bits(planValue) != float_bits(o[f]) || planChanged != changed || planUntil != until) { return false; }
+             if (f > 0 && changed != (float_bits(o[f]) != float_bits(o[f - 1]))) { return false; }
+             if (f > 0 && !changed && untilChange < FPSR_QS_CHANGE_HORIZON && until != untilChange - 1) { return false; }
+             untilChange = until;
+         }
+     }
+     return true;
+ }
+
+ bool qs_next_change(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         fpsr_qs_plan plan = g[i].plan(FPSR_BACKEND_SIN);
+         int f = 0;
+         while (f < kFrames) {
+             int frame = g[i].startFrame + f;
+             float v = fpsr_qs_eval(&plan, frame);
+             long long next = (frame == INT_MAX) ? 1LL + INT_MAX : fpsr_qs_plan_next_change(&plan, frame);
+             if (next <= frame) { return false; }
+             long long end = next - g[i].startFrame;
+             for (; f < kFrames && f < end; ++f) { out[i * kFrames + f] = v; }
+         }
+     }
+     return true;
+ }
+
+ bool qs_table(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         fpsr_qs_plan plan = g[i].plan(FPSR_BACKEND_SIN);
+         fpsr_qs_table table;
+         // Built over the middle of the window, so lookups on both sides fall back to fpsr_qs_eval().
+         int first = g[i].startFrame + kFrames / 8;
+         if (fpsr_qs_table_build(&table, &plan, first, first + (kFrames * 3 / 4)) != 0) { return false; }
+         for (int f = 0; f < kFrames; ++f) { out[i * kFrames + f] = fpsr_qs_table_eval(&table, g[i].startFrame + f); }
+         fpsr_qs_table_free(&table);
+     }
+     return true;
+ }
+
+ template <fpsr_rand_mode Mode>
+ bool qs_soa(const QsCase* g, float* out)
+ {
+     float freq[kGroupSize], mult[kGroupSize];
+     int qmin[kGroupSize], qmax[kGroupSize], o1[kGroupSize], o2[kGroupSize], sw[kGroupSize], d1[kGroupSize], d2[kGroupSize];
+     for (int i = 0; i < kGroupSize; ++i) {
+         freq[i] = g[i].baseWaveFreq; mult[i] = g[i].stream2FreqMult;
+         qmin[i] = g[i].quantLevelsMinMax[0]; qmax[i] = g[i].quantLevelsMinMax[1];
+         o1[i] = g[i].streamsOffset[0]; o2[i] = g[i].streamsOffset[1];
+         sw[i] = g[i].streamSwitchDur; d1[i] = g[i].stream1QuantDur; d2[i] = g[i].stream2QuantDur;
+     }
+     fpsr_qs_soa soa = { freq, mult, qmin, qmax, o1, o2, sw, d1, d2 };
+     const int k = kSoaSplit;
+     fpsr_qs_soa tail = { freq + k, mult + k, qmin + k, qmax + k, o1 + k, o2 + k, sw + k, d1 + k, d2 + k };
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_qs_eval_soa(&soa, kSoaSplit, g[0].startFrame + f, column, Mode);
+         fpsr_qs_eval_soa(&tail, kGroupSize - kSoaSplit, g[0].startFrame + f, column + kSoaSplit, Mode);
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     return true;
+ }
+
+ // The same SoA kernel after fpsr_qs_soa_resolve() has written the defaults.
+ bool qs_soa_resolved(const QsCase* g, float* out)
+ {
+     float freq[kGroupSize], mult[kGroupSize], rmult[kGroupSize];
+     int qmin[kGroupSize], qmax[kGroupSize], o1[kGroupSize], o2[kGroupSize], sw[kGroupSize], d1[kGroupSize], d2[kGroupSize];
+     int rsw[kGroupSize], rd1[kGroupSize], rd2[kGroupSize];
+     for (int i = 0; i < kGroupSize; ++i) {
+         freq[i] = g[i].baseWaveFreq; mult[i] = g[i].stream2FreqMult;
+         qmin[i] = g[i].quantLevelsMinMax[0]; qmax[i] = g[i].quantLevelsMinMax[1];
+         o1[i] = g[i].streamsOffset[0]; o2[i] = g[i].streamsOffset[1];
+         sw[i] = g[i].streamSwitchDur; d1[i] = g[i].stream1QuantDur; d2[i] = g[i].stream2QuantDur;
+     }
+     fpsr_qs_soa soa = { freq, mult, qmin, qmax, o1, o2, sw, d1, d2 };
+     fpsr_qs_soa_resolve(&soa, kGroupSize, rsw, rd1, rd2, rmult);
+     fpsr_qs_soa resolved = { freq, rmult, qmin, qmax, o1, o2, rsw, rd1, rd2 };
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_qs_eval_soa(&resolved, kGroupSize, g[0].startFrame + f, column, FPSR_RAND_EXACT);
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     return true;
+ }
+
+ std::vector<fpsr_qs_plan> qs_plans(const QsCase* g, fpsr_rand_backend backend)
+ {
+     std::vector<fpsr_qs_plan> plans(kGroupSize);
+     for (int i = 0; i < kGroupSize; ++i) { plans[i] = g[i].plan(backend); }
+     return plans;
+ }
+
+ bool qs_bake(const QsCase* g, float* out)
+ {
+     static fpsr_thread_pool* pool = fpsr_thread_pool_create(0);
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     return fpsr_bake_qs(pool, plans.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+ }
+
+ template <int Path>
+ bool qs_bake_path(const QsCase* g, float* out)
+ {
+     static fpsr_thread_pool* pool = fpsr_thread_pool_create(0);
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     if (Path == kAutoPath) {
+         return fpsr_bake_qs_auto(pool, nullptr, plans.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+     }
+     return fpsr_bake_qs_path(pool, (fpsr_bake_path)Path, plans.data(), kGroupSize, g[0].startFrame, kFrames, out, kFrames) == 0;
+ }
+
+ bool qs_channels(const QsCase* g, float* out)
+ {
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     fpsr_qs_channels channels;
+     if (fpsr_qs_channels_init(&channels, plans.data(), kGroupSize) != 0) { return false; }
+     float column[kGroupSize];
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_qs_channels_eval(&channels, g[0].startFrame + f, column);
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     fpsr_qs_channels_free(&channels);
+     return true;
+ }
+
+ template <bool Driven>
+ bool qs_graph(const QsCase* g, float* out)
+ {
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     fpsr_graph* graph = fpsr_graph_create();
+     int frame = graph_frame_input(graph, Driven);
+     std::vector<int> outputs;
+     for (const fpsr_qs_plan& p : plans) { outputs.push_back(fpsr_graph_qs(graph, frame, &p)); }
+     return run_graph(graph, outputs, g[0].startFrame, out);
+ }
+
+ bool qs_context(const QsCase* g, float* out)
+ {
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     fpsr_context ctx;
+     if (fpsr_context_init(&ctx, conformance_arena(), nullptr, 0, plans.data(), kGroupSize) != 0) { return false; }
+     for (int f = 0; f < kFrames; ++f) {
+         fpsr_context_begin_frame(&ctx);
+         const float* column = fpsr_context_eval_qs(&ctx, g[0].startFrame + f);
+         if (column == nullptr) { return false; }
+         for (int i = 0; i < kGroupSize; ++i) { out[i * kFrames + f] = column[i]; }
+     }
+     return true;
+ }
+
+ bool qs_board(const QsCase* g, float* out)
+ {
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     return read_board(fpsr_board_create(nullptr, 0, plans.data(), kGroupSize), g[0].startFrame, out);
+ }
+
+ bool qs_curve(const QsCase* g, float* out)
+ {
+     std::vector<fpsr_qs_plan> plans = qs_plans(g, FPSR_BACKEND_SIN);
+     return with_curve_file(
+         [&](fpsr_curve_writer* w) {
+             for (int i = 0; i < kGroupSize; ++i) {
+                 if (fpsr_curve_writer_add_qs(w, &plans[i], g[i].startFrame, g[i].startFrame + (kFrames - 1)) != i) { return false; }
+             }
+             return true;
+         },
+         [&](fpsr_curve_file* file) {
+             for (int i = 0; i < kGroupSize; ++i) {
+                 for (int f = 0; f < kFrames; ++f) { out[i * kFrames + f] = fpsr_curve_value_at(file, i, g[i].startFrame + f); }
+             }
+             return true;
+         });
+ }
+
+ bool qs_q16(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         fpsr_qs_plan plan = g[i].plan(FPSR_BACKEND_HASH);
+         fpsr_qs_q16_plan q16;
+         fpsr_qs_q16_plan_from(&q16, &plan);
+         for (int f = 0; f < kFrames; ++f) {
+             out[i * kFrames + f] = static_cast<float>(fpsr_qs_q16_eval(&q16, g[i].startFrame + f)) / FPSR_Q16_ONE;
+         }
+     }
+     return true;
+ }
+
+ bool qs_cpp(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         const QsCase& q = g[i];
+         fpsr::QuantisedSwitchingRuntime qs(q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                                            q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = q.startFrame + f;
+             out[i * kFrames + f] = qs(frame);
+             float direct = fpsr::qs(frame, q.baseWaveFreq, q.stream2FreqMult, q.quantLevelsMinMax, q.streamsOffset,
+                                     q.streamSwitchDur, q.stream1QuantDur, q.stream2QuantDur);
+             if (float_bits(direct) != float_bits(out[i * kFrames + f])) { return false; }
+         }
+     }
+     return true;
+ }
+
+ #if __cplusplus >= 202002L
+ bool qs_events(const QsCase* g, float* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         if (!fill_from_changes(g[i].plan(FPSR_BACKEND_SIN), g[i].startFrame, out + i * kFrames)) { return false; }
+     }
+     return true;
+ }
+ #endif
+
+ const QsBackend kQsBackends[] = {
+     { "c.qs_eval", FPSR_BACKEND_SIN, Expect::Exact, qs_plan<FPSR_BACKEND_SIN>, kAnyIsa },
+     { "c.qs_ex", FPSR_BACKEND_SIN, Expect::Exact, qs_ex, kAnyIsa },
+     { "c.qs_next_change", FPSR_BACKEND_SIN, Expect::Exact, qs_next_change, kAnyIsa },
+     { "c.qs_table", FPSR_BACKEND_SIN, Expect::Exact, qs_table, kAnyIsa },
+     { "simd.qs_eval_soa.scalar", FPSR_BACKEND_SIN, Expect::Exact, qs_soa<FPSR_RAND_EXACT>, FPSR_ISA_SCALAR },
+     { "simd.qs_eval_soa.neon", FPSR_BACKEND_SIN, Expect::Exact, qs_soa<FPSR_RAND_EXACT>, FPSR_ISA_NEON },
+     { "simd.qs_eval_soa.avx2", FPSR_BACKEND_SIN, Expect::Exact, qs_soa<FPSR_RAND_EXACT>, FPSR_ISA_AVX2 },
+     { "simd.qs_eval_soa.avx512", FPSR_BACKEND_SIN, Expect::Exact, qs_soa<FPSR_RAND_EXACT>, FPSR_ISA_AVX512 },
+     { "simd.qs_eval_soa.resolved", FPSR_BACKEND_SIN, Expect::Exact, qs_soa_resolved, FPSR_ISA_SCALAR },
+     { "simd.qs_eval_soa.approx", FPSR_BACKEND_SIN, Expect::Approx, qs_soa<FPSR_RAND_APPROX>, FPSR_ISA_SCALAR },
+     { "bake.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_bake, kAnyIsa },
+     { "bake.qs_segments", FPSR_BACKEND_SIN, Expect::Exact, qs_bake_path<FPSR_PATH_SEGMENTS>, kAnyIsa },
+     { "bake.qs_table", FPSR_BACKEND_SIN, Expect::Exact, qs_bake_path<FPSR_PATH_TABLE>, kAnyIsa },
+     { "bake.qs_simd", FPSR_BACKEND_SIN, Expect::Exact, qs_bake_path<FPSR_PATH_SIMD>, kAnyIsa },
+     { "bake.qs_auto", FPSR_BACKEND_SIN, Expect::Exact, qs_bake_path<kAutoPath>, kAnyIsa },
+     { "channels.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_channels, kAnyIsa },
+     { "context.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_context, kAnyIsa },
+     { "board.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_board, kAnyIsa },
+     { "graph.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_graph<false>, kAnyIsa },
+     { "graph.qs_driven", FPSR_BACKEND_SIN, Expect::Exact, qs_graph<true>, kAnyIsa },
+     { "curve.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_curve, kAnyIsa },
+     { "cpp.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_cpp, kAnyIsa },
+ #if __cplusplus >= 202002L
+     { "cpp.events.qs", FPSR_BACKEND_SIN, Expect::Exact, qs_events, kAnyIsa },
+ #endif
+     { "c.qs_eval", FPSR_BACKEND_HASH, Expect::Exact, qs_plan<FPSR_BACKEND_HASH>, kAnyIsa },
+     { "fixed.qs_q16", FPSR_BACKEND_HASH, Expect::Q16Approx, qs_q16, kAnyIsa },
+ };
+
+ /******************************************************************************/
+ /* Runner                                                                     */
+ /******************************************************************************/
+
+ const char* const kRandNames[2] = { "sin", "hash" };
+
+ struct Result {
+     long long values = 0, mismatches = 0;
+     bool failed = false; // The path reported an error or broke its own invariants.
+     int firstCase = -1;
+     long long firstFrame = 0;
+     uint32_t got = 0, want = 0;
+     double seconds = 0.0;
+ };
+
+ float expected_value(float reference, Expect expect)
+ {
+     return (expect == Expect::Q16 || expect == Expect::Q16Approx)
+         ? static_cast<float>(std::floor(reference * FPSR_Q16_ONE)) / FPSR_Q16_ONE
+         : reference;
+ }
+
+ void compare(const float* values, const float* reference, int firstCase, const int* startFrames, Expect expect, Result& r)
+ {
+     for (int i = 0; i < kGroupSize; ++i) {
+         for (int f = 0; f < kFrames; ++f) {
+             uint32_t got = float_bits(values[i * kFrames + f]);
+             uint32_t want = float_bits(expected_value(reference[i * kFrames + f], expect));
+             if (got != want) {
+                 if (r.mismatches++ == 0) {
+                     r.firstCase = firstCase + i;
+                     r.firstFrame = startFrames[i] + f;
+                     r.got = got;
+                     r.want = want;
+                 }
+             }
+         }
+     }
+     r.values += static_cast<long long>(kGroupSize) * kFrames;
+ }
+
+ bool is_exact(Expect expect) { return expect == Expect::Exact || expect == Expect::Q16; }
+
+ // Prints one result line; returns whether it counts as a failure.
+ bool report(const char* alg, fpsr_rand_backend rand, const std::string& name, Expect expect, const Result& r)
+ {
+     bool fail = r.failed || (is_exact(expect) && r.mismatches != 0);
+     const char* status = fail ? "FAIL" : (r.mismatches != 0) ? "INFO" : "PASS";
+     std::string path = std::string(alg) + "/" + kRandNames[rand];
+     std::printf("%s %-7s %-26s %9lld values %8.2f ns/value", status, path.c_str(), name.c_str(), r.values,
+                 (r.values != 0) ? 1e9 * r.seconds / static_cast<double>(r.values) : 0.0);
+     if (r.failed) { std::printf("  error or inconsistent side outputs"); }
+     if (r.mismatches != 0) {
+         std::printf("  %lld differ (%.4f%%%s); first: case %d frame %lld got 0x%08" PRIx32 " want 0x%08" PRIx32,
+                     r.mismatches, 100.0 * static_cast<double>(r.mismatches) / static_cast<double>(r.values),
+                     is_exact(expect) ? "" : ", approximate by design", r.firstCase, r.firstFrame, r.got, r.want);
+     }
+     std::printf("\n");
+     return fail;
+ }
+
+ struct Options {
+     const char* golden = kDefaultGolden;
+     bool quick = false;
+     bool generate = false;
+     const char* filter = nullptr;
+     const char* dumpAlg = nullptr;
+     int dumpCase = -1;
+ };
+
+ bool selected(const Options& opt, const char* alg, fpsr_rand_backend rand, const char* name)
+ {
+     std::string full = std::string(alg) + "/" + kRandNames[rand] + "/" + name;
+     return opt.filter == nullptr || full.find(opt.filter) != std::string::npos;
+ }
+
+ template <typename Case>
+ void start_frames(const Case* g, int* out)
+ {
+     for (int i = 0; i < kGroupSize; ++i) { out[i] = g[i].startFrame; }
+ }
+
+ template <typename Case>
+ double seconds_of(Run<Case> run, const Case* g, float* out, bool& ok)
+ {
+     auto t0 = std::chrono::steady_clock::now();
+     ok = run(g, out);
+     return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+ }
+
+ /**
+  * @brief Checks the two references of one algorithm, then every backend, over the selected groups.
+  * @return The number of failed checks.
+  */
+ template <typename Case, typename Backend, size_t N>
+ int check_algorithm(
+     const Options& opt, const char* alg, const std::vector<Case>& cases,
+     const Run<Case> references[2], const Backend (&backends)[N])
+ {
+     int groups = opt.quick ? kQuickGroups : kGroups;
+     std::vector<float> reference[2], values(static_cast<size_t>(kGroupSize) * kFrames);
+     for (int b = 0; b < 2; ++b) { reference[b].resize(values.size()); }
+     Result refResults[2];
+     std::vector<Result> results(N);
+     int failures = 0;
+
+     for (int g = 0; g < groups; ++g) {
+         const Case* group = &cases[g * kGroupSize];
+         int startFrames[kGroupSize];
+         start_frames(group, startFrames);
+         for (int b = 0; b < 2; ++b) {
+             Result& r = refResults[b];
+             bool ok;
+             r.seconds += seconds_of(references[b], group, reference[b].data(), ok);
+             r.values += static_cast<long long>(kGroupSize) * kFrames;
+             for (int i = 0; i < kGroupSize; ++i) {
+                 if (crc32_floats(&reference[b][i * kFrames], kFrames) != group[i].crc[b] && r.mismatches++ == 0) {
+                     r.firstCase = g * kGroupSize + i;
+                 }
+             }
+         }
+         for (size_t k = 0; k < N; ++k) {
+             const Backend& be = backends[k];
+             if (!selected(opt, alg, be.rand, be.name)) { continue; }
+             if (be.isa && !fpsr_simd_isa_supported(*be.isa)) { continue; }
+             std::optional<fpsr_simd_isa> previous;
+             if (be.isa) { previous = fpsr_simd_set_isa(*be.isa); }
+             bool ok;
+             results[k].seconds += seconds_of(be.run, group, values.data(), ok);
+             if (previous) { fpsr_simd_set_isa(*previous); }
+             if (!ok) { results[k].failed = true; continue; }
+             compare(values.data(), reference[be.rand].data(), g * kGroupSize, startFrames, be.expect, results[k]);
+         }
+     }
+
+     for (int b = 0; b < 2; ++b) {
+         const Result& r = refResults[b];
+         bool fail = r.mismatches != 0;
+         std::string path = std::string(alg) + "/" + kRandNames[b];
+         std::printf("%s %-7s %-26s %9lld values %8.2f ns/value", fail ? "FAIL" : "PASS", path.c_str(), "reference (golden)",
+                     r.values, 1e9 * r.seconds / static_cast<double>(r.values));
+         if (fail) { std::printf("  %lld of %lld cases differ from the corpus; first: case %d", r.mismatches, r.values / kFrames, r.firstCase); }
+         std::printf("\n");
+         failures += fail;
+     }
+     for (size_t k = 0; k < N; ++k) {
+         const Backend& be = backends[k];
+         if (results[k].values == 0 && !results[k].failed) {
+             if (selected(opt, alg, be.rand, be.name)) {
+                 std::string path = std::string(alg) + "/" + kRandNames[be.rand];
+                 std::printf("SKIP %-7s %-26s (ISA not supported)\n", path.c_str(), be.name);
+             }
+             continue;
+         }
+         failures += report(alg, be.rand, be.name, be.expect, results[k]);
+     }
+     return failures;
+ }
+
+ const Run<SmCase> kSmReferences[2] = { sm_reference<FPSR_BACKEND_SIN>, sm_reference<FPSR_BACKEND_HASH> };
+ const Run<QsCase> kQsReferences[2] = { qs_reference<FPSR_BACKEND_SIN>, qs_reference<FPSR_BACKEND_HASH> };
+
+ /******************************************************************************/
+ /* Cross checks                                                               */
+ /******************************************************************************/
+
+ // Paths the corpus rows cannot drive, because their parameters are compile-time
+ // or their reference is not fpsr_sm() / fpsr_qs(). Each one is compared value by
+ // value with the function it must equal, at the corpus start frames and seeds.
+ // The timings include that function.
+ using CrossRun = void (*)(const Corpus& corpus, int groups, Result& r);
+
+ struct CrossCheck {
+     const char* alg;
+     fpsr_rand_backend rand;
+     const char* name;
+     CrossRun run;
+ };
+
+ // Counts one compared value and keeps the first mismatch.
+ void tally(Result& r, int c, long long frame, uint32_t got, uint32_t want)
+ {
+     ++r.values;
+     if (got != want && r.mismatches++ == 0) {
+         r.firstCase = c;
+         r.firstFrame = frame;
+         r.got = got;
+         r.want = want;
+     }
+ }
+
+ // --- Compile-time templates against fpsr_sm() / fpsr_qs() ---
+
+ // The corpus seeds with MinHold, MaxHold and ReseedInterval fixed.
+ template <int MinHold, int MaxHold, int ReseedInterval>
+ void cross_sm_template(const Corpus& corpus, int groups, Result& r)
+ {
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const SmCase& s = corpus.sm[c];
+         fpsr::StackedModulo<MinHold, MaxHold, ReseedInterval> sm(s.p.seedInner, s.p.seedOuter);
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = s.startFrame + f;
+             tally(r, c, frame, float_bits(sm(frame)),
+                   float_bits(fpsr_sm(frame, MinHold, MaxHold, ReseedInterval, s.p.seedInner, s.p.seedOuter)));
+         }
+     }
+ }
+
+ // The corpus frequencies and offsets with the durations and levels fixed.
+ template <int StreamSwitchDur, int Stream1QuantDur, int Stream2QuantDur, int QuantLevelMin, int QuantLevelMax>
+ void cross_qs_template(const Corpus& corpus, int groups, Result& r)
+ {
+     const int levels[2] = { QuantLevelMin, QuantLevelMax };
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const QsCase& q = corpus.qs[c];
+         fpsr::QuantisedSwitching<StreamSwitchDur, Stream1QuantDur, Stream2QuantDur, QuantLevelMin, QuantLevelMax> qs(
+             q.baseWaveFreq, q.stream2FreqMult, q.streamsOffset[0], q.streamsOffset[1]);
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = q.startFrame + f;
+             tally(r, c, frame, float_bits(qs(frame)),
+                   float_bits(fpsr_qs(frame, q.baseWaveFreq, q.stream2FreqMult, levels, q.streamsOffset,
+                                      StreamSwitchDur, Stream1QuantDur, Stream2QuantDur)));
+         }
+     }
+ }
+
+ // --- VEX dialect: the batch entry points against its scalar functions ---
+
+ // The frame `changed` is computed against: the previous one, or one in an earlier window.
+ int cross_prev_frame(int frame, int f)
+ {
+     static const int kBack[3] = { 1, 18, 300 };
+     int back = kBack[f % 3];
+     return (frame >= INT_MIN + back) ? frame - back : frame;
+ }
+
+ void cross_vex_sm(const Corpus& corpus, int groups, Result& r)
+ {
+     for (int g = 0; g < groups; ++g) {
+         const SmCase* s = &corpus.sm[g * kGroupSize];
+         int minHold[kGroupSize], maxHold[kGroupSize], reseed[kGroupSize], inner[kGroupSize], outer[kGroupSize];
+         for (int i = 0; i < kGroupSize; ++i) {
+             minHold[i] = s[i].p.minHold; maxHold[i] = s[i].p.maxHold; reseed[i] = s[i].p.reseedInterval;
+             inner[i] = s[i].p.seedInner; outer[i] = s[i].p.seedOuter;
+         }
+         fpsr_sm_soa soa = { minHold, maxHold, reseed, inner, outer };
+         fpsr_sm_soa tail = { minHold + kSoaSplit, maxHold + kSoaSplit, reseed + kSoaSplit, inner + kSoaSplit, outer + kSoaSplit };
+         float column[kGroupSize];
+         int changed[kGroupSize];
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = s[0].startFrame + f, prev = cross_prev_frame(frame, f);
+             fpsr_vex_sm_soa(&soa, kSoaSplit, frame, prev, column, changed);
+             fpsr_vex_sm_soa(&tail, kGroupSize - kSoaSplit, frame, prev, column + kSoaSplit, changed + kSoaSplit);
+             for (int i = 0; i < kGroupSize; ++i) {
+                 const fpsr_sm_params& p = s[i].p;
+                 float want = fpsr_vex_sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+                 float before = fpsr_vex_sm(prev, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+                 tally(r, g * kGroupSize + i, frame, float_bits(column[i]), float_bits(want));
+                 tally(r, g * kGroupSize + i, frame, static_cast<uint32_t>(changed[i]), (want != before) ? 1u : 0u);
+             }
+         }
+     }
+ }
+
+ void cross_vex_qs(const Corpus& corpus, int groups, Result& r)
+ {
+     for (int g = 0; g < groups; ++g) {
+         const QsCase* q = &corpus.qs[g * kGroupSize];
+         float freq[kGroupSize], mult[kGroupSize];
+         int qmin[kGroupSize], qmax[kGroupSize], o1[kGroupSize], o2[kGroupSize], sw[kGroupSize], d1[kGroupSize], d2[kGroupSize];
+         for (int i = 0; i < kGroupSize; ++i) {
+             freq[i] = q[i].baseWaveFreq; mult[i] = q[i].stream2FreqMult;
+             qmin[i] = q[i].quantLevelsMinMax[0]; qmax[i] = q[i].quantLevelsMinMax[1];
+             o1[i] = q[i].streamsOffset[0]; o2[i] = q[i].streamsOffset[1];
+             sw[i] = q[i].streamSwitchDur; d1[i] = q[i].stream1QuantDur; d2[i] = q[i].stream2QuantDur;
+         }
+         fpsr_qs_soa soa = { freq, mult, qmin, qmax, o1, o2, sw, d1, d2 };
+         const int k = kSoaSplit;
+         fpsr_qs_soa tail = { freq + k, mult + k, qmin + k, qmax + k, o1 + k, o2 + k, sw + k, d1 + k, d2 + k };
+         float column[kGroupSize];
+         int changed[kGroupSize];
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = q[0].startFrame + f, prev = cross_prev_frame(frame, f);
+             fpsr_vex_qs_soa(&soa, kSoaSplit, frame, prev, column, changed);
+             fpsr_vex_qs_soa(&tail, kGroupSize - kSoaSplit, frame, prev, column + kSoaSplit, changed + kSoaSplit);
+             for (int i = 0; i < kGroupSize; ++i) {
+                 const QsCase& c = q[i];
+                 float want = fpsr_vex_qs(frame, c.baseWaveFreq, c.stream2FreqMult, c.quantLevelsMinMax, c.streamsOffset,
+                                          c.streamSwitchDur, c.stream1QuantDur, c.stream2QuantDur);
+                 float before = fpsr_vex_qs(prev, c.baseWaveFreq, c.stream2FreqMult, c.quantLevelsMinMax, c.streamsOffset,
+                                            c.streamSwitchDur, c.stream1QuantDur, c.stream2QuantDur);
+                 tally(r, g * kGroupSize + i, frame, float_bits(column[i]), float_bits(want));
+                 tally(r, g * kGroupSize + i, frame, static_cast<uint32_t>(changed[i]), (want != before) ? 1u : 0u);
+             }
+         }
+     }
+ }
+
+ // --- Time-inverse queries against a frame-by-frame scan ---
+
+ // The query window of a case: its corpus window, moved onto INT_MAX / INT_MIN for the groups next to them.
+ int query_window(int startFrame, int group)
+ {
+     switch (group % kQuickGroups) {
+         case 4: return INT_MAX - (kFrames - 1);
+         case 5: return INT_MIN;
+         default: return startFrame;
+     }
+ }
+
+ bool query_match(fpsr_query_op op, float threshold, float value)
+ {
+     switch (op) {
+         case FPSR_QUERY_LESS: return value < threshold;
+         case FPSR_QUERY_LESS_EQUAL: return value <= threshold;
+         case FPSR_QUERY_EQUAL: return value == threshold;
+         case FPSR_QUERY_NOT_EQUAL: return value != threshold;
+         case FPSR_QUERY_GREATER_EQUAL: return value >= threshold;
+         case FPSR_QUERY_GREATER: return value > threshold;
+     }
+     return false;
+ }
+
+ // The maximal runs of frames first + f, f < kFrames, for which match(f) holds.
+ template <typename Match>
+ std::vector<fpsr_frame_interval> scan_intervals(int first, Match match)
+ {
+     std::vector<fpsr_frame_interval> runs;
+     for (int f = 0; f < kFrames; ++f) {
+         if (!match(f)) { continue; }
+         if (!runs.empty() && runs.back().endFrame == first + f - 1) {
+             runs.back().endFrame = first + f;
+         } else {
+             runs.push_back({ first + f, first + f });
+         }
+     }
+     return runs;
+ }
+
+ // Compares a query's total n and its first `stored` intervals with the scanned ones.
+ void tally_intervals(Result& r, int c, const std::vector<fpsr_frame_interval>& want, size_t n, const fpsr_frame_interval* out, size_t stored)
+ {
+     tally(r, c, want.empty() ? 0 : want[0].startFrame, static_cast<uint32_t>(n), static_cast<uint32_t>(want.size()));
+     for (size_t i = 0; i < want.size() && i < stored && i < n; ++i) {
+         tally(r, c, want[i].startFrame, static_cast<uint32_t>(out[i].startFrame), static_cast<uint32_t>(want[i].startFrame));
+         tally(r, c, want[i].startFrame, static_cast<uint32_t>(out[i].endFrame), static_cast<uint32_t>(want[i].endFrame));
+     }
+ }
+
+ /**
+  * @brief Puts every op and several thresholds to a value query over one window and compares the answers with a scan.
+  * @param values The channel's values at frames first .. first + kFrames - 1.
+  * @param query query(op, threshold, out, capacity) over those frames.
+  */
+ template <typename Query>
+ void cross_query_window(const float* values, int first, int c, Query query, Result& r)
+ {
+     static const fpsr_query_op kOps[] = {
+         FPSR_QUERY_LESS, FPSR_QUERY_LESS_EQUAL, FPSR_QUERY_EQUAL,
+         FPSR_QUERY_NOT_EQUAL, FPSR_QUERY_GREATER_EQUAL, FPSR_QUERY_GREATER
+     };
+     const float mid = values[kFrames / 2];
+     const float thresholds[] = { values[0], mid, std::nextafter(mid, 1.0f), 0.0f, 0.5f, 1.0f };
+     std::vector<fpsr_frame_interval> out(kFrames);
+     for (fpsr_query_op op : kOps) {
+         for (float t : thresholds) {
+             std::vector<fpsr_frame_interval> want = scan_intervals(first, [&](int f) { return query_match(op, t, values[f]); });
+             tally_intervals(r, c, want, query(op, t, out.data(), out.size()), out.data(), out.size());
+             // Truncated to one interval, and counted only.
+             fpsr_frame_interval one = { 0, 0 };
+             tally_intervals(r, c, want, query(op, t, &one, 1), &one, 1);
+             tally_intervals(r, c, want, query(op, t, nullptr, 0), nullptr, 0);
+         }
+     }
+ }
+
+ // Index over the middle of the window, so the query also crosses both unindexed ends.
+ constexpr int kIndexMargin = 300;
+
+ template <bool Indexed>
+ void cross_sm_query(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<float> values(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const fpsr_sm_params& p = corpus.sm[c].p;
+         int first = query_window(corpus.sm[c].startFrame, c / kGroupSize), last = first + (kFrames - 1);
+         for (int f = 0; f < kFrames; ++f) {
+             values[f] = fpsr_sm(first + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+         }
+         if (!Indexed) {
+             cross_query_window(values.data(), first, c, [&](fpsr_query_op op, float t, fpsr_frame_interval* out, size_t cap) {
+                 return fpsr_sm_query_value(&p, first, last, op, t, out, cap);
+             }, r);
+             continue;
+         }
+         fpsr_value_index index;
+         if (fpsr_sm_index_build(&index, &p, first + kIndexMargin, last - kIndexMargin) != 0) { r.failed = true; return; }
+         cross_query_window(values.data(), first, c, [&](fpsr_query_op op, float t, fpsr_frame_interval* out, size_t cap) {
+             return fpsr_value_index_query(&index, first, last, op, t, out, cap);
+         }, r);
+         fpsr_value_index_free(&index);
+     }
+ }
+
+ template <fpsr_rand_backend B, bool Indexed>
+ void cross_qs_query(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<float> values(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         fpsr_qs_plan plan = corpus.qs[c].plan(B);
+         int first = query_window(corpus.qs[c].startFrame, c / kGroupSize), last = first + (kFrames - 1);
+         for (int f = 0; f < kFrames; ++f) { values[f] = fpsr_qs_eval(&plan, first + f); }
+         if (!Indexed) {
+             cross_query_window(values.data(), first, c, [&](fpsr_query_op op, float t, fpsr_frame_interval* out, size_t cap) {
+                 return fpsr_qs_query_value(&plan, first, last, op, t, out, cap);
+             }, r);
+             continue;
+         }
+         fpsr_value_index index;
+         if (fpsr_qs_index_build(&index, &plan, first + kIndexMargin, last - kIndexMargin) != 0) { r.failed = true; return; }
+         cross_query_window(values.data(), first, c, [&](fpsr_query_op op, float t, fpsr_frame_interval* out, size_t cap) {
+             return fpsr_value_index_query(&index, first, last, op, t, out, cap);
+         }, r);
+         fpsr_value_index_free(&index);
+     }
+ }
+
+ // fpsr_sm_held_state() frame by frame, then fpsr_sm_query_state() for a few of the states seen.
+ void cross_sm_state(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<int> states(kFrames);
+     std::vector<fpsr_frame_interval> out(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const fpsr_sm_params& p = corpus.sm[c].p;
+         int first = query_window(corpus.sm[c].startFrame, c / kGroupSize), last = first + (kFrames - 1);
+         fpsr_frame_interval prevRun = { 0, 0 };
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = first + f;
+             fpsr_frame_interval run;
+             states[f] = fpsr_sm_held_state(&p, frame, &run);
+             tally(r, c, frame, float_bits(portable_rand(states[f])),
+                   float_bits(fpsr_sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter)));
+             // Runs hold their frame and tile the window; frames of one run share its state.
+             bool inPrev = f > 0 && prevRun.endFrame >= frame;
+             bool tiles = run.startFrame <= frame && frame <= run.endFrame
+                 && (inPrev ? (run.startFrame == prevRun.startFrame && run.endFrame == prevRun.endFrame && states[f] == states[f - 1])
+                            : (f == 0 || (prevRun.endFrame == frame - 1 && run.startFrame == frame)));
+             tally(r, c, frame, tiles ? 1u : 0u, 1u);
+             prevRun = run;
+         }
+         for (int at : { 0, kFrames / 3, kFrames - 1 }) {
+             int state = states[at];
+             std::vector<fpsr_frame_interval> want = scan_intervals(first, [&](int f) { return states[f] == state; });
+             tally_intervals(r, c, want, fpsr_sm_query_state(&p, state, first, last, out.data(), out.size()), out.data(), out.size());
+             fpsr_frame_interval one = { 0, 0 };
+             tally_intervals(r, c, want, fpsr_sm_query_state(&p, state, first, last, &one, 1), &one, 1);
+         }
+     }
+ }
+
+ // --- 64-bit frames: the int API where they must agree, and the range paths ---
+
+ // Largest |seed| at which the 64-bit random functions still equal the int ones.
+ constexpr long long seed_limit(fpsr_rand_backend b)
+ {
+     return (b == FPSR_BACKEND_HASH) ? INT_MAX : FPSR_SEED_EXACT;
+ }
+
+ bool within(long long seed, long long limit) { return seed >= -limit && seed <= limit; }
+
+ // fpsr_sm64_backend() against fpsr_sm_backend() at the corpus frames whose seeds are in range.
+ template <fpsr_rand_backend B>
+ void cross_sm64(const Corpus& corpus, int groups, Result& r)
+ {
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const SmCase& s = corpus.sm[c];
+         const fpsr_sm_params& p = s.p;
+         int reseed = (p.reseedInterval < 1) ? 1 : p.reseedInterval;
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = s.startFrame + f;
+             // The int API hashes seedInner + the window base and a state between 0 and seedOuter + frame.
+             long long inner = static_cast<long long>(p.seedInner) + (frame - frame % reseed);
+             long long outer = static_cast<long long>(p.seedOuter) + frame;
+             if (!within(inner, seed_limit(B)) || !within(outer, seed_limit(B))) { continue; }
+             tally(r, c, frame,
+                   float_bits(fpsr_sm64_backend(B, frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter)),
+                   float_bits(fpsr_sm_backend(B, frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter)));
+         }
+     }
+ }
+
+ // fpsr_qs64_eval() against fpsr_qs_eval() at the corpus frames whose stream positions are within ±FPSR_SEED_EXACT.
+ template <fpsr_rand_backend B>
+ void cross_qs64(const Corpus& corpus, int groups, Result& r)
+ {
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const QsCase& q = corpus.qs[c];
+         fpsr_qs_plan plan = q.plan(B);
+         for (int f = 0; f < kFrames; ++f) {
+             int frame = q.startFrame + f;
+             if (!within(static_cast<long long>(q.streamsOffset[0]) + frame, FPSR_SEED_EXACT)
+                 || !within(static_cast<long long>(q.streamsOffset[1]) + frame, FPSR_SEED_EXACT)) { continue; }
+             tally(r, c, frame, float_bits(fpsr_qs64_eval(&plan, frame)), float_bits(fpsr_qs_eval(&plan, frame)));
+         }
+     }
+ }
+
+ // Range windows: the corpus one, one far outside the int range, and two across the ±FPSR_FRAME64_LIMIT clamps.
+ void frame64_windows(int startFrame, long long out[4])
+ {
+     out[0] = startFrame;
+     out[1] = static_cast<long long>(startFrame) * 4099 + 17;
+     out[2] = FPSR_FRAME64_LIMIT - kFrames / 2;
+     out[3] = -FPSR_FRAME64_LIMIT - kFrames / 2;
+ }
+
+ // Compares out[0 .. n) with eval(first + i); a second call starting mid-window checks restarts inside a run.
+ constexpr int kRangeRestart = 777;
+
+ template <typename Range, typename Eval>
+ void cross_range64(long long first, int c, Range range, Eval eval, std::vector<float>& out, Result& r)
+ {
+     for (int pass = 0; pass < 2; ++pass) {
+         long long start = first + ((pass == 0) ? 0 : kRangeRestart);
+         size_t n = static_cast<size_t>((pass == 0) ? kFrames : kFrames - kRangeRestart);
+         range(start, n, out.data());
+         for (size_t i = 0; i < n; ++i) {
+             long long frame = start + static_cast<long long>(i);
+             tally(r, c, frame, float_bits(out[i]), float_bits(eval(frame)));
+         }
+     }
+ }
+
+ void cross_sm64_range(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<float> out(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const fpsr_sm_params& p = corpus.sm[c].p;
+         long long windows[4];
+         frame64_windows(corpus.sm[c].startFrame, windows);
+         for (long long first : windows) {
+             cross_range64(first, c,
+                 [&](long long start, size_t n, float* o) {
+                     fpsr_sm64_range(start, n, o, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+                 },
+                 [&](long long frame) { return fpsr_sm64(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter); },
+                 out, r);
+         }
+     }
+ }
+
+ // fpsr_sm_range() across INT_MAX, where the frames past it take INT_MAX's value.
+ void cross_sm_range_limit(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<float> out(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         const fpsr_sm_params& p = corpus.sm[c].p;
+         cross_range64(static_cast<long long>(INT_MAX) - kFrames / 2, c,
+             [&](long long start, size_t n, float* o) {
+                 fpsr_sm_range(static_cast<int>(start), n, o, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             },
+             [&](long long frame) {
+                 int clamped = (frame > INT_MAX) ? INT_MAX : static_cast<int>(frame);
+                 return fpsr_sm(clamped, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             },
+             out, r);
+     }
+ }
+
+ // The auto bakes over the last kFrames frames before INT_MAX, then one frame
+ // further, which they must reject rather than plan.
+ void cross_bake_auto_limit(const Corpus& corpus, int groups, Result& r)
+ {
+     constexpr int kLast = INT_MAX - kFrames + 1;
+     std::vector<float> out(static_cast<size_t>(kGroupSize) * kFrames);
+     for (int g = 0; g < groups; ++g) {
+         const SmCase* sm = &corpus.sm[g * kGroupSize];
+         std::vector<fpsr_sm_params> params = sm_params(sm);
+         int status = fpsr_bake_sm_auto(nullptr, nullptr, params.data(), kGroupSize, kLast, kFrames, out.data(), kFrames);
+         tally(r, g * kGroupSize, kLast, static_cast<uint32_t>(status), 0u);
+         for (int i = 0; status == 0 && i < kGroupSize; ++i) {
+             const fpsr_sm_params& p = params[i];
+             for (int f = 0; f < kFrames; ++f) {
+                 float want = fpsr_sm(kLast + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+                 tally(r, g * kGroupSize + i, kLast + f, float_bits(out[i * kFrames + f]), float_bits(want));
+             }
+         }
+         status = fpsr_bake_sm_auto(nullptr, nullptr, params.data(), kGroupSize, kLast + 1, kFrames, out.data(), kFrames);
+         tally(r, g * kGroupSize, kLast + 1, static_cast<uint32_t>(status), static_cast<uint32_t>(-1));
+
+         const QsCase* qs = &corpus.qs[g * kGroupSize];
+         std::vector<fpsr_qs_plan> plans(kGroupSize);
+         for (int i = 0; i < kGroupSize; ++i) { plans[i] = qs[i].plan(FPSR_BACKEND_SIN); }
+         status = fpsr_bake_qs_auto(nullptr, nullptr, plans.data(), kGroupSize, kLast, kFrames, out.data(), kFrames);
+         tally(r, g * kGroupSize, kLast, static_cast<uint32_t>(status), 0u);
+         for (int i = 0; status == 0 && i < kGroupSize; ++i) {
+             for (int f = 0; f < kFrames; ++f) {
+                 tally(r, g * kGroupSize + i, kLast + f, float_bits(out[i * kFrames + f]), float_bits(fpsr_qs_eval(&plans[i], kLast + f)));
+             }
+         }
+         status = fpsr_bake_qs_auto(nullptr, nullptr, plans.data(), kGroupSize, kLast + 1, kFrames, out.data(), kFrames);
+         tally(r, g * kGroupSize, kLast + 1, static_cast<uint32_t>(status), static_cast<uint32_t>(-1));
+     }
+ }
+
+ // The context bakes over the last frames before INT_MAX, then one frame further, which
+ // must return NULL and leave the arena where it was.
+ void cross_context_bake_limit(const Corpus& corpus, int groups, Result& r)
+ {
+     constexpr size_t kBakeFrames = 256;
+     constexpr int kLast = INT_MAX - static_cast<int>(kBakeFrames) + 1;
+     for (int g = 0; g < groups; ++g) {
+         int c = g * kGroupSize;
+         std::vector<fpsr_sm_params> params = sm_params(&corpus.sm[c]);
+         std::vector<fpsr_qs_plan> plans(kGroupSize);
+         for (int i = 0; i < kGroupSize; ++i) { plans[i] = corpus.qs[c + i].plan(FPSR_BACKEND_SIN); }
+         fpsr_arena* arena = conformance_arena();
+         fpsr_context ctx;
+         if (fpsr_context_init(&ctx, arena, params.data(), kGroupSize, plans.data(), kGroupSize) != 0) {
+             tally(r, c, kLast, 1u, 0u);
+             continue;
+         }
+         for (int qs = 0; qs < 2; ++qs) {
+             fpsr_context_begin_frame(&ctx);
+             size_t stride = 0;
+             const float* out = qs ? fpsr_context_bake_qs(&ctx, nullptr, kLast, kBakeFrames, &stride)
+                                   : fpsr_context_bake_sm(&ctx, nullptr, kLast, kBakeFrames, &stride);
+             tally(r, c, kLast, out != nullptr, 1u);
+             for (int i = 0; out != nullptr && i < kGroupSize; ++i) {
+                 const fpsr_sm_params& p = params[i];
+                 for (size_t f = 0; f < kBakeFrames; ++f) {
+                     int frame = kLast + static_cast<int>(f);
+                     float want = qs ? fpsr_qs_eval(&plans[i], frame)
+                                     : fpsr_sm(frame, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+                     tally(r, c + i, frame, float_bits(out[i * stride + f]), float_bits(want));
+                 }
+             }
+             fpsr_context_begin_frame(&ctx);
+             size_t mark = fpsr_arena_mark(arena);
+             out = qs ? fpsr_context_bake_qs(&ctx, nullptr, kLast + 1, kBakeFrames, nullptr)
+                      : fpsr_context_bake_sm(&ctx, nullptr, kLast + 1, kBakeFrames, nullptr);
+             tally(r, c, kLast + 1, out == nullptr, 1u);
+             tally(r, c, kLast + 1, static_cast<uint32_t>(fpsr_arena_mark(arena) - mark), 0u);
+         }
+     }
+ }
+
+ template <fpsr_rand_backend B>
+ void cross_qs64_range(const Corpus& corpus, int groups, Result& r)
+ {
+     std::vector<float> out(kFrames);
+     for (int c = 0; c < groups * kGroupSize; ++c) {
+         fpsr_qs_plan plan = corpus.qs[c].plan(B);
+         long long windows[4];
+         frame64_windows(corpus.qs[c].startFrame, windows);
+         for (long long first : windows) {
+             cross_range64(first, c,
+                 [&](long long start, size_t n, float* o) { fpsr_qs64_range(&plan, start, n, o); },
+                 [&](long long frame) { return fpsr_qs64_eval(&plan, frame); },
+                 out, r);
+         }
+     }
+ }
+
+ // --- Result board: one producer and several readers on real threads ---
+
+ constexpr int kBoardReaders = 3;
+ constexpr int kBoardPasses = 4; // The producer publishes the window this many times over.
+
+ // Adds a partial result, keeping the first mismatch.
+ void merge(Result& r, const Result& part)
+ {
+     r.values += part.values;
+     r.failed = r.failed || part.failed;
+     if (part.mismatches != 0 && r.mismatches == 0) {
+         r.firstCase = part.firstCase;
+         r.firstFrame = part.firstFrame;
+         r.got = part.got;
+         r.want = part.want;
+     }
+     r.mismatches += part.mismatches;
+ }
+
+ // While one thread publishes the group's window, readers copy out the latest
+ // frame and the one before it, so some reads race with the slot being rewritten.
+ // A torn read (a half-written slot, or channels from two ticks) differs from the
+ // reference values. Readers that never hit the board would test nothing, so that fails too.
+ void cross_board_threads(const Corpus& corpus, int groups, Result& r)
+ {
+     constexpr int kSm = kGroupSize / 2, kQs = kGroupSize - kSm;
+     for (int g = 0; g < groups; ++g) {
+         const SmCase* sm = &corpus.sm[g * kGroupSize];
+         const QsCase* qs = &corpus.qs[g * kGroupSize];
+         int start = sm[0].startFrame;
+         std::vector<fpsr_sm_params> params(kSm);
+         std::vector<fpsr_qs_plan> plans(kQs);
+         std::vector<float> want(static_cast<size_t>(kFrames) * kGroupSize);
+         for (int i = 0; i < kSm; ++i) { params[i] = sm[i].p; }
+         for (int i = 0; i < kQs; ++i) { plans[i] = qs[i].plan(FPSR_BACKEND_SIN); }
+         for (int f = 0; f < kFrames; ++f) {
+             for (int i = 0; i < kSm; ++i) {
+                 const fpsr_sm_params& p = params[i];
+                 want[f * kGroupSize + i] = fpsr_sm(start + f, p.minHold, p.maxHold, p.reseedInterval, p.seedInner, p.seedOuter);
+             }
+             for (int i = 0; i < kQs; ++i) { want[f * kGroupSize + kSm + i] = fpsr_qs_eval(&plans[i], start + f); }
+         }
+
+         fpsr_board* board = fpsr_board_create(params.data(), kSm, plans.data(), kQs);
+         if (board == nullptr) { r.failed = true; return; }
+         std::atomic<bool> done(false);
+         Result parts[kBoardReaders];
+         long long hits[kBoardReaders] = {};
+         std::vector<std::thread> readers;
+         for (int k = 0; k < kBoardReaders; ++k) {
+             readers.emplace_back([&, k] {
+                 float values[kGroupSize];
+                 int latest;
+                 while (!done.load(std::memory_order_acquire)) {
+                     if (!fpsr_board_latest(board, &latest)) { continue; }
+                     for (int back = 0; back < 2; ++back) {
+                         int f = latest - start - back;
+                         if (f < 0) { continue; }
+                         int status = fpsr_board_read(board, start + f, 0, kGroupSize, values);
+                         hits[k] += (status == 0);
+                         for (int c = 0; c < kGroupSize; ++c) {
+                             tally(parts[k], g * kGroupSize + c, start + f, float_bits(values[c]), float_bits(want[f * kGroupSize + c]));
+                         }
+                     }
+                 }
+             });
+         }
+         for (int pass = 0; pass < kBoardPasses; ++pass) {
+             for (int f = 0; f < kFrames; ++f) { fpsr_board_publish(board, start + f); }
+         }
+         done.store(true, std::memory_order_release);
+         long long boardHits = 0;
+         for (int k = 0; k < kBoardReaders; ++k) {
+             readers[k].join();
+             merge(r, parts[k]);
+             boardHits += hits[k];
+         }
+         fpsr_board_destroy(board);
+         if (boardHits == 0) { r.failed = true; }
+     }
+ }
+
+ // Hold spans on both sides of kMaxModDispatchSpan, min > max, holds and reseed intervals below 1, and levels below 1.
+ const CrossCheck kCrossChecks[] = {
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<1,1,1>", cross_sm_template<1, 1, 1> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<3,40,11>", cross_sm_template<3, 40, 11> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<16,80,200>", cross_sm_template<16, 80, 200> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<16,81,33>", cross_sm_template<16, 81, 33> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<200,400,97>", cross_sm_template<200, 400, 97> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<40,3,7>", cross_sm_template<40, 3, 7> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<-5,6,0>", cross_sm_template<-5, 6, 0> },
+     { "sm", FPSR_BACKEND_SIN, "cpp.sm<0,0,-3>", cross_sm_template<0, 0, -3> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<24,12,8,3,12>", cross_qs_template<24, 12, 8, 3, 12> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<1,1,1,1,1>", cross_qs_template<1, 1, 1, 1, 1> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<2,3,5,0,-2>", cross_qs_template<2, 3, 5, 0, -2> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<7,2,9,-4,6>", cross_qs_template<7, 2, 9, -4, 6> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<100,33,17,2,40>", cross_qs_template<100, 33, 17, 2, 40> },
+     { "qs", FPSR_BACKEND_SIN, "cpp.qs<61,7,13,5,5>", cross_qs_template<61, 7, 13, 5, 5> },
+     { "vex", FPSR_BACKEND_SIN, "vex.sm_soa", cross_vex_sm },
+     { "vex", FPSR_BACKEND_SIN, "vex.qs_soa", cross_vex_qs },
+     { "sm", FPSR_BACKEND_SIN, "query.sm_value", cross_sm_query<false> },
+     { "sm", FPSR_BACKEND_SIN, "query.sm_index", cross_sm_query<true> },
+     { "sm", FPSR_BACKEND_SIN, "query.sm_state", cross_sm_state },
+     { "qs", FPSR_BACKEND_SIN, "query.qs_value", cross_qs_query<FPSR_BACKEND_SIN, false> },
+     { "qs", FPSR_BACKEND_SIN, "query.qs_index", cross_qs_query<FPSR_BACKEND_SIN, true> },
+     { "qs", FPSR_BACKEND_HASH, "query.qs_value", cross_qs_query<FPSR_BACKEND_HASH, false> },
+     { "qs", FPSR_BACKEND_HASH, "query.qs_index", cross_qs_query<FPSR_BACKEND_HASH, true> },
+     { "sm", FPSR_BACKEND_SIN, "frame64.sm64", cross_sm64<FPSR_BACKEND_SIN> },
+     { "sm", FPSR_BACKEND_HASH, "frame64.sm64", cross_sm64<FPSR_BACKEND_HASH> },
+     { "sm", FPSR_BACKEND_SIN, "frame64.sm64_range", cross_sm64_range },
+     { "sm", FPSR_BACKEND_SIN, "sm_range.int_max", cross_sm_range_limit },
+     { "bake", FPSR_BACKEND_SIN, "bake.auto.int_max", cross_bake_auto_limit },
+     { "context", FPSR_BACKEND_SIN, "context.bake.int_max", cross_context_bake_limit },
+     { "board", FPSR_BACKEND_SIN, "board.threads", cross_board_threads },
+     { "qs", FPSR_BACKEND_SIN, "frame64.qs64", cross_qs64<FPSR_BACKEND_SIN> },
+     { "qs", FPSR_BACKEND_HASH, "frame64.qs64", cross_qs64<FPSR_BACKEND_HASH> },
+     { "qs", FPSR_BACKEND_SIN, "frame64.qs64_range", cross_qs64_range<FPSR_BACKEND_SIN> },
+     { "qs", FPSR_BACKEND_HASH, "frame64.qs64_range", cross_qs64_range<FPSR_BACKEND_HASH> },
+ };
+
+ // Runs the selected cross checks; returns the number that failed.
+ int check_cross(const Options& opt, const Corpus& corpus)
+ {
+     int groups = opt.quick ? kQuickGroups : kGroups, failures = 0;
+     for (const CrossCheck& check : kCrossChecks) {
+         if (!selected(opt, check.alg, check.rand, check.name)) { continue; }
+         Result r;
+         auto t0 = std::chrono::steady_clock::now();
+         check.run(corpus, groups, r);
+         r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+         failures += report(check.alg, check.rand, check.name, Expect::Exact, r);
+     }
+     return failures;
+ }
+
+ int generate(const Options& opt)
+ {
+     Corpus corpus;
+     generate_cases(corpus);
+     std::vector<float> values(static_cast<size_t>(kGroupSize) * kFrames);
+     for (int g = 0; g < kGroups; ++g) {
+         for (int b = 0; b < 2; ++b) {
+             kSmReferences[b](&corpus.sm[g * kGroupSize], values.data());
+             for (int i = 0; i < kGroupSize; ++i) { corpus.sm[g * kGroupSize + i].crc[b] = crc32_floats(&values[i * kFrames], kFrames); }
+             kQsReferences[b](&corpus.qs[g * kGroupSize], values.data());
+             for (int i = 0; i < kGroupSize; ++i) { corpus.qs[g * kGroupSize + i].crc[b] = crc32_floats(&values[i * kFrames], kFrames); }
+         }
+     }
+     if (write_corpus(corpus, opt.golden) != 0) {
+         std::fprintf(stderr, "cannot write %s\n", opt.golden);
+         return 2;
+     }
+     std::printf("wrote %s: %d SM and %d QS cases of %d frames\n", opt.golden, kCases, kCases, kFrames);
+     return 0;
+ }
+
+ // Prints "frame value bits" for every frame of one case, with both random backends.
+ int dump(const Corpus& corpus, const Options& opt)
+ {
+     bool isSm = std::strcmp(opt.dumpAlg, "sm") == 0;
+     if ((!isSm && std::strcmp(opt.dumpAlg, "qs") != 0) || opt.dumpCase < 0 || opt.dumpCase >= kCases) {
+         std::fprintf(stderr, "--dump takes sm|qs and a case in [0, %d)\n", kCases);
+         return 2;
+     }
+     int g = opt.dumpCase / kGroupSize, i = opt.dumpCase % kGroupSize;
+     std::vector<float> values[2];
+     for (int b = 0; b < 2; ++b) {
+         values[b].resize(static_cast<size_t>(kGroupSize) * kFrames);
+         if (isSm) {
+             kSmReferences[b](&corpus.sm[g * kGroupSize], values[b].data());
+         } else {
+             kQsReferences[b](&corpus.qs[g * kGroupSize], values[b].data());
+         }
+     }
+     int start = isSm ? corpus.sm[opt.dumpCase].startFrame : corpus.qs[opt.dumpCase].startFrame;
+     std::printf("# frame sin sinBits hash hashBits\n");
+     for (int f = 0; f < kFrames; ++f) {
+         float s = values[0][i * kFrames + f], h = values[1][i * kFrames + f];
+         std::printf("%d %.9g %08" PRIx32 " %.9g %08" PRIx32 "\n", start + f, s, float_bits(s), h, float_bits(h));
+     }
+     return 0;
+ }
+
+ } // namespace
+
+ int main(int argc, char** argv)
+ {
+     Options opt;
+     for (int a = 1; a < argc; ++a) {
+         if (std::strcmp(argv[a], "--golden") == 0 && a + 1 < argc) {
+             opt.golden = argv[++a];
+         } else if (std::strcmp(argv[a], "--quick") == 0) {
+             opt.quick = true;
+         } else if (std::strcmp(argv[a], "--filter") == 0 && a + 1 < argc) {
+             opt.filter = argv[++a];
+         } else if (std::strcmp(argv[a], "--generate") == 0) {
+             opt.generate = true;
+         } else if (std::strcmp(argv[a], "--dump") == 0 && a + 2 < argc) {
+             opt.dumpAlg = argv[++a];
+             opt.dumpCase = std::atoi(argv[++a]);
+         } else {
+             std::fprintf(stderr, "usage: %s [--golden FILE] [--quick] [--filter TEXT] [--dump sm|qs CASE] [--generate]\n", argv[0]);
+             return 2;
+         }
+     }
+     if (opt.generate) { return generate(opt); }
+
+     Corpus corpus;
+     if (read_corpus(corpus, opt.golden) != 0) {
+         std::fprintf(stderr, "cannot read %s (missing, truncated or of another version)\n", opt.golden);
+         return 2;
+     }
+     if (opt.dumpAlg != nullptr) { return dump(corpus, opt); }
+
+     int failures = check_algorithm(opt, "sm", corpus.sm, kSmReferences, kSmBackends)
+                  + check_algorithm(opt, "qs", corpus.qs, kQsReferences, kQsBackends)
+                  + check_cross(opt, corpus);
+     std::printf("%s: %d failed check%s\n", (failures == 0) ? "conformant" : "NOT conformant", failures, (failures == 1) ? "" : "s");
+     return (failures == 0) ? 0 : 1;
+ }
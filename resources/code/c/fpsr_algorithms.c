@@ -8,8 +8,146 @@
  * consistent results across any platform.
  */
 
- #include <math.h> // For sin() and floor()
+ #if defined(FPSR_STATS) && FPSR_STATS >= 2 && !defined(_POSIX_C_SOURCE)
+ #define _POSIX_C_SOURCE 199309L // For clock_gettime() under -std=c11.
+ #endif
+
+ #include <limits.h> // For INT_MAX and LLONG_MAX
+ #include <math.h> // For sin(), asin() and floor()
+ #include <stdint.h> // For uint32_t
  #include <stdio.h> // For NULL
+ #include <stdlib.h> // For malloc(), realloc() and free()
+ #include <string.h> // For memset()
+ #include "fpsr_algorithms.h"
+
+ /******************************************************************************/
+ /* Instrumentation                                                            */
+ /******************************************************************************/
+
+ // FPSR_STATS: 0 (default) compiles every probe below to nothing; 1 keeps call
+ // and branch counters; 2 also times each instrumented call into a histogram.
+ // Counters are relaxed atomics shared by all threads, so multithreaded bakes
+ // contend on them: treat FPSR_STATS builds as diagnostic builds.
+ //
+ // Trace zones around the same calls are independent of FPSR_STATS. Define
+ // FPSR_TRACY (with TRACY_ENABLE) for Tracy's C API, or point FPSR_TRACE_HEADER
+ // at a header that defines FPSR_TRACE_BEGIN(name) and FPSR_TRACE_END() for
+ // anything else, e.g. perfetto's PERFETTO_TE slice macros.
+ #ifndef FPSR_STATS
+ #define FPSR_STATS 0
+ #endif
+
+ #if FPSR_STATS
+ #include <stdatomic.h>
+ #if FPSR_STATS >= 2 && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+ #include <x86intrin.h> // For __rdtsc()
+ #define FPSR_STATS_TSC 1
+ #elif FPSR_STATS >= 2
+ #include <time.h> // For clock_gettime()
+ #endif
+
+ static _Atomic unsigned long long fpsr_stats_calls[FPSR_STAT_CALLS];
+ static _Atomic unsigned long long fpsr_stats_events[FPSR_STAT_EVENTS];
+ static _Atomic unsigned long long fpsr_stats_ticks[FPSR_STAT_CALLS][FPSR_STATS_BUCKETS];
+
+ #define FPSR_STAT_EVENT(e) atomic_fetch_add_explicit(&fpsr_stats_events[e], 1, memory_order_relaxed)
+ #else
+ #define FPSR_STAT_EVENT(e) ((void)0)
+ #endif
+
+ #if FPSR_STATS >= 2
+ static inline unsigned long long fpsr_stats_now(void)
+ {
+ #ifdef FPSR_STATS_TSC
+     return __rdtsc();
+ #else
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+ #endif
+ }
+
+ // Adds one call of `ticks` to bucket floor(log2(ticks)) of the call's histogram.
+ static inline void fpsr_stats_record(int call, unsigned long long ticks)
+ {
+     int bucket = 0;
+     while (ticks > 1 && bucket < FPSR_STATS_BUCKETS - 1) { ticks >>= 1; ++bucket; }
+     atomic_fetch_add_explicit(&fpsr_stats_ticks[call][bucket], 1, memory_order_relaxed);
+ }
+ #endif
+
+ #if defined(FPSR_TRACY)
+ #include <tracy/TracyC.h>
+ #define FPSR_TRACE_BEGIN(name) TracyCZoneN(fpsr_trace_zone, name, 1)
+ #define FPSR_TRACE_END() TracyCZoneEnd(fpsr_trace_zone)
+ #elif defined(FPSR_TRACE_HEADER)
+ #include FPSR_TRACE_HEADER
+ #endif
+ #ifndef FPSR_TRACE_BEGIN
+ #define FPSR_TRACE_BEGIN(name) ((void)0)
+ #define FPSR_TRACE_END() ((void)0)
+ #endif
+
+ // Brackets the body of an instrumented entry point; `call` is an fpsr_stat_call.
+ #if FPSR_STATS >= 2
+ #define FPSR_PROBE_BEGIN(call, name) \
+     atomic_fetch_add_explicit(&fpsr_stats_calls[call], 1, memory_order_relaxed); \
+     FPSR_TRACE_BEGIN(name); \
+     unsigned long long fpsr_probe_start = fpsr_stats_now()
+ #define FPSR_PROBE_END(call) \
+     fpsr_stats_record(call, fpsr_stats_now() - fpsr_probe_start); \
+     FPSR_TRACE_END()
+ #elif FPSR_STATS
+ #define FPSR_PROBE_BEGIN(call, name) \
+     atomic_fetch_add_explicit(&fpsr_stats_calls[call], 1, memory_order_relaxed); \
+     FPSR_TRACE_BEGIN(name)
+ #define FPSR_PROBE_END(call) FPSR_TRACE_END()
+ #else
+ #define FPSR_PROBE_BEGIN(call, name) FPSR_TRACE_BEGIN(name)
+ #define FPSR_PROBE_END(call) FPSR_TRACE_END()
+ #endif
+
+ /**
+  * @brief Copies the instrumentation counters.
+  * @details With FPSR_STATS == 0 the result is all zeros with level 0. Counters
+  * are read one at a time while other threads may be updating them, so a
+  * snapshot taken during evaluation is only approximately consistent.
+  */
+ void fpsr_stats_snapshot(fpsr_stats* stats)
+ {
+     if (stats == NULL) { return; }
+     memset(stats, 0, sizeof(*stats));
+     stats->level = FPSR_STATS;
+ #if FPSR_STATS
+     for (int c = 0; c < FPSR_STAT_CALLS; ++c) {
+         stats->calls[c] = atomic_load_explicit(&fpsr_stats_calls[c], memory_order_relaxed);
+         for (int b = 0; b < FPSR_STATS_BUCKETS; ++b) {
+             stats->ticks[c][b] = atomic_load_explicit(&fpsr_stats_ticks[c][b], memory_order_relaxed);
+         }
+     }
+     for (int e = 0; e < FPSR_STAT_EVENTS; ++e) {
+         stats->events[e] = atomic_load_explicit(&fpsr_stats_events[e], memory_order_relaxed);
+     }
+ #endif
+ #if FPSR_STATS >= 2 && !defined(FPSR_STATS_TSC)
+     stats->ticksAreNanoseconds = 1;
+ #endif
+ }
+
+ void fpsr_stats_reset(void)
+ {
+ #if FPSR_STATS
+     for (int c = 0; c < FPSR_STAT_CALLS; ++c) {
+         atomic_store_explicit(&fpsr_stats_calls[c], 0, memory_order_relaxed);
+         for (int b = 0; b < FPSR_STATS_BUCKETS; ++b) {
+             atomic_store_explicit(&fpsr_stats_ticks[c][b], 0, memory_order_relaxed);
+         }
+     }
+     for (int e = 0; e < FPSR_STAT_EVENTS; ++e) {
+         atomic_store_explicit(&fpsr_stats_events[e], 0, memory_order_relaxed);
+     }
+ #endif
+ }
  
  /**
   * A simple, portable pseudo-random number generator.
@@ -21,15 +159,124 @@
      // A common technique for a simple hash-like random number.
      // The large prime numbers are used to create a chaotic, unpredictable result.
      // The frac() part (or fmod(x, 1.0)) ensures the result is in the [0, 1) range.
+     FPSR_STAT_EVENT(FPSR_STAT_RAND_SIN);
      float result = sin((float)seed * 12.9898) * 43758.5453;
      return result - floor(result);
  }
  
+ /**
+  * An integer-hash alternative to portable_rand().
+  * @brief Generates a deterministic float between 0.0 and 1.0 from an integer seed using only integer ops.
+  * @details Mixes the seed with a 32-bit avalanche hash (the "lowbias32"
+  * multiply/xor-shift finaliser) and keeps the top 24 bits, which map exactly
+  * onto the float mantissa. Unlike portable_rand() it needs no libm, no
+  * double precision and no rounding-sensitive steps, so every compiler and
+  * CPU produces the same bits, and it is several times faster.
+  * The values differ from portable_rand(); it is a different random sequence.
+  *
+  * @param seed An integer used to generate the random number.
+  * @return A pseudo-random float in [0.0, 1.0), a multiple of 2^-24.
+  */
+ float portable_rand_hash(int seed)
+ {
+     FPSR_STAT_EVENT(FPSR_STAT_RAND_HASH);
+     uint32_t x = (uint32_t)seed + 0x9E3779B9u; // Golden-ratio offset so seed 0 does not map to 0.
+     x ^= x >> 16;
+     x *= 0x7FEB352Du;
+     x ^= x >> 15;
+     x *= 0x846CA68Bu;
+     x ^= x >> 16;
+     return (float)(x >> 8) * (1.0f / 16777216.0f);
+ }
+ 
+ /**
+  * @brief Dispatches to the random number backend selected by `backend`.
+  */
+ static inline float fpsr_rand(fpsr_rand_backend backend, int seed)
+ {
+     return (backend == FPSR_BACKEND_HASH) ? portable_rand_hash(seed) : portable_rand(seed);
+ }
+ 
+ /**
+  * @brief a + b with 32-bit wraparound.
+  * @details The seed and offset sums (seedInner + frame, seedOuter + frame,
+  * streamsOffset + frame) wrap near the int limits. Summing in unsigned
+  * arithmetic keeps the wrap defined, so those frames produce the values the
+  * golden corpus records whatever a compiler assumes about signed overflow.
+  */
+ static inline int fpsr_wrap_add(int a, int b)
+ {
+     return (int)((unsigned)a + (unsigned)b);
+ }
+ 
+ /**
+  * @brief Finds the last frame of the run that shares x's "x - (x % d)" base.
+  * @details C's % truncates towards zero, so the base is a multiple of d that is
+  * never further from zero than x. Runs are therefore d frames long, except the
+  * run around zero which spans -(d-1) .. d-1. This is what both modulo stages of
+  * fpsr_sm() (and the duration cycles of fpsr_qs()) quantise frames with.
+  *
+  * @param x The value being quantised.
+  * @param d The modulus, >= 1.
+  * @return The largest x' >= x with the same base, widened to avoid overflow.
+  */
+ static inline long long fpsr_trunc_run_end(long long x, int d)
+ {
+     long long base = x - (x % d);
+     if (base > 0) { return base + d - 1; }
+     if (base < 0) { return base; }
+     return d - 1;
+ }
+
+ /**
+  * @brief Finds the first frame of the run that shares x's "x - (x % d)" base.
+  * @details The counterpart of fpsr_trunc_run_end().
+  *
+  * @param x The value being quantised.
+  * @param d The modulus, >= 1.
+  * @return The smallest x' <= x with the same base, widened to avoid overflow.
+  */
+ static inline long long fpsr_trunc_run_start(long long x, int d)
+ {
+     long long base = x - (x % d);
+     if (base > 0) { return base; }
+     if (base < 0) { return base - d + 1; }
+     return -(long long)(d - 1);
+ }
+ 
  
  /******************************************************************************/
  /* FPS-R: Stacked Modulo (SM)                            */
  /******************************************************************************/
  
+ /**
+  * @brief Core of fpsr_sm, shared by the scalar and batched entry points.
+  * @details Expects reseedInterval to be validated (>= 1) by the caller, so
+  * batched callers pay for the clamp once rather than once per frame.
+  * `backend` is a constant at every call site, so the dispatch folds away.
+  */
+ static inline float fpsr_sm_kernel(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter,
+     fpsr_rand_backend backend)
+ {
+     // --- 1. Calculate the random hold duration ---
+     float rand_for_duration = fpsr_rand(backend, fpsr_wrap_add(seedInner, frame - (frame % reseedInterval)));
+     int holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+ 
+     if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+ 
+     // --- 2. Generate the stable integer "state" for the hold period ---
+     // This value is constant for the entire duration of the hold.
+     int held_integer_state = fpsr_wrap_add(seedOuter, frame) - (fpsr_wrap_add(seedOuter, frame) % holdDuration);
+ 
+     // --- 3. Use the stable state as a seed for the final random value ---
+     // Because the seed is stable, the final value is also stable.
+     float fpsr_output = fpsr_rand(backend, held_integer_state);
+ 
+     return fpsr_output;
+ }
+ 
  /**
   * @brief Generates a persistent random value that holds for a calculated duration.
   * @details This function uses a two-step process. First, it determines a random
@@ -48,26 +295,413 @@
      int frame, int minHold, int maxHold,
      int reseedInterval, int seedInner, int seedOuter)
  {
-     // --- 1. Calculate the random hold duration ---
-     if (reseedInterval < 1) { reseedInterval = 1; } // Prevent division by zero.
+     FPSR_PROBE_BEGIN(FPSR_STAT_SM, "fpsr_sm");
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
  
-     float rand_for_duration = portable_rand(seedInner + frame - (frame % reseedInterval));
-     int holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+     float result = fpsr_sm_kernel(frame, minHold, maxHold, reseedInterval, seedInner, seedOuter, FPSR_BACKEND_SIN);
+     FPSR_PROBE_END(FPSR_STAT_SM);
+     return result;
+ }
+ 
+ /**
+  * @brief fpsr_sm with a selectable random number backend.
+  * @details With FPSR_BACKEND_SIN this is fpsr_sm(). With FPSR_BACKEND_HASH both
+  * hashing stages use portable_rand_hash(), giving the same hold structure
+  * with integer-only, platform-independent values.
+  *
+  * @param backend FPSR_BACKEND_SIN or FPSR_BACKEND_HASH.
+  * @param frame, minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  * @return A float value between 0.0 and 1.0 that remains constant for the hold duration.
+  */
+ float fpsr_sm_backend(
+     fpsr_rand_backend backend, int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     FPSR_PROBE_BEGIN(FPSR_STAT_SM_BACKEND, "fpsr_sm_backend");
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
  
-     if (holdDuration < 1) { holdDuration = 1; } // Prevent division by zero.
+     float result;
+     if (backend == FPSR_BACKEND_HASH) {
+         result = fpsr_sm_kernel(frame, minHold, maxHold, reseedInterval, seedInner, seedOuter, FPSR_BACKEND_HASH);
+     } else {
+         result = fpsr_sm_kernel(frame, minHold, maxHold, reseedInterval, seedInner, seedOuter, FPSR_BACKEND_SIN);
+     }
+     FPSR_PROBE_END(FPSR_STAT_SM_BACKEND);
+     return result;
+ }
  
-     // --- 2. Generate the stable integer "state" for the hold period ---
-     // This value is constant for the entire duration of the hold.
-     int held_integer_state = (seedOuter + frame) - ((seedOuter + frame) % holdDuration);
+ /**
+  * @brief Evaluates fpsr_sm for an array of arbitrary frames.
+  * @details Equivalent to calling fpsr_sm(frames[i], ...) for every i, but the
+  * parameters are validated once for the whole span and the results are written
+  * straight into the caller's buffer. The loop body has no calls besides
+  * portable_rand(), which keeps it a candidate for vectorisation.
+  *
+  * @param frames An array of n frame numbers, in any order.
+  * @param out A caller-owned array that receives n values.
+  * @param n The number of frames to evaluate.
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  */
+ void fpsr_sm_batch(
+     const int* frames, float* out, size_t n,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (frames == NULL || out == NULL) { return; }
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
  
-     // --- 3. Use the stable state as a seed for the final random value ---
-     // Because the seed is stable, the final value is also stable.
+     for (size_t i = 0; i < n; ++i) {
+         out[i] = fpsr_sm_kernel(frames[i], minHold, maxHold, reseedInterval, seedInner, seedOuter, FPSR_BACKEND_SIN);
+     }
+ }
+ 
+ /**
+  * @brief Evaluates fpsr_sm for a contiguous range of frames.
+  * @details Produces the same values as fpsr_sm(startFrame + i, ...) for
+  * i = 0 .. n-1. Because the frames are consecutive, the hold duration only
+  * needs recomputing when the reseed window changes, and the final hash only
+  * when the held integer state changes. Both portable_rand() calls are
+  * therefore paid per window/hold rather than per frame.
+  *
+  * @param startFrame The first frame to evaluate.
+  * @param n The number of consecutive frames to evaluate. Frames past INT_MAX
+  * are clamped to it and take its value, as the 64-bit range clamps at its limit.
+  * @param out A caller-owned array that receives n values.
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  */
+ void fpsr_sm_range(
+     int startFrame, size_t n, float* out,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (out == NULL || n == 0) { return; }
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
+ 
+     int reseed_base = 0;
+     int holdDuration = 1;
+     int held_integer_state = 0;
+     float fpsr_output = 0.0f;
+ 
+     // Frames up to INT_MAX are evaluated; the rest repeat INT_MAX's value. count >= 1.
+     size_t count = n;
+     if (count - 1 > (size_t)((long long)INT_MAX - startFrame)) { count = (size_t)((long long)INT_MAX - startFrame) + 1; }
+ 
+     for (size_t i = 0; i < count; ++i) {
+         int frame = (int)(startFrame + (long long)i);
+ 
+         // --- 1. Recompute the hold duration only when entering a new reseed window ---
+         int base = frame - (frame % reseedInterval);
+         if (i == 0 || base != reseed_base) {
+             reseed_base = base;
+             float rand_for_duration = portable_rand(fpsr_wrap_add(seedInner, base));
+             holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+             if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+         }
+ 
+         // --- 2. Rehash only when the held integer state changes ---
+         int state = fpsr_wrap_add(seedOuter, frame) - (fpsr_wrap_add(seedOuter, frame) % holdDuration);
+         if (i == 0 || state != held_integer_state) {
+             held_integer_state = state;
+             fpsr_output = portable_rand(held_integer_state);
+         }
+ 
+         out[i] = fpsr_output;
+     }
+     for (size_t i = count; i < n; ++i) { out[i] = fpsr_output; }
+ }
+ 
+ /**
+  * @brief Starts iterating the constant-value segments of fpsr_sm over [startFrame, endFrame].
+  * @details Instead of evaluating every frame, segment boundaries are derived from
+  * the reseed grid (frame % reseedInterval) and the hold grid of held_integer_state,
+  * so the cost is O(segments) rather than O(frames). Adjacent runs that happen to
+  * produce the same value are merged, so consecutive segments always differ.
+  *
+  * @param it The iterator to initialise.
+  * @param startFrame The first frame to cover.
+  * @param endFrame The last frame to cover (inclusive).
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  */
+ void fpsr_sm_segments_begin(
+     fpsr_sm_segment_iter* it, int startFrame, int endFrame,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (it == NULL) { return; }
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
+ 
+     it->minHold = minHold;
+     it->maxHold = maxHold;
+     it->reseedInterval = reseedInterval;
+     it->seedInner = seedInner;
+     it->seedOuter = seedOuter;
+     it->nextFrame = startFrame;
+     it->endFrame = endFrame;
+     it->done = (startFrame > endFrame);
+     it->windowEnd = (long long)startFrame - 1; // Forces a hold duration lookup on the first run.
+     it->holdDuration = 1;
+     it->hasPending = 0;
+ }
+ 
+ /**
+  * @brief Produces the next constant-value segment.
+  * @param it An iterator set up by fpsr_sm_segments_begin().
+  * @param seg Receives the segment; its endFrame is inclusive.
+  * @return 1 if a segment was produced, 0 once the range is exhausted.
+  */
+ int fpsr_sm_segments_next(fpsr_sm_segment_iter* it, fpsr_sm_segment* seg)
+ {
+     if (it == NULL || seg == NULL || it->done) { return 0; }
+ 
+     int have = 0;
+     long long frame = it->nextFrame;
+     while (frame <= it->endFrame) {
+         long long runEnd;
+         float value;
+         if (it->hasPending) {
+             // The run that ended the previous segment has already been evaluated.
+             runEnd = it->pendingEnd;
+             value = it->pendingValue;
+             it->hasPending = 0;
+         } else {
+             // --- 1. Hold duration is fixed for the whole reseed window ---
+             if (frame > it->windowEnd) {
+                 int f = (int)frame;
+                 float rand_for_duration = portable_rand(fpsr_wrap_add(it->seedInner, f - (f % it->reseedInterval)));
+                 int holdDuration = (int)floor(it->minHold + rand_for_duration * (it->maxHold - it->minHold));
+                 if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+                 it->holdDuration = holdDuration;
+                 it->windowEnd = fpsr_trunc_run_end(frame, it->reseedInterval);
+             }
+ 
+             // --- 2. The held state is fixed until the hold grid or the window ends ---
+             // Runs follow the int sum seedOuter + frame, so they also end where it wraps.
+             int sum = fpsr_wrap_add(it->seedOuter, (int)frame);
+             int state = sum - (sum % it->holdDuration);
+             runEnd = frame + (fpsr_trunc_run_end(sum, it->holdDuration) - sum);
+             if (runEnd > frame + ((long long)INT_MAX - sum)) { runEnd = frame + ((long long)INT_MAX - sum); }
+             if (runEnd > it->windowEnd) { runEnd = it->windowEnd; }
+             if (runEnd > it->endFrame) { runEnd = it->endFrame; }
+             value = portable_rand(state);
+         }
+ 
+         // --- 3. Extend the current segment, or stop at the first differing run ---
+         if (have && value != seg->value) {
+             it->hasPending = 1;
+             it->pendingEnd = runEnd;
+             it->pendingValue = value;
+             break;
+         }
+         if (!have) {
+             seg->startFrame = (int)frame;
+             seg->value = value;
+             have = 1;
+         }
+         seg->endFrame = (int)runEnd;
+         frame = runEnd + 1;
+     }
+ 
+     it->nextFrame = frame;
+     if (frame > it->endFrame) { it->done = 1; }
+     return have;
+ }
+ 
+ /**
+  * @brief Sets up a cursor for repeated fpsr_sm evaluation of one parameter set.
+  * @details The cursor remembers the reseed window (and so the hold duration)
+  * and the held-state run of the last frame it evaluated. Any later query that
+  * lands in the same run is answered without hashing, and one in the same
+  * window costs at most one portable_rand(). This holds in either direction and
+  * for jumps, so forward playback and timeline scrubbing both pay only at
+  * boundaries. The values are identical to fpsr_sm().
+  *
+  * @param cursor The cursor to initialise.
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  */
+ void fpsr_sm_cursor_init(
+     fpsr_sm_cursor* cursor, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (cursor == NULL) { return; }
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
+
+     cursor->minHold = minHold;
+     cursor->maxHold = maxHold;
+     cursor->reseedInterval = reseedInterval;
+     cursor->seedInner = seedInner;
+     cursor->seedOuter = seedOuter;
+     cursor->hasWindow = 0;
+     cursor->hasRun = 0;
+ }
+
+ /**
+  * @brief Evaluates fpsr_sm at `frame` through a cursor.
+  * @param cursor A cursor set up by fpsr_sm_cursor_init().
+  * @param frame The current frame or time input, in any order.
+  * @return The same value as fpsr_sm(frame, ...) for the cursor's parameters.
+  */
+ float fpsr_sm_cursor_eval(fpsr_sm_cursor* cursor, int frame)
+ {
+     // --- 1. Same held-state run: nothing to compute ---
+     if (cursor->hasRun && frame >= cursor->runStart && frame <= cursor->runEnd) {
+         return cursor->value;
+     }
+
+     // --- 2. Hold duration is fixed for the whole reseed window ---
+     if (!cursor->hasWindow || frame < cursor->windowStart || frame > cursor->windowEnd) {
+         int reseedInterval = cursor->reseedInterval;
+         float rand_for_duration = portable_rand(fpsr_wrap_add(cursor->seedInner, frame - (frame % reseedInterval)));
+         int holdDuration = (int)floor(cursor->minHold + rand_for_duration * (cursor->maxHold - cursor->minHold));
+         if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+         cursor->holdDuration = holdDuration;
+         cursor->windowStart = fpsr_trunc_run_start(frame, reseedInterval);
+         cursor->windowEnd = fpsr_trunc_run_end(frame, reseedInterval);
+         cursor->hasWindow = 1;
+     }
+
+     // --- 3. The held state's run, clipped to the window; hash only a new state ---
+     int holdDuration = cursor->holdDuration;
+     int state = fpsr_wrap_add(cursor->seedOuter, frame) - (fpsr_wrap_add(cursor->seedOuter, frame) % holdDuration);
+     if (!cursor->hasRun || state != cursor->heldState) {
+         cursor->heldState = state;
+         cursor->value = portable_rand(state);
+         cursor->hasRun = 1;
+     }
+     // Runs follow the int sum seedOuter + frame, so they also end where it wraps.
+     int sum = fpsr_wrap_add(cursor->seedOuter, frame);
+     cursor->runStart = frame + (fpsr_trunc_run_start(sum, holdDuration) - sum);
+     cursor->runEnd = frame + (fpsr_trunc_run_end(sum, holdDuration) - sum);
+     if (cursor->runStart < frame - ((long long)sum - INT_MIN)) { cursor->runStart = frame - ((long long)sum - INT_MIN); }
+     if (cursor->runEnd > frame + ((long long)INT_MAX - sum)) { cursor->runEnd = frame + ((long long)INT_MAX - sum); }
+     if (cursor->runStart < cursor->windowStart) { cursor->runStart = cursor->windowStart; }
+     if (cursor->runEnd > cursor->windowEnd) { cursor->runEnd = cursor->windowEnd; }
+
+     return cursor->value;
+ }
+
+ /**
+  * @brief Finds the first frame after `frame` at which fpsr_sm takes a different value.
+  * @details Walks held-state runs forward from a frame whose value, hold duration
+  * and reseed window are already known, so only the runs up to the change are hashed.
+  *
+  * @return The frame of the next change, or INT_MAX + 1 if the value holds to the end of the int range.
+  */
+ static long long fpsr_sm_change_after(
+     long long frame, float value, int holdDuration, long long windowEnd,
+     int minHold, int maxHold, int reseedInterval, int seedInner, int seedOuter)
+ {
+     int state = fpsr_wrap_add(seedOuter, (int)frame) - (fpsr_wrap_add(seedOuter, (int)frame) % holdDuration);
+     for (;;) {
+         // Runs follow the int sum seedOuter + frame, so they also end where it wraps.
+         int sum = fpsr_wrap_add(seedOuter, (int)frame);
+         long long runEnd = frame + (fpsr_trunc_run_end(sum, holdDuration) - sum);
+         if (runEnd > frame + ((long long)INT_MAX - sum)) { runEnd = frame + ((long long)INT_MAX - sum); }
+         if (runEnd > windowEnd) { runEnd = windowEnd; }
+         frame = runEnd + 1;
+         if (frame > INT_MAX) { return frame; }
+ 
+         if (frame > windowEnd) {
+             int f = (int)frame;
+             float rand_for_duration = portable_rand(fpsr_wrap_add(seedInner, f - (f % reseedInterval)));
+             holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+             if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+             windowEnd = fpsr_trunc_run_end(frame, reseedInterval);
+         }
+ 
+         int next_state = fpsr_wrap_add(seedOuter, (int)frame) - (fpsr_wrap_add(seedOuter, (int)frame) % holdDuration);
+         if (next_state != state) {
+             if (portable_rand(next_state) != value) { return frame; }
+             state = next_state;
+         }
+     }
+ }
+ 
+ /**
+  * @brief fpsr_sm with change detection fused into the same evaluation.
+  * @details Returns fpsr_sm(frame, ...) and, optionally, whether it differs from
+  * fpsr_sm(frame - 1, ...) and how many frames it will hold for. The previous
+  * frame almost always shares the reseed window (and so the hold duration) and
+  * usually the held state too, in which case no extra hashing is needed at all.
+  *
+  * @param frame, minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  * @param changed If not NULL, receives 1 when the value differs from the previous frame, else 0.
+  * INT_MIN has no previous frame and reports 0.
+  * @param framesUntilChange If not NULL, receives the number of frames (>= 1) until the value
+  * next differs, capped at INT_MAX.
+  * @return The same value as fpsr_sm(frame, ...).
+  */
+ float fpsr_sm_ex(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter,
+     int* changed, int* framesUntilChange)
+ {
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
+ 
+     // --- 1. Evaluate the current frame, keeping the intermediates ---
+     int reseed_base = frame - (frame % reseedInterval);
+     float rand_for_duration = portable_rand(fpsr_wrap_add(seedInner, reseed_base));
+     int holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+     if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+     int held_integer_state = fpsr_wrap_add(seedOuter, frame) - (fpsr_wrap_add(seedOuter, frame) % holdDuration);
      float fpsr_output = portable_rand(held_integer_state);
  
+     // --- 2. Compare with the previous frame, reusing whatever it shares ---
+     if (changed != NULL) {
+         int prev = (frame > INT_MIN) ? frame - 1 : frame;
+         int prev_base = prev - (prev % reseedInterval);
+         int prev_hold = holdDuration;
+         if (prev_base != reseed_base) {
+             float prev_rand = portable_rand(fpsr_wrap_add(seedInner, prev_base));
+             prev_hold = (int)floor(minHold + prev_rand * (maxHold - minHold));
+             if (prev_hold < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); prev_hold = 1; } // Prevent division by zero.
+         }
+         int prev_state = fpsr_wrap_add(seedOuter, prev) - (fpsr_wrap_add(seedOuter, prev) % prev_hold);
+         *changed = (prev_state != held_integer_state) && (portable_rand(prev_state) != fpsr_output);
+     }
+ 
+     // --- 3. Look ahead to the next change ---
+     if (framesUntilChange != NULL) {
+         long long next = fpsr_sm_change_after(
+             frame, fpsr_output, holdDuration, fpsr_trunc_run_end(frame, reseedInterval),
+             minHold, maxHold, reseedInterval, seedInner, seedOuter);
+         long long frames = next - frame;
+         *framesUntilChange = (frames > INT_MAX) ? INT_MAX : (int)frames;
+     }
+ 
      return fpsr_output;
  }
- 
+
+ /**
+  * @brief Finds the first frame after `frame` at which fpsr_sm takes a different value.
+  * @details Lets a scheduler sleep until the next change instead of polling
+  * every tick. Run boundaries come straight from the hold grid of
+  * held_integer_state and the reseed grid, so only the run that follows each
+  * boundary is hashed; in practice that is a single hash, as neighbouring
+  * runs almost never share a value.
+  *
+  * @param frame, minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  * @return The frame of the next change, or INT_MAX if the value holds through INT_MAX.
+  */
+ int fpsr_sm_next_change(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (reseedInterval < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_RESEED_CLAMP); reseedInterval = 1; } // Prevent division by zero.
+
+     int reseed_base = frame - (frame % reseedInterval);
+     float rand_for_duration = portable_rand(fpsr_wrap_add(seedInner, reseed_base));
+     int holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+     if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+     float fpsr_output = portable_rand(fpsr_wrap_add(seedOuter, frame) - (fpsr_wrap_add(seedOuter, frame) % holdDuration));
+
+     long long next = fpsr_sm_change_after(
+         frame, fpsr_output, holdDuration, fpsr_trunc_run_end(frame, reseedInterval),
+         minHold, maxHold, reseedInterval, seedInner, seedOuter);
+     return (next > INT_MAX) ? INT_MAX : (int)next;
+ }
+
 // Sample code to call the FPS-R:SM function
+#if 0 // Illustrative only; paste into your own frame loop.
 // Parameters
 int frame = 100; // Replace with the current frame value
 int minHoldFrames = 16; // probable minimum held period
@@ -79,16 +713,18 @@ int offsetOuter = 23; // offsets the outer frame
 // Call the FPS-R:SM function
 float randVal = 
     fpsr_sm(
-        int(frame), minHoldFrames, maxHoldFrames, 
-        reseedFrames, offsetInner, offsetOuter);
-float randVal_previous = 
-    fpsr_sm(
-        int(frame-1), minHoldFrames, maxHoldFrames, 
+        frame, minHoldFrames, maxHoldFrames, 
         reseedFrames, offsetInner, offsetOuter);
+
+// Or get the value and whether it changed from the previous frame in one call
 int changed = 0;
-if (randVal != randVal_previous) {
-    changed = 1; // value has changed from the previous frame
-}
+int framesUntilChange = 0;
+float randVal_ex = 
+    fpsr_sm_ex(
+        frame, minHoldFrames, maxHoldFrames, 
+        reseedFrames, offsetInner, offsetOuter,
+        &changed, &framesUntilChange);
+#endif
 
 
  /******************************************************************************/
@@ -115,26 +751,31 @@ if (randVal != randVal_previous) {
      const int quantLevelsMinMax[2], const int streamsOffset[2],
      int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
  {
+     FPSR_PROBE_BEGIN(FPSR_STAT_QS, "fpsr_qs");
+
      // --- 1. Set default durations if not provided ---
      // This pattern allows for optional parameters in a portable C-style.
      if (streamSwitchDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_SWITCH_DUR);
          streamSwitchDur = (int)floor((1.0 / baseWaveFreq) * 0.76);
      }
      if (stream1QuantDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_QUANT_DUR);
          stream1QuantDur = (int)floor((1.0 / baseWaveFreq) * 1.2);
      }
      if (stream2QuantDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_QUANT_DUR);
          stream2QuantDur = (int)floor((1.0 / baseWaveFreq) * 0.9);
      }
      // Ensure durations are at least 1 frame to prevent division by zero.
-     if (streamSwitchDur < 1) { streamSwitchDur = 1; }
-     if (stream1QuantDur < 1) { stream1QuantDur = 1; }
-     if (stream2QuantDur < 1) { stream2QuantDur = 1; }
+     if (streamSwitchDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); streamSwitchDur = 1; }
+     if (stream1QuantDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); stream1QuantDur = 1; }
+     if (stream2QuantDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); stream2QuantDur = 1; }
  
      // --- 2. Calculate quantisation levels for each stream ---
      // The quantisation level itself switches halfway through its own duration cycle.
      int s1_quant_level;
-     if ((streamsOffset[0] + frame) % stream1QuantDur < stream1QuantDur / 2) {
+     if (fpsr_wrap_add(streamsOffset[0], frame) % stream1QuantDur < stream1QuantDur / 2) {
          s1_quant_level = quantLevelsMinMax[0];
      } else {
          s1_quant_level = quantLevelsMinMax[1];
@@ -144,21 +785,21 @@ if (randVal != randVal_previous) {
      // Magic numbers are used to create more variation in the second stream's character.
      const float STREAM2_QUANT_RATIO_MIN = 1.24;
      const float STREAM2_QUANT_RATIO_MAX = 0.66;
-     if ((streamsOffset[1] + frame) % stream2QuantDur < stream2QuantDur / 2) {
+     if (fpsr_wrap_add(streamsOffset[1], frame) % stream2QuantDur < stream2QuantDur / 2) {
          s2_quant_level = (int)floor(quantLevelsMinMax[0] * STREAM2_QUANT_RATIO_MIN);
      } else {
          s2_quant_level = (int)floor(quantLevelsMinMax[1] * STREAM2_QUANT_RATIO_MAX);
      }
      // Ensure quantisation levels are at least 1.
-     if (s1_quant_level < 1) { s1_quant_level = 1; }
-     if (s2_quant_level < 1) { s2_quant_level = 1; }
+     if (s1_quant_level < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_LEVEL_CLAMP); s1_quant_level = 1; }
+     if (s2_quant_level < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_LEVEL_CLAMP); s2_quant_level = 1; }
  
  
      // --- 3. Generate the two quantised sine wave streams ---
-     if (stream2FreqMult < 0) { stream2FreqMult = 3.7; } // Default multiplier.
+     if (stream2FreqMult < 0) { FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_FREQ_MULT); stream2FreqMult = 3.7; } // Default multiplier.
  
-     float stream1 = floor(sin((float)(streamsOffset[0] + frame) * baseWaveFreq) * s1_quant_level) / s1_quant_level;
-     float stream2 = floor(sin((float)(streamsOffset[1] + frame) * baseWaveFreq * stream2FreqMult) * s2_quant_level) / s2_quant_level;
+     float stream1 = floor(sin((float)fpsr_wrap_add(streamsOffset[0], frame) * baseWaveFreq) * s1_quant_level) / s1_quant_level;
+     float stream2 = floor(sin((float)fpsr_wrap_add(streamsOffset[1], frame) * baseWaveFreq * stream2FreqMult) * s2_quant_level) / s2_quant_level;
  
      // --- 4. Switch between the two streams ---
      float active_stream_val;
@@ -171,11 +812,831 @@ if (randVal != randVal_previous) {
      // --- 5. Hash the final output to create a random-looking value ---
      // The stepped sine wave output is converted to a large integer and used
      // as a seed to produce the final, held random value.
-     fpsr_output = portable_rand((int)(active_stream_val * 100000.0));
+     float fpsr_output = portable_rand((int)(active_stream_val * 100000.0));
+     FPSR_PROBE_END(FPSR_STAT_QS);
      return fpsr_output;
  }
  
+ /**
+  * @brief Resolves a set of fpsr_qs parameters into a plan for repeated evaluation.
+  * @details Performs step 1 of fpsr_qs() (default durations derived from
+  * 1 / baseWaveFreq, clamping to at least one frame), the stream2FreqMult
+  * default, and the quantisation level selection and clamping of step 2 for
+  * both halves of each stream's duration cycle. None of this depends on the
+  * frame, so fpsr_qs_eval() only has the per-frame work left to do.
+  *
+  * @param plan The plan to fill in.
+  * @param baseWaveFreq ... stream2QuantDur As for fpsr_qs().
+  */
+ void fpsr_qs_plan_init(
+     fpsr_qs_plan* plan, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     if (plan == NULL) { return; }
+ 
+     // --- 1. Set default durations if not provided ---
+     if (streamSwitchDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_SWITCH_DUR);
+         streamSwitchDur = (int)floor((1.0 / baseWaveFreq) * 0.76);
+     }
+     if (stream1QuantDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_QUANT_DUR);
+         stream1QuantDur = (int)floor((1.0 / baseWaveFreq) * 1.2);
+     }
+     if (stream2QuantDur < 1) {
+         FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_QUANT_DUR);
+         stream2QuantDur = (int)floor((1.0 / baseWaveFreq) * 0.9);
+     }
+     // Ensure durations are at least 1 frame to prevent division by zero.
+     if (streamSwitchDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); streamSwitchDur = 1; }
+     if (stream1QuantDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); stream1QuantDur = 1; }
+     if (stream2QuantDur < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_DURATION_CLAMP); stream2QuantDur = 1; }
+ 
+     plan->streamSwitchDur = streamSwitchDur;
+     plan->stream1QuantDur = stream1QuantDur;
+     plan->stream2QuantDur = stream2QuantDur;
+     plan->streamSwitchHalf = streamSwitchDur / 2;
+     plan->stream1QuantHalf = stream1QuantDur / 2;
+     plan->stream2QuantHalf = stream2QuantDur / 2;
+ 
+     // --- 2. Quantisation levels for the first ([0]) and second ([1]) half of each cycle ---
+     const float STREAM2_QUANT_RATIO_MIN = 1.24;
+     const float STREAM2_QUANT_RATIO_MAX = 0.66;
+     plan->s1QuantLevels[0] = quantLevelsMinMax[0];
+     plan->s1QuantLevels[1] = quantLevelsMinMax[1];
+     plan->s2QuantLevels[0] = (int)floor(quantLevelsMinMax[0] * STREAM2_QUANT_RATIO_MIN);
+     plan->s2QuantLevels[1] = (int)floor(quantLevelsMinMax[1] * STREAM2_QUANT_RATIO_MAX);
+     for (int i = 0; i < 2; ++i) {
+         if (plan->s1QuantLevels[i] < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_LEVEL_CLAMP); plan->s1QuantLevels[i] = 1; }
+         if (plan->s2QuantLevels[i] < 1) { FPSR_STAT_EVENT(FPSR_STAT_QS_LEVEL_CLAMP); plan->s2QuantLevels[i] = 1; }
+     }
+ 
+     // --- 3. Stream frequencies ---
+     if (stream2FreqMult < 0) { FPSR_STAT_EVENT(FPSR_STAT_QS_DEFAULT_FREQ_MULT); stream2FreqMult = 3.7; } // Default multiplier.
+     plan->baseWaveFreq = baseWaveFreq;
+     plan->stream2FreqMult = stream2FreqMult;
+     plan->streamsOffset[0] = streamsOffset[0];
+     plan->streamsOffset[1] = streamsOffset[1];
+     plan->randBackend = FPSR_BACKEND_SIN;
+ }
+ 
+ /**
+  * @brief Evaluates only the stream that the switch selects at `frame`.
+  * @details Produces the same active_stream_val as steps 2 to 4 of fpsr_qs(),
+  * but skips the quantisation level and sine of the inactive stream. The only
+  * divisions left are the cycle modulos and the quantisation step itself.
+  * fpsr_qs_plan_stream() takes the switch decision (0 or 1) from the caller.
+  */
+ static inline float fpsr_qs_plan_stream(const fpsr_qs_plan* plan, int stream, int frame)
+ {
+     if (stream == 0) {
+         int t = fpsr_wrap_add(plan->streamsOffset[0], frame);
+         int level = plan->s1QuantLevels[(t % plan->stream1QuantDur) >= plan->stream1QuantHalf];
+         return floor(sin((float)t * plan->baseWaveFreq) * level) / level;
+     }
+     int t = fpsr_wrap_add(plan->streamsOffset[1], frame);
+     int level = plan->s2QuantLevels[(t % plan->stream2QuantDur) >= plan->stream2QuantHalf];
+     // Two float multiplies, in the same order as fpsr_qs(), keep the argument bit-identical.
+     return floor(sin((float)t * plan->baseWaveFreq * plan->stream2FreqMult) * level) / level;
+ }
+
+ static inline float fpsr_qs_plan_active_stream(const fpsr_qs_plan* plan, int frame)
+ {
+     return fpsr_qs_plan_stream(plan, (frame % plan->streamSwitchDur) >= plan->streamSwitchHalf, frame);
+ }
+
+ // The float sine argument of stream 0 or 1 at `frame`, rounded exactly as in fpsr_qs_plan_active_stream().
+ static inline float fpsr_qs_stream_arg(const fpsr_qs_plan* plan, int stream, int frame)
+ {
+     if (stream == 0) { return (float)fpsr_wrap_add(plan->streamsOffset[0], frame) * plan->baseWaveFreq; }
+     return (float)fpsr_wrap_add(plan->streamsOffset[1], frame) * plan->baseWaveFreq * plan->stream2FreqMult;
+ }
+
+ // Exclusive end of the look-ahead window of the QS change queries.
+ static inline long long fpsr_qs_change_limit(int frame)
+ {
+     long long limit = (long long)frame + FPSR_QS_CHANGE_HORIZON;
+     return (limit > INT_MAX) ? INT_MAX : limit;
+ }
+
+ // First frame after `frame` at which offset + frame wraps in the int arithmetic of fpsr_qs().
+ static inline long long fpsr_qs_wrap_frame(const fpsr_qs_plan* plan, int stream, int frame)
+ {
+     return (long long)frame + ((long long)INT_MAX - fpsr_wrap_add(plan->streamsOffset[stream], frame)) + 1;
+ }
+
+ /**
+  * @brief Finds the first x' > x at which "(x' % d) < half" differs from "(x % d) < half".
+  * @details The first/second-half test of the QS duration cycles. With C's
+  * truncating %, every negative x is in the first half, so the first flip of a
+  * negative x is at `half`.
+  *
+  * @return The flip, or LLONG_MAX if the test never changes (d == 1).
+  */
+ static long long fpsr_next_half_flip(long long x, int d, int half)
+ {
+     if (half == 0) { return LLONG_MAX; }
+     if (x < 0) { return half; }
+     long long r = x % d;
+     return (r < half) ? x + (half - r) : x + (d - r);
+ }
+
+ // The smallest base + 2*pi*k strictly beyond `a` in direction `dir` (+1 or -1).
+ static double fpsr_next_angle(double a, double base, int dir)
+ {
+     const double TWO_PI = 6.28318530717958647692;
+     double x = base + TWO_PI * floor((a - base) / TWO_PI);
+     if (dir > 0) {
+         while (x <= a) { x += TWO_PI; }
+         while (x - TWO_PI > a) { x -= TWO_PI; }
+     } else {
+         x += TWO_PI;
+         while (x >= a) { x -= TWO_PI; }
+         while (x + TWO_PI < a) { x += TWO_PI; }
+     }
+     return x;
+ }
+
+ /**
+  * @brief Finds the next frame in (frame, limit) at which a stream leaves its quantisation step.
+  * @details With the level fixed, the stream's step at frame f is
+  * floor(sin(arg(f)) * level), and arg(f) is monotonic in f. The step can only
+  * change once sin() reaches an edge of [step / level, (step + 1) / level), so
+  * the next edge angle is solved with asin() and the first frame whose argument
+  * comes within a small margin of it is found by a galloping search, which
+  * needs no sin() at all. From there frames are evaluated exactly until the step
+  * changes or the argument is safely past the edge (sin() only touched it).
+  *
+  * @return The first frame whose step differs from the one at `frame`, or limit if there is none.
+  */
+ static long long fpsr_qs_next_step(
+     const fpsr_qs_plan* plan, int stream, int level, long long frame, long long limit)
+ {
+     const double PI = 3.14159265358979323846;
+     // asin() and sin() near an edge agree to ~1e-8 rad even where the sine is flat.
+     const double EDGE_MARGIN_ABS = 1e-6;
+     const double EDGE_MARGIN_REL = 1e-15;
+
+     float w = (stream == 0) ? plan->baseWaveFreq : plan->baseWaveFreq * plan->stream2FreqMult;
+     if (w == 0.0f) { return limit; } // A constant argument never changes step.
+     int dir = (w > 0.0f) ? 1 : -1;
+
+     double a = fpsr_qs_stream_arg(plan, stream, (int)frame);
+     double step = floor(sin(a) * level);
+     if (a != a) { return limit; } // NaN frequency: every frame hashes the same seed.
+
+     long long cur = frame;
+     while (cur + 1 < limit) {
+         // --- 1. The nearest edge angle beyond the current argument ---
+         double x = (dir > 0) ? INFINITY : -INFINITY;
+         double edges[2] = { step / level, (step + 1) / level };
+         for (int e = 0; e < 2; ++e) {
+             if (edges[e] < -1.0 || edges[e] > 1.0) { continue; }
+             double r = asin(edges[e]);
+             double c0 = fpsr_next_angle(a, r, dir);
+             double c1 = fpsr_next_angle(a, PI - r, dir);
+             if (dir * (c0 - x) < 0) { x = c0; }
+             if (dir * (c1 - x) < 0) { x = c1; }
+         }
+         double margin = EDGE_MARGIN_ABS + fabs(x) * EDGE_MARGIN_REL;
+         double lo = x - dir * margin;
+         double hi = x + dir * margin;
+
+         // --- 2. First frame whose argument reaches the margin (gallop, then bisect) ---
+         long long good = cur;          // dir * arg(good) < dir * lo
+         long long bad = cur + 1;       // Candidate for the first frame at or past lo.
+         long long span = 1;
+         while (bad < limit && dir * ((double)fpsr_qs_stream_arg(plan, stream, (int)bad) - lo) < 0) {
+             good = bad;
+             span *= 2;
+             bad = (limit - good > span) ? good + span : limit;
+         }
+         while (bad - good > 1) {
+             long long mid = good + (bad - good) / 2;
+             if (dir * ((double)fpsr_qs_stream_arg(plan, stream, (int)mid) - lo) < 0) { good = mid; } else { bad = mid; }
+         }
+         if (bad >= limit) { return limit; }
+
+         // --- 3. Evaluate exactly across the edge ---
+         long long f = bad;
+         for (; f < limit; ++f) {
+             a = fpsr_qs_stream_arg(plan, stream, (int)f);
+             if (floor(sin(a) * level) != step) { return f; }
+             if (dir * (a - hi) > 0) { break; }
+         }
+         cur = f;
+     }
+     return limit;
+ }
+
+ /**
+  * @brief Finds the first frame in (frame, limit) at which fpsr_qs_eval() no longer returns `value`.
+  * @details Walks the segments over which the switch and the active stream's
+  * quantisation level are fixed, and the quantisation steps inside each. Only
+  * frames where one of those changes are evaluated and hashed.
+  *
+  * @param seed, value The hash seed and result at `frame`.
+  * @return The frame of the change, or limit if there is none.
+  */
+ static long long fpsr_qs_change_after(
+     const fpsr_qs_plan* plan, long long frame, int seed, float value, long long limit)
+ {
+     long long pos = frame;
+     while (pos < limit) {
+         // --- 1. The segment [pos, end) with a fixed stream and level ---
+         int f = (int)pos;
+         int stream = ((f % plan->streamSwitchDur) < plan->streamSwitchHalf) ? 0 : 1;
+         int quantDur = stream ? plan->stream2QuantDur : plan->stream1QuantDur;
+         int quantHalf = stream ? plan->stream2QuantHalf : plan->stream1QuantHalf;
+         int t = fpsr_wrap_add(plan->streamsOffset[stream], f);
+         int level = (stream ? plan->s2QuantLevels : plan->s1QuantLevels)[(t % quantDur) >= quantHalf];
+
+         long long end = fpsr_next_half_flip(pos, plan->streamSwitchDur, plan->streamSwitchHalf);
+         long long levelFlip = fpsr_next_half_flip(t, quantDur, quantHalf);
+         if (levelFlip != LLONG_MAX && pos + (levelFlip - t) < end) { end = pos + (levelFlip - t); }
+         // End the segment where offset + frame wraps, so the argument stays monotonic.
+         long long wrap = fpsr_qs_wrap_frame(plan, stream, f);
+         if (wrap < end) { end = wrap; }
+         if (end > limit) { end = limit; }
+
+         // --- 2. Quantisation steps inside the segment, then the segment's end ---
+         long long next = pos;
+         for (;;) {
+             next = fpsr_qs_next_step(plan, stream, level, next, end);
+             if (next >= limit) { return limit; }
+             int next_seed = (int)(fpsr_qs_plan_active_stream(plan, (int)next) * 100000.0);
+             if (next_seed != seed && fpsr_rand(plan->randBackend, next_seed) != value) { return next; }
+             if (next >= end) { break; }
+         }
+         pos = end;
+     }
+     return limit;
+ }
+
+ /**
+  * @brief Evaluates fpsr_qs from a plan built by fpsr_qs_plan_init().
+  * @details The hot path for fixed parameter sets: no default handling, no
+  * clamping and a single sine per frame. The result is identical to calling
+  * fpsr_qs() with the parameters the plan was built from.
+  *
+  * @param plan A plan built by fpsr_qs_plan_init().
+  * @param frame The current frame or time input.
+  * @return The same value as fpsr_qs(frame, ...).
+  */
+ float fpsr_qs_eval(const fpsr_qs_plan* plan, int frame)
+ {
+     FPSR_PROBE_BEGIN(FPSR_STAT_QS_EVAL, "fpsr_qs_eval");
+     float active_stream_val = fpsr_qs_plan_active_stream(plan, frame);
+     float result = fpsr_rand(plan->randBackend, (int)(active_stream_val * 100000.0));
+     FPSR_PROBE_END(FPSR_STAT_QS_EVAL);
+     return result;
+ }
+ 
+ /**
+  * @brief fpsr_qs_ex() for a prebuilt plan.
+  * @param plan A plan built by fpsr_qs_plan_init().
+  * @param frame, changed, framesUntilChange As for fpsr_qs_ex().
+  * @return The same value as fpsr_qs_eval(plan, frame).
+  */
+ float fpsr_qs_plan_eval_ex(
+     const fpsr_qs_plan* plan, int frame,
+     int* changed, int* framesUntilChange)
+ {
+     // --- 1. Evaluate the current frame ---
+     float active_stream_val = fpsr_qs_plan_active_stream(plan, frame);
+     int seed = (int)(active_stream_val * 100000.0);
+     float fpsr_output = fpsr_rand(plan->randBackend, seed);
+ 
+     // --- 2. Compare with the previous frame; equal seeds need no hashing ---
+     if (changed != NULL) {
+         float prev_val = fpsr_qs_plan_active_stream(plan, (frame > INT_MIN) ? frame - 1 : frame);
+         int prev_seed = (int)(prev_val * 100000.0);
+         *changed = (prev_seed != seed) && (fpsr_rand(plan->randBackend, prev_seed) != fpsr_output);
+     }
+ 
+     // --- 3. Look ahead to the next change ---
+     if (framesUntilChange != NULL) {
+         // The look-ahead stops at INT_MAX, so at INT_MAX itself report the 1 frame past the range, as SM does.
+         long long frames = fpsr_qs_change_after(plan, frame, seed, fpsr_output, fpsr_qs_change_limit(frame)) - frame;
+         *framesUntilChange = (frames < 1) ? 1 : (frames > INT_MAX) ? INT_MAX : (int)frames;
+     }
+
+     return fpsr_output;
+ }
+
+ /**
+  * @brief Finds the first frame after `frame` at which fpsr_qs_eval() takes a different value.
+  * @details See fpsr_qs_next_change(); the plan's randBackend is honoured.
+  * @param plan A plan built by fpsr_qs_plan_init().
+  * @param frame The current frame or time input.
+  * @return The frame of the next change, capped at frame + FPSR_QS_CHANGE_HORIZON and INT_MAX.
+  */
+ int fpsr_qs_plan_next_change(const fpsr_qs_plan* plan, int frame)
+ {
+     int seed = (int)(fpsr_qs_plan_active_stream(plan, frame) * 100000.0);
+     float fpsr_output = fpsr_rand(plan->randBackend, seed);
+     return (int)fpsr_qs_change_after(plan, frame, seed, fpsr_output, fpsr_qs_change_limit(frame));
+ }
+
+ /**
+  * @brief Finds the first frame after `frame` at which fpsr_qs takes a different value.
+  * @details Lets a scheduler sleep until the next change instead of polling
+  * every tick. The value can only change where the stream switch or the active
+  * stream's quantisation level flips, both read off their duration cycles, or
+  * where the active sine crosses one of its quantisation steps, which is
+  * solved with asin() and located with a search over the frame's sine
+  * argument. Every candidate is confirmed with the exact per-frame arithmetic,
+  * so the answer matches a frame-by-frame scan while costing O(changes).
+  *
+  * @param frame ... stream2QuantDur As for fpsr_qs().
+  * @return The frame of the next change, capped at frame + FPSR_QS_CHANGE_HORIZON and INT_MAX.
+  * A capped result means "no change before then"; query again from there.
+  */
+ int fpsr_qs_next_change(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(
+         &plan, baseWaveFreq, stream2FreqMult, quantLevelsMinMax, streamsOffset,
+         streamSwitchDur, stream1QuantDur, stream2QuantDur);
+     return fpsr_qs_plan_next_change(&plan, frame);
+ }
+ 
+ /**
+  * @brief fpsr_qs with change detection fused into the same evaluation.
+  * @details Returns fpsr_qs(frame, ...) and, optionally, whether it differs from
+  * fpsr_qs(frame - 1, ...) and how many frames it will hold for. The defaults
+  * are resolved once for both frames, only the active stream is evaluated per
+  * frame, and the previous frame is only hashed when its active stream value
+  * actually differs.
+  *
+  * @param frame ... stream2QuantDur As for fpsr_qs().
+  * @param changed If not NULL, receives 1 when the value differs from the previous frame, else 0.
+  * INT_MIN has no previous frame and reports 0.
+  * @param framesUntilChange If not NULL, receives the number of frames (>= 1) until the value
+  * next differs, capped at FPSR_QS_CHANGE_HORIZON.
+  * @return The same value as fpsr_qs(frame, ...).
+  */
+ float fpsr_qs_ex(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur,
+     int* changed, int* framesUntilChange)
+ {
+     // Resolve defaults once for every frame evaluated below.
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(
+         &plan, baseWaveFreq, stream2FreqMult, quantLevelsMinMax, streamsOffset,
+         streamSwitchDur, stream1QuantDur, stream2QuantDur);
+     return fpsr_qs_plan_eval_ex(&plan, frame, changed, framesUntilChange);
+ }
+ 
+ /**
+  * @brief fpsr_qs with a selectable random number backend for the final hash.
+  * @details With FPSR_BACKEND_SIN this is fpsr_qs(). With FPSR_BACKEND_HASH the
+  * final hash uses portable_rand_hash(). The two quantised streams are sine
+  * waves by design and still use sin(); set fpsr_qs_plan.randBackend to use the
+  * hash backend with the plan-based entry points.
+  *
+  * @param backend FPSR_BACKEND_SIN or FPSR_BACKEND_HASH.
+  * @param frame ... stream2QuantDur As for fpsr_qs().
+  * @return A float value between 0.0 and 1.0.
+  */
+ float fpsr_qs_backend(
+     fpsr_rand_backend backend, int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     fpsr_qs_plan plan;
+     fpsr_qs_plan_init(
+         &plan, baseWaveFreq, stream2FreqMult, quantLevelsMinMax, streamsOffset,
+         streamSwitchDur, stream1QuantDur, stream2QuantDur);
+     plan.randBackend = backend;
+     return fpsr_qs_eval(&plan, frame);
+ }
+ 
+ /**
+  * @brief Tabulates the runs of one stream at one quantisation level over [startFrame, endFrame].
+  * @details Step changes are found with fpsr_qs_next_step(), so building costs
+  * O(runs) rather than a sin() per frame. Each run stores the final hashed
+  * output, so lookups need no transcendental at all.
+  */
+ static int fpsr_qs_runs_build(
+     fpsr_qs_runs* runs, const fpsr_qs_plan* plan, int stream, int level, int startFrame, int endFrame)
+ {
+     size_t capacity = 64;
+     runs->runStart = (int*)malloc(sizeof(int) * capacity);
+     runs->value = (float*)malloc(sizeof(float) * capacity);
+     runs->blockRun = NULL;
+     runs->count = 0;
+     if (runs->runStart == NULL || runs->value == NULL) { return -1; }
+
+     long long frame = startFrame;
+     while (frame <= endFrame) {
+         if (runs->count == capacity) {
+             capacity *= 2;
+             int* runStart = (int*)realloc(runs->runStart, sizeof(int) * capacity);
+             if (runStart != NULL) { runs->runStart = runStart; }
+             float* value = (float*)realloc(runs->value, sizeof(float) * capacity);
+             if (value != NULL) { runs->value = value; }
+             if (runStart == NULL || value == NULL) { return -1; }
+         }
+
+         // Same arithmetic as fpsr_qs_plan_active_stream() for a fixed stream and level.
+         float arg = fpsr_qs_stream_arg(plan, stream, (int)frame);
+         float active_stream_val = floor(sin(arg) * level) / level;
+         runs->runStart[runs->count] = (int)frame;
+         runs->value[runs->count] = fpsr_rand(plan->randBackend, (int)(active_stream_val * 100000.0));
+         runs->count++;
+
+         long long limit = fpsr_qs_wrap_frame(plan, stream, (int)frame);
+         if (limit > (long long)endFrame + 1) { limit = (long long)endFrame + 1; }
+         frame = fpsr_qs_next_step(plan, stream, level, frame, limit);
+     }
+
+     // --- Block index: the run covering the first frame of every block ---
+     size_t blocks = (size_t)(((long long)endFrame - startFrame) / FPSR_QS_TABLE_BLOCK) + 1;
+     runs->blockRun = (size_t*)malloc(sizeof(size_t) * blocks);
+     if (runs->blockRun == NULL) { return -1; }
+     size_t i = 0;
+     for (size_t b = 0; b < blocks; ++b) {
+         long long first = (long long)startFrame + (long long)b * FPSR_QS_TABLE_BLOCK;
+         while (i + 1 < runs->count && runs->runStart[i + 1] <= first) { ++i; }
+         runs->blockRun[b] = i;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Precomputes fpsr_qs_eval() for a plan over a frame range as run tables.
+  * @details For each stream and each half of its quantisation cycle (i.e. each
+  * of its two levels) the frames where the quantised value changes are
+  * tabulated together with the hashed output, plus an index of the run at the
+  * start of every FPSR_QS_TABLE_BLOCK frames. fpsr_qs_table_eval() then only
+  * needs the integer cycle tests and an index lookup. Streams whose two levels
+  * are equal share one table. Memory is 8 bytes per quantisation step plus
+  * sizeof(size_t) per block, per table.
+  *
+  * @param table The table to build; release it with fpsr_qs_table_free().
+  * @param plan A plan built by fpsr_qs_plan_init(); it is copied.
+  * @param startFrame The first frame to tabulate.
+  * @param endFrame The last frame to tabulate (inclusive).
+  * @return 0 on success, -1 if the range is empty or memory ran out.
+  */
+ int fpsr_qs_table_build(fpsr_qs_table* table, const fpsr_qs_plan* plan, int startFrame, int endFrame)
+ {
+     if (table == NULL) { return -1; }
+     memset(table, 0, sizeof(*table));
+     if (plan == NULL || startFrame > endFrame) { return -1; }
+
+     table->plan = *plan;
+     table->startFrame = startFrame;
+     table->endFrame = endFrame;
+     for (int s = 0; s < 2; ++s) {
+         const int* levels = s ? plan->s2QuantLevels : plan->s1QuantLevels;
+         for (int h = 0; h < 2; ++h) {
+             if (h == 1 && levels[1] == levels[0]) {
+                 table->runs[s][1] = table->runs[s][0];
+                 continue;
+             }
+             if (fpsr_qs_runs_build(&table->runs[s][h], plan, s, levels[h], startFrame, endFrame) != 0) {
+                 fpsr_qs_table_free(table);
+                 return -1;
+             }
+         }
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Releases the run tables of a table built by fpsr_qs_table_build().
+  */
+ void fpsr_qs_table_free(fpsr_qs_table* table)
+ {
+     if (table == NULL) { return; }
+     for (int s = 0; s < 2; ++s) {
+         if (table->runs[s][1].runStart != table->runs[s][0].runStart) {
+             free(table->runs[s][1].runStart);
+             free(table->runs[s][1].value);
+             free(table->runs[s][1].blockRun);
+         }
+         free(table->runs[s][0].runStart);
+         free(table->runs[s][0].value);
+         free(table->runs[s][0].blockRun);
+     }
+     memset(table->runs, 0, sizeof(table->runs));
+ }
+
+ /**
+  * @brief Evaluates fpsr_qs_eval() from precomputed run tables.
+  * @details Inside the tabulated range this is the stream switch and level
+  * tests, one block index lookup and a short forward scan over the runs of
+  * that block (at most FPSR_QS_TABLE_BLOCK steps); outside it falls back to
+  * fpsr_qs_eval(). Either way the result is identical to fpsr_qs_eval().
+  *
+  * @param table A table built by fpsr_qs_table_build().
+  * @param frame The current frame or time input.
+  * @return The same value as fpsr_qs_eval(&table->plan, frame).
+  */
+ float fpsr_qs_table_eval(const fpsr_qs_table* table, int frame)
+ {
+     const fpsr_qs_plan* plan = &table->plan;
+     if (frame < table->startFrame || frame > table->endFrame) { return fpsr_qs_eval(plan, frame); }
+
+     int s = ((frame % plan->streamSwitchDur) < plan->streamSwitchHalf) ? 0 : 1;
+     int t = fpsr_wrap_add(plan->streamsOffset[s], frame);
+     int h = s ? ((t % plan->stream2QuantDur) >= plan->stream2QuantHalf)
+               : ((t % plan->stream1QuantDur) >= plan->stream1QuantHalf);
+     const fpsr_qs_runs* runs = &table->runs[s][h];
+
+     // The block index gives the run covering the block's first frame; step forward from there.
+     size_t i = runs->blockRun[(size_t)((long long)frame - table->startFrame) / FPSR_QS_TABLE_BLOCK];
+     while (i + 1 < runs->count && runs->runStart[i + 1] <= frame) { ++i; }
+     return runs->value[i];
+ }
+
+ // Strict order of two channels a, b of `items`; every order ends on the channel index, so there are no ties.
+ typedef int (*fpsr_channel_less)(const void* items, size_t a, size_t b);
+
+ static void fpsr_channel_sift_down(size_t* order, size_t root, size_t n, fpsr_channel_less less, const void* items)
+ {
+     for (;;) {
+         size_t child = 2 * root + 1;
+         if (child >= n) { return; }
+         if (child + 1 < n && less(items, order[child], order[child + 1])) { ++child; }
+         if (!less(items, order[root], order[child])) { return; }
+         size_t t = order[root];
+         order[root] = order[child];
+         order[child] = t;
+         root = child;
+     }
+ }
+
+ // Fills order[] with 0 .. n-1 sorted by less(). A heapsort, in place: unlike qsort() it needs no keyed copy of the channels.
+ static void fpsr_channel_sort(size_t* order, size_t n, fpsr_channel_less less, const void* items)
+ {
+     for (size_t i = 0; i < n; ++i) { order[i] = i; }
+     for (size_t i = n / 2; i-- > 0;) { fpsr_channel_sift_down(order, i, n, less, items); }
+     for (size_t end = n; end-- > 1;) {
+         size_t t = order[0];
+         order[0] = order[end];
+         order[end] = t;
+         fpsr_channel_sift_down(order, 0, end, less, items);
+     }
+ }
+
+ static inline int fpsr_sm_channel_reseed(const fpsr_sm_params* p)
+ {
+     return (p->reseedInterval < 1) ? 1 : p->reseedInterval; // As fpsr_sm().
+ }
+
+ // Order of SM channels: the parameters that fix the hold duration, then the channel index.
+ static int fpsr_sm_channel_less(const void* items, size_t a, size_t b)
+ {
+     const fpsr_sm_params* x = (const fpsr_sm_params*)items + a;
+     const fpsr_sm_params* y = (const fpsr_sm_params*)items + b;
+     const int kx[4] = { fpsr_sm_channel_reseed(x), x->minHold, x->maxHold, x->seedInner };
+     const int ky[4] = { fpsr_sm_channel_reseed(y), y->minHold, y->maxHold, y->seedInner };
+     for (int i = 0; i < 4; ++i) {
+         if (kx[i] != ky[i]) { return kx[i] < ky[i]; }
+     }
+     return a < b;
+ }
+
+ /**
+  * @brief The memory fpsr_sm_channels_init_in() needs for `count` channels.
+  * @return A size in bytes; the block must be aligned for max_align_t.
+  */
+ size_t fpsr_sm_channels_memory(size_t count)
+ {
+     return count * (sizeof(fpsr_sm_channel_group) + sizeof(size_t) + sizeof(int));
+ }
+
+ /**
+  * @brief Prepares a set of SM channels for evaluation at shared frames.
+  * @details Channels are grouped by (reseedInterval, minHold, maxHold,
+  * seedInner): within a group the reseed window and therefore the random hold
+  * duration are the same at every frame, so fpsr_sm_channels_eval() computes
+  * them once per group. Groups are ordered by reseedInterval so that
+  * frame % reseedInterval is taken once per distinct interval.
+  *
+  * @param channels The set to fill; release it with fpsr_sm_channels_free().
+  * @param params An array of `count` parameter sets; it is copied.
+  * @param count The number of channels.
+  * @return 0 on success, -1 on invalid arguments or if memory ran out.
+  */
+ int fpsr_sm_channels_init(fpsr_sm_channels* channels, const fpsr_sm_params* params, size_t count)
+ {
+     if (channels == NULL) { return -1; }
+     memset(channels, 0, sizeof(*channels));
+     if (params == NULL && count != 0) { return -1; }
+
+     size_t size = fpsr_sm_channels_memory(count ? count : 1);
+     void* memory = malloc(size);
+     if (memory == NULL || fpsr_sm_channels_init_in(channels, params, count, memory, size) != 0) {
+         free(memory);
+         return -1;
+     }
+     channels->ownsMemory = 1;
+     return 0;
+ }
+
+ /**
+  * @brief fpsr_sm_channels_init() in caller-owned memory; allocates nothing.
+  * @param channels, params, count As for fpsr_sm_channels_init().
+  * @param memory A block aligned for max_align_t that outlives the set.
+  * @param size The block's size, at least fpsr_sm_channels_memory(count).
+  * @return 0 on success, -1 on invalid arguments or if the block is too small.
+  */
+ int fpsr_sm_channels_init_in(fpsr_sm_channels* channels, const fpsr_sm_params* params, size_t count, void* memory, size_t size)
+ {
+     if (channels == NULL) { return -1; }
+     memset(channels, 0, sizeof(*channels));
+     if ((params == NULL || memory == NULL) && count != 0) { return -1; }
+     if (size < fpsr_sm_channels_memory(count)) { return -1; }
+
+     // Groups, then the output slots, then the outer seeds: each array keeps the alignment of the one before.
+     channels->groups = (fpsr_sm_channel_group*)memory;
+     channels->outIndex = (size_t*)(channels->groups + count);
+     channels->seedOuter = (int*)(channels->outIndex + count);
+     fpsr_channel_sort(channels->outIndex, count, fpsr_sm_channel_less, params);
+
+     for (size_t i = 0; i < count; ++i) {
+         const fpsr_sm_params* p = &params[channels->outIndex[i]];
+         int reseedInterval = fpsr_sm_channel_reseed(p);
+         fpsr_sm_channel_group* g = channels->groupCount ? &channels->groups[channels->groupCount - 1] : NULL;
+         if (g == NULL || g->reseedInterval != reseedInterval || g->minHold != p->minHold ||
+             g->maxHold != p->maxHold || g->seedInner != p->seedInner) {
+             g = &channels->groups[channels->groupCount++];
+             g->minHold = p->minHold;
+             g->maxHold = p->maxHold;
+             g->reseedInterval = reseedInterval;
+             g->seedInner = p->seedInner;
+             g->first = i;
+             g->count = 0;
+         }
+         g->count++;
+         channels->seedOuter[i] = p->seedOuter;
+     }
+     channels->count = count;
+     return 0;
+ }
+
+ void fpsr_sm_channels_free(fpsr_sm_channels* channels)
+ {
+     if (channels == NULL) { return; }
+     if (channels->ownsMemory) { free(channels->groups); }
+     memset(channels, 0, sizeof(*channels));
+ }
+
+ /**
+  * @brief Evaluates every channel of a set at one frame.
+  * @details Per distinct reseedInterval: one modulo. Per group: one hash for
+  * the hold duration. Per channel: the held state and the final hash. The
+  * arithmetic is that of fpsr_sm(), so out[i] is bit-identical to
+  * fpsr_sm(frame, params[i]...).
+  *
+  * @param channels A set from fpsr_sm_channels_init().
+  * @param frame The current frame or time input.
+  * @param out A caller-owned array that receives one value per channel, in the order given to init.
+  */
+ void fpsr_sm_channels_eval(const fpsr_sm_channels* channels, int frame, float* out)
+ {
+     if (channels == NULL || out == NULL) { return; }
+
+     int interval = 0;
+     int phase = 0;
+     for (size_t gi = 0; gi < channels->groupCount; ++gi) {
+         const fpsr_sm_channel_group* g = &channels->groups[gi];
+
+         // --- 1. Shared by the group: the reseed window and the hold duration ---
+         if (g->reseedInterval != interval) {
+             interval = g->reseedInterval;
+             phase = frame % interval;
+         }
+         float rand_for_duration = portable_rand(fpsr_wrap_add(g->seedInner, frame - phase));
+         int holdDuration = (int)floor(g->minHold + rand_for_duration * (g->maxHold - g->minHold));
+         if (holdDuration < 1) { FPSR_STAT_EVENT(FPSR_STAT_SM_HOLD_CLAMP); holdDuration = 1; } // Prevent division by zero.
+
+         // --- 2. Per channel: the held state and its value ---
+         for (size_t i = g->first; i < g->first + g->count; ++i) {
+             int t = fpsr_wrap_add(channels->seedOuter[i], frame);
+             out[channels->outIndex[i]] = portable_rand(t - (t % holdDuration));
+         }
+     }
+ }
+
+ // Order of QS channels: switch duration, then the channel index.
+ static int fpsr_qs_channel_less(const void* items, size_t a, size_t b)
+ {
+     const fpsr_qs_plan* x = (const fpsr_qs_plan*)items + a;
+     const fpsr_qs_plan* y = (const fpsr_qs_plan*)items + b;
+     if (x->streamSwitchDur != y->streamSwitchDur) { return x->streamSwitchDur < y->streamSwitchDur; }
+     return a < b;
+ }
+
+ /**
+  * @brief The memory fpsr_qs_channels_init_in() needs for `count` channels.
+  * @return A size in bytes; the block must be aligned for max_align_t.
+  */
+ size_t fpsr_qs_channels_memory(size_t count)
+ {
+     return count * (sizeof(size_t) + sizeof(fpsr_qs_plan));
+ }
+
+ /**
+  * @brief Prepares a set of QS channels for evaluation at shared frames.
+  * @details Channels are ordered by streamSwitchDur. All channels with the same
+  * switch duration take the same stream at a given frame, so
+  * fpsr_qs_channels_eval() makes the switch decision once per distinct
+  * duration and runs each run of channels through a single stream's code.
+  *
+  * @param channels The set to fill; release it with fpsr_qs_channels_free().
+  * @param plans An array of `count` plans built by fpsr_qs_plan_init(); they are copied.
+  * @param count The number of channels.
+  * @return 0 on success, -1 on invalid arguments or if memory ran out.
+  */
+ int fpsr_qs_channels_init(fpsr_qs_channels* channels, const fpsr_qs_plan* plans, size_t count)
+ {
+     if (channels == NULL) { return -1; }
+     memset(channels, 0, sizeof(*channels));
+     if (plans == NULL && count != 0) { return -1; }
+
+     size_t size = fpsr_qs_channels_memory(count ? count : 1);
+     void* memory = malloc(size);
+     if (memory == NULL || fpsr_qs_channels_init_in(channels, plans, count, memory, size) != 0) {
+         free(memory);
+         return -1;
+     }
+     channels->ownsMemory = 1;
+     return 0;
+ }
+
+ /**
+  * @brief fpsr_qs_channels_init() in caller-owned memory; allocates nothing.
+  * @param channels, plans, count As for fpsr_qs_channels_init().
+  * @param memory A block aligned for max_align_t that outlives the set.
+  * @param size The block's size, at least fpsr_qs_channels_memory(count).
+  * @return 0 on success, -1 on invalid arguments or if the block is too small.
+  */
+ int fpsr_qs_channels_init_in(fpsr_qs_channels* channels, const fpsr_qs_plan* plans, size_t count, void* memory, size_t size)
+ {
+     if (channels == NULL) { return -1; }
+     memset(channels, 0, sizeof(*channels));
+     if ((plans == NULL || memory == NULL) && count != 0) { return -1; }
+     if (size < fpsr_qs_channels_memory(count)) { return -1; }
+
+     channels->outIndex = (size_t*)memory;
+     channels->plans = (fpsr_qs_plan*)(channels->outIndex + count);
+     fpsr_channel_sort(channels->outIndex, count, fpsr_qs_channel_less, plans);
+     for (size_t i = 0; i < count; ++i) { channels->plans[i] = plans[channels->outIndex[i]]; }
+     channels->count = count;
+     return 0;
+ }
+
+ void fpsr_qs_channels_free(fpsr_qs_channels* channels)
+ {
+     if (channels == NULL) { return; }
+     if (channels->ownsMemory) { free(channels->outIndex); }
+     memset(channels, 0, sizeof(*channels));
+ }
+
+ /**
+  * @brief Evaluates every channel of a set at one frame.
+  * @details One switch modulo per distinct streamSwitchDur; each channel then
+  * costs its quantisation test, one sine and the final hash. out[i] is
+  * bit-identical to fpsr_qs_eval(&plans[i], frame).
+  *
+  * @param channels A set from fpsr_qs_channels_init().
+  * @param frame The current frame or time input.
+  * @param out A caller-owned array that receives one value per channel, in the order given to init.
+  */
+ void fpsr_qs_channels_eval(const fpsr_qs_channels* channels, int frame, float* out)
+ {
+     if (channels == NULL || out == NULL) { return; }
+
+     size_t i = 0;
+     while (i < channels->count) {
+         // --- 1. Shared by every channel with this switch duration: the active stream ---
+         const fpsr_qs_plan* first = &channels->plans[i];
+         int stream = (frame % first->streamSwitchDur) >= first->streamSwitchHalf;
+         size_t end = i + 1;
+         while (end < channels->count && channels->plans[end].streamSwitchDur == first->streamSwitchDur) { ++end; }
+
+         // --- 2. Per channel: that stream's level, sine and hash ---
+         for (; i < end; ++i) {
+             const fpsr_qs_plan* plan = &channels->plans[i];
+             float active_stream_val = fpsr_qs_plan_stream(plan, stream, frame);
+             out[channels->outIndex[i]] = fpsr_rand(plan->randBackend, (int)(active_stream_val * 100000.0));
+         }
+     }
+ }
+
 // Sample code to call the FPS-R:QS function
+#if 0 // Illustrative only; paste into your own frame loop.
 // Parameters
 int frame = 103; // Current frame number
 float baseWaveFreq = 0.012; // Base frequency for the modulation wave of stream 1
@@ -190,12 +1651,11 @@ float randVal = fpsr_qs(
     frame, baseWaveFreq, stream2freqMult, quantLevelsMinMax, 
     streamsOffset, streamSwitchDur, stream1QuantDur, stream2QuantDur);
 
-// another call to fpsr_qs for the previous frame
-float randVal_previous = fpsr_qs(
-    int(@Frame - 1), baseWaveFreq, stream2freqMult, quantLevelsMinMax, 
-    streamsOffset, streamSwitchDur, stream1QuantDur, stream2QuantDur);
-
+// Or get the value and whether it changed from the previous frame in one call
 int changed = 0; // Variable to track if the value has changed
-if (randVal != randVal_previous) {
-    changed = 1; // Mark as changed if the value has changed from the previous frame
-} 
\ No newline at end of file
+int framesUntilChange = 0; // Frames until the value changes again
+float randVal_ex = fpsr_qs_ex(
+    frame, baseWaveFreq, stream2freqMult, quantLevelsMinMax, 
+    streamsOffset, streamSwitchDur, stream1QuantDur, stream2QuantDur,
+    &changed, &framesUntilChange);
+#endif
@@ -0,0 +1,743 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_algorithms.h
+ * @brief Public interface for the portable C implementation of FPS-R (see fpsr_algorithms.c).
+ * @details Declares the scalar reference functions and the batched entry points that
+ * write straight into caller-owned buffers. Full documentation lives with each
+ * definition in fpsr_algorithms.c.
+ */
+
+ #ifndef FPSR_ALGORITHMS_H
+ #define FPSR_ALGORITHMS_H
+
+ #include <stddef.h> // For size_t
+ #include <stdint.h> // For int32_t, uint32_t
+
+ #ifdef __cplusplus
+ extern "C" {
+ #endif
+
+ float portable_rand(int seed);
+
+ // Integer-only alternative to portable_rand(): bit-identical on every compiler and CPU.
+ float portable_rand_hash(int seed);
+
+ typedef enum fpsr_rand_backend {
+     FPSR_BACKEND_SIN = 0,  // portable_rand(), the reference.
+     FPSR_BACKEND_HASH = 1  // portable_rand_hash().
+ } fpsr_rand_backend;
+
+ /******************************************************************************/
+ /* FPS-R: Stacked Modulo (SM)                            */
+ /******************************************************************************/
+
+ float fpsr_sm(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ // fpsr_sm() with the hashing stages routed through `backend`.
+ float fpsr_sm_backend(
+     fpsr_rand_backend backend, int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ // Evaluates fpsr_sm for n arbitrary frames: out[i] = fpsr_sm(frames[i], ...).
+ void fpsr_sm_batch(
+     const int* frames, float* out, size_t n,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ // Evaluates fpsr_sm for the contiguous frames startFrame .. startFrame + n - 1; frames past INT_MAX take INT_MAX's value.
+ void fpsr_sm_range(
+     int startFrame, size_t n, float* out,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ // A run of frames [startFrame, endFrame] (inclusive) over which fpsr_sm is constant.
+ typedef struct fpsr_sm_segment {
+     int startFrame;
+     int endFrame;
+     float value;
+ } fpsr_sm_segment;
+
+ // Iterator state for fpsr_sm_segments_begin() / fpsr_sm_segments_next(). Treat as opaque.
+ typedef struct fpsr_sm_segment_iter {
+     int minHold, maxHold, reseedInterval, seedInner, seedOuter;
+     long long nextFrame, endFrame;
+     long long windowEnd; // Last frame of the reseed window holdDuration belongs to.
+     int holdDuration;
+     int hasPending; // A run past the last segment was already evaluated.
+     long long pendingEnd;
+     float pendingValue;
+     int done;
+ } fpsr_sm_segment_iter;
+
+ // Walks the constant-value segments of fpsr_sm over [startFrame, endFrame] in O(segments).
+ void fpsr_sm_segments_begin(
+     fpsr_sm_segment_iter* it, int startFrame, int endFrame,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+ int fpsr_sm_segments_next(fpsr_sm_segment_iter* it, fpsr_sm_segment* seg);
+
+ // Caches the reseed window and held-state run of the last frame evaluated. Treat as opaque.
+ typedef struct fpsr_sm_cursor {
+     int minHold, maxHold, reseedInterval, seedInner, seedOuter;
+     int hasWindow;
+     long long windowStart, windowEnd; // Frames sharing the cached holdDuration.
+     int holdDuration;
+     int hasRun;
+     long long runStart, runEnd;       // Frames sharing heldState, within the window.
+     int heldState;
+     float value;
+ } fpsr_sm_cursor;
+
+ // fpsr_sm for one parameter set at frames in any order, hashing only at window and hold boundaries.
+ void fpsr_sm_cursor_init(
+     fpsr_sm_cursor* cursor, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+ float fpsr_sm_cursor_eval(fpsr_sm_cursor* cursor, int frame);
+
+ // fpsr_sm plus "changed since frame - 1" and "frames until next change"; either out-pointer may be NULL.
+ float fpsr_sm_ex(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter,
+     int* changed, int* framesUntilChange);
+
+ // First frame after `frame` with a different fpsr_sm value, or INT_MAX if it holds through INT_MAX.
+ int fpsr_sm_next_change(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ /******************************************************************************/
+ /* FPS-R: Quantised Switching (QS)                         */
+ /******************************************************************************/
+
+ float fpsr_qs(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+
+ // fpsr_qs() with the final hash routed through `backend`.
+ float fpsr_qs_backend(
+     fpsr_rand_backend backend, int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+
+ // Furthest fpsr_qs_ex() and fpsr_qs_next_change() look ahead for the next change, in frames.
+ #define FPSR_QS_CHANGE_HORIZON 65536
+
+ // fpsr_qs plus "changed since frame - 1" and "frames until next change"; either out-pointer may be NULL.
+ float fpsr_qs_ex(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur,
+     int* changed, int* framesUntilChange);
+
+ // First frame after `frame` with a different fpsr_qs value, capped at frame + FPSR_QS_CHANGE_HORIZON and INT_MAX.
+ int fpsr_qs_next_change(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+
+ // fpsr_qs parameters with defaults, clamps and quantisation levels resolved up front.
+ typedef struct fpsr_qs_plan {
+     float baseWaveFreq;
+     float stream2FreqMult;       // Default already applied.
+     int streamsOffset[2];
+     int streamSwitchDur;         // Durations: defaults applied, >= 1.
+     int stream1QuantDur;
+     int stream2QuantDur;
+     int streamSwitchHalf;        // Each duration / 2.
+     int stream1QuantHalf;
+     int stream2QuantHalf;
+     int s1QuantLevels[2];        // Levels for the first / second half of each cycle, >= 1.
+     int s2QuantLevels[2];
+     fpsr_rand_backend randBackend; // FPSR_BACKEND_SIN after init; may be changed.
+ } fpsr_qs_plan;
+
+ void fpsr_qs_plan_init(
+     fpsr_qs_plan* plan, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+
+ // Hot path: same value as fpsr_qs() for the planned parameters.
+ float fpsr_qs_eval(const fpsr_qs_plan* plan, int frame);
+
+ // fpsr_qs_ex() for a prebuilt plan.
+ float fpsr_qs_plan_eval_ex(
+     const fpsr_qs_plan* plan, int frame,
+     int* changed, int* framesUntilChange);
+
+ // fpsr_qs_next_change() for a prebuilt plan.
+ int fpsr_qs_plan_next_change(const fpsr_qs_plan* plan, int frame);
+
+ // Frames per entry of the block index of an fpsr_qs_table.
+ #define FPSR_QS_TABLE_BLOCK 16
+
+ // Runs of one QS stream at one quantisation level: frames runStart[i] .. runStart[i + 1] - 1 give value[i].
+ typedef struct fpsr_qs_runs {
+     int* runStart;
+     float* value;
+     size_t count;
+     size_t* blockRun;            // Run covering frame startFrame + b * FPSR_QS_TABLE_BLOCK.
+ } fpsr_qs_runs;
+
+ // fpsr_qs_eval() precomputed over [startFrame, endFrame] as run tables; no sin() per lookup.
+ typedef struct fpsr_qs_table {
+     fpsr_qs_plan plan;
+     int startFrame, endFrame;
+     fpsr_qs_runs runs[2][2];     // [stream][first / second half of its quantisation cycle].
+ } fpsr_qs_table;
+
+ // Returns 0 or -1. Frames outside the range still evaluate correctly, through fpsr_qs_eval().
+ int fpsr_qs_table_build(fpsr_qs_table* table, const fpsr_qs_plan* plan, int startFrame, int endFrame);
+ void fpsr_qs_table_free(fpsr_qs_table* table);
+ float fpsr_qs_table_eval(const fpsr_qs_table* table, int frame);
+
+ /******************************************************************************/
+ /* SIMD kernels (fpsr_simd.c)                                                 */
+ /******************************************************************************/
+
+ typedef enum fpsr_rand_mode {
+     FPSR_RAND_EXACT = 0,  // Bit-identical to portable_rand().
+     FPSR_RAND_APPROX = 1  // Faster; within 2^-7 of portable_rand() (circular distance).
+ } fpsr_rand_mode;
+
+ typedef enum fpsr_simd_isa {
+     FPSR_ISA_SCALAR = 0,
+     FPSR_ISA_NEON = 1,
+     FPSR_ISA_AVX2 = 2,
+     FPSR_ISA_AVX512 = 3
+ } fpsr_simd_isa;
+
+ int fpsr_simd_isa_supported(fpsr_simd_isa isa);
+ fpsr_simd_isa fpsr_simd_active_isa(void);
+ fpsr_simd_isa fpsr_simd_set_isa(fpsr_simd_isa isa);
+
+ // out[i] = portable_rand(seeds[i]), 8 or 16 seeds per iteration.
+ void portable_rand_batch(const int* seeds, float* out, size_t n, fpsr_rand_mode mode);
+
+ // Per-instance SM parameters as structure-of-arrays; each pointer addresses `count` values.
+ typedef struct fpsr_sm_soa {
+     const int* minHold;
+     const int* maxHold;
+     const int* reseedInterval;
+     const int* seedInner;
+     const int* seedOuter;
+ } fpsr_sm_soa;
+
+ // Per-instance QS parameters as structure-of-arrays; each pointer addresses `count` values.
+ typedef struct fpsr_qs_soa {
+     const float* baseWaveFreq;
+     const float* stream2FreqMult;
+     const int* quantLevelMin;
+     const int* quantLevelMax;
+     const int* stream1Offset;
+     const int* stream2Offset;
+     const int* streamSwitchDur;
+     const int* stream1QuantDur;
+     const int* stream2QuantDur;
+ } fpsr_qs_soa;
+
+ // out[i] = fpsr_sm(frame, params[i]...) for i < count.
+ void fpsr_sm_eval_soa(const fpsr_sm_soa* params, size_t count, int frame, float* out, fpsr_rand_mode mode);
+
+ // Writes the defaulted durations and multipliers so fpsr_qs_eval_soa() skips its default branches.
+ void fpsr_qs_soa_resolve(
+     const fpsr_qs_soa* params, size_t count,
+     int* streamSwitchDur, int* stream1QuantDur, int* stream2QuantDur, float* stream2FreqMult);
+
+ // out[i] = fpsr_qs(frame, params[i]...) for i < count.
+ void fpsr_qs_eval_soa(const fpsr_qs_soa* params, size_t count, int frame, float* out, fpsr_rand_mode mode);
+
+ /******************************************************************************/
+ /* Multithreaded bake (fpsr_bake.c)                                           */
+ /******************************************************************************/
+
+ // One row of an SM bake: the fpsr_sm() parameters of a single instance.
+ typedef struct fpsr_sm_params {
+     int minHold;
+     int maxHold;
+     int reseedInterval;
+     int seedInner;
+     int seedOuter;
+ } fpsr_sm_params;
+
+ typedef struct fpsr_thread_pool fpsr_thread_pool;
+
+ // threads < 1 uses every online CPU. The calling thread counts as one of them.
+ fpsr_thread_pool* fpsr_thread_pool_create(int threads);
+ void fpsr_thread_pool_destroy(fpsr_thread_pool* pool);
+ int fpsr_thread_pool_size(const fpsr_thread_pool* pool);
+
+ // out[i * outStride + f] = fpsr_sm(startFrame + f, params[i]...). pool may be NULL. Returns 0 or -1.
+ int fpsr_bake_sm(
+     fpsr_thread_pool* pool, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+
+ // out[i * outStride + f] = fpsr_qs_eval(&plans[i], startFrame + f). pool may be NULL. Returns 0 or -1.
+ int fpsr_bake_qs(
+     fpsr_thread_pool* pool, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+
+ // How a bake fills its rows. Every path produces the same bits.
+ typedef enum fpsr_bake_path {
+     FPSR_PATH_SCALAR = 0,   // fpsr_sm() / fpsr_qs_eval() per value.
+     FPSR_PATH_RANGE = 1,    // SM: fpsr_sm_range(), one hash per hold. fpsr_bake_sm()'s path.
+     FPSR_PATH_SEGMENTS = 2, // SM: segment iteration. QS: one evaluation per run, to fpsr_qs_plan_next_change().
+     FPSR_PATH_TABLE = 3,    // QS: an fpsr_qs_table per row. Slower than FPSR_PATH_SEGMENTS in bakes.
+     FPSR_PATH_SIMD = 4,     // fpsr_sm_eval_soa() / fpsr_qs_eval_soa() across rows, frame by frame.
+     FPSR_PATH_COUNT
+ } fpsr_bake_path;
+
+ // Bake along a given path. Return 0, or -1 on invalid arguments, a range past INT_MAX or a path that does not apply.
+ int fpsr_bake_sm_path(
+     fpsr_thread_pool* pool, fpsr_bake_path path, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+ int fpsr_bake_qs_path(
+     fpsr_thread_pool* pool, fpsr_bake_path path, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+
+ /******************************************************************************/
+ /* Bake planner (fpsr_planner.c)                                              */
+ /******************************************************************************/
+
+ // Cost of one bake path, in ns per baked value: perValue + perChange * (value changes per frame).
+ typedef struct fpsr_path_cost {
+     double perValue;  // < 0 if the path is unavailable.
+     double perChange;
+ } fpsr_path_cost;
+
+ typedef struct fpsr_cost_model {
+     fpsr_path_cost sm[FPSR_PATH_COUNT];
+     fpsr_path_cost qs[FPSR_PATH_COUNT];
+ } fpsr_cost_model;
+
+ typedef struct fpsr_bake_plan {
+     fpsr_bake_path path;           // The cheapest path.
+     double changesPerValue;        // Sampled estimate of value changes per frame.
+     double cost[FPSR_PATH_COUNT];  // Estimated ns of the whole bake per path; < 0 where unavailable.
+ } fpsr_bake_plan;
+
+ // Built-in coefficients for the active SIMD ISA.
+ void fpsr_cost_model_default(fpsr_cost_model* model);
+ // Refits the coefficients by timing each path here. Returns 0, or -1 if memory ran out.
+ int fpsr_cost_model_calibrate(fpsr_cost_model* model);
+
+ // Plan a bake of the given arguments; `model` may be NULL for the default. Return 0, or -1 on invalid
+ // arguments or a range past INT_MAX.
+ int fpsr_plan_bake_sm(
+     const fpsr_cost_model* model, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, fpsr_bake_plan* plan);
+ int fpsr_plan_bake_qs(
+     const fpsr_cost_model* model, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, fpsr_bake_plan* plan);
+
+ // fpsr_bake_sm() / fpsr_bake_qs() along the planned path. Same values, same return codes.
+ int fpsr_bake_sm_auto(
+     fpsr_thread_pool* pool, const fpsr_cost_model* model, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+ int fpsr_bake_qs_auto(
+     fpsr_thread_pool* pool, const fpsr_cost_model* model, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride);
+
+ /******************************************************************************/
+ /* Multi-channel evaluation                                                   */
+ /******************************************************************************/
+
+ // SM channels sharing reseedInterval, minHold, maxHold and seedInner, i.e. one hold duration per frame.
+ typedef struct fpsr_sm_channel_group {
+     int minHold, maxHold, reseedInterval, seedInner;
+     size_t first, count; // Range of the group's channels in seedOuter / outIndex.
+ } fpsr_sm_channel_group;
+
+ // Many SM channels evaluated at the same frames. Treat as opaque.
+ typedef struct fpsr_sm_channels {
+     fpsr_sm_channel_group* groups;
+     size_t groupCount;
+     int* seedOuter;      // Per channel, sorted by group.
+     size_t* outIndex;    // Output slot of each sorted channel.
+     size_t count;
+     int ownsMemory;      // Set by fpsr_sm_channels_init(), not by fpsr_sm_channels_init_in().
+ } fpsr_sm_channels;
+
+ // Returns 0, or -1 on invalid arguments or out of memory.
+ int fpsr_sm_channels_init(fpsr_sm_channels* channels, const fpsr_sm_params* params, size_t count);
+ // The same in a caller-owned block of fpsr_sm_channels_memory(count) bytes; allocates nothing.
+ size_t fpsr_sm_channels_memory(size_t count);
+ int fpsr_sm_channels_init_in(fpsr_sm_channels* channels, const fpsr_sm_params* params, size_t count, void* memory, size_t size);
+ void fpsr_sm_channels_free(fpsr_sm_channels* channels);
+ // out[i] = fpsr_sm(frame, params[i]...), computing the shared hold durations once per group.
+ void fpsr_sm_channels_eval(const fpsr_sm_channels* channels, int frame, float* out);
+
+ // Many QS channels evaluated at the same frames. Treat as opaque.
+ typedef struct fpsr_qs_channels {
+     fpsr_qs_plan* plans; // Sorted by streamSwitchDur.
+     size_t* outIndex;    // Output slot of each sorted plan.
+     size_t count;
+     int ownsMemory;      // Set by fpsr_qs_channels_init(), not by fpsr_qs_channels_init_in().
+ } fpsr_qs_channels;
+
+ // Returns 0, or -1 on invalid arguments or out of memory.
+ int fpsr_qs_channels_init(fpsr_qs_channels* channels, const fpsr_qs_plan* plans, size_t count);
+ // The same in a caller-owned block of fpsr_qs_channels_memory(count) bytes; allocates nothing.
+ size_t fpsr_qs_channels_memory(size_t count);
+ int fpsr_qs_channels_init_in(fpsr_qs_channels* channels, const fpsr_qs_plan* plans, size_t count, void* memory, size_t size);
+ void fpsr_qs_channels_free(fpsr_qs_channels* channels);
+ // out[i] = fpsr_qs_eval(&plans[i], frame), deciding the stream once per distinct switch duration.
+ void fpsr_qs_channels_eval(const fpsr_qs_channels* channels, int frame, float* out);
+
+ /******************************************************************************/
+ /* Instrumentation                                                            */
+ /******************************************************************************/
+
+ // Counters are compiled in only when fpsr_algorithms.c is built with
+ // -DFPSR_STATS=1 (counts) or -DFPSR_STATS=2 (counts and timing histograms).
+ // They cover the scalar entry points in fpsr_algorithms.c; SIMD and
+ // fixed-point kernels are not instrumented.
+ typedef enum fpsr_stat_call {
+     FPSR_STAT_SM,         // fpsr_sm()
+     FPSR_STAT_SM_BACKEND, // fpsr_sm_backend()
+     FPSR_STAT_QS,         // fpsr_qs()
+     FPSR_STAT_QS_EVAL,    // fpsr_qs_eval()
+     FPSR_STAT_CALLS
+ } fpsr_stat_call;
+
+ typedef enum fpsr_stat_event {
+     FPSR_STAT_RAND_SIN,              // portable_rand() calls, from any entry point.
+     FPSR_STAT_RAND_HASH,             // portable_rand_hash() calls, from any entry point.
+     FPSR_STAT_SM_RESEED_CLAMP,       // reseedInterval < 1 raised to 1.
+     FPSR_STAT_SM_HOLD_CLAMP,         // A computed hold duration < 1 raised to 1.
+     FPSR_STAT_QS_DEFAULT_SWITCH_DUR, // streamSwitchDur < 1 derived from baseWaveFreq.
+     FPSR_STAT_QS_DEFAULT_QUANT_DUR,  // stream1QuantDur or stream2QuantDur < 1 derived from baseWaveFreq.
+     FPSR_STAT_QS_DURATION_CLAMP,     // A derived duration < 1 raised to 1.
+     FPSR_STAT_QS_LEVEL_CLAMP,        // A quantisation level < 1 raised to 1.
+     FPSR_STAT_QS_DEFAULT_FREQ_MULT,  // stream2FreqMult < 0 replaced by 3.7.
+     FPSR_STAT_EVENTS
+ } fpsr_stat_event;
+
+ #define FPSR_STATS_BUCKETS 32
+
+ typedef struct fpsr_stats {
+     int level;               // The FPSR_STATS level the library was built with; 0 means everything below is 0.
+     int ticksAreNanoseconds; // 0: ticks are TSC cycles (x86), 1: clock_gettime() nanoseconds.
+     unsigned long long calls[FPSR_STAT_CALLS];
+     unsigned long long events[FPSR_STAT_EVENTS];
+     // ticks[c][b]: calls of c that took [2^b, 2^(b+1)) ticks (bucket 0 also holds 0 and 1). Level 2 only.
+     unsigned long long ticks[FPSR_STAT_CALLS][FPSR_STATS_BUCKETS];
+ } fpsr_stats;
+
+ void fpsr_stats_snapshot(fpsr_stats* stats);
+ void fpsr_stats_reset(void);
+
+ /******************************************************************************/
+ /* Curve files (fpsr_curve.c)                                                 */
+ /******************************************************************************/
+
+ typedef enum fpsr_curve_kind {
+     FPSR_CURVE_SM = 0,
+     FPSR_CURVE_QS = 1
+ } fpsr_curve_kind;
+
+ // Streams baked channels to a file; the directory and header are written on close.
+ typedef struct fpsr_curve_writer fpsr_curve_writer;
+
+ fpsr_curve_writer* fpsr_curve_writer_open(const char* path);
+ // Bake frames [startFrame, endFrame] of one channel. Return the channel index, or -1.
+ int fpsr_curve_writer_add_sm(fpsr_curve_writer* writer, const fpsr_sm_params* params, int startFrame, int endFrame);
+ int fpsr_curve_writer_add_qs(fpsr_curve_writer* writer, const fpsr_qs_plan* plan, int startFrame, int endFrame);
+ // Finishes the file and frees the writer. Returns 0, or -1 if any step failed.
+ int fpsr_curve_writer_close(fpsr_curve_writer* writer);
+
+ // A memory-mapped curve file.
+ typedef struct fpsr_curve_file fpsr_curve_file;
+
+ // Also verify every channel's segment checksum at open (reads the whole file).
+ #define FPSR_CURVE_VERIFY_SEGMENTS 1
+
+ typedef struct fpsr_curve_channel {
+     fpsr_curve_kind kind;
+     int startFrame, endFrame;    // Baked range, inclusive.
+     size_t segmentCount;
+     fpsr_sm_params sm;           // Valid for FPSR_CURVE_SM.
+     fpsr_qs_plan qs;             // Valid for FPSR_CURVE_QS.
+ } fpsr_curve_channel;
+
+ // Returns NULL if the file is missing, truncated, corrupt or of another version.
+ fpsr_curve_file* fpsr_curve_open(const char* path, int flags);
+ void fpsr_curve_close(fpsr_curve_file* file);
+ size_t fpsr_curve_channel_count(const fpsr_curve_file* file);
+ int fpsr_curve_channel_info(const fpsr_curve_file* file, size_t channel, fpsr_curve_channel* info);
+ // Returns 0 if the channel's segments match their checksum, else -1.
+ int fpsr_curve_verify_channel(const fpsr_curve_file* file, size_t channel);
+ // Zero-copy lookup; frames outside the baked range are evaluated from the stored parameters.
+ float fpsr_curve_value_at(const fpsr_curve_file* file, size_t channel, int frame);
+
+ /******************************************************************************/
+ /* Evaluation contexts (fpsr_context.c)                                       */
+ /******************************************************************************/
+
+ // A bump allocator over a caller-owned block; it never calls malloc().
+ typedef struct fpsr_arena {
+     unsigned char* base;
+     size_t size;
+     size_t used;
+     size_t peak;         // Highest `used` so far, for sizing the block.
+ } fpsr_arena;
+
+ void fpsr_arena_init(fpsr_arena* arena, void* memory, size_t size);
+ // `align` is a power of two. Returns NULL, leaving the arena unchanged, if the block is full.
+ void* fpsr_arena_alloc(fpsr_arena* arena, size_t size, size_t align);
+ size_t fpsr_arena_mark(const fpsr_arena* arena);
+ // Frees everything allocated since `mark` was taken.
+ void fpsr_arena_release(fpsr_arena* arena, size_t mark);
+
+ // SM and QS channels whose parameters, plans and per-frame outputs all live in one arena. Treat as opaque.
+ typedef struct fpsr_context {
+     fpsr_arena* arena;
+     fpsr_sm_params* smParams; // In the order given to fpsr_context_init().
+     fpsr_qs_plan* qsPlans;
+     size_t smCount, qsCount;
+     fpsr_sm_channels sm;
+     fpsr_qs_channels qs;
+     size_t frameMark;         // Where the per-frame outputs start.
+ } fpsr_context;
+
+ // Arena bytes fpsr_context_init() takes, per-frame outputs not included.
+ size_t fpsr_context_memory(size_t smCount, size_t qsCount);
+ // Returns 0, or -1 on invalid arguments or if the arena is too small. Needs no free.
+ int fpsr_context_init(
+     fpsr_context* ctx, fpsr_arena* arena,
+     const fpsr_sm_params* sm, size_t smCount, const fpsr_qs_plan* qs, size_t qsCount);
+ // Drops every output returned since the last call.
+ void fpsr_context_begin_frame(fpsr_context* ctx);
+ // The outputs below are arena allocations valid until fpsr_context_begin_frame(), or NULL if the arena is full.
+ // One value per channel, in the order given.
+ const float* fpsr_context_eval_sm(fpsr_context* ctx, int frame);
+ const float* fpsr_context_eval_qs(fpsr_context* ctx, int frame);
+ // One row of `frames` values per channel, *outStride floats apart. pool may be NULL. NULL, with nothing
+ // allocated, if the range runs past INT_MAX.
+ const float* fpsr_context_bake_sm(
+     fpsr_context* ctx, fpsr_thread_pool* pool, int startFrame, size_t frames, size_t* outStride);
+ const float* fpsr_context_bake_qs(
+     fpsr_context* ctx, fpsr_thread_pool* pool, int startFrame, size_t frames, size_t* outStride);
+ // The constant segments of SM channel `channel` over [startFrame, endFrame]; *count receives their number.
+ const fpsr_sm_segment* fpsr_context_sm_segments(
+     fpsr_context* ctx, size_t channel, int startFrame, int endFrame, size_t* count);
+
+ /******************************************************************************/
+ /* Result boards (fpsr_board.c)                                               */
+ /******************************************************************************/
+
+ #define FPSR_BOARD_SLOTS 4   // Ticks a board keeps.
+
+ // Per-tick SM/QS values published by one producer thread for any number of readers.
+ // Channel ids: the SM channels in the order given, then the QS channels.
+ typedef struct fpsr_board fpsr_board;
+
+ // Returns NULL on invalid arguments or if memory ran out. The parameters and plans are copied.
+ fpsr_board* fpsr_board_create(const fpsr_sm_params* sm, size_t smCount, const fpsr_qs_plan* qs, size_t qsCount);
+ void fpsr_board_destroy(fpsr_board* board);
+ size_t fpsr_board_channel_count(const fpsr_board* board);
+ // Producer only: evaluates every channel at `frame` and publishes the tick. Does nothing if `board` is NULL.
+ void fpsr_board_publish(fpsr_board* board, int frame);
+ // Any thread, wait-free, never mixes ticks. Returns 0 if read from the board, 1 if the frame
+ // was not on it and the values were evaluated directly (they are identical), -1 on invalid arguments.
+ int fpsr_board_read(const fpsr_board* board, int frame, size_t first, size_t count, float* out);
+ float fpsr_board_value(const fpsr_board* board, size_t channel, int frame);
+ // Returns 1 and the frame of the latest tick, or 0 if nothing has been published or an argument is NULL.
+ int fpsr_board_latest(const fpsr_board* board, int* frame);
+
+ /******************************************************************************/
+ /* 64-bit frames (fpsr_frame64.c)                                             */
+ /******************************************************************************/
+
+ #define FPSR_SEED_EXACT (1 << 24)       // |seed| up to which (float)seed, and so portable_rand(), is exact.
+ #define FPSR_FRAME64_LIMIT (1LL << 62)  // 64-bit frames are clamped to ±this.
+
+ // Range reduction happens in integer space: seeds beyond ±FPSR_SEED_EXACT are folded into
+ // [0, 2^22) with a 64-bit mix, and QS stream positions beyond it are taken mod FPSR_SEED_EXACT. Bit-identical to the int
+ // API wherever its seeds and stream positions stay within ±FPSR_SEED_EXACT.
+ float portable_rand64(long long seed);
+ float portable_rand_hash64(long long seed);
+ float fpsr_sm64(
+     long long frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+ float fpsr_sm64_backend(
+     fpsr_rand_backend backend, long long frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+ // out[i] = fpsr_sm64(startFrame + i, ...), hashing once per hold.
+ void fpsr_sm64_range(
+     long long startFrame, size_t n, float* out,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+ float fpsr_qs64_eval(const fpsr_qs_plan* plan, long long frame);
+ // out[i] = fpsr_qs64_eval(plan, startFrame + i).
+ void fpsr_qs64_range(const fpsr_qs_plan* plan, long long startFrame, size_t n, float* out);
+
+ /******************************************************************************/
+ /* VEX dialect (fpsr_vex.c)                                                   */
+ /******************************************************************************/
+
+ // The Houdini wrangles' FPS-R as transcribed under sinf(): 32-bit floats and the snippets' own QS arithmetic.
+ // Not the C reference's values, and not yet compared with values from Houdini.
+ float fpsr_vex_rand(int seed);
+ float fpsr_vex_sm(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int offsetInner, int offsetOuter);
+ float fpsr_vex_qs(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+
+ // Per-point batches. changed (may be NULL) receives the snippets' @changed: 1 where the value differs at prevFrame.
+ void fpsr_vex_sm_soa(const fpsr_sm_soa* params, size_t count, int frame, int prevFrame, float* out, int* changed);
+ void fpsr_vex_qs_soa(const fpsr_qs_soa* params, size_t count, int frame, int prevFrame, float* out, int* changed);
+
+ /******************************************************************************/
+ /* Time-inverse queries (fpsr_query.c)                                        */
+ /******************************************************************************/
+
+ // Frames [startFrame, endFrame], inclusive.
+ typedef struct fpsr_frame_interval {
+     int startFrame;
+     int endFrame;
+ } fpsr_frame_interval;
+
+ // The test a query applies: value `op` threshold.
+ typedef enum fpsr_query_op {
+     FPSR_QUERY_LESS,
+     FPSR_QUERY_LESS_EQUAL,
+     FPSR_QUERY_EQUAL,
+     FPSR_QUERY_NOT_EQUAL,
+     FPSR_QUERY_GREATER_EQUAL,
+     FPSR_QUERY_GREATER
+ } fpsr_query_op;
+
+ // The queries write the first `capacity` matching intervals to out (which may be NULL)
+ // and return how many there are in total. Adjacent matching frames form one interval.
+ // Frames of [startFrame, endFrame] whose value passes the test; O(held runs), not O(frames).
+ size_t fpsr_sm_query_value(
+     const fpsr_sm_params* params, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity);
+ size_t fpsr_qs_query_value(
+     const fpsr_qs_plan* plan, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity);
+
+ // SM's held_integer_state at `frame`; run (may be NULL) receives the frames holding it around `frame`.
+ int fpsr_sm_held_state(const fpsr_sm_params* params, int frame, fpsr_frame_interval* run);
+ // Frames of [startFrame, endFrame] holding `state`; O(maxHold) whatever the range.
+ size_t fpsr_sm_query_state(
+     const fpsr_sm_params* params, int state, int startFrame, int endFrame,
+     fpsr_frame_interval* out, size_t capacity);
+
+ // Runs per minimum / maximum entry of an fpsr_value_index.
+ #define FPSR_VALUE_INDEX_BLOCK 64
+
+ // One channel's runs over [startFrame, endFrame], for repeated value queries over long ranges.
+ typedef struct fpsr_value_index {
+     fpsr_curve_kind kind;
+     fpsr_sm_params sm;           // Valid for FPSR_CURVE_SM.
+     fpsr_qs_plan qs;             // Valid for FPSR_CURVE_QS.
+     int startFrame, endFrame;
+     int* runStart;               // Frames runStart[i] .. runStart[i + 1] - 1 hold value[i].
+     float* value;
+     size_t count;
+     float* blockMin;             // Over runs [b * FPSR_VALUE_INDEX_BLOCK, (b + 1) * FPSR_VALUE_INDEX_BLOCK).
+     float* blockMax;
+     size_t blockCount;
+ } fpsr_value_index;
+
+ // Return 0, or -1 if the range is empty or out of memory.
+ int fpsr_sm_index_build(fpsr_value_index* index, const fpsr_sm_params* params, int startFrame, int endFrame);
+ int fpsr_qs_index_build(fpsr_value_index* index, const fpsr_qs_plan* plan, int startFrame, int endFrame);
+ void fpsr_value_index_free(fpsr_value_index* index);
+ // As the query functions above; frames outside the indexed range are answered from the parameters.
+ size_t fpsr_value_index_query(
+     const fpsr_value_index* index, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity);
+
+ /******************************************************************************/
+ /* Expression graphs (fpsr_graph.c)                                           */
+ /******************************************************************************/
+
+ typedef enum fpsr_combine_op {
+     FPSR_COMBINE_ADD,
+     FPSR_COMBINE_SUB,            // First input minus second.
+     FPSR_COMBINE_MUL,
+     FPSR_COMBINE_MIN,
+     FPSR_COMBINE_MAX
+ } fpsr_combine_op;
+
+ // Nodes of layered / driven SM and QS signals. Adding an existing node returns its id.
+ typedef struct fpsr_graph fpsr_graph;
+
+ fpsr_graph* fpsr_graph_create(void);
+ void fpsr_graph_destroy(fpsr_graph* graph);
+ size_t fpsr_graph_node_count(const fpsr_graph* graph);
+ // Each returns a node id, or -1 if an input is -1 / unknown or memory ran out.
+ int fpsr_graph_frame(fpsr_graph* graph, int offset);
+ int fpsr_graph_constant(fpsr_graph* graph, double value);
+ // fpsr_sm() / fpsr_qs_eval() at floor(value of frameNode), clamped to the int range.
+ int fpsr_graph_sm(fpsr_graph* graph, int frameNode, const fpsr_sm_params* params);
+ int fpsr_graph_qs(fpsr_graph* graph, int frameNode, const fpsr_qs_plan* plan);
+ int fpsr_graph_remap(fpsr_graph* graph, int input, double fromMin, double fromMax, double toMin, double toMax);
+ // 1 where input >= threshold, else 0.
+ int fpsr_graph_threshold(fpsr_graph* graph, int input, double threshold);
+ int fpsr_graph_combine(fpsr_graph* graph, fpsr_combine_op op, int a, int b);
+
+ // A graph compiled for a set of outputs into one blocked pass. Not thread-safe.
+ typedef struct fpsr_program fpsr_program;
+
+ fpsr_program* fpsr_program_compile(const fpsr_graph* graph, const int* outputs, size_t outputCount);
+ void fpsr_program_destroy(fpsr_program* program);
+ // out[o * outStride + f] = output o at startFrame + f. Returns 0 or -1.
+ int fpsr_program_eval(fpsr_program* program, int startFrame, size_t frames, float* out, size_t outStride);
+
+ /******************************************************************************/
+ /* Fixed point (fpsr_fixed.c)                                                 */
+ /******************************************************************************/
+
+ // Q16.16: value = q / 65536. The outputs below are in [0, FPSR_Q16_ONE).
+ typedef int32_t fpsr_q16;
+ #define FPSR_Q16_ONE 65536
+
+ // floor(portable_rand_hash(seed) * 65536), without floating point.
+ fpsr_q16 portable_rand_hash_q16(int seed);
+
+ // sin(2π · phase / 2^32) in Q16.16, within 1 LSB.
+ fpsr_q16 fpsr_q16_sin(uint32_t phase);
+
+ // floor(fpsr_sm_backend(FPSR_BACKEND_HASH, ...) * 65536), bit-exact, without floating point.
+ // Off on a few frames when fpsr_fixed.c is built with FPSR_FIXED_APPROX (smaller).
+ fpsr_q16 fpsr_sm_q16(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter);
+
+ // A QS plan with frequencies as phase steps: 2^32 per full turn, i.e. radians per frame · 2^32 / 2π.
+ typedef struct fpsr_qs_q16_plan {
+     uint32_t phaseStep[2];       // Per stream.
+     int streamsOffset[2];
+     int streamSwitchDur;         // >= 1.
+     int streamSwitchHalf;
+     int quantDur[2];             // Per stream, >= 1.
+     int quantHalf[2];
+     int quantLevels[2][2];       // [stream][half of its cycle], >= 1.
+ } fpsr_qs_q16_plan;
+
+ // Integer-only plan setup; durations < 1 become 1 (no frequency-derived defaults).
+ void fpsr_qs_q16_plan_init(
+     fpsr_qs_q16_plan* plan, uint32_t phaseStep, uint32_t stream2PhaseStep,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur);
+ // Host-side conversion of a float plan, defaults included (not built with FPSR_NO_FLOAT).
+ void fpsr_qs_q16_plan_from(fpsr_qs_q16_plan* plan, const fpsr_qs_plan* source);
+
+ // fpsr_qs_eval() with FPSR_BACKEND_HASH, with a fixed-point sine; see fpsr_fixed.c for the mapping.
+ fpsr_q16 fpsr_qs_q16_eval(const fpsr_qs_q16_plan* plan, int frame);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+ #endif // FPSR_ALGORITHMS_H
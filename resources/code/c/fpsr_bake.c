@@ -0,0 +1,450 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_bake.c
+ * @brief Multithreaded baking of FPS-R curves over instance × frame grids.
+ * @details fpsr_sm() and fpsr_qs() are pure functions of (frame, params), so a
+ * grid of instances × frames can be split into independent tiles and filled
+ * in parallel with no synchronisation beyond handing out the tiles.
+ *
+ * Each worker owns a contiguous range of tiles and claims them one at a time
+ * through an atomic counter. Once its own range is exhausted it steals
+ * remaining tiles from the other workers' ranges through the same counters,
+ * so uneven tiles (e.g. QS instances with very different costs) still keep every
+ * core busy. The calling thread takes part as worker 0.
+ *
+ * Tiles are FPSR_BAKE_TILE_FRAMES frames wide, a multiple of 16 floats, so when
+ * the output buffer is 64-byte aligned and its row stride is a multiple of 16,
+ * no two workers ever write to the same cache line.
+ *
+ * Uses POSIX threads and C11 atomics.
+ */
+
+ #include <limits.h> // For INT_MAX
+ #include <pthread.h>
+ #include <stdatomic.h>
+ #include <stdio.h> // For NULL
+ #include <stdlib.h> // For aligned_alloc() and free()
+ #include <unistd.h> // For sysconf()
+ #include "fpsr_algorithms.h"
+
+ // A tile covers FPSR_BAKE_TILE_INSTANCES rows × FPSR_BAKE_TILE_FRAMES columns of the output.
+ #define FPSR_BAKE_TILE_INSTANCES 32
+ #define FPSR_BAKE_TILE_FRAMES 256
+ #define FPSR_CACHE_LINE 64
+
+ // One worker's range of tiles, padded so that counters of different workers never share a line.
+ typedef struct fpsr_bake_queue {
+     _Alignas(FPSR_CACHE_LINE) atomic_size_t next;
+     size_t end;
+ } fpsr_bake_queue;
+
+ typedef enum fpsr_bake_kind { FPSR_BAKE_SM, FPSR_BAKE_QS } fpsr_bake_kind;
+
+ typedef struct fpsr_bake_job {
+     fpsr_bake_kind kind;
+     fpsr_bake_path path;
+     const void* params; // fpsr_sm_params* or fpsr_qs_plan*
+     size_t instances;
+     int startFrame;
+     size_t frames;
+     float* out;
+     size_t outStride;
+     size_t tileFrames; // FPSR_BAKE_TILE_FRAMES, or every frame for FPSR_PATH_TABLE.
+     size_t tilesPerRow;
+ } fpsr_bake_job;
+
+ struct fpsr_thread_pool {
+     int workerCount; // Including the calling thread.
+     pthread_t* threads;
+     fpsr_bake_queue* queues;
+     pthread_mutex_t mutex;
+     pthread_cond_t wake;
+     pthread_cond_t done;
+     unsigned long generation; // Bumped for every job.
+     int pending; // Background workers still running the current job.
+     int shutdown;
+     const fpsr_bake_job* job;
+ };
+
+
+ /******************************************************************************/
+ /* Tiles                                                                      */
+ /******************************************************************************/
+
+ // One SM row of a tile along `path`; every path writes the same values.
+ static void fpsr_bake_sm_row(fpsr_bake_path path, const fpsr_sm_params* p, int frame0, size_t cols, float* dst)
+ {
+     if (path == FPSR_PATH_SCALAR) {
+         for (size_t c = 0; c < cols; ++c) {
+             dst[c] = fpsr_sm(frame0 + (int)c, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+         }
+     } else if (path == FPSR_PATH_SEGMENTS) {
+         fpsr_sm_segment_iter it;
+         fpsr_sm_segment seg;
+         fpsr_sm_segments_begin(&it, frame0, frame0 + (int)(cols - 1), p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+         while (fpsr_sm_segments_next(&it, &seg)) {
+             for (long long f = seg.startFrame; f <= seg.endFrame; ++f) { dst[f - frame0] = seg.value; }
+         }
+     } else {
+         // Consecutive frames let the range form share hashes across each hold.
+         fpsr_sm_range(frame0, cols, dst, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+     }
+ }
+
+ // One QS row of a tile along `path`; every path writes the same values.
+ static void fpsr_bake_qs_row(fpsr_bake_path path, const fpsr_qs_plan* plan, int frame0, size_t cols, float* dst)
+ {
+     fpsr_qs_table table;
+     if (path == FPSR_PATH_TABLE && fpsr_qs_table_build(&table, plan, frame0, frame0 + (int)(cols - 1)) == 0) {
+         for (size_t c = 0; c < cols; ++c) { dst[c] = fpsr_qs_table_eval(&table, frame0 + (int)c); }
+         fpsr_qs_table_free(&table);
+     } else if (path == FPSR_PATH_SEGMENTS) {
+         // Evaluate once per run and fill up to the next change.
+         long long end = (long long)frame0 + (long long)cols;
+         for (long long f = frame0; f < end;) {
+             float value = fpsr_qs_eval(plan, (int)f);
+             long long next = fpsr_qs_plan_next_change(plan, (int)f);
+             if (next <= f) { next = f + 1; } // At INT_MAX the search has nowhere left to look.
+             if (next > end) { next = end; }
+             for (; f < next; ++f) { dst[f - frame0] = value; }
+         }
+     } else {
+         // FPSR_PATH_SCALAR, or a table that ran out of memory.
+         for (size_t c = 0; c < cols; ++c) { dst[c] = fpsr_qs_eval(plan, frame0 + (int)c); }
+     }
+ }
+
+ // A tile along FPSR_PATH_SIMD: each frame is one SoA call across the tile's rows, scattered into them.
+ static void fpsr_bake_simd_tile(const fpsr_bake_job* job, size_t row0, size_t rows, size_t col0, size_t cols)
+ {
+     int i0[FPSR_BAKE_TILE_INSTANCES], i1[FPSR_BAKE_TILE_INSTANCES], i2[FPSR_BAKE_TILE_INSTANCES];
+     int i3[FPSR_BAKE_TILE_INSTANCES], i4[FPSR_BAKE_TILE_INSTANCES];
+     float f0[FPSR_BAKE_TILE_INSTANCES], f1[FPSR_BAKE_TILE_INSTANCES], column[FPSR_BAKE_TILE_INSTANCES];
+     int frame0 = job->startFrame + (int)col0;
+
+     if (job->kind == FPSR_BAKE_SM) {
+         const fpsr_sm_params* p = (const fpsr_sm_params*)job->params + row0;
+         for (size_t r = 0; r < rows; ++r) {
+             i0[r] = p[r].minHold; i1[r] = p[r].maxHold; i2[r] = p[r].reseedInterval;
+             i3[r] = p[r].seedInner; i4[r] = p[r].seedOuter;
+         }
+         fpsr_sm_soa soa = { i0, i1, i2, i3, i4 };
+         for (size_t c = 0; c < cols; ++c) {
+             fpsr_sm_eval_soa(&soa, rows, frame0 + (int)c, column, FPSR_RAND_EXACT);
+             for (size_t r = 0; r < rows; ++r) { job->out[(row0 + r) * job->outStride + col0 + c] = column[r]; }
+         }
+         return;
+     }
+
+     // A plan's resolved fields are valid fpsr_qs_soa inputs: the durations are >= 1, so no
+     // default is rederived, and the clamped stream 1 levels give the same stream 2 levels.
+     // fpsr_qs_eval_soa() only hashes with portable_rand(); tiles with FPSR_BACKEND_HASH rows are evaluated per row.
+     const fpsr_qs_plan* plan = (const fpsr_qs_plan*)job->params + row0;
+     int q0[FPSR_BAKE_TILE_INSTANCES], q1[FPSR_BAKE_TILE_INSTANCES];
+     for (size_t r = 0; r < rows; ++r) {
+         if (plan[r].randBackend != FPSR_BACKEND_SIN) {
+             for (size_t k = 0; k < rows; ++k) {
+                 fpsr_bake_qs_row(FPSR_PATH_SCALAR, &plan[k], frame0, cols, job->out + (row0 + k) * job->outStride + col0);
+             }
+             return;
+         }
+     }
+     for (size_t r = 0; r < rows; ++r) {
+         f0[r] = plan[r].baseWaveFreq; f1[r] = plan[r].stream2FreqMult;
+         q0[r] = plan[r].s1QuantLevels[0]; q1[r] = plan[r].s1QuantLevels[1];
+         i0[r] = plan[r].streamsOffset[0]; i1[r] = plan[r].streamsOffset[1];
+         i2[r] = plan[r].streamSwitchDur; i3[r] = plan[r].stream1QuantDur; i4[r] = plan[r].stream2QuantDur;
+     }
+     fpsr_qs_soa soa = { f0, f1, q0, q1, i0, i1, i2, i3, i4 };
+     for (size_t c = 0; c < cols; ++c) {
+         fpsr_qs_eval_soa(&soa, rows, frame0 + (int)c, column, FPSR_RAND_EXACT);
+         for (size_t r = 0; r < rows; ++r) { job->out[(row0 + r) * job->outStride + col0 + c] = column[r]; }
+     }
+ }
+
+ // Fills one tile of the output grid.
+ static void fpsr_bake_tile(const fpsr_bake_job* job, size_t tile)
+ {
+     size_t row0 = (tile / job->tilesPerRow) * FPSR_BAKE_TILE_INSTANCES;
+     size_t col0 = (tile % job->tilesPerRow) * job->tileFrames;
+     size_t rows = job->instances - row0;
+     size_t cols = job->frames - col0;
+     if (rows > FPSR_BAKE_TILE_INSTANCES) { rows = FPSR_BAKE_TILE_INSTANCES; }
+     if (cols > job->tileFrames) { cols = job->tileFrames; }
+     int frame0 = job->startFrame + (int)col0;
+
+     if (job->path == FPSR_PATH_SIMD) {
+         fpsr_bake_simd_tile(job, row0, rows, col0, cols);
+         return;
+     }
+     for (size_t r = row0; r < row0 + rows; ++r) {
+         float* dst = job->out + r * job->outStride + col0;
+         if (job->kind == FPSR_BAKE_SM) {
+             fpsr_bake_sm_row(job->path, (const fpsr_sm_params*)job->params + r, frame0, cols, dst);
+         } else {
+             fpsr_bake_qs_row(job->path, (const fpsr_qs_plan*)job->params + r, frame0, cols, dst);
+         }
+     }
+ }
+
+ // Runs worker `self`: drain its own range, then steal from the others in turn.
+ static void fpsr_bake_work(fpsr_thread_pool* pool, const fpsr_bake_job* job, int self)
+ {
+     for (int k = 0; k < pool->workerCount; ++k) {
+         fpsr_bake_queue* q = &pool->queues[(self + k) % pool->workerCount];
+         for (;;) {
+             size_t tile = atomic_fetch_add_explicit(&q->next, 1, memory_order_relaxed);
+             if (tile >= q->end) { break; }
+             fpsr_bake_tile(job, tile);
+         }
+     }
+ }
+
+ static void* fpsr_bake_thread_main(void* arg)
+ {
+     fpsr_thread_pool* pool = (fpsr_thread_pool*)arg;
+
+     pthread_mutex_lock(&pool->mutex);
+     // Each background worker claims a distinct id in 1 .. workerCount-1; 0 is the calling thread.
+     int self = pool->pending--;
+     unsigned long seen = pool->generation;
+     if (pool->pending == 0) { pthread_cond_signal(&pool->done); }
+
+     for (;;) {
+         while (!pool->shutdown && pool->generation == seen) {
+             pthread_cond_wait(&pool->wake, &pool->mutex);
+         }
+         if (pool->shutdown) { break; }
+         seen = pool->generation;
+         const fpsr_bake_job* job = pool->job;
+         pthread_mutex_unlock(&pool->mutex);
+
+         fpsr_bake_work(pool, job, self);
+
+         pthread_mutex_lock(&pool->mutex);
+         if (--pool->pending == 0) { pthread_cond_signal(&pool->done); }
+     }
+     pthread_mutex_unlock(&pool->mutex);
+     return NULL;
+ }
+
+
+ /******************************************************************************/
+ /* Thread pool                                                                */
+ /******************************************************************************/
+
+ /**
+  * @brief Creates a pool of worker threads for the bake functions.
+  * @param threads The total number of threads to bake with, including the
+  * calling thread. If < 1, the number of online CPUs is used.
+  * @return The pool, or NULL if it could not be created.
+  */
+ fpsr_thread_pool* fpsr_thread_pool_create(int threads)
+ {
+     if (threads < 1) {
+         long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+         threads = (cpus > 0) ? (int)cpus : 1;
+     }
+
+     fpsr_thread_pool* pool = (fpsr_thread_pool*)calloc(1, sizeof(*pool));
+     if (pool == NULL) { return NULL; }
+     pool->workerCount = threads;
+     pool->queues = (fpsr_bake_queue*)aligned_alloc(FPSR_CACHE_LINE, sizeof(fpsr_bake_queue) * (size_t)threads);
+     pool->threads = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+     if (pool->queues == NULL || pool->threads == NULL) {
+         free(pool->queues);
+         free(pool->threads);
+         free(pool);
+         return NULL;
+     }
+     for (int i = 0; i < threads; ++i) {
+         atomic_init(&pool->queues[i].next, 0);
+         pool->queues[i].end = 0;
+     }
+     pthread_mutex_init(&pool->mutex, NULL);
+     pthread_cond_init(&pool->wake, NULL);
+     pthread_cond_init(&pool->done, NULL);
+
+     // Start the background workers and wait until each has taken its id.
+     pthread_mutex_lock(&pool->mutex);
+     pool->pending = threads - 1;
+     int started = 1;
+     for (; started < threads; ++started) {
+         if (pthread_create(&pool->threads[started], NULL, fpsr_bake_thread_main, pool) != 0) { break; }
+     }
+     pool->pending -= threads - started; // Ids that will never be claimed.
+     while (pool->pending > 0) {
+         pthread_cond_wait(&pool->done, &pool->mutex);
+     }
+     pthread_mutex_unlock(&pool->mutex);
+
+     if (started < threads) {
+         pool->workerCount = started;
+         fpsr_thread_pool_destroy(pool);
+         return NULL;
+     }
+     return pool;
+ }
+
+ /**
+  * @brief Stops the worker threads and frees the pool.
+  * @param pool A pool from fpsr_thread_pool_create(), or NULL.
+  */
+ void fpsr_thread_pool_destroy(fpsr_thread_pool* pool)
+ {
+     if (pool == NULL) { return; }
+
+     pthread_mutex_lock(&pool->mutex);
+     pool->shutdown = 1;
+     pthread_cond_broadcast(&pool->wake);
+     pthread_mutex_unlock(&pool->mutex);
+     for (int i = 1; i < pool->workerCount; ++i) {
+         pthread_join(pool->threads[i], NULL);
+     }
+
+     pthread_cond_destroy(&pool->done);
+     pthread_cond_destroy(&pool->wake);
+     pthread_mutex_destroy(&pool->mutex);
+     free(pool->threads);
+     free(pool->queues);
+     free(pool);
+ }
+
+ /**
+  * @brief Returns the number of threads a pool bakes with, including the caller.
+  */
+ int fpsr_thread_pool_size(const fpsr_thread_pool* pool)
+ {
+     return (pool == NULL) ? 1 : pool->workerCount;
+ }
+
+ // Splits the job's tiles evenly across the workers and runs it to completion.
+ static void fpsr_bake_run(fpsr_thread_pool* pool, fpsr_bake_job* job)
+ {
+     // A run table costs a pass over the whole range it covers, so table tiles span every frame
+     // and each row builds its table once.
+     size_t tileRows = (job->instances + FPSR_BAKE_TILE_INSTANCES - 1) / FPSR_BAKE_TILE_INSTANCES;
+     job->tileFrames = (job->path == FPSR_PATH_TABLE) ? job->frames : FPSR_BAKE_TILE_FRAMES;
+     job->tilesPerRow = (job->frames + job->tileFrames - 1) / job->tileFrames;
+     size_t tiles = tileRows * job->tilesPerRow;
+
+     if (pool == NULL || pool->workerCount == 1 || tiles == 1) {
+         for (size_t t = 0; t < tiles; ++t) { fpsr_bake_tile(job, t); }
+         return;
+     }
+
+     size_t workers = (size_t)pool->workerCount;
+     for (size_t w = 0; w < workers; ++w) {
+         atomic_store_explicit(&pool->queues[w].next, tiles * w / workers, memory_order_relaxed);
+         pool->queues[w].end = tiles * (w + 1) / workers;
+     }
+
+     pthread_mutex_lock(&pool->mutex);
+     pool->job = job;
+     pool->pending = pool->workerCount - 1;
+     pool->generation++;
+     pthread_cond_broadcast(&pool->wake);
+     pthread_mutex_unlock(&pool->mutex);
+
+     fpsr_bake_work(pool, job, 0);
+
+     pthread_mutex_lock(&pool->mutex);
+     while (pool->pending > 0) {
+         pthread_cond_wait(&pool->done, &pool->mutex);
+     }
+     pool->job = NULL;
+     pthread_mutex_unlock(&pool->mutex);
+ }
+
+
+ /******************************************************************************/
+ /* Bake entry points                                                          */
+ /******************************************************************************/
+
+ /**
+  * @brief Bakes fpsr_sm for every instance over a frame range.
+  * @details Row i of the output receives fpsr_sm(startFrame + f, params[i]...)
+  * for f = 0 .. frames-1, i.e. out[i * outStride + f]. Uses FPSR_PATH_RANGE;
+  * fpsr_bake_sm_auto() picks the path from the parameters instead.
+  *
+  * @param pool The thread pool to bake with, or NULL to bake on the calling thread.
+  * One bake runs on a pool at a time.
+  * @param params An array of `instances` parameter sets.
+  * @param instances The number of rows to bake.
+  * @param startFrame The first frame of every row.
+  * @param frames The number of frames per row.
+  * @param out A caller-owned buffer of at least (instances - 1) * outStride + frames floats.
+  * @param outStride The distance between rows in floats, >= frames.
+  * @return 0 on success, -1 if the arguments are invalid or startFrame + frames - 1 is past INT_MAX.
+  */
+ int fpsr_bake_sm(
+     fpsr_thread_pool* pool, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     return fpsr_bake_sm_path(pool, FPSR_PATH_RANGE, params, instances, startFrame, frames, out, outStride);
+ }
+
+ /**
+  * @brief Bakes fpsr_qs for every instance over a frame range.
+  * @details As fpsr_bake_sm(), with one prebuilt fpsr_qs_plan per row. Uses FPSR_PATH_SCALAR.
+  *
+  * @param pool The thread pool to bake with, or NULL to bake on the calling thread.
+  * @param plans An array of `instances` plans built by fpsr_qs_plan_init().
+  * @param instances, startFrame, frames, out, outStride As for fpsr_bake_sm().
+  * @return 0 on success, -1 if the arguments are invalid or startFrame + frames - 1 is past INT_MAX.
+  */
+ int fpsr_bake_qs(
+     fpsr_thread_pool* pool, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     return fpsr_bake_qs_path(pool, FPSR_PATH_SCALAR, plans, instances, startFrame, frames, out, outStride);
+ }
+
+ /**
+  * @brief fpsr_bake_sm() along a given path.
+  * @param path FPSR_PATH_SCALAR, FPSR_PATH_RANGE, FPSR_PATH_SEGMENTS or FPSR_PATH_SIMD.
+  * @param pool, params, instances, startFrame, frames, out, outStride As for fpsr_bake_sm().
+  * @return 0 on success, -1 if the arguments are invalid, the range runs past INT_MAX
+  * or the path does not apply to SM.
+  */
+ int fpsr_bake_sm_path(
+     fpsr_thread_pool* pool, fpsr_bake_path path, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     if (params == NULL || out == NULL || outStride < frames) { return -1; }
+     if (path != FPSR_PATH_SCALAR && path != FPSR_PATH_RANGE && path != FPSR_PATH_SEGMENTS && path != FPSR_PATH_SIMD) { return -1; }
+     if (instances == 0 || frames == 0) { return 0; }
+     if (frames - 1 > (size_t)((long long)INT_MAX - startFrame)) { return -1; }
+
+     fpsr_bake_job job = { FPSR_BAKE_SM, path, params, instances, startFrame, frames, out, outStride, 0, 0 };
+     fpsr_bake_run(pool, &job);
+     return 0;
+ }
+
+ /**
+  * @brief fpsr_bake_qs() along a given path.
+  * @details FPSR_PATH_TABLE builds one fpsr_qs_table per row, over the whole range;
+  * its tiles span every frame. Building the table walks every quantisation step
+  * of both levels of both streams, so it costs about twice what FPSR_PATH_SEGMENTS
+  * pays per change and is slower than it at any change rate. It is kept for
+  * comparison and is never the planner's choice with the default cost model.
+  * FPSR_PATH_SIMD evaluates tiles holding FPSR_BACKEND_HASH plans per row.
+  * @param path FPSR_PATH_SCALAR, FPSR_PATH_SEGMENTS, FPSR_PATH_TABLE or FPSR_PATH_SIMD.
+  * @param pool, plans, instances, startFrame, frames, out, outStride As for fpsr_bake_qs().
+  * @return 0 on success, -1 if the arguments are invalid, the range runs past INT_MAX
+  * or the path does not apply to QS.
+  */
+ int fpsr_bake_qs_path(
+     fpsr_thread_pool* pool, fpsr_bake_path path, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     if (plans == NULL || out == NULL || outStride < frames) { return -1; }
+     if (path != FPSR_PATH_SCALAR && path != FPSR_PATH_SEGMENTS && path != FPSR_PATH_TABLE && path != FPSR_PATH_SIMD) { return -1; }
+     if (instances == 0 || frames == 0) { return 0; }
+     if (frames - 1 > (size_t)((long long)INT_MAX - startFrame)) { return -1; }
+
+     fpsr_bake_job job = { FPSR_BAKE_QS, path, plans, instances, startFrame, frames, out, outStride, 0, 0 };
+     fpsr_bake_run(pool, &job);
+     return 0;
+ }
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_board.c
+ * @brief A per-tick board of FPS-R results shared by one producer and any
+ * number of reader threads.
+ * @details Engines often have several threads (physics, audio, render) asking
+ * for the same channels at the same frame. Instead of each thread calling
+ * fpsr_sm() / fpsr_qs_eval() itself, one producer thread evaluates every
+ * channel once per tick with fpsr_sm_channels_eval() / fpsr_qs_channels_eval()
+ * and publishes the values. Readers then copy them out.
+ *
+ * The board keeps the last FPSR_BOARD_SLOTS ticks in a ring. Each slot is a
+ * seqlock: the producer makes its sequence odd, writes the frame and the
+ * values, and makes it even again. A reader checks the sequence
+ * before and after copying, and only keeps the copy if the sequence was even
+ * and unchanged. The producer never waits for readers, and readers never write
+ * to the board, so readers on other cores never contend with each other.
+ *
+ * Readers are wait-free. They try each slot at most twice, and if the frame
+ * is not on the board (it has not been published yet, has been overwritten,
+ * or the producer kept lapping the reader) they compute the values directly
+ * from the channels' parameters. FPS-R is stateless, so either way a reader
+ * gets exactly the value fpsr_sm() / fpsr_qs_eval() would return, and all
+ * readers of one frame agree. A multi-channel read never mixes ticks.
+ *
+ * Channel ids: the SM channels first, in the order given, then the QS channels.
+ *
+ * Uses C11 atomics.
+ */
+
+ #include <stdatomic.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include "fpsr_algorithms.h"
+
+ #define FPSR_CACHE_LINE 64
+
+ // One published tick. The header sits on its own line so that readers polling it never share a line with the values.
+ typedef struct fpsr_board_slot {
+     _Alignas(FPSR_CACHE_LINE) atomic_uint seq; // Odd while being written; 0 until first written.
+     atomic_int frame;
+     _Atomic float* values;                         // channelCount values.
+ } fpsr_board_slot;
+
+ struct fpsr_board {
+     fpsr_board_slot slots[FPSR_BOARD_SLOTS];
+     _Alignas(FPSR_CACHE_LINE) atomic_ulong published; // Ticks published so far.
+     atomic_int latestFrame;                            // Frame of the latest tick.
+     unsigned long ticks;                               // Producer's copy of `published`.
+     fpsr_sm_channels sm;
+     fpsr_qs_channels qs;
+     fpsr_sm_params* smParams;                          // In channel order, for direct evaluation.
+     fpsr_qs_plan* qsPlans;
+     size_t smCount, qsCount;
+     float* scratch;                                    // The producer's evaluation buffer.
+ };
+
+ /**
+  * @brief Creates a board for a set of SM and QS channels.
+  * @param sm An array of `smCount` SM parameter sets; it is copied.
+  * @param smCount The number of SM channels (ids 0 .. smCount - 1).
+  * @param qs An array of `qsCount` plans built by fpsr_qs_plan_init(); it is copied.
+  * @param qsCount The number of QS channels (ids smCount .. smCount + qsCount - 1).
+  * @return The board (release it with fpsr_board_destroy()), or NULL on
+  * invalid arguments or if memory ran out.
+  */
+ fpsr_board* fpsr_board_create(const fpsr_sm_params* sm, size_t smCount, const fpsr_qs_plan* qs, size_t qsCount)
+ {
+     if ((sm == NULL && smCount != 0) || (qs == NULL && qsCount != 0)) { return NULL; }
+     size_t count = smCount + qsCount;
+
+     fpsr_board* board = (fpsr_board*)aligned_alloc(FPSR_CACHE_LINE, (sizeof(fpsr_board) + FPSR_CACHE_LINE - 1) / FPSR_CACHE_LINE * FPSR_CACHE_LINE);
+     if (board == NULL) { return NULL; }
+     memset(board, 0, sizeof(*board));
+     board->smCount = smCount;
+     board->qsCount = qsCount;
+     board->smParams = (fpsr_sm_params*)malloc(sizeof(fpsr_sm_params) * (smCount ? smCount : 1));
+     board->qsPlans = (fpsr_qs_plan*)malloc(sizeof(fpsr_qs_plan) * (qsCount ? qsCount : 1));
+     board->scratch = (float*)malloc(sizeof(float) * (count ? count : 1));
+     int ok = board->smParams != NULL && board->qsPlans != NULL && board->scratch != NULL;
+     for (int s = 0; s < FPSR_BOARD_SLOTS; ++s) {
+         fpsr_board_slot* slot = &board->slots[s];
+         atomic_init(&slot->seq, 0u);
+         atomic_init(&slot->frame, 0);
+         slot->values = (_Atomic float*)malloc(sizeof(_Atomic float) * (count ? count : 1));
+         ok = ok && slot->values != NULL;
+     }
+     atomic_init(&board->published, 0ul);
+     atomic_init(&board->latestFrame, 0);
+     if (!ok || fpsr_sm_channels_init(&board->sm, sm, smCount) != 0 || fpsr_qs_channels_init(&board->qs, qs, qsCount) != 0) {
+         fpsr_board_destroy(board);
+         return NULL;
+     }
+     if (smCount != 0) { memcpy(board->smParams, sm, sizeof(fpsr_sm_params) * smCount); }
+     if (qsCount != 0) { memcpy(board->qsPlans, qs, sizeof(fpsr_qs_plan) * qsCount); }
+     return board;
+ }
+
+ /**
+  * @brief Releases a board. No reader or producer may be using it.
+  */
+ void fpsr_board_destroy(fpsr_board* board)
+ {
+     if (board == NULL) { return; }
+     for (int s = 0; s < FPSR_BOARD_SLOTS; ++s) { free((void*)board->slots[s].values); }
+     fpsr_sm_channels_free(&board->sm);
+     fpsr_qs_channels_free(&board->qs);
+     free(board->smParams);
+     free(board->qsPlans);
+     free(board->scratch);
+     free(board);
+ }
+
+ size_t fpsr_board_channel_count(const fpsr_board* board)
+ {
+     return (board != NULL) ? board->smCount + board->qsCount : 0;
+ }
+
+ /**
+  * @brief Evaluates every channel at `frame` and publishes the values (producer only).
+  * @details Only one thread may publish to a board. The slot written is the
+  * oldest of the ring, so the last FPSR_BOARD_SLOTS frames published stay
+  * readable.
+  * @param board The board.
+  * @param frame The frame of this tick.
+  */
+ void fpsr_board_publish(fpsr_board* board, int frame)
+ {
+     if (board == NULL) { return; }
+     size_t count = board->smCount + board->qsCount;
+     fpsr_sm_channels_eval(&board->sm, frame, board->scratch);
+     fpsr_qs_channels_eval(&board->qs, frame, board->scratch + board->smCount);
+
+     fpsr_board_slot* slot = &board->slots[board->ticks % FPSR_BOARD_SLOTS];
+     unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+     atomic_store_explicit(&slot->seq, seq + 1u, memory_order_relaxed);
+     atomic_thread_fence(memory_order_release); // The odd sequence is visible before any value changes.
+     atomic_store_explicit(&slot->frame, frame, memory_order_relaxed);
+     for (size_t i = 0; i < count; ++i) { atomic_store_explicit(&slot->values[i], board->scratch[i], memory_order_relaxed); }
+     atomic_store_explicit(&slot->seq, seq + 2u, memory_order_release);
+
+     board->ticks++;
+     atomic_store_explicit(&board->latestFrame, frame, memory_order_relaxed);
+     atomic_store_explicit(&board->published, board->ticks, memory_order_release);
+ }
+
+ // Copies channels [first, first + count) of `frame` from one slot; 1 if the copy is consistent.
+ static int fpsr_board_try_slot(const fpsr_board_slot* slot, int frame, size_t first, size_t count, float* out)
+ {
+     unsigned seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+     if (seq == 0u || (seq & 1u) != 0u) { return 0; }
+     if (atomic_load_explicit(&slot->frame, memory_order_relaxed) != frame) { return 0; }
+     for (size_t i = 0; i < count; ++i) { out[i] = atomic_load_explicit(&slot->values[first + i], memory_order_relaxed); }
+     atomic_thread_fence(memory_order_acquire); // The copy completes before the sequence is checked again.
+     return atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq;
+ }
+
+ /**
+  * @brief Reads channels [first, first + count) at `frame` (any thread, wait-free).
+  * @param board The board.
+  * @param frame The frame to read.
+  * @param first The first channel id.
+  * @param count The number of consecutive channels.
+  * @param out Receives `count` values.
+  * @return 0 if the values came from the board (all from one tick), 1 if the
+  * frame was not on the board and they were evaluated directly, -1 if the
+  * channel range is invalid. The values are the same either way.
+  */
+ int fpsr_board_read(const fpsr_board* board, int frame, size_t first, size_t count, float* out)
+ {
+     if (board == NULL || out == NULL) { return -1; }
+     size_t channels = board->smCount + board->qsCount;
+     if (first > channels || count > channels - first) { return -1; }
+
+     // --- 1. Newest slots first; two attempts each bound the work ---
+     unsigned long published = atomic_load_explicit(&board->published, memory_order_acquire);
+     unsigned long slots = (published < FPSR_BOARD_SLOTS) ? published : FPSR_BOARD_SLOTS;
+     for (int attempt = 0; attempt < 2; ++attempt) {
+         for (unsigned long k = 0; k < slots; ++k) {
+             const fpsr_board_slot* slot = &board->slots[(published - 1 - k) % FPSR_BOARD_SLOTS];
+             if (fpsr_board_try_slot(slot, frame, first, count, out)) { return 0; }
+         }
+     }
+
+     // --- 2. Not on the board: FPS-R is stateless, so evaluate directly ---
+     for (size_t i = 0; i < count; ++i) {
+         size_t c = first + i;
+         if (c < board->smCount) {
+             const fpsr_sm_params* p = &board->smParams[c];
+             out[i] = fpsr_sm(frame, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+         } else {
+             out[i] = fpsr_qs_eval(&board->qsPlans[c - board->smCount], frame);
+         }
+     }
+     return 1;
+ }
+
+ // One channel's value at `frame`, from the board when it is there.
+ float fpsr_board_value(const fpsr_board* board, size_t channel, int frame)
+ {
+     float value = 0.0f;
+     fpsr_board_read(board, frame, channel, 1, &value);
+     return value;
+ }
+
+ /**
+  * @brief The frame of the latest tick.
+  * @return 1 and *frame set, or 0 if nothing has been published yet or an argument is NULL.
+  */
+ int fpsr_board_latest(const fpsr_board* board, int* frame)
+ {
+     if (board == NULL || frame == NULL) { return 0; }
+     if (atomic_load_explicit(&board->published, memory_order_acquire) == 0) { return 0; }
+     *frame = atomic_load_explicit(&board->latestFrame, memory_order_relaxed);
+     return 1;
+ }
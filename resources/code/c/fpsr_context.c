@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_context.c
+ * @brief Arena-backed evaluation contexts: SM and QS channels evaluated per
+ * frame with no heap allocation.
+ * @details A host that evaluates FPS-R inside its frame loop (a game update,
+ * a render callback) cannot afford malloc() there: it takes a lock, its cost
+ * is unbounded, and it fragments long-running processes. An fpsr_context
+ * lives entirely in one caller-supplied block of memory, the fpsr_arena:
+ *
+ *   - fpsr_context_init() copies the channels' parameters and QS plans into
+ *     the arena and builds the multi-channel sets there with
+ *     fpsr_sm_channels_init_in() / fpsr_qs_channels_init_in();
+ *   - each frame's outputs (per-channel values, bakes, SM segment lists) are
+ *     bump-allocated after them and dropped together by
+ *     fpsr_context_begin_frame().
+ *
+ * The budget is fixed by the block the caller hands over. When a request does
+ * not fit, the call returns NULL and the arena is left as it was; nothing
+ * ever falls back to the heap. arena->peak records the high-water mark, so the
+ * block can be sized from a trial run.
+ *
+ * Baking through a thread pool allocates nothing either: the pool's workers
+ * are created with the pool, and fpsr_bake_sm() / fpsr_bake_qs() hand out
+ * tiles through counters inside the pool.
+ *
+ * Contexts and arenas are not thread-safe; use one per thread.
+ *
+ * Build with fpsr_algorithms.c and fpsr_bake.c.
+ */
+
+ #include <stddef.h> // For max_align_t
+ #include <stdint.h> // For uintptr_t
+ #include <string.h>
+ #include "fpsr_algorithms.h"
+
+ #define FPSR_CONTEXT_ALIGN _Alignof(max_align_t)
+ #define FPSR_CACHE_LINE 64 // Bake rows start on their own line, as fpsr_bake.c expects.
+
+ /******************************************************************************/
+ /* Arena                                                                      */
+ /******************************************************************************/
+
+ /**
+  * @brief Makes an arena over a caller-owned block.
+  * @param arena The arena to initialise.
+  * @param memory The block; it must outlive the arena and everything allocated from it.
+  * @param size The block's size in bytes.
+  */
+ void fpsr_arena_init(fpsr_arena* arena, void* memory, size_t size)
+ {
+     arena->base = (unsigned char*)memory;
+     arena->size = (memory != NULL) ? size : 0;
+     arena->used = 0;
+     arena->peak = 0;
+ }
+
+ // Offset of the first `align`-aligned byte at or after arena->used, or arena->size + 1 if there is none.
+ static size_t fpsr_arena_aligned(const fpsr_arena* arena, size_t align)
+ {
+     uintptr_t at = (uintptr_t)(arena->base + arena->used);
+     size_t pad = (size_t)((align - (at & (align - 1))) & (align - 1));
+     return (pad <= arena->size - arena->used) ? arena->used + pad : arena->size + 1;
+ }
+
+ /**
+  * @brief Bump-allocates from an arena.
+  * @param arena The arena.
+  * @param size The number of bytes.
+  * @param align The alignment, a power of two.
+  * @return The block, or NULL if it does not fit (the arena is unchanged).
+  */
+ void* fpsr_arena_alloc(fpsr_arena* arena, size_t size, size_t align)
+ {
+     if (align == 0 || (align & (align - 1)) != 0) { return NULL; }
+     size_t at = fpsr_arena_aligned(arena, align);
+     if (at > arena->size || size > arena->size - at) { return NULL; }
+     arena->used = at + size;
+     if (arena->used > arena->peak) { arena->peak = arena->used; }
+     return arena->base + at;
+ }
+
+ // A point to fpsr_arena_release() back to.
+ size_t fpsr_arena_mark(const fpsr_arena* arena)
+ {
+     return arena->used;
+ }
+
+ /**
+  * @brief Frees everything allocated since `mark` was taken.
+  * @param arena The arena.
+  * @param mark A value from fpsr_arena_mark() on this arena, not already released past.
+  */
+ void fpsr_arena_release(fpsr_arena* arena, size_t mark)
+ {
+     if (mark < arena->used) { arena->used = mark; }
+ }
+
+ /******************************************************************************/
+ /* Contexts                                                                   */
+ /******************************************************************************/
+
+ // Bytes a max_align_t-aligned allocation of `size` can take, padding included.
+ static size_t fpsr_context_block(size_t size)
+ {
+     return (size + FPSR_CONTEXT_ALIGN - 1) / FPSR_CONTEXT_ALIGN * FPSR_CONTEXT_ALIGN;
+ }
+
+ /**
+  * @brief The arena space fpsr_context_init() takes for these channel counts.
+  * @details Add the per-frame outputs on top: smCount + qsCount floats for
+  * fpsr_context_eval_sm() / fpsr_context_eval_qs(), count * frames floats per
+  * bake, and a segment per held run for fpsr_context_sm_segments().
+  * @return A size in bytes that fits wherever the arena starts.
+  */
+ size_t fpsr_context_memory(size_t smCount, size_t qsCount)
+ {
+     return FPSR_CONTEXT_ALIGN - 1 +
+         fpsr_context_block(smCount * sizeof(fpsr_sm_params)) +
+         fpsr_context_block(qsCount * sizeof(fpsr_qs_plan)) +
+         fpsr_context_block(fpsr_sm_channels_memory(smCount)) +
+         fpsr_context_block(fpsr_qs_channels_memory(qsCount));
+ }
+
+ // A persistent copy of `size` bytes in the arena; NULL only when it does not fit.
+ static void* fpsr_context_copy(fpsr_arena* arena, const void* data, size_t size)
+ {
+     void* copy = fpsr_arena_alloc(arena, size, FPSR_CONTEXT_ALIGN);
+     if (copy != NULL && size != 0) { memcpy(copy, data, size); }
+     return copy;
+ }
+
+ /**
+  * @brief Builds a context in an arena.
+  * @details Everything the context keeps is allocated from `arena`, after
+  * whatever the arena already holds. The context stays valid until the arena
+  * is released to a mark taken before this call; it needs no free.
+  *
+  * @param ctx The context to fill.
+  * @param arena The arena that holds the context and its per-frame outputs.
+  * @param sm An array of `smCount` SM parameter sets; it is copied.
+  * @param smCount The number of SM channels.
+  * @param qs An array of `qsCount` plans built by fpsr_qs_plan_init(); it is copied.
+  * @param qsCount The number of QS channels.
+  * @return 0 on success, -1 on invalid arguments or if the arena is too small
+  * (the arena is then unchanged).
+  */
+ int fpsr_context_init(
+     fpsr_context* ctx, fpsr_arena* arena,
+     const fpsr_sm_params* sm, size_t smCount, const fpsr_qs_plan* qs, size_t qsCount)
+ {
+     if (ctx == NULL || arena == NULL) { return -1; }
+     memset(ctx, 0, sizeof(*ctx));
+     if ((sm == NULL && smCount != 0) || (qs == NULL && qsCount != 0)) { return -1; }
+
+     size_t mark = fpsr_arena_mark(arena);
+     size_t smSize = fpsr_sm_channels_memory(smCount);
+     size_t qsSize = fpsr_qs_channels_memory(qsCount);
+     ctx->smParams = (fpsr_sm_params*)fpsr_context_copy(arena, sm, smCount * sizeof(fpsr_sm_params));
+     ctx->qsPlans = (fpsr_qs_plan*)fpsr_context_copy(arena, qs, qsCount * sizeof(fpsr_qs_plan));
+     void* smMemory = fpsr_arena_alloc(arena, smSize, FPSR_CONTEXT_ALIGN);
+     void* qsMemory = fpsr_arena_alloc(arena, qsSize, FPSR_CONTEXT_ALIGN);
+     if (ctx->smParams == NULL || ctx->qsPlans == NULL || smMemory == NULL || qsMemory == NULL ||
+         fpsr_sm_channels_init_in(&ctx->sm, ctx->smParams, smCount, smMemory, smSize) != 0 ||
+         fpsr_qs_channels_init_in(&ctx->qs, ctx->qsPlans, qsCount, qsMemory, qsSize) != 0) {
+         fpsr_arena_release(arena, mark);
+         memset(ctx, 0, sizeof(*ctx));
+         return -1;
+     }
+     ctx->arena = arena;
+     ctx->smCount = smCount;
+     ctx->qsCount = qsCount;
+     ctx->frameMark = fpsr_arena_mark(arena);
+     return 0;
+ }
+
+ /**
+  * @brief Drops every output allocated since the context was built or the last call.
+  * @details Pointers returned by the fpsr_context_eval_* / _bake_* / _sm_segments
+  * calls before this one are no longer valid. Allocations the caller made from
+  * the same arena after fpsr_context_init() are dropped as well.
+  */
+ void fpsr_context_begin_frame(fpsr_context* ctx)
+ {
+     fpsr_arena_release(ctx->arena, ctx->frameMark);
+ }
+
+ /**
+  * @brief Evaluates every SM channel at one frame.
+  * @return smCount values in the order the channels were given (an arena
+  * allocation valid until the next fpsr_context_begin_frame()), or NULL if
+  * the arena is full.
+  */
+ const float* fpsr_context_eval_sm(fpsr_context* ctx, int frame)
+ {
+     float* out = (float*)fpsr_arena_alloc(ctx->arena, ctx->smCount * sizeof(float), _Alignof(float));
+     if (out != NULL) { fpsr_sm_channels_eval(&ctx->sm, frame, out); }
+     return out;
+ }
+
+ // As fpsr_context_eval_sm(), for the QS channels.
+ const float* fpsr_context_eval_qs(fpsr_context* ctx, int frame)
+ {
+     float* out = (float*)fpsr_arena_alloc(ctx->arena, ctx->qsCount * sizeof(float), _Alignof(float));
+     if (out != NULL) { fpsr_qs_channels_eval(&ctx->qs, frame, out); }
+     return out;
+ }
+
+ // Row stride of a bake: whole cache lines per row, so rows start line-aligned.
+ static size_t fpsr_context_bake_stride(size_t frames)
+ {
+     const size_t perLine = FPSR_CACHE_LINE / sizeof(float);
+     return (frames + perLine - 1) / perLine * perLine;
+ }
+
+ // A cache-line-aligned rows × stride block, or NULL if it does not fit or its size overflows.
+ static float* fpsr_context_bake_out(fpsr_context* ctx, size_t rows, size_t stride)
+ {
+     if (stride != 0 && rows > (size_t)-1 / sizeof(float) / stride) { return NULL; }
+     return (float*)fpsr_arena_alloc(ctx->arena, rows * stride * sizeof(float), FPSR_CACHE_LINE);
+ }
+
+ /**
+  * @brief Bakes every SM channel over a frame range into the arena.
+  * @param ctx The context.
+  * @param pool The thread pool to bake with, or NULL to bake on the calling thread.
+  * @param startFrame The first frame of every row.
+  * @param frames The number of frames per row.
+  * @param outStride Receives the distance between rows in floats (frames rounded
+  * up to a cache line); may be NULL.
+  * @return Channel i's values at out[i * *outStride + f], in the order the
+  * channels were given; NULL if the arena is full, frames is 0 or
+  * startFrame + frames - 1 is past INT_MAX, in which case nothing is left
+  * allocated.
+  */
+ const float* fpsr_context_bake_sm(
+     fpsr_context* ctx, fpsr_thread_pool* pool, int startFrame, size_t frames, size_t* outStride)
+ {
+     size_t stride = fpsr_context_bake_stride(frames);
+     size_t mark = fpsr_arena_mark(ctx->arena);
+     float* out = (frames != 0) ? fpsr_context_bake_out(ctx, ctx->smCount, stride) : NULL;
+     if (out == NULL) { return NULL; }
+     if (fpsr_bake_sm(pool, ctx->smParams, ctx->smCount, startFrame, frames, out, stride) != 0) {
+         fpsr_arena_release(ctx->arena, mark);
+         return NULL;
+     }
+     if (outStride != NULL) { *outStride = stride; }
+     return out;
+ }
+
+ // As fpsr_context_bake_sm(), for the QS channels.
+ const float* fpsr_context_bake_qs(
+     fpsr_context* ctx, fpsr_thread_pool* pool, int startFrame, size_t frames, size_t* outStride)
+ {
+     size_t stride = fpsr_context_bake_stride(frames);
+     size_t mark = fpsr_arena_mark(ctx->arena);
+     float* out = (frames != 0) ? fpsr_context_bake_out(ctx, ctx->qsCount, stride) : NULL;
+     if (out == NULL) { return NULL; }
+     if (fpsr_bake_qs(pool, ctx->qsPlans, ctx->qsCount, startFrame, frames, out, stride) != 0) {
+         fpsr_arena_release(ctx->arena, mark);
+         return NULL;
+     }
+     if (outStride != NULL) { *outStride = stride; }
+     return out;
+ }
+
+ /**
+  * @brief Lists the constant segments of one SM channel over [startFrame, endFrame].
+  * @details The number of segments is not known in advance, so the list is
+  * written into the free end of the arena and then trimmed to its length.
+  *
+  * @param ctx The context.
+  * @param channel The channel's index in the order the channels were given.
+  * @param startFrame, endFrame The inclusive frame range; endFrame >= startFrame.
+  * @param count Receives the number of segments.
+  * @return The segments in frame order, or NULL on invalid arguments or if
+  * they do not fit (the arena is then unchanged).
+  */
+ const fpsr_sm_segment* fpsr_context_sm_segments(
+     fpsr_context* ctx, size_t channel, int startFrame, int endFrame, size_t* count)
+ {
+     if (count == NULL) { return NULL; }
+     *count = 0;
+     if (channel >= ctx->smCount || endFrame < startFrame) { return NULL; }
+
+     fpsr_arena* arena = ctx->arena;
+     size_t at = fpsr_arena_aligned(arena, _Alignof(fpsr_sm_segment));
+     if (at > arena->size) { return NULL; }
+     fpsr_sm_segment* segments = (fpsr_sm_segment*)(arena->base + at);
+     size_t capacity = (arena->size - at) / sizeof(fpsr_sm_segment);
+
+     const fpsr_sm_params* p = &ctx->smParams[channel];
+     fpsr_sm_segment_iter it;
+     fpsr_sm_segment seg;
+     size_t n = 0;
+     fpsr_sm_segments_begin(&it, startFrame, endFrame, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+     while (fpsr_sm_segments_next(&it, &seg)) {
+         if (n == capacity) { return NULL; }
+         segments[n++] = seg;
+     }
+
+     // Commit exactly the part written; this returns the same address.
+     fpsr_sm_segment* committed = (fpsr_sm_segment*)fpsr_arena_alloc(arena, n * sizeof(fpsr_sm_segment), _Alignof(fpsr_sm_segment));
+     *count = n;
+     return committed;
+ }
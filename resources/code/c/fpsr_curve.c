@@ -0,0 +1,537 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_curve.c
+ * @brief A compact on-disk format for baked FPS-R curves, with memory-mapped playback.
+ * @details A curve file holds any number of channels. Each channel is one
+ * fpsr_sm parameter set or fpsr_qs plan baked over a frame range as run-length
+ * segments: the frame each run starts on and the value it holds. SM and QS
+ * both hold their values for many frames, so a channel costs a few bytes per
+ * change rather than four per frame.
+ *
+ * Layout (all fields little-endian, every block 8-byte aligned):
+ *
+ *     header      fpsr_curve_header, 64 bytes
+ *     segments    per channel: int32 runStart[count], float value[count], padding
+ *     directory   fpsr_curve_entry[channelCount], 96 bytes each
+ *
+ * The writer streams each channel's segments to disk as it is added and only
+ * keeps the directory in memory; the directory and the header are written by
+ * fpsr_curve_writer_close(). Until then the header is all zeros, so a file
+ * whose writer failed or never finished is rejected by fpsr_curve_open().
+ *
+ * Each directory entry carries the channel's parameters, so frames outside the
+ * baked range can still be answered exactly, and a CRC-32 of its segments. The
+ * header carries a CRC-32 of itself and of the directory. fpsr_curve_open()
+ * always checks the header and the directory; segment checksums are only read
+ * when asked for, so opening a file with thousands of channels touches a few
+ * pages rather than the whole file.
+ *
+ * The reader uses the mapped segments in place. The format is little-endian
+ * and is only read and written on little-endian hosts.
+ *
+ * Uses POSIX mmap().
+ */
+
+ #include <fcntl.h> // For open()
+ #include <stdint.h>
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <sys/mman.h> // For mmap()
+ #include <sys/stat.h> // For fstat()
+ #include <unistd.h> // For close()
+ #include "fpsr_algorithms.h"
+
+ #define FPSR_CURVE_MAGIC "FPSRCURV"
+ #define FPSR_CURVE_VERSION 1u
+
+ typedef struct fpsr_curve_header {
+     char magic[8];             // FPSR_CURVE_MAGIC, not NUL-terminated.
+     uint32_t version;          // FPSR_CURVE_VERSION.
+     uint32_t channelCount;
+     uint64_t directoryOffset;
+     uint64_t fileSize;
+     uint32_t directoryCrc;
+     uint32_t headerCrc;        // CRC-32 of the header with this field zeroed.
+     uint8_t reserved[24];      // Zero.
+ } fpsr_curve_header;
+
+ // Parameter slots of a directory entry, by channel kind.
+ enum {
+     FPSR_CURVE_SM_MIN_HOLD = 0, FPSR_CURVE_SM_MAX_HOLD, FPSR_CURVE_SM_RESEED,
+     FPSR_CURVE_SM_SEED_INNER, FPSR_CURVE_SM_SEED_OUTER
+ };
+ enum {
+     FPSR_CURVE_QS_OFFSET_1 = 0, FPSR_CURVE_QS_OFFSET_2, FPSR_CURVE_QS_SWITCH_DUR,
+     FPSR_CURVE_QS_S1_DUR, FPSR_CURVE_QS_S2_DUR, FPSR_CURVE_QS_S1_LEVELS_1,
+     FPSR_CURVE_QS_S1_LEVELS_2, FPSR_CURVE_QS_S2_LEVELS_1, FPSR_CURVE_QS_S2_LEVELS_2
+ };
+ #define FPSR_CURVE_INT_PARAMS 13
+
+ typedef struct fpsr_curve_entry {
+     uint32_t kind;             // fpsr_curve_kind.
+     uint32_t randBackend;      // fpsr_rand_backend of a QS plan; FPSR_BACKEND_SIN for SM.
+     int32_t startFrame;        // Baked range, inclusive.
+     int32_t endFrame;
+     uint64_t segmentOffset;
+     uint64_t segmentCount;
+     uint32_t segmentCrc;       // CRC-32 of runStart[] followed by value[].
+     int32_t ints[FPSR_CURVE_INT_PARAMS];  // Unused slots are zero.
+     float floats[2];           // QS: baseWaveFreq, stream2FreqMult (resolved).
+ } fpsr_curve_entry;
+
+ _Static_assert(sizeof(fpsr_curve_header) == 64, "fpsr_curve_header is part of the file format");
+ _Static_assert(sizeof(fpsr_curve_entry) == 96, "fpsr_curve_entry is part of the file format");
+
+ static int fpsr_curve_host_is_little(void)
+ {
+     const uint16_t one = 1;
+     return *(const unsigned char*)&one == 1;
+ }
+
+ /**
+  * @brief CRC-32 (IEEE 802.3, reflected) of a block, continuing from a previous result.
+  * @details The 1 KiB table is rebuilt per call; that is noise next to a
+  * channel's worth of segments and keeps the function free of shared state.
+  */
+ static uint32_t fpsr_crc32(uint32_t crc, const void* data, size_t size)
+ {
+     uint32_t table[256];
+     for (uint32_t i = 0; i < 256; ++i) {
+         uint32_t c = i;
+         for (int k = 0; k < 8; ++k) { c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+         table[i] = c;
+     }
+
+     const unsigned char* p = (const unsigned char*)data;
+     crc = ~crc;
+     for (size_t i = 0; i < size; ++i) { crc = table[(crc ^ p[i]) & 0xFFu] ^ (crc >> 8); }
+     return ~crc;
+ }
+
+ static uint32_t fpsr_curve_header_crc(const fpsr_curve_header* header)
+ {
+     fpsr_curve_header copy = *header;
+     copy.headerCrc = 0;
+     return fpsr_crc32(0, &copy, sizeof(copy));
+ }
+
+ static void fpsr_curve_entry_plan(const fpsr_curve_entry* e, fpsr_qs_plan* plan)
+ {
+     plan->baseWaveFreq = e->floats[0];
+     plan->stream2FreqMult = e->floats[1];
+     plan->streamsOffset[0] = e->ints[FPSR_CURVE_QS_OFFSET_1];
+     plan->streamsOffset[1] = e->ints[FPSR_CURVE_QS_OFFSET_2];
+     plan->streamSwitchDur = e->ints[FPSR_CURVE_QS_SWITCH_DUR];
+     plan->stream1QuantDur = e->ints[FPSR_CURVE_QS_S1_DUR];
+     plan->stream2QuantDur = e->ints[FPSR_CURVE_QS_S2_DUR];
+     plan->streamSwitchHalf = plan->streamSwitchDur / 2;
+     plan->stream1QuantHalf = plan->stream1QuantDur / 2;
+     plan->stream2QuantHalf = plan->stream2QuantDur / 2;
+     plan->s1QuantLevels[0] = e->ints[FPSR_CURVE_QS_S1_LEVELS_1];
+     plan->s1QuantLevels[1] = e->ints[FPSR_CURVE_QS_S1_LEVELS_2];
+     plan->s2QuantLevels[0] = e->ints[FPSR_CURVE_QS_S2_LEVELS_1];
+     plan->s2QuantLevels[1] = e->ints[FPSR_CURVE_QS_S2_LEVELS_2];
+     plan->randBackend = (fpsr_rand_backend)e->randBackend;
+ }
+
+
+ /******************************************************************************/
+ /* Writer                                                                     */
+ /******************************************************************************/
+
+ struct fpsr_curve_writer {
+     FILE* file;
+     uint64_t offset;           // Bytes written so far.
+     int failed;                // A write failed; close() reports it.
+     fpsr_curve_entry* entries;
+     size_t count, capacity;
+     int32_t* runStart;         // Segments of the channel being baked, reused across channels.
+     float* value;
+     size_t runCount, runCapacity;
+ };
+
+ static void fpsr_curve_write(fpsr_curve_writer* w, const void* data, size_t size)
+ {
+     if (w->failed) { return; }
+     if (size != 0 && fwrite(data, 1, size, w->file) != size) { w->failed = 1; return; }
+     w->offset += size;
+ }
+
+ static void fpsr_curve_pad(fpsr_curve_writer* w)
+ {
+     static const unsigned char zeros[8] = { 0 };
+     fpsr_curve_write(w, zeros, (size_t)(-w->offset & 7u));
+ }
+
+ // Appends a run, merging it into the previous one when the value is unchanged.
+ static int fpsr_curve_push(fpsr_curve_writer* w, int startFrame, float value)
+ {
+     if (w->runCount != 0 && w->value[w->runCount - 1] == value) { return 0; }
+     if (w->runCount == w->runCapacity) {
+         size_t capacity = w->runCapacity ? w->runCapacity * 2 : 1024;
+         int32_t* runStart = (int32_t*)realloc(w->runStart, capacity * sizeof(int32_t));
+         if (runStart == NULL) { return -1; }
+         w->runStart = runStart;
+         float* values = (float*)realloc(w->value, capacity * sizeof(float));
+         if (values == NULL) { return -1; }
+         w->value = values;
+         w->runCapacity = capacity;
+     }
+     w->runStart[w->runCount] = startFrame;
+     w->value[w->runCount] = value;
+     ++w->runCount;
+     return 0;
+ }
+
+ // Streams the collected runs to disk and records the channel. Returns its index, or -1.
+ static int fpsr_curve_commit(fpsr_curve_writer* w, fpsr_curve_entry* e)
+ {
+     if (w->count >= UINT32_MAX || w->count >= (size_t)INT32_MAX) { return -1; }
+     if (w->count == w->capacity) {
+         size_t capacity = w->capacity ? w->capacity * 2 : 16;
+         fpsr_curve_entry* entries = (fpsr_curve_entry*)realloc(w->entries, capacity * sizeof(fpsr_curve_entry));
+         if (entries == NULL) { return -1; }
+         w->entries = entries;
+         w->capacity = capacity;
+     }
+
+     e->segmentOffset = w->offset;
+     e->segmentCount = w->runCount;
+     e->segmentCrc = fpsr_crc32(0, w->runStart, w->runCount * sizeof(int32_t));
+     e->segmentCrc = fpsr_crc32(e->segmentCrc, w->value, w->runCount * sizeof(float));
+     fpsr_curve_write(w, w->runStart, w->runCount * sizeof(int32_t));
+     fpsr_curve_write(w, w->value, w->runCount * sizeof(float));
+     fpsr_curve_pad(w);
+     if (w->failed) { return -1; }
+
+     w->entries[w->count] = *e;
+     return (int)w->count++;
+ }
+
+ /**
+  * @brief Creates a curve file and a writer that streams channels into it.
+  * @param path The file to create or truncate.
+  * @return The writer, or NULL if the file cannot be created (or the host is big-endian).
+  */
+ fpsr_curve_writer* fpsr_curve_writer_open(const char* path)
+ {
+     if (path == NULL || !fpsr_curve_host_is_little()) { return NULL; }
+
+     fpsr_curve_writer* w = (fpsr_curve_writer*)calloc(1, sizeof(fpsr_curve_writer));
+     if (w == NULL) { return NULL; }
+     w->file = fopen(path, "wb");
+     if (w->file == NULL) { free(w); return NULL; }
+
+     // Placeholder; the real header is written on close.
+     fpsr_curve_header blank;
+     memset(&blank, 0, sizeof(blank));
+     fpsr_curve_write(w, &blank, sizeof(blank));
+     return w;
+ }
+
+ /**
+  * @brief Bakes one fpsr_sm channel over [startFrame, endFrame].
+  * @details Walks the constant-value segments with fpsr_sm_segments_next(), so
+  * the cost is proportional to the number of holds, not the number of frames.
+  *
+  * @param writer A writer from fpsr_curve_writer_open().
+  * @param params The SM parameter set, stored with the channel.
+  * @param startFrame, endFrame The inclusive frame range to bake.
+  * @return The channel's index, or -1 on invalid arguments or a failed write.
+  */
+ int fpsr_curve_writer_add_sm(fpsr_curve_writer* writer, const fpsr_sm_params* params, int startFrame, int endFrame)
+ {
+     if (writer == NULL || writer->failed || params == NULL || startFrame > endFrame) { return -1; }
+
+     fpsr_curve_entry e;
+     memset(&e, 0, sizeof(e));
+     e.kind = FPSR_CURVE_SM;
+     e.randBackend = FPSR_BACKEND_SIN;
+     e.startFrame = startFrame;
+     e.endFrame = endFrame;
+     e.ints[FPSR_CURVE_SM_MIN_HOLD] = params->minHold;
+     e.ints[FPSR_CURVE_SM_MAX_HOLD] = params->maxHold;
+     e.ints[FPSR_CURVE_SM_RESEED] = params->reseedInterval;
+     e.ints[FPSR_CURVE_SM_SEED_INNER] = params->seedInner;
+     e.ints[FPSR_CURVE_SM_SEED_OUTER] = params->seedOuter;
+
+     writer->runCount = 0;
+     fpsr_sm_segment_iter it;
+     fpsr_sm_segment seg;
+     fpsr_sm_segments_begin(&it, startFrame, endFrame, params->minHold, params->maxHold,
+                            params->reseedInterval, params->seedInner, params->seedOuter);
+     while (fpsr_sm_segments_next(&it, &seg)) {
+         if (fpsr_curve_push(writer, seg.startFrame, seg.value) != 0) { return -1; }
+     }
+     return fpsr_curve_commit(writer, &e);
+ }
+
+ /**
+  * @brief Bakes one fpsr_qs channel over [startFrame, endFrame].
+  * @details Steps from change to change with fpsr_qs_plan_next_change(), so
+  * the cost is proportional to the number of value changes. Steps that stop at
+  * the look-ahead horizon without a change are merged away.
+  *
+  * @param writer A writer from fpsr_curve_writer_open().
+  * @param plan A plan built by fpsr_qs_plan_init(), stored with the channel.
+  * @param startFrame, endFrame The inclusive frame range to bake.
+  * @return The channel's index, or -1 on invalid arguments or a failed write.
+  */
+ int fpsr_curve_writer_add_qs(fpsr_curve_writer* writer, const fpsr_qs_plan* plan, int startFrame, int endFrame)
+ {
+     if (writer == NULL || writer->failed || plan == NULL || startFrame > endFrame) { return -1; }
+
+     fpsr_curve_entry e;
+     memset(&e, 0, sizeof(e));
+     e.kind = FPSR_CURVE_QS;
+     e.randBackend = (uint32_t)plan->randBackend;
+     e.startFrame = startFrame;
+     e.endFrame = endFrame;
+     e.ints[FPSR_CURVE_QS_OFFSET_1] = plan->streamsOffset[0];
+     e.ints[FPSR_CURVE_QS_OFFSET_2] = plan->streamsOffset[1];
+     e.ints[FPSR_CURVE_QS_SWITCH_DUR] = plan->streamSwitchDur;
+     e.ints[FPSR_CURVE_QS_S1_DUR] = plan->stream1QuantDur;
+     e.ints[FPSR_CURVE_QS_S2_DUR] = plan->stream2QuantDur;
+     e.ints[FPSR_CURVE_QS_S1_LEVELS_1] = plan->s1QuantLevels[0];
+     e.ints[FPSR_CURVE_QS_S1_LEVELS_2] = plan->s1QuantLevels[1];
+     e.ints[FPSR_CURVE_QS_S2_LEVELS_1] = plan->s2QuantLevels[0];
+     e.ints[FPSR_CURVE_QS_S2_LEVELS_2] = plan->s2QuantLevels[1];
+     e.floats[0] = plan->baseWaveFreq;
+     e.floats[1] = plan->stream2FreqMult;
+
+     writer->runCount = 0;
+     int frame = startFrame;
+     for (;;) {
+         if (fpsr_curve_push(writer, frame, fpsr_qs_eval(plan, frame)) != 0) { return -1; }
+         int next = fpsr_qs_plan_next_change(plan, frame);
+         if (next <= frame || next > endFrame) { break; }
+         frame = next;
+     }
+     return fpsr_curve_commit(writer, &e);
+ }
+
+ /**
+  * @brief Writes the directory and header, closes the file and frees the writer.
+  * @param writer A writer from fpsr_curve_writer_open(), or NULL.
+  * @return 0 if the file is complete, -1 if any write (including earlier ones) failed.
+  */
+ int fpsr_curve_writer_close(fpsr_curve_writer* writer)
+ {
+     if (writer == NULL) { return -1; }
+     fpsr_curve_writer* w = writer;
+
+     fpsr_curve_header header;
+     memset(&header, 0, sizeof(header));
+     memcpy(header.magic, FPSR_CURVE_MAGIC, sizeof(header.magic));
+     header.version = FPSR_CURVE_VERSION;
+     header.channelCount = (uint32_t)w->count;
+     header.directoryOffset = w->offset;
+     header.directoryCrc = fpsr_crc32(0, w->entries, w->count * sizeof(fpsr_curve_entry));
+     fpsr_curve_write(w, w->entries, w->count * sizeof(fpsr_curve_entry));
+     header.fileSize = w->offset;
+     header.headerCrc = fpsr_curve_header_crc(&header);
+
+     if (!w->failed && fseek(w->file, 0, SEEK_SET) != 0) { w->failed = 1; }
+     fpsr_curve_write(w, &header, sizeof(header));
+     if (fclose(w->file) != 0) { w->failed = 1; }
+
+     int result = w->failed ? -1 : 0;
+     free(w->entries);
+     free(w->runStart);
+     free(w->value);
+     free(w);
+     return result;
+ }
+
+
+ /******************************************************************************/
+ /* Reader                                                                     */
+ /******************************************************************************/
+
+ struct fpsr_curve_file {
+     const unsigned char* base;  // The whole file, mapped read-only.
+     size_t size;
+     const fpsr_curve_entry* entries;
+     size_t count;
+ };
+
+ // Checks that an entry's segments lie inside the file and its parameters are usable.
+ static int fpsr_curve_entry_valid(const fpsr_curve_entry* e, size_t fileSize)
+ {
+     if (e->kind != FPSR_CURVE_SM && e->kind != FPSR_CURVE_QS) { return 0; }
+     if (e->startFrame > e->endFrame) { return 0; }
+     uint64_t frames = (uint64_t)((int64_t)e->endFrame - e->startFrame) + 1;
+     if (e->segmentCount == 0 || e->segmentCount > frames) { return 0; }
+     if ((e->segmentOffset & 3u) != 0 || e->segmentOffset > fileSize) { return 0; }
+     if (e->segmentCount > (fileSize - e->segmentOffset) / (sizeof(int32_t) + sizeof(float))) { return 0; }
+
+     if (e->kind == FPSR_CURVE_QS) {
+         // fpsr_qs_plan_init() guarantees these; fpsr_qs_eval() divides by them.
+         if (e->randBackend != FPSR_BACKEND_SIN && e->randBackend != FPSR_BACKEND_HASH) { return 0; }
+         for (int i = FPSR_CURVE_QS_SWITCH_DUR; i <= FPSR_CURVE_QS_S2_LEVELS_2; ++i) {
+             if (e->ints[i] < 1) { return 0; }
+         }
+     }
+     return 1;
+ }
+
+ /**
+  * @brief Maps a curve file and validates its header and directory.
+  * @param path The file to open.
+  * @param flags 0, or FPSR_CURVE_VERIFY_SEGMENTS to also check every channel's segment checksum.
+  * @return The mapped file, or NULL if it cannot be read, is truncated, fails a
+  * checksum, has another version or (on a big-endian host) cannot be used in place.
+  */
+ fpsr_curve_file* fpsr_curve_open(const char* path, int flags)
+ {
+     if (path == NULL || !fpsr_curve_host_is_little()) { return NULL; }
+
+     int fd = open(path, O_RDONLY);
+     if (fd < 0) { return NULL; }
+     struct stat st;
+     if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(fpsr_curve_header)) { close(fd); return NULL; }
+     size_t size = (size_t)st.st_size;
+     void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+     close(fd);
+     if (map == MAP_FAILED) { return NULL; }
+
+     fpsr_curve_file* file = (fpsr_curve_file*)malloc(sizeof(fpsr_curve_file));
+     if (file == NULL) { munmap(map, size); return NULL; }
+     file->base = (const unsigned char*)map;
+     file->size = size;
+     file->entries = NULL;
+     file->count = 0;
+
+     // --- 1. Header ---
+     const fpsr_curve_header* header = (const fpsr_curve_header*)file->base;
+     int ok = memcmp(header->magic, FPSR_CURVE_MAGIC, sizeof(header->magic)) == 0
+           && header->version == FPSR_CURVE_VERSION
+           && header->headerCrc == fpsr_curve_header_crc(header)
+           && header->fileSize == size
+           && (header->directoryOffset & 7u) == 0
+           && header->directoryOffset <= size
+           && header->channelCount <= (size - header->directoryOffset) / sizeof(fpsr_curve_entry);
+
+     // --- 2. Directory ---
+     if (ok) {
+         file->entries = (const fpsr_curve_entry*)(file->base + header->directoryOffset);
+         file->count = header->channelCount;
+         ok = header->directoryCrc == fpsr_crc32(0, file->entries, file->count * sizeof(fpsr_curve_entry));
+         for (size_t i = 0; ok && i < file->count; ++i) {
+             ok = fpsr_curve_entry_valid(&file->entries[i], size);
+         }
+     }
+
+     // --- 3. Segments, on request ---
+     if ((flags & FPSR_CURVE_VERIFY_SEGMENTS) != 0) {
+         for (size_t i = 0; ok && i < file->count; ++i) {
+             ok = fpsr_curve_verify_channel(file, i) == 0;
+         }
+     }
+
+     if (!ok) { fpsr_curve_close(file); return NULL; }
+
+ #ifdef MADV_RANDOM
+     // Playback jumps between channels; don't read ahead of each fault.
+     madvise(map, size, MADV_RANDOM);
+ #endif
+     return file;
+ }
+
+ void fpsr_curve_close(fpsr_curve_file* file)
+ {
+     if (file == NULL) { return; }
+     munmap((void*)file->base, file->size);
+     free(file);
+ }
+
+ size_t fpsr_curve_channel_count(const fpsr_curve_file* file)
+ {
+     return file != NULL ? file->count : 0;
+ }
+
+ /**
+  * @brief Describes one channel: its kind, baked range and stored parameters.
+  * @return 0 on success, -1 if the channel does not exist.
+  */
+ int fpsr_curve_channel_info(const fpsr_curve_file* file, size_t channel, fpsr_curve_channel* info)
+ {
+     if (file == NULL || info == NULL || channel >= file->count) { return -1; }
+     const fpsr_curve_entry* e = &file->entries[channel];
+
+     memset(info, 0, sizeof(*info));
+     info->kind = (fpsr_curve_kind)e->kind;
+     info->startFrame = e->startFrame;
+     info->endFrame = e->endFrame;
+     info->segmentCount = (size_t)e->segmentCount;
+     if (e->kind == FPSR_CURVE_SM) {
+         info->sm.minHold = e->ints[FPSR_CURVE_SM_MIN_HOLD];
+         info->sm.maxHold = e->ints[FPSR_CURVE_SM_MAX_HOLD];
+         info->sm.reseedInterval = e->ints[FPSR_CURVE_SM_RESEED];
+         info->sm.seedInner = e->ints[FPSR_CURVE_SM_SEED_INNER];
+         info->sm.seedOuter = e->ints[FPSR_CURVE_SM_SEED_OUTER];
+     } else {
+         fpsr_curve_entry_plan(e, &info->qs);
+     }
+     return 0;
+ }
+
+ int fpsr_curve_verify_channel(const fpsr_curve_file* file, size_t channel)
+ {
+     if (file == NULL || channel >= file->count) { return -1; }
+     const fpsr_curve_entry* e = &file->entries[channel];
+
+     const int32_t* runStart = (const int32_t*)(file->base + e->segmentOffset);
+     size_t bytes = (size_t)e->segmentCount * (sizeof(int32_t) + sizeof(float));
+     if (fpsr_crc32(0, runStart, bytes) != e->segmentCrc) { return -1; }
+
+     // The lookup in fpsr_curve_value_at() relies on this ordering.
+     if (runStart[0] != e->startFrame) { return -1; }
+     for (size_t i = 1; i < e->segmentCount; ++i) {
+         if (runStart[i] <= runStart[i - 1] || runStart[i] > e->endFrame) { return -1; }
+     }
+     return 0;
+ }
+
+ /**
+  * @brief The value of one channel at one frame.
+  * @details Inside the baked range this is a binary search over the mapped
+  * run starts, reading the file in place. Outside it, the channel's stored
+  * parameters are evaluated with fpsr_sm() or fpsr_qs_eval(), so every frame
+  * gets the same value the live functions would return.
+  *
+  * @param file A file from fpsr_curve_open().
+  * @param channel The channel index, < fpsr_curve_channel_count().
+  * @param frame Any frame.
+  * @return The channel's value, or 0.0f if the channel does not exist.
+  */
+ float fpsr_curve_value_at(const fpsr_curve_file* file, size_t channel, int frame)
+ {
+     if (file == NULL || channel >= file->count) { return 0.0f; }
+     const fpsr_curve_entry* e = &file->entries[channel];
+
+     if (frame < e->startFrame || frame > e->endFrame) {
+         if (e->kind == FPSR_CURVE_SM) {
+             return fpsr_sm(frame, e->ints[FPSR_CURVE_SM_MIN_HOLD], e->ints[FPSR_CURVE_SM_MAX_HOLD],
+                            e->ints[FPSR_CURVE_SM_RESEED], e->ints[FPSR_CURVE_SM_SEED_INNER],
+                            e->ints[FPSR_CURVE_SM_SEED_OUTER]);
+         }
+         fpsr_qs_plan plan;
+         fpsr_curve_entry_plan(e, &plan);
+         return fpsr_qs_eval(&plan, frame);
+     }
+
+     // Last run starting at or before `frame`; runStart[0] == startFrame <= frame.
+     const int32_t* runStart = (const int32_t*)(file->base + e->segmentOffset);
+     const float* value = (const float*)(runStart + e->segmentCount);
+     size_t lo = 0;
+     size_t n = (size_t)e->segmentCount;
+     while (n > 1) {
+         size_t half = n / 2;
+         lo = (runStart[lo + half] <= frame) ? lo + half : lo;
+         n -= half;
+     }
+     return value[lo];
+ }
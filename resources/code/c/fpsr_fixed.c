@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_fixed.c
+ * @brief Integer-only FPS-R for microcontrollers without an FPU, in Q16.16.
+ * @details Everything here uses 32-bit integer arithmetic plus a handful of
+ * 32 × 32 → 64-bit multiplies and shifts. There are no divisions by variables
+ * apart from the modulos fpsr_sm() and fpsr_qs() are defined with, and every
+ * loop has a fixed upper bound. A call therefore takes a bounded number of
+ * cycles, but not a constant one: fpsr_q_round24() shifts once per bit above
+ * 24 (at most 38 steps) and fpsr_q_level_seed() once per leading zero of the
+ * quotient (at most 31) before its fixed 24 steps (a fixed 17 steps with
+ * FPSR_FIXED_APPROX). Build it with
+ * -DFPSR_NO_FLOAT to leave out fpsr_qs_q16_plan_from(), the one host-side
+ * helper; the rest touches no FPU registers (checked with
+ * -mgeneral-regs-only).
+ *
+ * Build it with -DFPSR_FIXED_APPROX as well to drop the float-rounding
+ * helpers: the SM hold and the stream 2 levels are then computed exactly
+ * instead of rounded as float operations, and the level seed from a truncated
+ * 17-bit quotient. fpsr_sm_q16() then differs from the reference on a few
+ * frames in a million (3 of 524288 in conformance), and fpsr_qs_q16_eval()
+ * picks a different hash on more step edges than it already does.
+ *
+ * Size, x86-64 text with gcc 12 -Os -DFPSR_NO_FLOAT: 1144 bytes, or 841 with
+ * -DFPSR_FIXED_APPROX. Neither is within the few hundred bytes of flash asked
+ * for. The Cortex-M0 size (arm-none-eabi-gcc -Os -mcpu=cortex-m0, with the
+ * libgcc helpers for the 64-bit multiplies, shifts and the modulos) has not
+ * been measured, so the budget is not claimed to be met.
+ *
+ * Mapping to the float reference. Results are the float value scaled by
+ * FPSR_Q16_ONE and truncated, i.e. q = floor(value * 65536):
+ *  - portable_rand_hash_q16(seed) is exactly floor(portable_rand_hash(seed) * 65536).
+ *    The sin()-based portable_rand() has no integer equivalent; the fixed-point
+ *    functions always use the hash backend.
+ *  - fpsr_sm_q16() is bit-exact with fpsr_sm_backend(FPSR_BACKEND_HASH, ...),
+ *    except with FPSR_FIXED_APPROX. The hold duration is computed in float
+ *    there, so the rounding of each float operation is reproduced with integers.
+ *  - fpsr_qs_q16_eval() follows fpsr_qs_eval() with FPSR_BACKEND_HASH. The
+ *    switch and quantisation cycles, the stream 2 level ratios and the hash
+ *    seed of each quantised level are exact. The sine is not: the argument is
+ *    a 32-bit phase accumulator (phase = t · phaseStep, wrapping once per turn)
+ *    and fpsr_q16_sin() is a polynomial accurate to 1 LSB. A frame where
+ *    sin(arg) · level lands within about 2^-15 · level of an integer, or where
+ *    the float argument of the reference has lost precision (|t| · freq
+ *    beyond ~10^4 radians), may pick the neighbouring level. Quantised steps
+ *    therefore start and end on the same frames as the reference except for
+ *    occasional one-frame shifts at step edges.
+ *
+ * Offsets are added to frames with 32-bit wraparound, which is what the
+ * reference's int arithmetic does on every supported compiler.
+ */
+
+ #include <limits.h> // For INT_MAX, INT_MIN
+ #include <stdint.h>
+ #include <stdio.h> // For NULL
+ #include "fpsr_algorithms.h"
+
+ // sin(π/2 · z) ≈ z · (A + z²·(B + z²·(C + z²·D))) on z in [0, 1], coefficients in Q30.
+ #define FPSR_Q_SIN_A 1686624015
+ #define FPSR_Q_SIN_B (-693522266)
+ #define FPSR_Q_SIN_C 85292218
+ #define FPSR_Q_SIN_D (-4652785)
+
+ // STREAM2_QUANT_RATIO_MIN / _MAX of fpsr_qs_plan_init() as float mantissa · 2^-exponent.
+ #define FPSR_Q_RATIO_MIN_MANTISSA 10401874 // 1.24f
+ #define FPSR_Q_RATIO_MIN_EXPONENT 23
+ #define FPSR_Q_RATIO_MAX_MANTISSA 11072963 // 0.66f
+ #define FPSR_Q_RATIO_MAX_EXPONENT 24
+
+ // a + b with 32-bit wraparound.
+ static inline int32_t fpsr_q_add(int32_t a, int32_t b)
+ {
+     return (int32_t)((uint32_t)a + (uint32_t)b);
+ }
+
+ // floor(x / 2^shift).
+ static inline int64_t fpsr_q_floor_shift(int64_t x, int shift)
+ {
+     if (x >= 0) { return x >> shift; }
+     return -(int64_t)((0 - (uint64_t)x + (UINT64_C(1) << shift) - 1) >> shift);
+ }
+
+ #ifndef FPSR_FIXED_APPROX
+ /**
+  * @brief Rounds x to 24 significant bits, ties to even.
+  * @details This is what an int-to-float conversion, or a float multiply or add
+  * of values on a common fixed-point grid, does to the exact result.
+  * |x| must be below 2^62.
+  */
+ static int64_t fpsr_q_round24(int64_t x)
+ {
+     uint64_t m = (x < 0) ? 0 - (uint64_t)x : (uint64_t)x;
+     int shift = 0;
+     while ((m >> shift) >= (UINT64_C(1) << 24)) { ++shift; } // At most 38 steps.
+     if (shift > 0) {
+         uint64_t rem = m & ((UINT64_C(1) << shift) - 1);
+         uint64_t half = UINT64_C(1) << (shift - 1);
+         m >>= shift;
+         if (rem > half || (rem == half && (m & 1u))) { ++m; }
+         m <<= shift;
+     }
+     return (x < 0) ? -(int64_t)m : (int64_t)m;
+ }
+ #endif
+
+ // The 32-bit mix behind portable_rand_hash().
+ static inline uint32_t fpsr_q_hash(int seed)
+ {
+     uint32_t x = (uint32_t)seed + 0x9E3779B9u;
+     x ^= x >> 16;
+     x *= 0x7FEB352Du;
+     x ^= x >> 15;
+     x *= 0x846CA68Bu;
+     x ^= x >> 16;
+     return x;
+ }
+
+ /**
+  * @brief floor(portable_rand_hash(seed) * 65536).
+  * @details portable_rand_hash() is (x >> 8) · 2^-24 for the 32-bit mix x, so
+  * the Q16.16 value is just its top 16 bits.
+  */
+ fpsr_q16 portable_rand_hash_q16(int seed)
+ {
+     return (fpsr_q16)(fpsr_q_hash(seed) >> 16);
+ }
+
+ /**
+  * @brief sin(2π · phase / 2^32) in Q16.16.
+  * @details Folds the phase into the first quadrant and evaluates a minimax
+  * polynomial in Q30. The result is within 1 LSB (2^-16) of the true sine and
+  * is exactly 0 and ±FPSR_Q16_ONE at the quadrant boundaries.
+  *
+  * @param phase The angle, 2^32 per full turn.
+  * @return The sine, in [-FPSR_Q16_ONE, FPSR_Q16_ONE].
+  */
+ fpsr_q16 fpsr_q16_sin(uint32_t phase)
+ {
+     uint32_t quadrant = phase >> 30;
+     int32_t z = (int32_t)(phase & 0x3FFFFFFFu); // Q30 position in the quadrant.
+     if (quadrant & 1u) { z = (1 << 30) - z; }
+
+     int32_t z2 = (int32_t)(((int64_t)z * z) >> 30);
+     int32_t p = FPSR_Q_SIN_D;
+     p = FPSR_Q_SIN_C + (int32_t)(((int64_t)p * z2) >> 30);
+     p = FPSR_Q_SIN_B + (int32_t)(((int64_t)p * z2) >> 30);
+     p = FPSR_Q_SIN_A + (int32_t)(((int64_t)p * z2) >> 30);
+     fpsr_q16 s = (fpsr_q16)(((int64_t)z * p + (INT64_C(1) << 43)) >> 44);
+     return (quadrant & 2u) ? -s : s;
+ }
+
+ /**
+  * @brief (int)floor(minHold + r * (maxHold - minHold)) for r = k · 2^-24, as fpsr_sm() computes it in float.
+  * @details The span and minHold are rounded as int-to-float conversions, the
+  * product and the sum as float operations, all on a grid of 2^-24.
+  */
+ static int fpsr_q_hold(uint32_t k, int minHold, int maxHold)
+ {
+     int32_t span = (int32_t)((uint32_t)maxHold - (uint32_t)minHold);
+ #ifdef FPSR_FIXED_APPROX
+     int64_t hold = minHold + fpsr_q_floor_shift((int64_t)k * span, 24); // Exact, not rounded as floats are.
+ #else
+     int64_t product = fpsr_q_round24((int64_t)k * fpsr_q_round24(span));
+     int64_t sum = fpsr_q_round24(fpsr_q_round24(minHold) * (INT64_C(1) << 24) + product);
+     int64_t hold = fpsr_q_floor_shift(sum, 24);
+ #endif
+     if (hold > INT_MAX) { return INT_MAX; }
+     if (hold < INT_MIN) { return INT_MIN; }
+     return (int)hold;
+ }
+
+ /**
+  * @brief fpsr_sm() with the hash backend, in Q16.16 and without floating point.
+  * @param frame, minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  * @return floor(fpsr_sm_backend(FPSR_BACKEND_HASH, ...) * 65536), in [0, FPSR_Q16_ONE).
+  */
+ fpsr_q16 fpsr_sm_q16(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (reseedInterval < 1) { reseedInterval = 1; } // Prevent division by zero.
+
+     // --- 1. The hold duration, from the top 24 bits of the hash ---
+     int32_t durationSeed = fpsr_q_add(fpsr_q_add(seedInner, frame), -(frame % reseedInterval));
+     int holdDuration = fpsr_q_hold(fpsr_q_hash(durationSeed) >> 8, minHold, maxHold);
+     if (holdDuration < 1) { holdDuration = 1; }
+
+     // --- 2. The held state and its value ---
+     int32_t t = fpsr_q_add(seedOuter, frame);
+     return portable_rand_hash_q16(t - (t % holdDuration));
+ }
+
+ /**
+  * @brief (int)floor(l * ratio) for ratio = mantissa · 2^-exponent, reproducing the float multiply.
+  * @details Clamped to >= 1 as fpsr_qs_plan_init() does with the stream 2 levels.
+  */
+ static int fpsr_q_scale_level(int l, int32_t mantissa, int exponent)
+ {
+     if (l < 1) { return 1; } // The product is <= 0 and would be clamped anyway.
+ #ifdef FPSR_FIXED_APPROX
+     int64_t level = ((int64_t)l * mantissa) >> exponent;
+ #else
+     int64_t level = fpsr_q_round24(fpsr_q_round24(l) * mantissa) >> exponent;
+ #endif
+     if (level > INT_MAX) { return INT_MAX; }
+     return (level < 1) ? 1 : (int)level;
+ }
+
+ /**
+  * @brief The hash seed fpsr_qs_eval() derives from quantised level n of `level`.
+  * @details That is (int)((float)((double)n / level) * 100000.0). The quotient
+  * is produced by long division, 24 significant bits plus a rounding bit, and
+  * rounded to even as the conversion to float does. (The reference rounds to
+  * double first; that only matters for levels beyond 2^28.)
+  *
+  * @param n The quantised step, |n| <= level.
+  * @param level The quantisation level, >= 1.
+  */
+ static int32_t fpsr_q_level_seed(int32_t n, int32_t level)
+ {
+     uint32_t a = (n < 0) ? 0 - (uint32_t)n : (uint32_t)n;
+     uint32_t d = (uint32_t)level;
+     if (a == 0) { return 0; }
+
+ #ifdef FPSR_FIXED_APPROX
+     // a / d to 17 fractional bits, truncated, then · 100000 = · 3125 · 2^5.
+     uint32_t r = a;
+     uint32_t q = 0;
+     for (int i = 0; i < 17; ++i) {
+         r <<= 1; // r < d < 2^31 before the shift (r == d only on the first step).
+         q <<= 1;
+         if (r >= d) { r -= d; q |= 1u; }
+     }
+     uint32_t seed = (a == d) ? 100000u : (q * 3125u) >> 12;
+ #else
+     uint32_t seed = 100000u; // a == d
+     if (a < d) {
+         // --- 1. Leading zeros: a / d in [2^-exponent, 2^(1-exponent)) ---
+         uint32_t r = a;
+         int exponent = 0;
+         do { r <<= 1; ++exponent; } while (r < d); // r < d < 2^31, so r << 1 cannot overflow.
+
+         // --- 2. The remaining 23 significant bits and the rounding bit ---
+         uint32_t q = 1;
+         r -= d;
+         for (int i = 0; i < 23; ++i) {
+             r <<= 1;
+             q <<= 1;
+             if (r >= d) { r -= d; q |= 1u; }
+         }
+         r <<= 1;
+         if (r >= d) {
+             r -= d;
+             if (r != 0 || (q & 1u)) { ++q; } // Above half, or a tie to even.
+         }
+
+         // --- 3. Scale by 100000 and truncate ---
+         seed = (uint32_t)(((uint64_t)q * 100000u) >> (exponent + 23));
+     }
+ #endif
+     return (n < 0) ? -(int32_t)seed : (int32_t)seed;
+ }
+
+ /**
+  * @brief Sets up a fixed-point QS plan from integer parameters.
+  * @details Levels and durations are resolved as fpsr_qs_plan_init() does,
+  * including the float ratios of the stream 2 levels. Durations < 1 become 1;
+  * the frequency-derived defaults of the float plan need
+  * fpsr_qs_q16_plan_from().
+  *
+  * @param plan The plan to fill.
+  * @param phaseStep The phase advance of stream 1 per frame: baseWaveFreq · 2^32 / 2π.
+  * @param stream2PhaseStep The same for stream 2: baseWaveFreq · stream2FreqMult · 2^32 / 2π.
+  * @param quantLevelsMinMax, streamsOffset, streamSwitchDur, stream1QuantDur, stream2QuantDur As for fpsr_qs().
+  */
+ void fpsr_qs_q16_plan_init(
+     fpsr_qs_q16_plan* plan, uint32_t phaseStep, uint32_t stream2PhaseStep,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     if (plan == NULL) { return; }
+
+     plan->phaseStep[0] = phaseStep;
+     plan->phaseStep[1] = stream2PhaseStep;
+     plan->streamsOffset[0] = streamsOffset[0];
+     plan->streamsOffset[1] = streamsOffset[1];
+     plan->streamSwitchDur = (streamSwitchDur < 1) ? 1 : streamSwitchDur;
+     plan->quantDur[0] = (stream1QuantDur < 1) ? 1 : stream1QuantDur;
+     plan->quantDur[1] = (stream2QuantDur < 1) ? 1 : stream2QuantDur;
+     plan->streamSwitchHalf = plan->streamSwitchDur / 2;
+     plan->quantHalf[0] = plan->quantDur[0] / 2;
+     plan->quantHalf[1] = plan->quantDur[1] / 2;
+
+     plan->quantLevels[0][0] = (quantLevelsMinMax[0] < 1) ? 1 : quantLevelsMinMax[0];
+     plan->quantLevels[0][1] = (quantLevelsMinMax[1] < 1) ? 1 : quantLevelsMinMax[1];
+     plan->quantLevels[1][0] = fpsr_q_scale_level(quantLevelsMinMax[0], FPSR_Q_RATIO_MIN_MANTISSA, FPSR_Q_RATIO_MIN_EXPONENT);
+     plan->quantLevels[1][1] = fpsr_q_scale_level(quantLevelsMinMax[1], FPSR_Q_RATIO_MAX_MANTISSA, FPSR_Q_RATIO_MAX_EXPONENT);
+ }
+
+ #ifndef FPSR_NO_FLOAT
+ // radiansPerFrame · 2^32 / 2π, modulo 2^32.
+ static uint32_t fpsr_q_phase_step(float radiansPerFrame)
+ {
+     double turns = (double)radiansPerFrame * (1.0 / 6.283185307179586);
+     turns -= (double)(int64_t)turns; // Whole turns do not move the phase.
+     return (uint32_t)(int64_t)(turns * 4294967296.0 + 0.5);
+ }
+
+ /**
+  * @brief Converts a float plan, defaults already resolved, into a fixed-point plan.
+  * @details Meant for the host side of a firmware build: make the plans with
+  * fpsr_qs_plan_init() and ship the fpsr_qs_q16_plan structs. Stream 2 uses the
+  * float product baseWaveFreq · stream2FreqMult, as fpsr_qs() does.
+  */
+ void fpsr_qs_q16_plan_from(fpsr_qs_q16_plan* plan, const fpsr_qs_plan* source)
+ {
+     if (plan == NULL || source == NULL) { return; }
+
+     plan->phaseStep[0] = fpsr_q_phase_step(source->baseWaveFreq);
+     plan->phaseStep[1] = fpsr_q_phase_step(source->baseWaveFreq * source->stream2FreqMult);
+     plan->streamsOffset[0] = source->streamsOffset[0];
+     plan->streamsOffset[1] = source->streamsOffset[1];
+     plan->streamSwitchDur = source->streamSwitchDur;
+     plan->streamSwitchHalf = source->streamSwitchHalf;
+     plan->quantDur[0] = source->stream1QuantDur;
+     plan->quantDur[1] = source->stream2QuantDur;
+     plan->quantHalf[0] = source->stream1QuantHalf;
+     plan->quantHalf[1] = source->stream2QuantHalf;
+     plan->quantLevels[0][0] = source->s1QuantLevels[0];
+     plan->quantLevels[0][1] = source->s1QuantLevels[1];
+     plan->quantLevels[1][0] = source->s2QuantLevels[0];
+     plan->quantLevels[1][1] = source->s2QuantLevels[1];
+ }
+ #endif
+
+ /**
+  * @brief fpsr_qs_eval() with the hash backend, in Q16.16 and without floating point.
+  * @details Same structure as fpsr_qs_plan_active_stream(): the switch picks a
+  * stream, the stream's quantisation cycle picks a level, and the quantised
+  * sine step is hashed. See the file comment for how closely it tracks the
+  * float reference.
+  *
+  * @param plan A plan from fpsr_qs_q16_plan_init() or fpsr_qs_q16_plan_from().
+  * @param frame The current frame or time input.
+  * @return A value in [0, FPSR_Q16_ONE).
+  */
+ fpsr_q16 fpsr_qs_q16_eval(const fpsr_qs_q16_plan* plan, int frame)
+ {
+     int stream = (frame % plan->streamSwitchDur) >= plan->streamSwitchHalf;
+     int32_t t = fpsr_q_add(plan->streamsOffset[stream], frame);
+     int level = plan->quantLevels[stream][(t % plan->quantDur[stream]) >= plan->quantHalf[stream]];
+
+     fpsr_q16 s = fpsr_q16_sin((uint32_t)t * plan->phaseStep[stream]);
+     int32_t n = (int32_t)fpsr_q_floor_shift((int64_t)s * level, 16);
+     return portable_rand_hash_q16(fpsr_q_level_seed(n, level));
+ }
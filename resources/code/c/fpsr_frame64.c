@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_frame64.c
+ * @brief FPS-R over 64-bit frames, for timestamps and long-running counters.
+ * @details The int API loses structure long before it overflows.
+ * portable_rand() computes sin((float)seed * 12.9898), and (float)seed is
+ * only exact up to 2^24. Beyond that, neighbouring SM hold states round to
+ * the same float and share a value, so holds merge and the change rate
+ * collapses. fpsr_qs() has the same problem with
+ * sin((float)(streamsOffset + frame) * baseWaveFreq): past 2^24 the stream
+ * argument moves in steps of several frames. Frames also wrap past INT_MAX.
+ *
+ * The functions here take long long frames and keep everything exact by
+ * reducing in integer space before any float conversion:
+ *  - Reseed windows, hold states, and the QS switch and quantisation cycles
+ *    are computed in 64-bit integers with the same truncating % as the int
+ *    API.
+ *  - A seed within ±FPSR_SEED_EXACT is used as is. A larger one is first
+ *    folded into [0, 2^22) with a 64-bit integer mix, so distinct states keep
+ *    distinct, well-spread values.
+ *  - A QS stream position t = streamsOffset + frame within ±FPSR_SEED_EXACT
+ *    is used as is. A larger one is reduced to t mod FPSR_SEED_EXACT, so the
+ *    sine argument stays exact and the stream keeps stepping one frame at a
+ *    time. The stream's phase restarts once every 2^24 frames out there;
+ *    the switch and quantisation cycles are unaffected.
+ *
+ * Wherever every seed and stream position lies within ±FPSR_SEED_EXACT, the
+ * results are bit-identical to fpsr_sm() / fpsr_qs_eval() at the same frame.
+ * Frames are clamped to ±FPSR_FRAME64_LIMIT, which keeps every sum clear of
+ * overflow.
+ */
+
+ #include <math.h> // For sin() and floor()
+ #include <stdint.h> // For uint32_t and uint64_t
+ #include <stdio.h> // For NULL
+ #include "fpsr_algorithms.h"
+
+ // Folded seeds land in [0, FPSR_SEED_FOLD). Smaller than FPSR_SEED_EXACT so that the sine
+ // arguments (seed * 12.9898) stay where libm's argument reduction takes its fast path.
+ #define FPSR_SEED_FOLD (1 << 22)
+
+ // Folds a 64-bit seed into [0, 2^64) with the murmur3 finaliser; every input bit reaches every output bit.
+ static inline uint64_t fpsr_mix64(long long seed)
+ {
+     uint64_t x = (uint64_t)seed;
+     x ^= x >> 33;
+     x *= 0xFF51AFD7ED558CCDull;
+     x ^= x >> 33;
+     x *= 0xC4CEB9FE1A85EC53ull;
+     x ^= x >> 33;
+     return x;
+ }
+
+ static inline long long fpsr_frame64_clamp(long long frame)
+ {
+     if (frame > FPSR_FRAME64_LIMIT) { return FPSR_FRAME64_LIMIT; }
+     if (frame < -FPSR_FRAME64_LIMIT) { return -FPSR_FRAME64_LIMIT; }
+     return frame;
+ }
+
+ /**
+  * @brief portable_rand() for 64-bit seeds.
+  * @details Seeds within ±FPSR_SEED_EXACT give portable_rand(seed). Larger ones
+  * are folded into [0, FPSR_SEED_FOLD) first, where (float)seed is exact.
+  */
+ float portable_rand64(long long seed)
+ {
+     if (seed >= -FPSR_SEED_EXACT && seed <= FPSR_SEED_EXACT) { return portable_rand((int)seed); }
+     return portable_rand((int)(fpsr_mix64(seed) & (FPSR_SEED_FOLD - 1)));
+ }
+
+ /**
+  * @brief portable_rand_hash() for 64-bit seeds.
+  * @details The hash is exact over all 32-bit seeds, so seeds in the int range
+  * give portable_rand_hash(seed), and larger ones are folded to 32 bits.
+  */
+ float portable_rand_hash64(long long seed)
+ {
+     if (seed >= INT32_MIN && seed <= INT32_MAX) { return portable_rand_hash((int)seed); }
+     return portable_rand_hash((int)(uint32_t)fpsr_mix64(seed));
+ }
+
+ static inline float fpsr_rand64(fpsr_rand_backend backend, long long seed)
+ {
+     return (backend == FPSR_BACKEND_HASH) ? portable_rand_hash64(seed) : portable_rand64(seed);
+ }
+
+ // As fpsr_trunc_run_end() in fpsr_algorithms.c, from the base: the last x with "x - (x % d)" == base.
+ // Bases are multiples of d, and the base after `base` is always base + d, zero included.
+ static inline long long fpsr_base_end64(long long base, int d)
+ {
+     if (base > 0) { return base + d - 1; }
+     if (base < 0) { return base; }
+     return d - 1;
+ }
+
+ /******************************************************************************/
+ /* Stacked Modulo (SM)                                                        */
+ /******************************************************************************/
+
+ // The hold duration of the reseed window starting at `base`, as in fpsr_sm().
+ static inline int fpsr_sm64_hold(fpsr_rand_backend backend, long long base, int minHold, int maxHold, int seedInner)
+ {
+     float rand_for_duration = fpsr_rand64(backend, seedInner + base);
+     int holdDuration = (int)floor(minHold + rand_for_duration * (maxHold - minHold));
+     return (holdDuration < 1) ? 1 : holdDuration; // Prevent division by zero.
+ }
+
+ /**
+  * @brief fpsr_sm() with a selectable backend, for a 64-bit frame.
+  * @param backend FPSR_BACKEND_SIN or FPSR_BACKEND_HASH.
+  * @param frame The frame, clamped to ±FPSR_FRAME64_LIMIT.
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  * @return fpsr_sm_backend(backend, frame, ...) wherever its seeds lie within ±FPSR_SEED_EXACT.
+  */
+ float fpsr_sm64_backend(
+     fpsr_rand_backend backend, long long frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (reseedInterval < 1) { reseedInterval = 1; } // Prevent division by zero.
+     frame = fpsr_frame64_clamp(frame);
+
+     int holdDuration = fpsr_sm64_hold(backend, frame - (frame % reseedInterval), minHold, maxHold, seedInner);
+     long long outer = seedOuter + frame;
+     return fpsr_rand64(backend, outer - (outer % holdDuration));
+ }
+
+ // fpsr_sm64_backend() with FPSR_BACKEND_SIN.
+ float fpsr_sm64(
+     long long frame, int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     return fpsr_sm64_backend(FPSR_BACKEND_SIN, frame, minHold, maxHold, reseedInterval, seedInner, seedOuter);
+ }
+
+ /**
+  * @brief fpsr_sm64() for a contiguous range of frames.
+  * @details Walks the frames run by run. Each run ends at the next reseed
+  * window or hold boundary. Consecutive windows and holds step by a fixed
+  * amount, so the only 64-bit division is one per window. As in
+  * fpsr_sm_range(), the duration is hashed once per window and the value once
+  * per held state.
+  *
+  * @param startFrame The first frame; frames beyond ±FPSR_FRAME64_LIMIT take the value at the limit.
+  * @param n The number of consecutive frames.
+  * @param out A caller-owned array that receives n values.
+  * @param minHold, maxHold, reseedInterval, seedInner, seedOuter As for fpsr_sm().
+  */
+ void fpsr_sm64_range(
+     long long startFrame, size_t n, float* out,
+     int minHold, int maxHold,
+     int reseedInterval, int seedInner, int seedOuter)
+ {
+     if (out == NULL || n == 0) { return; }
+     if (reseedInterval < 1) { reseedInterval = 1; } // Prevent division by zero.
+     if (startFrame < -FPSR_FRAME64_LIMIT) { // Clamped frames all share the limit's value.
+         float first = fpsr_sm64(startFrame, minHold, maxHold, reseedInterval, seedInner, seedOuter);
+         for (; n > 0 && startFrame < -FPSR_FRAME64_LIMIT; --n, ++startFrame) { *out++ = first; }
+         if (n == 0) { return; }
+     }
+
+     long long windowBase = 0, windowEnd = startFrame - 1; // Forces a hold duration lookup on the first run.
+     int holdDuration = 1;
+     long long heldState = 0;
+     float value = 0.0f;
+     size_t i = 0;
+     while (i < n) {
+         long long frame = startFrame + (long long)i;
+         if (frame >= FPSR_FRAME64_LIMIT) { // Clamped frames all share the limit's value.
+             float last = fpsr_sm64(frame, minHold, maxHold, reseedInterval, seedInner, seedOuter);
+             for (; i < n; ++i) { out[i] = last; }
+             break;
+         }
+
+         // --- 1. A new reseed window needs a hold duration and one division for its first state ---
+         long long state;
+         if (frame > windowEnd) {
+             windowBase = (i == 0) ? frame - (frame % reseedInterval) : windowBase + reseedInterval;
+             windowEnd = fpsr_base_end64(windowBase, reseedInterval);
+             holdDuration = fpsr_sm64_hold(FPSR_BACKEND_SIN, windowBase, minHold, maxHold, seedInner);
+             long long outer = seedOuter + frame;
+             state = outer - (outer % holdDuration);
+         } else {
+             state = heldState + holdDuration; // The previous run ended with its hold.
+         }
+
+         // --- 2. The run ends at the hold's end or the window's, whichever comes first ---
+         long long runEnd = fpsr_base_end64(state, holdDuration) - seedOuter;
+         if (runEnd > windowEnd) { runEnd = windowEnd; }
+         if (runEnd > FPSR_FRAME64_LIMIT - 1) { runEnd = FPSR_FRAME64_LIMIT - 1; }
+
+         // --- 3. Fill the run with its held value; rehash only when the held state changes ---
+         if (i == 0 || state != heldState) { value = portable_rand64(state); }
+         heldState = state;
+         size_t len = (size_t)(runEnd - frame) + 1;
+         if (len > n - i) { len = n - i; }
+         for (size_t k = 0; k < len; ++k) { out[i + k] = value; }
+         i += len;
+     }
+ }
+
+ /******************************************************************************/
+ /* Quantised Switching (QS)                                                   */
+ /******************************************************************************/
+
+ // The stream position t as the sine sees it: t itself within ±FPSR_SEED_EXACT, else t mod FPSR_SEED_EXACT.
+ static inline float fpsr_qs64_position(long long t)
+ {
+     if (t >= -FPSR_SEED_EXACT && t <= FPSR_SEED_EXACT) { return (float)t; }
+     return (float)(t & (FPSR_SEED_EXACT - 1));
+ }
+
+ // As fpsr_qs_plan_active_stream() in fpsr_algorithms.c, over 64-bit frames.
+ static inline float fpsr_qs64_active_stream(const fpsr_qs_plan* plan, long long frame)
+ {
+     if ((frame % plan->streamSwitchDur) < plan->streamSwitchHalf) {
+         long long t = plan->streamsOffset[0] + frame;
+         int level = plan->s1QuantLevels[(t % plan->stream1QuantDur) >= plan->stream1QuantHalf];
+         return floor(sin(fpsr_qs64_position(t) * plan->baseWaveFreq) * level) / level;
+     }
+     long long t = plan->streamsOffset[1] + frame;
+     int level = plan->s2QuantLevels[(t % plan->stream2QuantDur) >= plan->stream2QuantHalf];
+     // Two float multiplies, in the same order as fpsr_qs(), keep the argument bit-identical.
+     return floor(sin(fpsr_qs64_position(t) * plan->baseWaveFreq * plan->stream2FreqMult) * level) / level;
+ }
+
+ /**
+  * @brief fpsr_qs_eval() for a 64-bit frame.
+  * @param plan A plan built by fpsr_qs_plan_init(); its randBackend is honoured.
+  * @param frame The frame, clamped to ±FPSR_FRAME64_LIMIT.
+  * @return fpsr_qs_eval(plan, frame) wherever both stream positions lie within ±FPSR_SEED_EXACT.
+  */
+ float fpsr_qs64_eval(const fpsr_qs_plan* plan, long long frame)
+ {
+     float active_stream_val = fpsr_qs64_active_stream(plan, fpsr_frame64_clamp(frame));
+     // The seed is a stepped sine times 100000, so it is always within ±FPSR_SEED_EXACT.
+     int seed = (int)(active_stream_val * 100000.0);
+     return (plan->randBackend == FPSR_BACKEND_HASH) ? portable_rand_hash(seed) : portable_rand(seed);
+ }
+
+ /**
+  * @brief fpsr_qs64_eval() for a contiguous range of frames.
+  * @details One sine per frame, like fpsr_qs_eval(). The final hash is only
+  * recomputed when the stepped stream value changes, which for the usual
+  * quantisation levels is a fraction of the frames.
+  *
+  * @param plan A plan built by fpsr_qs_plan_init().
+  * @param startFrame The first frame; frames beyond ±FPSR_FRAME64_LIMIT take the value at the limit.
+  * @param n The number of consecutive frames.
+  * @param out A caller-owned array that receives n values.
+  */
+ void fpsr_qs64_range(const fpsr_qs_plan* plan, long long startFrame, size_t n, float* out)
+ {
+     if (plan == NULL || out == NULL || n == 0) { return; }
+
+     int seed = 0;
+     float value = 0.0f;
+     for (size_t i = 0; i < n; ++i) {
+         // Past the upper limit every frame clamps to it; checking first keeps startFrame + i from overflowing.
+         long long frame = (startFrame >= FPSR_FRAME64_LIMIT) ? FPSR_FRAME64_LIMIT : fpsr_frame64_clamp(startFrame + (long long)i);
+         int s = (int)(fpsr_qs64_active_stream(plan, frame) * 100000.0);
+         if (i == 0 || s != seed) {
+             seed = s;
+             value = (plan->randBackend == FPSR_BACKEND_HASH) ? portable_rand_hash(seed) : portable_rand(seed);
+         }
+         out[i] = value;
+     }
+ }
@@ -0,0 +1,505 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_graph.c
+ * @brief Expression graphs of layered and driven FPS-R signals, compiled to
+ * one blocked pass over a frame range.
+ * @details FPSR_Tech.md combines the algorithms by feeding one into another,
+ * e.g. a QS output offsetting the frame an SM instance reads, or by layering
+ * their outputs. Written by hand as nested fpsr_sm() / fpsr_qs() calls, such
+ * a rig re-evaluates every shared sub-signal once per use and cannot use any
+ * of the range kernels. An fpsr_graph describes the rig as nodes instead:
+ *
+ *   frame       the frame being evaluated, plus a constant offset
+ *   constant    a fixed value
+ *   sm / qs     fpsr_sm() / fpsr_qs_eval() at floor(input), clamped to the int range
+ *   remap       linear map of [fromMin, fromMax] onto [toMin, toMax]
+ *   threshold   1 where input >= threshold, else 0
+ *   combine     add, subtract, multiply, min or max of two nodes
+ *
+ * Adding a node that already exists (same kind, inputs and parameters)
+ * returns the existing node, so shared sub-signals are computed once however
+ * often they are referenced. Commutative combines are stored with their
+ * inputs in a canonical order so that a + b and b + a are also shared.
+ *
+ * fpsr_program_compile() keeps only the nodes the requested outputs depend
+ * on and evaluates nodes that do not depend on the frame once, at compile
+ * time. It then assigns every remaining node a column of FPSR_GRAPH_BLOCK values,
+ * reusing columns once their last reader has run. fpsr_program_eval() walks
+ * the frame range in blocks and runs every node over the whole block before
+ * the next, so all intermediate values stay in cache and the whole rig costs
+ * one pass.
+ *
+ * SM and QS nodes that read the frame node directly use the range paths:
+ * fpsr_sm_range() hashes once per held run and QS fills each held run from
+ * fpsr_qs_plan_next_change(). Driven SM nodes evaluate through an
+ * fpsr_sm_cursor kept across blocks, and driven QS nodes reuse the previous value
+ * while the driven frame does not move. Either way the values are those of
+ * fpsr_sm() and fpsr_qs_eval() at the driven frame.
+ *
+ * Arithmetic between nodes is in double; node outputs are written as float.
+ */
+
+ #include <limits.h> // For INT_MIN and INT_MAX
+ #include <math.h> // For floor()
+ #include <stdlib.h>
+ #include <string.h>
+ #include "fpsr_algorithms.h"
+
+ // Frames per column; 256 doubles per column keep a dozen live columns in L1.
+ #define FPSR_GRAPH_BLOCK 256
+
+ typedef enum fpsr_graph_kind {
+     FPSR_GRAPH_FRAME,
+     FPSR_GRAPH_CONSTANT,
+     FPSR_GRAPH_SM,
+     FPSR_GRAPH_QS,
+     FPSR_GRAPH_REMAP,
+     FPSR_GRAPH_THRESHOLD,
+     FPSR_GRAPH_COMBINE
+ } fpsr_graph_kind;
+
+ // Zero-filled before use, so nodes can be compared with memcmp().
+ typedef struct fpsr_graph_node {
+     fpsr_graph_kind kind;
+     int inputs[2];               // Node ids, -1 where unused.
+     int frameOffset;             // FPSR_GRAPH_FRAME.
+     fpsr_combine_op op;          // FPSR_GRAPH_COMBINE.
+     double k[4];                 // Constant value, remap ranges or threshold.
+     fpsr_sm_params sm;           // FPSR_GRAPH_SM.
+     fpsr_qs_plan qs;             // FPSR_GRAPH_QS.
+ } fpsr_graph_node;
+
+ struct fpsr_graph {
+     fpsr_graph_node* nodes;
+     size_t count;
+     size_t capacity;
+ };
+
+ /******************************************************************************/
+ /* Building                                                                   */
+ /******************************************************************************/
+
+ fpsr_graph* fpsr_graph_create(void)
+ {
+     return (fpsr_graph*)calloc(1, sizeof(fpsr_graph));
+ }
+
+ void fpsr_graph_destroy(fpsr_graph* graph)
+ {
+     if (graph == NULL) { return; }
+     free(graph->nodes);
+     free(graph);
+ }
+
+ // Distinct nodes in the graph, after sharing.
+ size_t fpsr_graph_node_count(const fpsr_graph* graph)
+ {
+     return (graph != NULL) ? graph->count : 0;
+ }
+
+ static void fpsr_graph_node_clear(fpsr_graph_node* node, fpsr_graph_kind kind)
+ {
+     memset(node, 0, sizeof(*node));
+     node->kind = kind;
+     node->inputs[0] = -1;
+     node->inputs[1] = -1;
+ }
+
+ // Returns the id of an equal node, adding `node` if there is none; -1 if one of its
+ // `arity` inputs is not a node of the graph or memory ran out.
+ static int fpsr_graph_intern(fpsr_graph* graph, const fpsr_graph_node* node, int arity)
+ {
+     if (graph == NULL) { return -1; }
+     for (int i = 0; i < arity; ++i) {
+         if (node->inputs[i] < 0 || (size_t)node->inputs[i] >= graph->count) { return -1; }
+     }
+     for (size_t i = 0; i < graph->count; ++i) {
+         if (memcmp(&graph->nodes[i], node, sizeof(*node)) == 0) { return (int)i; }
+     }
+     if (graph->count >= INT_MAX) { return -1; }
+     if (graph->count == graph->capacity) {
+         size_t capacity = graph->capacity ? graph->capacity * 2 : 16;
+         fpsr_graph_node* nodes = (fpsr_graph_node*)realloc(graph->nodes, sizeof(fpsr_graph_node) * capacity);
+         if (nodes == NULL) { return -1; }
+         graph->nodes = nodes;
+         graph->capacity = capacity;
+     }
+     memcpy(&graph->nodes[graph->count], node, sizeof(*node)); // Padding included, for memcmp().
+     return (int)graph->count++;
+ }
+
+ // The frame being evaluated plus `offset`.
+ int fpsr_graph_frame(fpsr_graph* graph, int offset)
+ {
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_FRAME);
+     node.frameOffset = offset;
+     return fpsr_graph_intern(graph, &node, 0);
+ }
+
+ int fpsr_graph_constant(fpsr_graph* graph, double value)
+ {
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_CONSTANT);
+     node.k[0] = value;
+     return fpsr_graph_intern(graph, &node, 0);
+ }
+
+ /**
+  * @brief fpsr_sm() of a node's value.
+  * @param graph The graph.
+  * @param frameNode The node whose value, floored and clamped to the int range, is the frame.
+  * @param params The SM parameters; they are copied.
+  * @return The node id, or -1 on invalid arguments or if memory ran out.
+  */
+ int fpsr_graph_sm(fpsr_graph* graph, int frameNode, const fpsr_sm_params* params)
+ {
+     if (params == NULL) { return -1; }
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_SM);
+     node.inputs[0] = frameNode;
+     node.sm = *params;
+     return fpsr_graph_intern(graph, &node, 1);
+ }
+
+ /**
+  * @brief fpsr_qs_eval() of a node's value.
+  * @param graph The graph.
+  * @param frameNode As for fpsr_graph_sm().
+  * @param plan A plan built by fpsr_qs_plan_init(); it is copied, randBackend included.
+  * @return The node id, or -1 on invalid arguments or if memory ran out.
+  */
+ int fpsr_graph_qs(fpsr_graph* graph, int frameNode, const fpsr_qs_plan* plan)
+ {
+     if (plan == NULL) { return -1; }
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_QS);
+     node.inputs[0] = frameNode;
+     node.qs = *plan;
+     return fpsr_graph_intern(graph, &node, 1);
+ }
+
+ // toMin + (input - fromMin) * (toMax - toMin) / (fromMax - fromMin); toMin where fromMin == fromMax.
+ int fpsr_graph_remap(fpsr_graph* graph, int input, double fromMin, double fromMax, double toMin, double toMax)
+ {
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_REMAP);
+     node.inputs[0] = input;
+     node.k[0] = fromMin;
+     node.k[1] = fromMax;
+     node.k[2] = toMin;
+     node.k[3] = toMax;
+     return fpsr_graph_intern(graph, &node, 1);
+ }
+
+ // 1 where input >= threshold, else 0.
+ int fpsr_graph_threshold(fpsr_graph* graph, int input, double threshold)
+ {
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_THRESHOLD);
+     node.inputs[0] = input;
+     node.k[0] = threshold;
+     return fpsr_graph_intern(graph, &node, 1);
+ }
+
+ int fpsr_graph_combine(fpsr_graph* graph, fpsr_combine_op op, int a, int b)
+ {
+     if (op < FPSR_COMBINE_ADD || op > FPSR_COMBINE_MAX) { return -1; }
+     fpsr_graph_node node;
+     fpsr_graph_node_clear(&node, FPSR_GRAPH_COMBINE);
+     // Every op but SUB is commutative; order their inputs so that a op b and b op a share a node.
+     int swap = (op != FPSR_COMBINE_SUB && b < a);
+     node.inputs[0] = swap ? b : a;
+     node.inputs[1] = swap ? a : b;
+     node.op = op;
+     return fpsr_graph_intern(graph, &node, 2);
+ }
+
+ /******************************************************************************/
+ /* Compiling                                                                  */
+ /******************************************************************************/
+
+ // One node of a compiled program, in evaluation order.
+ typedef struct fpsr_program_step {
+     fpsr_graph_node node;
+     int direct;                  // SM / QS reading a frame node: range path, frameOffset from that node.
+     int directOffset;
+     double* column;              // This node's values for the current block.
+     const double* in[2];         // Input columns.
+     fpsr_sm_cursor cursor;       // Driven SM.
+     int lastFrame;               // Driven QS: the last frame evaluated and its value.
+     int hasLast;
+     double lastValue;
+ } fpsr_program_step;
+
+ struct fpsr_program {
+     fpsr_program_step* steps;
+     size_t stepCount;
+     double* columns;             // Column storage: folded constants first, then the reused columns.
+     const double** outputs;      // Column of each requested output.
+     size_t outputCount;
+     float runs[FPSR_GRAPH_BLOCK]; // Scratch for the range paths.
+ };
+
+ // v floored and clamped to the int range; NaN reads as frame 0.
+ static int fpsr_graph_to_frame(double v)
+ {
+     if (v != v) { return 0; }
+     if (v <= (double)INT_MIN) { return INT_MIN; }
+     if (v >= (double)INT_MAX) { return INT_MAX; }
+     return (int)floor(v);
+ }
+
+ // Runs one step over frames startFrame .. startFrame + n - 1 (n <= FPSR_GRAPH_BLOCK).
+ static void fpsr_program_run_step(fpsr_program* program, fpsr_program_step* step, long long startFrame, int n)
+ {
+     const fpsr_graph_node* node = &step->node;
+     double* out = step->column;
+     const double* a = step->in[0];
+     const double* b = step->in[1];
+
+     switch (node->kind) {
+     case FPSR_GRAPH_FRAME:
+         for (int i = 0; i < n; ++i) { out[i] = (double)(startFrame + i + node->frameOffset); }
+         break;
+     case FPSR_GRAPH_CONSTANT:
+         for (int i = 0; i < n; ++i) { out[i] = node->k[0]; }
+         break;
+     case FPSR_GRAPH_SM: {
+         const fpsr_sm_params* p = &node->sm;
+         long long first = startFrame + step->directOffset;
+         if (step->direct && first >= INT_MIN && first + n - 1 <= INT_MAX) {
+             fpsr_sm_range((int)first, (size_t)n, program->runs, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+             for (int i = 0; i < n; ++i) { out[i] = program->runs[i]; }
+         } else {
+             for (int i = 0; i < n; ++i) { out[i] = fpsr_sm_cursor_eval(&step->cursor, fpsr_graph_to_frame(a[i])); }
+         }
+         break;
+     }
+     case FPSR_GRAPH_QS: {
+         long long first = startFrame + step->directOffset;
+         if (step->direct && first >= INT_MIN && first + n - 1 <= INT_MAX) {
+             // Fill each held run with one evaluation.
+             int i = 0;
+             while (i < n) {
+                 int frame = (int)(first + i);
+                 double value = fpsr_qs_eval(&node->qs, frame);
+                 long long run = (frame < INT_MAX) ? (long long)fpsr_qs_plan_next_change(&node->qs, frame) - frame : 1;
+                 int end = (run < (long long)(n - i)) ? i + (int)run : n;
+                 for (; i < end; ++i) { out[i] = value; }
+             }
+         } else {
+             for (int i = 0; i < n; ++i) {
+                 int frame = fpsr_graph_to_frame(a[i]);
+                 if (!step->hasLast || frame != step->lastFrame) {
+                     step->lastFrame = frame;
+                     step->lastValue = fpsr_qs_eval(&node->qs, frame);
+                     step->hasLast = 1;
+                 }
+                 out[i] = step->lastValue;
+             }
+         }
+         break;
+     }
+     case FPSR_GRAPH_REMAP: {
+         double span = node->k[1] - node->k[0];
+         double scale = (span != 0.0) ? (node->k[3] - node->k[2]) / span : 0.0;
+         for (int i = 0; i < n; ++i) { out[i] = node->k[2] + (a[i] - node->k[0]) * scale; }
+         break;
+     }
+     case FPSR_GRAPH_THRESHOLD:
+         for (int i = 0; i < n; ++i) { out[i] = (a[i] >= node->k[0]) ? 1.0 : 0.0; }
+         break;
+     case FPSR_GRAPH_COMBINE:
+         switch (node->op) {
+         case FPSR_COMBINE_ADD: for (int i = 0; i < n; ++i) { out[i] = a[i] + b[i]; } break;
+         case FPSR_COMBINE_SUB: for (int i = 0; i < n; ++i) { out[i] = a[i] - b[i]; } break;
+         case FPSR_COMBINE_MUL: for (int i = 0; i < n; ++i) { out[i] = a[i] * b[i]; } break;
+         case FPSR_COMBINE_MIN: for (int i = 0; i < n; ++i) { out[i] = (b[i] < a[i]) ? b[i] : a[i]; } break;
+         case FPSR_COMBINE_MAX: for (int i = 0; i < n; ++i) { out[i] = (b[i] > a[i]) ? b[i] : a[i]; } break;
+         }
+         break;
+     }
+ }
+
+ // Clears the per-range state of the driven steps, so every evaluation starts alike.
+ static void fpsr_program_reset(fpsr_program* program)
+ {
+     for (size_t s = 0; s < program->stepCount; ++s) {
+         fpsr_program_step* step = &program->steps[s];
+         const fpsr_sm_params* p = &step->node.sm;
+         if (step->node.kind == FPSR_GRAPH_SM) {
+             fpsr_sm_cursor_init(&step->cursor, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+         }
+         step->hasLast = 0;
+     }
+ }
+
+ void fpsr_program_destroy(fpsr_program* program)
+ {
+     if (program == NULL) { return; }
+     free(program->steps);
+     free(program->columns);
+     free(program->outputs);
+     free(program);
+ }
+
+ /**
+  * @brief Compiles the part of a graph that a set of outputs depends on.
+  * @details Unreferenced nodes are dropped, nodes that do not depend on the
+  * frame are evaluated here once, and the rest are scheduled in dependency
+  * order over columns that are reused once their last reader has run. The
+  * program does not refer to the graph afterwards.
+  *
+  * @param graph The graph.
+  * @param outputs The node ids to output, in output order; repeats are allowed.
+  * @param outputCount The number of outputs.
+  * @return The program (release it with fpsr_program_destroy()), or NULL on
+  * invalid arguments (including a -1 from a node builder) or if memory ran out.
+  */
+ fpsr_program* fpsr_program_compile(const fpsr_graph* graph, const int* outputs, size_t outputCount)
+ {
+     if (graph == NULL || outputs == NULL || outputCount == 0) { return NULL; }
+     for (size_t o = 0; o < outputCount; ++o) {
+         if (outputs[o] < 0 || (size_t)outputs[o] >= graph->count) { return NULL; }
+     }
+
+     size_t count = graph->count;
+     fpsr_program* program = (fpsr_program*)calloc(1, sizeof(fpsr_program));
+     // Per node: reachable, folded constant, position of the last reader (or count for outputs), column.
+     unsigned char* live = (unsigned char*)calloc(count, 2);
+     size_t* lastUse = (size_t*)calloc(count, sizeof(size_t));
+     size_t* column = (size_t*)calloc(count, sizeof(size_t));
+     size_t* freeColumns = (size_t*)calloc(count, sizeof(size_t));
+     if (program == NULL || live == NULL || lastUse == NULL || column == NULL || freeColumns == NULL) { goto fail; }
+     unsigned char* folded = live + count;
+
+     // --- 1. Keep what the outputs depend on; inputs always precede their readers ---
+     for (size_t o = 0; o < outputCount; ++o) {
+         live[outputs[o]] = 1;
+         lastUse[outputs[o]] = count;
+     }
+     for (size_t i = count; i-- > 0;) {
+         if (!live[i]) { continue; }
+         for (int k = 0; k < 2; ++k) {
+             int in = graph->nodes[i].inputs[k];
+             if (in < 0) { continue; }
+             live[in] = 1;
+             if (lastUse[in] < i) { lastUse[in] = i; }
+         }
+     }
+
+     // --- 2. Frame-independent nodes fold to constants ---
+     size_t foldedCount = 0, steps = 0;
+     for (size_t i = 0; i < count; ++i) {
+         if (!live[i]) { continue; }
+         const fpsr_graph_node* node = &graph->nodes[i];
+         int constant = (node->kind != FPSR_GRAPH_FRAME);
+         for (int k = 0; k < 2; ++k) {
+             if (node->inputs[k] >= 0 && !folded[node->inputs[k]]) { constant = 0; }
+         }
+         folded[i] = (unsigned char)constant;
+         if (constant) { column[i] = foldedCount++; } else { ++steps; }
+     }
+
+     // --- 3. Columns for the rest, reused after their last reader ---
+     size_t columns = foldedCount, freeCount = 0;
+     for (size_t i = 0; i < count; ++i) {
+         if (!live[i] || folded[i]) { continue; }
+         column[i] = (freeCount > 0) ? freeColumns[--freeCount] : columns++;
+         // Inputs read for the last time by this node give their columns back once it has run.
+         for (int k = 0; k < 2; ++k) {
+             int in = graph->nodes[i].inputs[k];
+             if (in >= 0 && !folded[in] && lastUse[in] == i && (k == 0 || graph->nodes[i].inputs[0] != in)) {
+                 freeColumns[freeCount++] = column[in];
+             }
+         }
+     }
+
+     program->columns = (double*)malloc(sizeof(double) * FPSR_GRAPH_BLOCK * (columns ? columns : 1));
+     program->steps = (fpsr_program_step*)calloc(steps ? steps : 1, sizeof(fpsr_program_step));
+     program->outputs = (const double**)malloc(sizeof(double*) * outputCount);
+     if (program->columns == NULL || program->steps == NULL || program->outputs == NULL) { goto fail; }
+
+     // --- 4. Steps in dependency order; folded nodes run once, now ---
+     for (size_t i = 0; i < count; ++i) {
+         if (!live[i]) { continue; }
+         fpsr_program_step step;
+         memset(&step, 0, sizeof(step));
+         step.node = graph->nodes[i];
+         step.column = program->columns + column[i] * FPSR_GRAPH_BLOCK;
+         for (int k = 0; k < 2; ++k) {
+             int in = step.node.inputs[k];
+             step.in[k] = (in >= 0) ? program->columns + column[in] * FPSR_GRAPH_BLOCK : NULL;
+         }
+         int in0 = step.node.inputs[0];
+         if ((step.node.kind == FPSR_GRAPH_SM || step.node.kind == FPSR_GRAPH_QS) && graph->nodes[in0].kind == FPSR_GRAPH_FRAME) {
+             step.direct = 1;
+             step.directOffset = graph->nodes[in0].frameOffset;
+         }
+         if (folded[i]) {
+             if (step.node.kind == FPSR_GRAPH_SM) {
+                 const fpsr_sm_params* p = &step.node.sm;
+                 fpsr_sm_cursor_init(&step.cursor, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+             }
+             fpsr_program_run_step(program, &step, 0, FPSR_GRAPH_BLOCK);
+         } else {
+             program->steps[program->stepCount++] = step;
+         }
+     }
+     for (size_t o = 0; o < outputCount; ++o) {
+         program->outputs[o] = program->columns + column[outputs[o]] * FPSR_GRAPH_BLOCK;
+     }
+     program->outputCount = outputCount;
+
+     free(live);
+     free(lastUse);
+     free(column);
+     free(freeColumns);
+     return program;
+
+ fail:
+     free(live);
+     free(lastUse);
+     free(column);
+     free(freeColumns);
+     fpsr_program_destroy(program);
+     return NULL;
+ }
+
+ /******************************************************************************/
+ /* Evaluating                                                                 */
+ /******************************************************************************/
+
+ /**
+  * @brief Evaluates a program over frames startFrame .. startFrame + frames - 1.
+  * @details Not thread-safe: the program holds the columns and cursors. Use a
+  * program per thread (compiling is cheap).
+  *
+  * @param program A program from fpsr_program_compile().
+  * @param startFrame The first frame.
+  * @param frames The number of frames.
+  * @param out Receives output o at out[o * outStride + f].
+  * @param outStride The distance between outputs in floats, >= frames.
+  * @return 0 on success, -1 on invalid arguments or if the range runs past INT_MAX.
+  */
+ int fpsr_program_eval(fpsr_program* program, int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     if (program == NULL || out == NULL || outStride < frames) { return -1; }
+     if (frames == 0) { return 0; }
+     if (frames - 1 > (size_t)((long long)INT_MAX - startFrame)) { return -1; }
+
+     fpsr_program_reset(program);
+     for (size_t done = 0; done < frames; done += FPSR_GRAPH_BLOCK) {
+         int n = (frames - done < FPSR_GRAPH_BLOCK) ? (int)(frames - done) : FPSR_GRAPH_BLOCK;
+         long long first = (long long)startFrame + (long long)done;
+         for (size_t s = 0; s < program->stepCount; ++s) { fpsr_program_run_step(program, &program->steps[s], first, n); }
+         for (size_t o = 0; o < program->outputCount; ++o) {
+             float* row = out + o * outStride + done;
+             const double* values = program->outputs[o];
+             for (int i = 0; i < n; ++i) { row[i] = (float)values[i]; }
+         }
+     }
+     return 0;
+ }
@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_planner.c
+ * @brief Picks the fastest bake path for a parameter set and frame range.
+ * @details How fast a bake fills its rows depends mostly on how often the
+ * values change. SM with holds of a frame or two changes almost every frame,
+ * so segment iteration only adds overhead, while with long holds
+ * fpsr_sm_range() and the segments skip nearly all hashing. QS at a low
+ * baseWaveFreq has long quantised steps, where per-run evaluation skips nearly
+ * every sine. The SIMD kernels ignore runs entirely. The run tables of
+ * FPSR_PATH_TABLE cover all four stream levels of a row, so they pay about
+ * twice the segments' cost per change and more per value: the model prices
+ * them, but they lose to FPSR_PATH_SEGMENTS at every change rate.
+ *
+ * The planner models each path as a linear cost per baked value:
+ *     ns = perValue + perChange · (value changes per frame)
+ * It estimates the change rate by sampling the actual parameters, without
+ * baking anything:
+ *  - SM: the exact hold durations of a few reseed windows of some rows.
+ *  - QS: fpsr_qs_plan_next_change() from a few frames of some rows.
+ * The path with the lowest total estimate wins.
+ *
+ * fpsr_cost_model_default() returns coefficients measured with
+ * fpsr_cost_model_calibrate() on an x86-64 AVX-512 machine; the bench's
+ * fpsr_bake_*\/path rows time the same paths. fpsr_cost_model_calibrate()
+ * refits every coefficient on the running machine in a fraction of a second,
+ * by timing each path on a high-change and a low-change workload.
+ */
+
+ #ifndef _POSIX_C_SOURCE
+ #define _POSIX_C_SOURCE 199309L // For clock_gettime() under -std=c11.
+ #endif
+
+ #include <limits.h> // For INT_MAX
+ #include <math.h> // For floor()
+ #include <stdlib.h> // For malloc() and free()
+ #include <string.h> // For memset() and memcmp()
+ #include <time.h> // For clock_gettime()
+ #include "fpsr_algorithms.h"
+
+ // Rows and frames each row is sampled at; planning costs at most a few hundred evaluations.
+ #define FPSR_PLAN_SAMPLE_ROWS 16
+ #define FPSR_PLAN_SAMPLE_FRAMES 8
+
+ /******************************************************************************/
+ /* Cost model                                                                 */
+ /******************************************************************************/
+
+ // Measured by fpsr_cost_model_calibrate(), single-threaded, with FPSR_ISA_AVX512 active.
+ static const fpsr_path_cost fpsr_default_sm[FPSR_PATH_COUNT] = {
+     [FPSR_PATH_SCALAR] = { 53.0, 13.0 },
+     [FPSR_PATH_RANGE] = { 4.9, 32.0 },
+     [FPSR_PATH_SEGMENTS] = { 1.3, 43.0 },
+     [FPSR_PATH_TABLE] = { -1.0, 0.0 },
+     [FPSR_PATH_SIMD] = { 11.4, 0.0 },
+ };
+ static const fpsr_path_cost fpsr_default_qs[FPSR_PATH_COUNT] = {
+     [FPSR_PATH_SCALAR] = { 39.0, 16.0 },
+     [FPSR_PATH_RANGE] = { -1.0, 0.0 },
+     [FPSR_PATH_SEGMENTS] = { 2.0, 245.0 },
+     [FPSR_PATH_TABLE] = { 9.5, 455.0 },
+     [FPSR_PATH_SIMD] = { 9.5, 0.0 },
+ };
+ // FPSR_PATH_SIMD per value at each fpsr_simd_isa, for SM and QS. NEON has not been measured; it uses AVX2's.
+ static const double fpsr_default_simd[4][2] = {
+     { 32.4, 36.3 }, // FPSR_ISA_SCALAR
+     { 15.6, 17.4 }, // FPSR_ISA_NEON
+     { 15.6, 17.4 }, // FPSR_ISA_AVX2
+     { 11.4, 9.5 },  // FPSR_ISA_AVX512
+ };
+
+ /**
+  * @brief Fills in the built-in cost model for the active SIMD ISA.
+  */
+ void fpsr_cost_model_default(fpsr_cost_model* model)
+ {
+     if (model == NULL) { return; }
+     memcpy(model->sm, fpsr_default_sm, sizeof(model->sm));
+     memcpy(model->qs, fpsr_default_qs, sizeof(model->qs));
+     int isa = (int)fpsr_simd_active_isa();
+     if (isa >= 0 && isa < 4) {
+         model->sm[FPSR_PATH_SIMD].perValue = fpsr_default_simd[isa][0];
+         model->qs[FPSR_PATH_SIMD].perValue = fpsr_default_simd[isa][1];
+     }
+ }
+
+ // Lanes of one fpsr_sm_eval_soa() / fpsr_qs_eval_soa() iteration at the active ISA.
+ static size_t fpsr_simd_lanes(void)
+ {
+     switch (fpsr_simd_active_isa()) {
+     case FPSR_ISA_AVX512: return 16;
+     case FPSR_ISA_AVX2: return 8;
+     case FPSR_ISA_NEON: return 4;
+     default: return 1;
+     }
+ }
+
+ // Fills plan->cost from the model and the sampled change rate, and picks the path.
+ static void fpsr_plan_choose(
+     const fpsr_path_cost* costs, size_t instances, size_t frames, double changes, int simdUsable,
+     fpsr_bake_plan* plan)
+ {
+     // The SIMD path pads each tile's rows up to whole vectors.
+     size_t rows = (instances < 32) ? instances : 32;
+     size_t lanes = fpsr_simd_lanes();
+     double simdWaste = (double)((rows + lanes - 1) / lanes * lanes) / (double)rows;
+
+     double values = (double)instances * (double)frames;
+     plan->changesPerValue = changes;
+     plan->path = FPSR_PATH_SCALAR;
+     for (int p = 0; p < FPSR_PATH_COUNT; ++p) {
+         plan->cost[p] = -1.0;
+         if (costs[p].perValue < 0.0 || (p == FPSR_PATH_SIMD && !simdUsable)) { continue; }
+         double cost = values * (costs[p].perValue + costs[p].perChange * changes);
+         if (p == FPSR_PATH_SIMD) { cost *= simdWaste; }
+         plan->cost[p] = cost;
+         if (plan->cost[plan->path] < 0.0 || cost < plan->cost[plan->path]) { plan->path = (fpsr_bake_path)p; }
+     }
+ }
+
+ /******************************************************************************/
+ /* Planning                                                                   */
+ /******************************************************************************/
+
+ /**
+  * @brief Estimates every path of an SM bake and picks the cheapest.
+  * @details Samples the hold duration of FPSR_PLAN_SAMPLE_FRAMES reseed windows
+  * in up to FPSR_PLAN_SAMPLE_ROWS rows, with the arithmetic of fpsr_sm(). A row
+  * changes about 1 / holdDuration + 1 / reseedInterval times per frame.
+  *
+  * @param model The cost model, or NULL for fpsr_cost_model_default().
+  * @param params, instances, startFrame, frames As for fpsr_bake_sm().
+  * @param plan Receives the estimates and the chosen path.
+  * @return 0, or -1 on invalid arguments or if startFrame + frames - 1 is past INT_MAX.
+  */
+ int fpsr_plan_bake_sm(
+     const fpsr_cost_model* model, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, fpsr_bake_plan* plan)
+ {
+     if (params == NULL || plan == NULL || instances == 0 || frames == 0) { return -1; }
+     if (frames - 1 > (size_t)((long long)INT_MAX - startFrame)) { return -1; }
+     fpsr_cost_model builtin;
+     if (model == NULL) {
+         fpsr_cost_model_default(&builtin);
+         model = &builtin;
+     }
+
+     size_t rows = (instances < FPSR_PLAN_SAMPLE_ROWS) ? instances : FPSR_PLAN_SAMPLE_ROWS;
+     double changes = 0.0;
+     for (size_t r = 0; r < rows; ++r) {
+         const fpsr_sm_params* p = &params[r * instances / rows];
+         int reseedInterval = (p->reseedInterval < 1) ? 1 : p->reseedInterval;
+         double inverseHold = 0.0;
+         for (int k = 0; k < FPSR_PLAN_SAMPLE_FRAMES; ++k) {
+             int frame = startFrame + (int)((frames - 1) * (size_t)k / (FPSR_PLAN_SAMPLE_FRAMES - 1));
+             int base = frame - (frame % reseedInterval);
+             // Unsigned so that the sum wraps exactly as fpsr_sm()'s does.
+             float rand_for_duration = portable_rand((int)((unsigned)p->seedInner + (unsigned)base));
+             int holdDuration = (int)floor(p->minHold + rand_for_duration * (p->maxHold - p->minHold));
+             inverseHold += 1.0 / (double)((holdDuration < 1) ? 1 : holdDuration);
+         }
+         double rate = inverseHold / FPSR_PLAN_SAMPLE_FRAMES + 1.0 / reseedInterval;
+         changes += (rate > 1.0) ? 1.0 : rate;
+     }
+     fpsr_plan_choose(model->sm, instances, frames, changes / (double)rows, 1, plan);
+     return 0;
+ }
+
+ /**
+  * @brief Estimates every path of a QS bake and picks the cheapest.
+  * @details Samples run lengths with fpsr_qs_plan_next_change() from
+  * FPSR_PLAN_SAMPLE_FRAMES frames of up to FPSR_PLAN_SAMPLE_ROWS rows. The SIMD
+  * path is only considered when every plan hashes with FPSR_BACKEND_SIN.
+  *
+  * @param model The cost model, or NULL for fpsr_cost_model_default().
+  * @param plans, instances, startFrame, frames As for fpsr_bake_qs().
+  * @param plan Receives the estimates and the chosen path.
+  * @return 0, or -1 on invalid arguments or if startFrame + frames - 1 is past INT_MAX.
+  */
+ int fpsr_plan_bake_qs(
+     const fpsr_cost_model* model, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, fpsr_bake_plan* plan)
+ {
+     if (plans == NULL || plan == NULL || instances == 0 || frames == 0) { return -1; }
+     if (frames - 1 > (size_t)((long long)INT_MAX - startFrame)) { return -1; }
+     fpsr_cost_model builtin;
+     if (model == NULL) {
+         fpsr_cost_model_default(&builtin);
+         model = &builtin;
+     }
+
+     int simdUsable = 1;
+     for (size_t i = 0; i < instances && simdUsable; ++i) { simdUsable = plans[i].randBackend == FPSR_BACKEND_SIN; }
+
+     size_t rows = (instances < FPSR_PLAN_SAMPLE_ROWS) ? instances : FPSR_PLAN_SAMPLE_ROWS;
+     long long endFrame = (long long)startFrame + (long long)frames; // Exclusive.
+     double runFrames = 0.0;
+     for (size_t r = 0; r < rows; ++r) {
+         const fpsr_qs_plan* p = &plans[r * instances / rows];
+         for (int k = 0; k < FPSR_PLAN_SAMPLE_FRAMES; ++k) {
+             int frame = startFrame + (int)((frames - 1) * (size_t)k / (FPSR_PLAN_SAMPLE_FRAMES - 1));
+             long long next = fpsr_qs_plan_next_change(p, frame);
+             if (next > endFrame) { next = endFrame; }
+             runFrames += (next > frame) ? (double)(next - frame) : 1.0;
+         }
+     }
+     double changes = (double)(rows * FPSR_PLAN_SAMPLE_FRAMES) / runFrames;
+     fpsr_plan_choose(model->qs, instances, frames, changes, simdUsable, plan);
+     return 0;
+ }
+
+ /**
+  * @brief fpsr_bake_sm() along the path fpsr_plan_bake_sm() picks.
+  * @param model The cost model, or NULL for fpsr_cost_model_default().
+  * @param pool, params, instances, startFrame, frames, out, outStride As for fpsr_bake_sm().
+  * @return 0 on success, -1 if the arguments are invalid or the range runs past INT_MAX.
+  */
+ int fpsr_bake_sm_auto(
+     fpsr_thread_pool* pool, const fpsr_cost_model* model, const fpsr_sm_params* params, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     fpsr_bake_plan plan;
+     if (fpsr_plan_bake_sm(model, params, instances, startFrame, frames, &plan) != 0) {
+         return fpsr_bake_sm(pool, params, instances, startFrame, frames, out, outStride); // Validates and handles empty bakes.
+     }
+     return fpsr_bake_sm_path(pool, plan.path, params, instances, startFrame, frames, out, outStride);
+ }
+
+ // fpsr_bake_qs() along the path fpsr_plan_bake_qs() picks; as fpsr_bake_sm_auto().
+ int fpsr_bake_qs_auto(
+     fpsr_thread_pool* pool, const fpsr_cost_model* model, const fpsr_qs_plan* plans, size_t instances,
+     int startFrame, size_t frames, float* out, size_t outStride)
+ {
+     fpsr_bake_plan plan;
+     if (fpsr_plan_bake_qs(model, plans, instances, startFrame, frames, &plan) != 0) {
+         return fpsr_bake_qs(pool, plans, instances, startFrame, frames, out, outStride);
+     }
+     return fpsr_bake_qs_path(pool, plan.path, plans, instances, startFrame, frames, out, outStride);
+ }
+
+ /******************************************************************************/
+ /* Calibration                                                                */
+ /******************************************************************************/
+
+ #define FPSR_CALIBRATE_ROWS 32
+ #define FPSR_CALIBRATE_FRAMES 2048
+ #define FPSR_CALIBRATE_REPEATS 3
+
+ static double fpsr_now_ns(void)
+ {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+ }
+
+ // Value changes per value of a baked grid, counted along each row.
+ static double fpsr_grid_changes(const float* out)
+ {
+     size_t changes = 0;
+     for (size_t r = 0; r < FPSR_CALIBRATE_ROWS; ++r) {
+         const float* row = out + r * FPSR_CALIBRATE_FRAMES;
+         for (size_t f = 1; f < FPSR_CALIBRATE_FRAMES; ++f) { changes += memcmp(&row[f], &row[f - 1], sizeof(float)) != 0; }
+     }
+     return (double)changes / (double)(FPSR_CALIBRATE_ROWS * (FPSR_CALIBRATE_FRAMES - 1));
+ }
+
+ // Best-of-FPSR_CALIBRATE_REPEATS nanoseconds per value of one path on one workload.
+ static double fpsr_time_path(int qs, fpsr_bake_path path, const void* params, float* out)
+ {
+     double best = -1.0;
+     for (int k = 0; k < FPSR_CALIBRATE_REPEATS; ++k) {
+         double start = fpsr_now_ns();
+         if (qs) {
+             fpsr_bake_qs_path(NULL, path, (const fpsr_qs_plan*)params, FPSR_CALIBRATE_ROWS, 0, FPSR_CALIBRATE_FRAMES, out, FPSR_CALIBRATE_FRAMES);
+         } else {
+             fpsr_bake_sm_path(NULL, path, (const fpsr_sm_params*)params, FPSR_CALIBRATE_ROWS, 0, FPSR_CALIBRATE_FRAMES, out, FPSR_CALIBRATE_FRAMES);
+         }
+         double ns = (fpsr_now_ns() - start) / (double)(FPSR_CALIBRATE_ROWS * FPSR_CALIBRATE_FRAMES);
+         if (best < 0.0 || ns < best) { best = ns; }
+     }
+     return best;
+ }
+
+ // Fits perValue + perChange · changes through the path's timings on the two workloads.
+ static void fpsr_fit_path(int qs, fpsr_bake_path path, const void* busy, const void* calm, float* out, fpsr_path_cost* cost)
+ {
+     double tBusy = fpsr_time_path(qs, path, busy, out);
+     double cBusy = fpsr_grid_changes(out);
+     double tCalm = fpsr_time_path(qs, path, calm, out);
+     double cCalm = fpsr_grid_changes(out);
+
+     double perChange = (cBusy > cCalm) ? (tBusy - tCalm) / (cBusy - cCalm) : 0.0;
+     if (perChange < 0.0) { perChange = 0.0; } // Timing noise on a change-insensitive path.
+     double perValue = tCalm - perChange * cCalm;
+     cost->perValue = (perValue < 0.0) ? 0.0 : perValue;
+     cost->perChange = perChange;
+ }
+
+ /**
+  * @brief Refits the coefficients of a cost model on this machine.
+  * @details Times every path, single-threaded and at the active SIMD ISA,
+  * on a 32 × 2048 bake of a high-change and a low-change workload, and fits
+  * each path's line through the two. It takes a fraction of a second.
+  *
+  * @param model The model to update; other fields are kept.
+  * @return 0, or -1 if memory ran out.
+  */
+ int fpsr_cost_model_calibrate(fpsr_cost_model* model)
+ {
+     if (model == NULL) { return -1; }
+     float* out = (float*)malloc(sizeof(float) * FPSR_CALIBRATE_ROWS * FPSR_CALIBRATE_FRAMES);
+     if (out == NULL) { return -1; }
+
+     // --- 1. SM: holds of 1-3 frames against holds of 200-400 ---
+     fpsr_sm_params busySm[FPSR_CALIBRATE_ROWS], calmSm[FPSR_CALIBRATE_ROWS];
+     for (int i = 0; i < FPSR_CALIBRATE_ROWS; ++i) {
+         busySm[i] = (fpsr_sm_params){ 1, 3, 5, -41 + 7 * i, 23 + 13 * i };
+         calmSm[i] = (fpsr_sm_params){ 200, 400, 97, -41 + 7 * i, 23 + 13 * i };
+     }
+     const fpsr_bake_path smPaths[] = { FPSR_PATH_SCALAR, FPSR_PATH_RANGE, FPSR_PATH_SEGMENTS, FPSR_PATH_SIMD };
+     for (size_t k = 0; k < sizeof(smPaths) / sizeof(smPaths[0]); ++k) {
+         fpsr_fit_path(0, smPaths[k], busySm, calmSm, out, &model->sm[smPaths[k]]);
+     }
+
+     // --- 2. QS: a fast wave with fine levels against a slow one ---
+     fpsr_qs_plan busyQs[FPSR_CALIBRATE_ROWS], calmQs[FPSR_CALIBRATE_ROWS];
+     const int busyLevels[2] = { 12, 22 }, calmLevels[2] = { 4, 6 };
+     for (int i = 0; i < FPSR_CALIBRATE_ROWS; ++i) {
+         const int offsets[2] = { 11 * i, 76 + 5 * i };
+         fpsr_qs_plan_init(&busyQs[i], 0.2f, 3.1f, busyLevels, offsets, 24, 16, 20);
+         fpsr_qs_plan_init(&calmQs[i], 0.0007f, -1.0f, calmLevels, offsets, 0, 0, 0);
+     }
+     const fpsr_bake_path qsPaths[] = { FPSR_PATH_SCALAR, FPSR_PATH_SEGMENTS, FPSR_PATH_TABLE, FPSR_PATH_SIMD };
+     for (size_t k = 0; k < sizeof(qsPaths) / sizeof(qsPaths[0]); ++k) {
+         fpsr_fit_path(1, qsPaths[k], busyQs, calmQs, out, &model->qs[qsPaths[k]]);
+     }
+
+     free(out);
+     return 0;
+ }
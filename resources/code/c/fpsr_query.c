@@ -0,0 +1,462 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_query.c
+ * @brief Time-inverse queries: the frames at which an SM or QS channel takes
+ * a given value or held state.
+ * @details The functions here answer the inverse of fpsr_sm() / fpsr_qs(),
+ * e.g. "on which frames in [a, b] is the value above t", by walking held runs
+ * instead of single frames.
+ *
+ * - fpsr_sm_query_value() walks the SM segment iterator, so it costs
+ *   O(segments).
+ * - fpsr_qs_query_value() jumps between changes with
+ *   fpsr_qs_plan_next_change(), so it costs O(changes).
+ *
+ * Matching frames come back as inclusive frame intervals. Adjacent matching
+ * runs are merged, so consecutive intervals are always separated by at least
+ * one frame that does not match.
+ *
+ * Held states are SM's held_integer_state, seedOuter + frame rounded toward
+ * zero to the hold grid. A state s can only be held while the int sum
+ * seedOuter + frame lies within one hold duration of s. fpsr_sm_query_state()
+ * therefore only walks the at most 2 * max(minHold, maxHold) frames around
+ * s - seedOuter (more than one span when the sum wraps inside the range),
+ * whatever the length of the query range.
+ *
+ * For repeated value queries over long ranges, fpsr_value_index tabulates a
+ * channel's runs once. It keeps the minimum and maximum value of every
+ * FPSR_VALUE_INDEX_BLOCK runs, so a query skips or wholly accepts most blocks
+ * without looking at their runs.
+ *
+ * All results are exact: every value compared is the one fpsr_sm() or
+ * fpsr_qs_eval() returns for those frames.
+ */
+
+ #include <limits.h> // For INT_MIN and INT_MAX
+ #include <stdlib.h> // For malloc(), realloc() and free()
+ #include <string.h>
+ #include "fpsr_algorithms.h"
+
+ /******************************************************************************/
+ /* Interval output                                                            */
+ /******************************************************************************/
+
+ // Collects matching runs into a caller's interval buffer, merging adjacent ones.
+ typedef struct fpsr_interval_sink {
+     fpsr_frame_interval* out;
+     size_t capacity;
+     size_t count;       // Intervals found, including any past capacity.
+     long long lastEnd;  // End of the last interval, whether or not it was stored.
+ } fpsr_interval_sink;
+
+ static void fpsr_sink_init(fpsr_interval_sink* sink, fpsr_frame_interval* out, size_t capacity)
+ {
+     sink->out = out;
+     sink->capacity = (out != NULL) ? capacity : 0;
+     sink->count = 0;
+     sink->lastEnd = (long long)INT_MIN - 2;
+ }
+
+ // Adds frames [startFrame, endFrame]; runs arrive in increasing frame order.
+ static void fpsr_sink_add(fpsr_interval_sink* sink, long long startFrame, long long endFrame)
+ {
+     if (sink->count > 0 && startFrame == sink->lastEnd + 1) {
+         if (sink->count <= sink->capacity) { sink->out[sink->count - 1].endFrame = (int)endFrame; }
+     } else {
+         if (sink->count < sink->capacity) {
+             sink->out[sink->count].startFrame = (int)startFrame;
+             sink->out[sink->count].endFrame = (int)endFrame;
+         }
+         sink->count++;
+     }
+     sink->lastEnd = endFrame;
+ }
+
+ static int fpsr_query_match(fpsr_query_op op, float threshold, float value)
+ {
+     switch (op) {
+     case FPSR_QUERY_LESS: return value < threshold;
+     case FPSR_QUERY_LESS_EQUAL: return value <= threshold;
+     case FPSR_QUERY_EQUAL: return value == threshold;
+     case FPSR_QUERY_NOT_EQUAL: return value != threshold;
+     case FPSR_QUERY_GREATER_EQUAL: return value >= threshold;
+     case FPSR_QUERY_GREATER: return value > threshold;
+     }
+     return 0;
+ }
+
+ /******************************************************************************/
+ /* Value queries                                                              */
+ /******************************************************************************/
+
+ static void fpsr_sm_query_runs(
+     fpsr_interval_sink* sink, const fpsr_sm_params* p, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold)
+ {
+     fpsr_sm_segment_iter it;
+     fpsr_sm_segment seg;
+     fpsr_sm_segments_begin(&it, startFrame, endFrame, p->minHold, p->maxHold, p->reseedInterval, p->seedInner, p->seedOuter);
+     while (fpsr_sm_segments_next(&it, &seg)) {
+         if (fpsr_query_match(op, threshold, seg.value)) { fpsr_sink_add(sink, seg.startFrame, seg.endFrame); }
+     }
+ }
+
+ static void fpsr_qs_query_runs(
+     fpsr_interval_sink* sink, const fpsr_qs_plan* plan, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold)
+ {
+     long long frame = startFrame;
+     while (frame <= endFrame) {
+         float value = fpsr_qs_eval(plan, (int)frame);
+         long long next = (frame < INT_MAX) ? fpsr_qs_plan_next_change(plan, (int)frame) : (long long)INT_MAX + 1;
+         long long runEnd = (next - 1 < endFrame) ? next - 1 : endFrame;
+         if (fpsr_query_match(op, threshold, value)) { fpsr_sink_add(sink, frame, runEnd); }
+         frame = runEnd + 1;
+     }
+ }
+
+ /**
+  * @brief Finds the frames in [startFrame, endFrame] at which fpsr_sm's value satisfies `op threshold`.
+  * @param params The channel's parameters.
+  * @param startFrame The first frame to search.
+  * @param endFrame The last frame to search (inclusive).
+  * @param op The comparison, value `op` threshold.
+  * @param threshold The value compared against.
+  * @param out Receives the first `capacity` matching intervals in frame order; may be NULL.
+  * @param capacity The size of `out`.
+  * @return The number of matching intervals, which may exceed capacity (as
+  * snprintf() does): call again with a larger buffer to get them all.
+  */
+ size_t fpsr_sm_query_value(
+     const fpsr_sm_params* params, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity)
+ {
+     fpsr_interval_sink sink;
+     fpsr_sink_init(&sink, out, capacity);
+     if (params != NULL) { fpsr_sm_query_runs(&sink, params, startFrame, endFrame, op, threshold); }
+     return sink.count;
+ }
+
+ /**
+  * @brief fpsr_sm_query_value() for fpsr_qs_eval().
+  * @param plan A plan built by fpsr_qs_plan_init(); its randBackend is honoured.
+  * @param startFrame, endFrame, op, threshold, out, capacity As for fpsr_sm_query_value().
+  * @return The number of matching intervals, which may exceed capacity.
+  */
+ size_t fpsr_qs_query_value(
+     const fpsr_qs_plan* plan, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity)
+ {
+     fpsr_interval_sink sink;
+     fpsr_sink_init(&sink, out, capacity);
+     if (plan != NULL) { fpsr_qs_query_runs(&sink, plan, startFrame, endFrame, op, threshold); }
+     return sink.count;
+ }
+
+ /******************************************************************************/
+ /* Held-state queries                                                         */
+ /******************************************************************************/
+
+ /**
+  * @brief Returns the held_integer_state fpsr_sm uses at `frame`.
+  * @param params The channel's parameters.
+  * @param frame The frame.
+  * @param run If not NULL, receives the frames around `frame` that hold the
+  * same state without a break (one hold run, clipped to its reseed window).
+  * @return The held state; fpsr_sm(frame, ...) is portable_rand() of it.
+  */
+ int fpsr_sm_held_state(const fpsr_sm_params* params, int frame, fpsr_frame_interval* run)
+ {
+     fpsr_sm_cursor cursor;
+     fpsr_sm_cursor_init(&cursor, params->minHold, params->maxHold, params->reseedInterval, params->seedInner, params->seedOuter);
+     fpsr_sm_cursor_eval(&cursor, frame);
+     if (run != NULL) {
+         // The cursor's run may extend past the int frame range; no frame there exists.
+         run->startFrame = (cursor.runStart < INT_MIN) ? INT_MIN : (int)cursor.runStart;
+         run->endFrame = (cursor.runEnd > INT_MAX) ? INT_MAX : (int)cursor.runEnd;
+     }
+     return cursor.heldState;
+ }
+
+ // Walks the held-state runs of [startFrame, endFrame] and keeps those holding `state`.
+ static void fpsr_sm_query_state_span(
+     fpsr_interval_sink* sink, fpsr_sm_cursor* cursor, int state, long long startFrame, long long endFrame)
+ {
+     long long frame = startFrame;
+     while (frame <= endFrame) {
+         fpsr_sm_cursor_eval(cursor, (int)frame);
+         long long runEnd = (cursor->runEnd < endFrame) ? cursor->runEnd : endFrame;
+         if (cursor->heldState == state) { fpsr_sink_add(sink, frame, runEnd); }
+         frame = runEnd + 1;
+     }
+ }
+
+ /**
+  * @brief Finds the frames in [startFrame, endFrame] at which fpsr_sm holds `state`.
+  * @details To find when the state at frame f next recurs, take state and run
+  * from fpsr_sm_held_state(params, f, &run) and search from run.endFrame + 1
+  * with capacity 1. Costs O(maxHold) whatever the length of the range.
+  *
+  * @param params The channel's parameters.
+  * @param state A held_integer_state, e.g. from fpsr_sm_held_state().
+  * @param startFrame, endFrame, out, capacity As for fpsr_sm_query_value().
+  * @return The number of matching intervals, which may exceed capacity.
+  */
+ size_t fpsr_sm_query_state(
+     const fpsr_sm_params* params, int state, int startFrame, int endFrame,
+     fpsr_frame_interval* out, size_t capacity)
+ {
+     fpsr_interval_sink sink;
+     fpsr_sink_init(&sink, out, capacity);
+     if (params == NULL || startFrame > endFrame) { return 0; }
+
+     // |held state - (seedOuter + frame)| < holdDuration <= reach, with a frame to spare for float rounding.
+     long long reach = (params->minHold > params->maxHold) ? params->minHold : params->maxHold;
+     reach = ((reach > 1) ? reach : 1) + 1;
+
+     // The frame whose int sum seedOuter + frame equals `state`; sums wrap, so so do the candidates.
+     long long center = (int)((unsigned)state - (unsigned)params->seedOuter);
+     fpsr_sm_cursor cursor;
+     fpsr_sm_cursor_init(&cursor, params->minHold, params->maxHold, params->reseedInterval, params->seedInner, params->seedOuter);
+     for (int shift = -1; shift <= 1; ++shift) {
+         long long lo = center - reach + 1 + shift * 4294967296LL;
+         long long hi = center + reach - 1 + shift * 4294967296LL;
+         if (lo < startFrame) { lo = startFrame; }
+         if (hi > endFrame) { hi = endFrame; }
+         fpsr_sm_query_state_span(&sink, &cursor, state, lo, hi);
+     }
+     return sink.count;
+ }
+
+ /******************************************************************************/
+ /* Value index                                                                */
+ /******************************************************************************/
+
+ // Appends a run, extending the previous one instead when the value is the same.
+ static int fpsr_value_index_push(fpsr_value_index* index, size_t* capacity, long long frame, float value)
+ {
+     if (index->count > 0 && index->value[index->count - 1] == value) { return 0; }
+     if (index->count == *capacity) {
+         *capacity = (*capacity != 0) ? *capacity * 2 : 256;
+         int* runStart = (int*)realloc(index->runStart, sizeof(int) * *capacity);
+         if (runStart != NULL) { index->runStart = runStart; }
+         float* values = (float*)realloc(index->value, sizeof(float) * *capacity);
+         if (values != NULL) { index->value = values; }
+         if (runStart == NULL || values == NULL) { return -1; }
+     }
+     index->runStart[index->count] = (int)frame;
+     index->value[index->count] = value;
+     index->count++;
+     return 0;
+ }
+
+ // Fills the per-block minimum and maximum once the runs are in place.
+ static int fpsr_value_index_finish(fpsr_value_index* index)
+ {
+     index->blockCount = (index->count + FPSR_VALUE_INDEX_BLOCK - 1) / FPSR_VALUE_INDEX_BLOCK;
+     index->blockMin = (float*)malloc(sizeof(float) * (index->blockCount ? index->blockCount : 1));
+     index->blockMax = (float*)malloc(sizeof(float) * (index->blockCount ? index->blockCount : 1));
+     if (index->blockMin == NULL || index->blockMax == NULL) { return -1; }
+     for (size_t b = 0; b < index->blockCount; ++b) {
+         size_t first = b * FPSR_VALUE_INDEX_BLOCK;
+         size_t last = (first + FPSR_VALUE_INDEX_BLOCK < index->count) ? first + FPSR_VALUE_INDEX_BLOCK : index->count;
+         float lo = index->value[first], hi = index->value[first];
+         for (size_t i = first + 1; i < last; ++i) {
+             if (index->value[i] < lo) { lo = index->value[i]; }
+             if (index->value[i] > hi) { hi = index->value[i]; }
+         }
+         index->blockMin[b] = lo;
+         index->blockMax[b] = hi;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Tabulates the runs of an SM channel over [startFrame, endFrame] for value queries.
+  * @details Memory is 8 bytes per run plus 8 bytes per FPSR_VALUE_INDEX_BLOCK runs.
+  * @param index The index to build; release it with fpsr_value_index_free().
+  * @param params The channel's parameters; they are copied.
+  * @param startFrame The first frame to index.
+  * @param endFrame The last frame to index (inclusive).
+  * @return 0 on success, -1 if the range is empty or memory ran out.
+  */
+ int fpsr_sm_index_build(fpsr_value_index* index, const fpsr_sm_params* params, int startFrame, int endFrame)
+ {
+     if (index == NULL) { return -1; }
+     memset(index, 0, sizeof(*index));
+     if (params == NULL || startFrame > endFrame) { return -1; }
+
+     index->kind = FPSR_CURVE_SM;
+     index->sm = *params;
+     index->startFrame = startFrame;
+     index->endFrame = endFrame;
+
+     size_t capacity = 0;
+     fpsr_sm_segment_iter it;
+     fpsr_sm_segment seg;
+     fpsr_sm_segments_begin(&it, startFrame, endFrame, params->minHold, params->maxHold, params->reseedInterval, params->seedInner, params->seedOuter);
+     while (fpsr_sm_segments_next(&it, &seg)) {
+         if (fpsr_value_index_push(index, &capacity, seg.startFrame, seg.value) != 0) {
+             fpsr_value_index_free(index);
+             return -1;
+         }
+     }
+     if (fpsr_value_index_finish(index) != 0) {
+         fpsr_value_index_free(index);
+         return -1;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief fpsr_sm_index_build() for a QS channel.
+  * @param index The index to build; release it with fpsr_value_index_free().
+  * @param plan A plan built by fpsr_qs_plan_init(); it is copied.
+  * @param startFrame, endFrame As for fpsr_sm_index_build().
+  * @return 0 on success, -1 if the range is empty or memory ran out.
+  */
+ int fpsr_qs_index_build(fpsr_value_index* index, const fpsr_qs_plan* plan, int startFrame, int endFrame)
+ {
+     if (index == NULL) { return -1; }
+     memset(index, 0, sizeof(*index));
+     if (plan == NULL || startFrame > endFrame) { return -1; }
+
+     index->kind = FPSR_CURVE_QS;
+     index->qs = *plan;
+     index->startFrame = startFrame;
+     index->endFrame = endFrame;
+
+     size_t capacity = 0;
+     long long frame = startFrame;
+     while (frame <= endFrame) {
+         if (fpsr_value_index_push(index, &capacity, frame, fpsr_qs_eval(plan, (int)frame)) != 0) {
+             fpsr_value_index_free(index);
+             return -1;
+         }
+         frame = (frame < INT_MAX) ? fpsr_qs_plan_next_change(plan, (int)frame) : (long long)INT_MAX + 1;
+     }
+     if (fpsr_value_index_finish(index) != 0) {
+         fpsr_value_index_free(index);
+         return -1;
+     }
+     return 0;
+ }
+
+ void fpsr_value_index_free(fpsr_value_index* index)
+ {
+     if (index == NULL) { return; }
+     free(index->runStart);
+     free(index->value);
+     free(index->blockMin);
+     free(index->blockMax);
+     memset(index, 0, sizeof(*index));
+ }
+
+ // Whether no run, every run or only some runs of a block with values in [lo, hi] can match.
+ typedef enum fpsr_block_match { FPSR_BLOCK_NONE, FPSR_BLOCK_ALL, FPSR_BLOCK_SOME } fpsr_block_match;
+
+ static fpsr_block_match fpsr_query_block(fpsr_query_op op, float threshold, float lo, float hi)
+ {
+     if (fpsr_query_match(op, threshold, lo) && fpsr_query_match(op, threshold, hi)) {
+         // Every op but NOT_EQUAL holds over an interval of values, so both ends passing covers the block.
+         if (op != FPSR_QUERY_NOT_EQUAL || threshold < lo || threshold > hi) { return FPSR_BLOCK_ALL; }
+         return FPSR_BLOCK_SOME;
+     }
+     switch (op) {
+     case FPSR_QUERY_LESS: return (lo < threshold) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     case FPSR_QUERY_LESS_EQUAL: return (lo <= threshold) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     case FPSR_QUERY_EQUAL: return (lo <= threshold && threshold <= hi) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     case FPSR_QUERY_NOT_EQUAL: return (lo != hi) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     case FPSR_QUERY_GREATER_EQUAL: return (hi >= threshold) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     case FPSR_QUERY_GREATER: return (hi > threshold) ? FPSR_BLOCK_SOME : FPSR_BLOCK_NONE;
+     }
+     return FPSR_BLOCK_SOME;
+ }
+
+ // Last frame of run i.
+ static long long fpsr_value_index_run_end(const fpsr_value_index* index, size_t i)
+ {
+     return (i + 1 < index->count) ? (long long)index->runStart[i + 1] - 1 : index->endFrame;
+ }
+
+ // Index of the run covering `frame`, which lies inside the indexed range.
+ static size_t fpsr_value_index_find(const fpsr_value_index* index, int frame)
+ {
+     size_t lo = 0, hi = index->count; // runStart[lo] <= frame < runStart[hi]
+     while (hi - lo > 1) {
+         size_t mid = lo + (hi - lo) / 2;
+         if (index->runStart[mid] <= frame) { lo = mid; } else { hi = mid; }
+     }
+     return lo;
+ }
+
+ // Frames [startFrame, endFrame] of an unindexed part of the range, from the channel itself.
+ static void fpsr_value_index_query_direct(
+     fpsr_interval_sink* sink, const fpsr_value_index* index, long long startFrame, long long endFrame,
+     fpsr_query_op op, float threshold)
+ {
+     if (startFrame > endFrame) { return; }
+     if (index->kind == FPSR_CURVE_SM) {
+         fpsr_sm_query_runs(sink, &index->sm, (int)startFrame, (int)endFrame, op, threshold);
+     } else {
+         fpsr_qs_query_runs(sink, &index->qs, (int)startFrame, (int)endFrame, op, threshold);
+     }
+ }
+
+ /**
+  * @brief Answers a value query from an index.
+  * @details Inside the indexed range, whole blocks of FPSR_VALUE_INDEX_BLOCK
+  * runs are skipped or taken from their minimum and maximum, and only blocks
+  * that straddle the threshold are scanned. Parts of the query range outside
+  * the indexed range are answered as fpsr_sm_query_value() /
+  * fpsr_qs_query_value() would. The result is identical to theirs.
+  *
+  * @param index An index built by fpsr_sm_index_build() or fpsr_qs_index_build().
+  * @param startFrame, endFrame, op, threshold, out, capacity As for fpsr_sm_query_value().
+  * @return The number of matching intervals, which may exceed capacity.
+  */
+ size_t fpsr_value_index_query(
+     const fpsr_value_index* index, int startFrame, int endFrame,
+     fpsr_query_op op, float threshold, fpsr_frame_interval* out, size_t capacity)
+ {
+     fpsr_interval_sink sink;
+     fpsr_sink_init(&sink, out, capacity);
+     if (index == NULL || index->count == 0 || startFrame > endFrame) { return 0; }
+
+     // --- 1. Before the indexed range ---
+     long long first = startFrame, last = endFrame;
+     fpsr_value_index_query_direct(&sink, index, first, (last < index->startFrame) ? last : (long long)index->startFrame - 1, op, threshold);
+
+     // --- 2. Inside it: whole blocks where possible, runs where they straddle the threshold ---
+     long long lo = (first > index->startFrame) ? first : index->startFrame;
+     long long hi = (last < index->endFrame) ? last : index->endFrame;
+     if (lo <= hi) {
+         size_t i = fpsr_value_index_find(index, (int)lo);
+         while (i < index->count && index->runStart[i] <= hi) {
+             if (i % FPSR_VALUE_INDEX_BLOCK == 0) {
+                 size_t blockLast = ((i + FPSR_VALUE_INDEX_BLOCK < index->count) ? i + FPSR_VALUE_INDEX_BLOCK : index->count) - 1;
+                 long long blockEnd = fpsr_value_index_run_end(index, blockLast);
+                 size_t b = i / FPSR_VALUE_INDEX_BLOCK;
+                 fpsr_block_match match = (blockEnd <= hi)
+                     ? fpsr_query_block(op, threshold, index->blockMin[b], index->blockMax[b]) : FPSR_BLOCK_SOME;
+                 if (match != FPSR_BLOCK_SOME) {
+                     if (match == FPSR_BLOCK_ALL) {
+                         fpsr_sink_add(&sink, (index->runStart[i] > lo) ? index->runStart[i] : lo, blockEnd);
+                     }
+                     i = blockLast + 1;
+                     continue;
+                 }
+             }
+             if (fpsr_query_match(op, threshold, index->value[i])) {
+                 long long runEnd = fpsr_value_index_run_end(index, i);
+                 fpsr_sink_add(&sink, (index->runStart[i] > lo) ? index->runStart[i] : lo, (runEnd < hi) ? runEnd : hi);
+             }
+             ++i;
+         }
+     }
+
+     // --- 3. After it ---
+     fpsr_value_index_query_direct(&sink, index, (first > index->endFrame) ? first : (long long)index->endFrame + 1, last, op, threshold);
+     return sink.count;
+ }
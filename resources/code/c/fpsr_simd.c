@@ -0,0 +1,843 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_simd.c
+ * @brief Vectorised kernels for FPS-R (AVX2, AVX-512 and NEON) with runtime CPU dispatch.
+ * @details portable_rand() is frac(sin(seed * 12.9898) * 43758.5453), evaluated in
+ * double precision. The kernels here replace the libm sin() with an inline
+ * range reduction and polynomial so that 8 (AVX2 / NEON) or 16 (AVX-512) seeds
+ * are hashed per loop iteration.
+ *
+ * Two modes are offered:
+ *  - FPSR_RAND_EXACT: bit-identical to the scalar portable_rand(). The vector
+ *    sin() is accurate to about 1e-15, so the only way it can disagree with
+ *    libm is when the pre-frac product lands within a hair of a float rounding
+ *    boundary. Those lanes are detected and recomputed with the scalar
+ *    reference, which makes the result identical to portable_rand() on any libm
+ *    whose sin() is accurate to 1 ulp (glibc, musl, Apple, MSVC CRT).
+ *  - FPSR_RAND_APPROX: a shorter reduction and polynomial, no fallback.
+ *    The sin() error is below 2e-9, so the pre-frac product is within 1e-4 of
+ *    the reference and the output is within 2^-7 of portable_rand() measured
+ *    as circular distance on [0, 1) (the value may wrap from ~1.0 to ~0.0 when
+ *    the product straddles an integer). All ISAs, including the scalar
+ *    fallback, use the same fused operations in the same order, so APPROX
+ *    output is itself deterministic across machines.
+ *
+ * fpsr_qs_eval_soa() also runs QS's stream sine on the vector sin(). Its
+ * floor() quantisation cannot tolerate any error, so lanes that land near a
+ * quantisation step are always recomputed with libm, in either mode.
+ */
+
+ #include <math.h> // For sin(), floor(), fma() and rint()
+ #include <stdatomic.h>
+ #include <stdio.h> // For NULL
+ #include "fpsr_algorithms.h"
+
+ #if defined(__x86_64__) || defined(__i386__)
+ #if defined(__GNUC__) || defined(__clang__)
+ #define FPSR_SIMD_X86 1
+ #include <immintrin.h>
+ #endif
+ #elif defined(__aarch64__) && defined(__ARM_NEON)
+ #define FPSR_SIMD_NEON 1
+ #include <arm_neon.h>
+ #endif
+
+ // Constants of the portable_rand() hash.
+ #define FPSR_RAND_SCALE 12.9898
+ #define FPSR_RAND_AMP 43758.5453
+
+ // Cody-Waite split of pi/2 (fdlibm pio2_1 / pio2_2 / pio2_3) and 2/pi.
+ #define FPSR_PIO2_1 1.57079632673412561417e+00
+ #define FPSR_PIO2_2 6.07710050630396597660e-11
+ #define FPSR_PIO2_3 2.02226624871116645580e-21
+ #define FPSR_INVPIO2 6.36619772367581382433e-01
+
+ // Minimax coefficients for sin/cos on [-pi/4, pi/4] (fdlibm __kernel_sin / __kernel_cos).
+ #define FPSR_S1 -1.66666666666666324348e-01
+ #define FPSR_S2 8.33333333332248946124e-03
+ #define FPSR_S3 -1.98412698298579493134e-04
+ #define FPSR_S4 2.75573137070700676789e-06
+ #define FPSR_S5 -2.50507602534068634195e-08
+ #define FPSR_S6 1.58969099521155010221e-10
+ #define FPSR_C1 4.16666666666666019037e-02
+ #define FPSR_C2 -1.38888888888741095749e-03
+ #define FPSR_C3 2.48015872894767294178e-05
+ #define FPSR_C4 -2.75573143513906633035e-07
+ #define FPSR_C5 2.08757232129817482790e-09
+ #define FPSR_C6 -1.13596475577881948265e-11
+
+ // Lanes whose pre-frac product lies within this distance of a float rounding
+ // boundary are recomputed with the scalar reference in FPSR_RAND_EXACT mode.
+ // The band is |p| * REL + ABS, ~20x the worst combined error of the vector
+ // sin() and a 1 ulp libm sin().
+ #define FPSR_EXACT_GUARD_REL 0x1p-36
+ #define FPSR_EXACT_GUARD_ABS 0x1p-30
+
+ // QS stream lanes whose sin() * level lies within level * QS_GUARD_REL of an
+ // integer, where floor() could go either way, are recomputed with libm sin(),
+ // as are arguments outside the range the vector reduction is accurate for.
+ #define FPSR_QS_GUARD_REL 0x1p-40
+ #define FPSR_SIMD_SIN_LIMIT 0x1p36
+
+ // a + b with 32-bit wraparound, as fpsr_algorithms.c sums seeds and offsets with frames.
+ static inline int fpsr_wrap_add(int a, int b)
+ {
+     return (int)((unsigned)a + (unsigned)b);
+ }
+
+
+ /******************************************************************************/
+ /* Scalar model of the vector kernels                                         */
+ /******************************************************************************/
+
+ /**
+  * @brief Scalar version of the vector sin() used by every kernel in this file.
+  * @details Mirrors the vector code operation for operation (same fma() calls
+  * in the same order), so tails and the scalar fallback agree with the SIMD
+  * lanes bit for bit.
+  *
+  * @param x The argument, |x| < 2^36.
+  * @param accurate Non-zero for the 3-part reduction and full polynomials (EXACT),
+  * zero for the 2-part reduction and short polynomials (APPROX).
+  * @return sin(x).
+  */
+ static double fpsr_simd_sin(double x, int accurate)
+ {
+     double k = rint(x * FPSR_INVPIO2);
+     double r = fma(-k, FPSR_PIO2_1, x);
+     r = fma(-k, FPSR_PIO2_2, r);
+     if (accurate) { r = fma(-k, FPSR_PIO2_3, r); }
+     double z = r * r;
+
+     double ps, pc;
+     if (accurate) {
+         ps = fma(z, FPSR_S6, FPSR_S5);
+         ps = fma(z, ps, FPSR_S4);
+         ps = fma(z, ps, FPSR_S3);
+         ps = fma(z, ps, FPSR_S2);
+         pc = fma(z, FPSR_C6, FPSR_C5);
+         pc = fma(z, pc, FPSR_C4);
+         pc = fma(z, pc, FPSR_C3);
+         pc = fma(z, pc, FPSR_C2);
+     } else {
+         ps = fma(z, FPSR_S4, FPSR_S3);
+         ps = fma(z, ps, FPSR_S2);
+         pc = fma(z, FPSR_C4, FPSR_C3);
+         pc = fma(z, pc, FPSR_C2);
+     }
+     ps = fma(z, ps, FPSR_S1);
+     pc = fma(z, pc, FPSR_C1);
+     double s = fma(r * z, ps, r);
+     double c = fma(z * z, pc, fma(z, -0.5, 1.0));
+
+     // Quadrant 0: sin, 1: cos, 2: -sin, 3: -cos.
+     double q = k - 4.0 * floor(k * 0.25);
+     double v = (q == 1.0 || q == 3.0) ? c : s;
+     return (q >= 2.0) ? -v : v;
+ }
+
+ // portable_rand() built on fpsr_simd_sin(); the FPSR_ISA_SCALAR APPROX path and the vector tails.
+ static float fpsr_simd_rand_scalar(int seed, int accurate)
+ {
+     float result = (float)(fpsr_simd_sin((double)(float)seed * FPSR_RAND_SCALE, accurate) * FPSR_RAND_AMP);
+     return result - floorf(result);
+ }
+
+ static void fpsr_rand_batch_scalar(const int* seeds, float* out, size_t n, fpsr_rand_mode mode)
+ {
+     if (mode == FPSR_RAND_EXACT) {
+         for (size_t i = 0; i < n; ++i) { out[i] = portable_rand(seeds[i]); }
+     } else {
+         for (size_t i = 0; i < n; ++i) { out[i] = fpsr_simd_rand_scalar(seeds[i], 0); }
+     }
+ }
+
+ // The seed fpsr_qs() hashes for a stream argument and quantisation level; steps 3 and 5 of fpsr_qs().
+ static inline int fpsr_qs_stream_seed(float arg, int level)
+ {
+     float active_stream_val = floor(sin(arg) * level) / level;
+     return (int)(active_stream_val * 100000.0);
+ }
+
+ static void fpsr_qs_stream_batch_scalar(const float* args, const int* levels, int* seeds, size_t n)
+ {
+     for (size_t i = 0; i < n; ++i) { seeds[i] = fpsr_qs_stream_seed(args[i], levels[i]); }
+ }
+
+
+ /******************************************************************************/
+ /* x86: AVX2 + FMA (8 seeds per iteration) and AVX-512 (16 seeds)             */
+ /******************************************************************************/
+
+ #if defined(FPSR_SIMD_X86)
+
+ /**
+  * @brief The vector sin() of fpsr_simd_sin() for 4 doubles.
+  * @details One 256-bit half of the 8-wide AVX2 kernels.
+  */
+ __attribute__((target("avx2,fma")))
+ static inline __m256d fpsr_avx2_sin(__m256d x, int accurate)
+ {
+     __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(FPSR_INVPIO2)),
+                                 _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+     __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(FPSR_PIO2_1), x);
+     r = _mm256_fnmadd_pd(k, _mm256_set1_pd(FPSR_PIO2_2), r);
+     if (accurate) { r = _mm256_fnmadd_pd(k, _mm256_set1_pd(FPSR_PIO2_3), r); }
+     __m256d z = _mm256_mul_pd(r, r);
+
+     __m256d ps, pc;
+     if (accurate) {
+         ps = _mm256_fmadd_pd(z, _mm256_set1_pd(FPSR_S6), _mm256_set1_pd(FPSR_S5));
+         ps = _mm256_fmadd_pd(z, ps, _mm256_set1_pd(FPSR_S4));
+         ps = _mm256_fmadd_pd(z, ps, _mm256_set1_pd(FPSR_S3));
+         ps = _mm256_fmadd_pd(z, ps, _mm256_set1_pd(FPSR_S2));
+         pc = _mm256_fmadd_pd(z, _mm256_set1_pd(FPSR_C6), _mm256_set1_pd(FPSR_C5));
+         pc = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(FPSR_C4));
+         pc = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(FPSR_C3));
+         pc = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(FPSR_C2));
+     } else {
+         ps = _mm256_fmadd_pd(z, _mm256_set1_pd(FPSR_S4), _mm256_set1_pd(FPSR_S3));
+         ps = _mm256_fmadd_pd(z, ps, _mm256_set1_pd(FPSR_S2));
+         pc = _mm256_fmadd_pd(z, _mm256_set1_pd(FPSR_C4), _mm256_set1_pd(FPSR_C3));
+         pc = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(FPSR_C2));
+     }
+     ps = _mm256_fmadd_pd(z, ps, _mm256_set1_pd(FPSR_S1));
+     pc = _mm256_fmadd_pd(z, pc, _mm256_set1_pd(FPSR_C1));
+     __m256d s = _mm256_fmadd_pd(_mm256_mul_pd(r, z), ps, r);
+     __m256d c = _mm256_fmadd_pd(_mm256_mul_pd(z, z), pc,
+                                 _mm256_fmadd_pd(z, _mm256_set1_pd(-0.5), _mm256_set1_pd(1.0)));
+
+     __m256d q = _mm256_sub_pd(k, _mm256_mul_pd(_mm256_set1_pd(4.0),
+                                 _mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.25)))));
+     __m256d odd = _mm256_or_pd(_mm256_cmp_pd(q, _mm256_set1_pd(1.0), _CMP_EQ_OQ),
+                                _mm256_cmp_pd(q, _mm256_set1_pd(3.0), _CMP_EQ_OQ));
+     __m256d neg = _mm256_and_pd(_mm256_cmp_pd(q, _mm256_set1_pd(2.0), _CMP_GE_OQ),
+                                 _mm256_set1_pd(-0.0));
+     return _mm256_xor_pd(_mm256_blendv_pd(s, c, odd), neg);
+ }
+
+ // Hashes 4 seeds (already widened to double) and returns the pre-frac products.
+ __attribute__((target("avx2,fma")))
+ static inline __m256d fpsr_avx2_product(__m256d x, int accurate)
+ {
+     return _mm256_mul_pd(fpsr_avx2_sin(x, accurate), _mm256_set1_pd(FPSR_RAND_AMP));
+ }
+
+ // Returns a 4-bit mask of lanes whose product is too close to a float rounding boundary.
+ __attribute__((target("avx2,fma")))
+ static inline int fpsr_avx2_unsafe(__m256d p)
+ {
+     __m256d absp = _mm256_andnot_pd(_mm256_set1_pd(-0.0), p);
+     __m256d g = _mm256_fmadd_pd(absp, _mm256_set1_pd(FPSR_EXACT_GUARD_REL), _mm256_set1_pd(FPSR_EXACT_GUARD_ABS));
+     __m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(p, g));
+     __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(p, g));
+     return 0xF & ~_mm_movemask_ps(_mm_cmpeq_ps(lo, hi));
+ }
+
+ __attribute__((target("avx2,fma")))
+ static void fpsr_rand_batch_avx2(const int* seeds, float* out, size_t n, fpsr_rand_mode mode)
+ {
+     const int accurate = (mode == FPSR_RAND_EXACT);
+     size_t i = 0;
+     for (; i + 8 <= n; i += 8) {
+         __m256 seedf = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(seeds + i)));
+         __m256d x0 = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(seedf)), _mm256_set1_pd(FPSR_RAND_SCALE));
+         __m256d x1 = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(seedf, 1)), _mm256_set1_pd(FPSR_RAND_SCALE));
+         __m256d p0 = fpsr_avx2_product(x0, accurate);
+         __m256d p1 = fpsr_avx2_product(x1, accurate);
+         __m256 result = _mm256_set_m128(_mm256_cvtpd_ps(p1), _mm256_cvtpd_ps(p0));
+         _mm256_storeu_ps(out + i, _mm256_sub_ps(result, _mm256_floor_ps(result)));
+
+         if (accurate) {
+             int unsafe = fpsr_avx2_unsafe(p0) | (fpsr_avx2_unsafe(p1) << 4);
+             while (unsafe) {
+                 int lane = __builtin_ctz(unsafe);
+                 out[i + lane] = portable_rand(seeds[i + lane]);
+                 unsafe &= unsafe - 1;
+             }
+         }
+     }
+     fpsr_rand_batch_scalar(seeds + i, out + i, n - i, mode);
+ }
+
+ /**
+  * @brief fpsr_qs_stream_seed() for 4 lanes, plus a mask of lanes to recompute.
+  * @details Only sin() differs from the scalar code: floor(), the division by
+  * the level and the float and int conversions round exactly as in fpsr_qs().
+  */
+ __attribute__((target("avx2,fma")))
+ static inline __m128i fpsr_avx2_qs_seeds(__m128 arg, __m128i level, int* unsafe)
+ {
+     __m256d x = _mm256_cvtps_pd(arg);
+     __m256d lv = _mm256_cvtepi32_pd(level);
+     __m256d y = _mm256_mul_pd(fpsr_avx2_sin(x, 1), lv);
+     __m128 active = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_floor_pd(y), lv));
+     __m128i seeds = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(active), _mm256_set1_pd(100000.0)));
+
+     __m256d sign = _mm256_set1_pd(-0.0);
+     __m256d dist = _mm256_andnot_pd(sign, _mm256_sub_pd(y, _mm256_round_pd(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+     __m256d near = _mm256_cmp_pd(dist, _mm256_mul_pd(lv, _mm256_set1_pd(FPSR_QS_GUARD_REL)), _CMP_LE_OQ);
+     __m256d wide = _mm256_cmp_pd(_mm256_andnot_pd(sign, x), _mm256_set1_pd(FPSR_SIMD_SIN_LIMIT), _CMP_NLT_UQ);
+     *unsafe = _mm256_movemask_pd(_mm256_or_pd(near, wide));
+     return seeds;
+ }
+
+ __attribute__((target("avx2,fma")))
+ static void fpsr_qs_stream_batch_avx2(const float* args, const int* levels, int* seeds, size_t n)
+ {
+     size_t i = 0;
+     for (; i + 8 <= n; i += 8) {
+         __m256 a = _mm256_loadu_ps(args + i);
+         __m256i l = _mm256_loadu_si256((const __m256i*)(levels + i));
+         int u0, u1;
+         __m128i s0 = fpsr_avx2_qs_seeds(_mm256_castps256_ps128(a), _mm256_castsi256_si128(l), &u0);
+         __m128i s1 = fpsr_avx2_qs_seeds(_mm256_extractf128_ps(a, 1), _mm256_extracti128_si256(l, 1), &u1);
+         _mm256_storeu_si256((__m256i*)(seeds + i), _mm256_set_m128i(s1, s0));
+
+         int unsafe = u0 | (u1 << 4);
+         while (unsafe) {
+             int lane = __builtin_ctz(unsafe);
+             seeds[i + lane] = fpsr_qs_stream_seed(args[i + lane], levels[i + lane]);
+             unsafe &= unsafe - 1;
+         }
+     }
+     fpsr_qs_stream_batch_scalar(args + i, levels + i, seeds + i, n - i);
+ }
+
+ // AVX-512 counterpart of fpsr_avx2_sin() for 8 doubles.
+ __attribute__((target("avx512f")))
+ static inline __m512d fpsr_avx512_sin(__m512d x, int accurate)
+ {
+     __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(FPSR_INVPIO2)),
+                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+     __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(FPSR_PIO2_1), x);
+     r = _mm512_fnmadd_pd(k, _mm512_set1_pd(FPSR_PIO2_2), r);
+     if (accurate) { r = _mm512_fnmadd_pd(k, _mm512_set1_pd(FPSR_PIO2_3), r); }
+     __m512d z = _mm512_mul_pd(r, r);
+
+     __m512d ps, pc;
+     if (accurate) {
+         ps = _mm512_fmadd_pd(z, _mm512_set1_pd(FPSR_S6), _mm512_set1_pd(FPSR_S5));
+         ps = _mm512_fmadd_pd(z, ps, _mm512_set1_pd(FPSR_S4));
+         ps = _mm512_fmadd_pd(z, ps, _mm512_set1_pd(FPSR_S3));
+         ps = _mm512_fmadd_pd(z, ps, _mm512_set1_pd(FPSR_S2));
+         pc = _mm512_fmadd_pd(z, _mm512_set1_pd(FPSR_C6), _mm512_set1_pd(FPSR_C5));
+         pc = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(FPSR_C4));
+         pc = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(FPSR_C3));
+         pc = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(FPSR_C2));
+     } else {
+         ps = _mm512_fmadd_pd(z, _mm512_set1_pd(FPSR_S4), _mm512_set1_pd(FPSR_S3));
+         ps = _mm512_fmadd_pd(z, ps, _mm512_set1_pd(FPSR_S2));
+         pc = _mm512_fmadd_pd(z, _mm512_set1_pd(FPSR_C4), _mm512_set1_pd(FPSR_C3));
+         pc = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(FPSR_C2));
+     }
+     ps = _mm512_fmadd_pd(z, ps, _mm512_set1_pd(FPSR_S1));
+     pc = _mm512_fmadd_pd(z, pc, _mm512_set1_pd(FPSR_C1));
+     __m512d s = _mm512_fmadd_pd(_mm512_mul_pd(r, z), ps, r);
+     __m512d c = _mm512_fmadd_pd(_mm512_mul_pd(z, z), pc,
+                                 _mm512_fmadd_pd(z, _mm512_set1_pd(-0.5), _mm512_set1_pd(1.0)));
+
+     __m512d q = _mm512_sub_pd(k, _mm512_mul_pd(_mm512_set1_pd(4.0),
+                                 _mm512_roundscale_pd(_mm512_mul_pd(k, _mm512_set1_pd(0.25)),
+                                                      _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+     __mmask8 odd = _mm512_cmp_pd_mask(q, _mm512_set1_pd(1.0), _CMP_EQ_OQ)
+                  | _mm512_cmp_pd_mask(q, _mm512_set1_pd(3.0), _CMP_EQ_OQ);
+     __mmask8 neg = _mm512_cmp_pd_mask(q, _mm512_set1_pd(2.0), _CMP_GE_OQ);
+     __m512d v = _mm512_mask_blend_pd(odd, s, c);
+     return _mm512_mask_sub_pd(v, neg, _mm512_setzero_pd(), v);
+ }
+
+ // AVX-512 counterpart of fpsr_avx2_product() for 8 doubles.
+ __attribute__((target("avx512f")))
+ static inline __m512d fpsr_avx512_product(__m512d x, int accurate)
+ {
+     return _mm512_mul_pd(fpsr_avx512_sin(x, accurate), _mm512_set1_pd(FPSR_RAND_AMP));
+ }
+
+ // Returns an 8-bit mask of lanes whose product is too close to a float rounding boundary.
+ __attribute__((target("avx512f")))
+ static inline int fpsr_avx512_unsafe(__m512d p)
+ {
+     __m512d g = _mm512_fmadd_pd(_mm512_abs_pd(p), _mm512_set1_pd(FPSR_EXACT_GUARD_REL), _mm512_set1_pd(FPSR_EXACT_GUARD_ABS));
+     __m256 lo = _mm512_cvtpd_ps(_mm512_sub_pd(p, g));
+     __m256 hi = _mm512_cvtpd_ps(_mm512_add_pd(p, g));
+     __m512 lo512 = _mm512_castps256_ps512(lo);
+     __m512 hi512 = _mm512_castps256_ps512(hi);
+     return (int)(_mm512_cmp_ps_mask(lo512, hi512, _CMP_NEQ_UQ) & 0xFF);
+ }
+
+ __attribute__((target("avx512f")))
+ static void fpsr_rand_batch_avx512(const int* seeds, float* out, size_t n, fpsr_rand_mode mode)
+ {
+     const int accurate = (mode == FPSR_RAND_EXACT);
+     size_t i = 0;
+     for (; i + 16 <= n; i += 16) {
+         __m512 seedf = _mm512_cvtepi32_ps(_mm512_loadu_si512((const void*)(seeds + i)));
+         __m512d x0 = _mm512_mul_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(seedf)), _mm512_set1_pd(FPSR_RAND_SCALE));
+         __m512d x1 = _mm512_mul_pd(_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(seedf), 1))),
+                                    _mm512_set1_pd(FPSR_RAND_SCALE));
+         __m512d p0 = fpsr_avx512_product(x0, accurate);
+         __m512d p1 = fpsr_avx512_product(x1, accurate);
+         __m512 result = _mm512_castpd_ps(_mm512_insertf64x4(
+             _mm512_castpd256_pd512(_mm256_castps_pd(_mm512_cvtpd_ps(p0))),
+             _mm256_castps_pd(_mm512_cvtpd_ps(p1)), 1));
+         __m512 fl = _mm512_roundscale_ps(result, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+         _mm512_storeu_ps(out + i, _mm512_sub_ps(result, fl));
+
+         if (accurate) {
+             int unsafe = fpsr_avx512_unsafe(p0) | (fpsr_avx512_unsafe(p1) << 8);
+             while (unsafe) {
+                 int lane = __builtin_ctz(unsafe);
+                 out[i + lane] = portable_rand(seeds[i + lane]);
+                 unsafe &= unsafe - 1;
+             }
+         }
+     }
+     fpsr_rand_batch_scalar(seeds + i, out + i, n - i, mode);
+ }
+
+ // AVX-512 counterpart of fpsr_avx2_qs_seeds() for 8 lanes.
+ __attribute__((target("avx512f")))
+ static inline __m256i fpsr_avx512_qs_seeds(__m256 arg, __m256i level, int* unsafe)
+ {
+     __m512d x = _mm512_cvtps_pd(arg);
+     __m512d lv = _mm512_cvtepi32_pd(level);
+     __m512d y = _mm512_mul_pd(fpsr_avx512_sin(x, 1), lv);
+     __m512d fl = _mm512_roundscale_pd(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+     __m256 active = _mm512_cvtpd_ps(_mm512_div_pd(fl, lv));
+     __m256i seeds = _mm512_cvttpd_epi32(_mm512_mul_pd(_mm512_cvtps_pd(active), _mm512_set1_pd(100000.0)));
+
+     __m512d dist = _mm512_abs_pd(_mm512_sub_pd(y, _mm512_roundscale_pd(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+     __mmask8 near = _mm512_cmp_pd_mask(dist, _mm512_mul_pd(lv, _mm512_set1_pd(FPSR_QS_GUARD_REL)), _CMP_LE_OQ);
+     __mmask8 wide = _mm512_cmp_pd_mask(_mm512_abs_pd(x), _mm512_set1_pd(FPSR_SIMD_SIN_LIMIT), _CMP_NLT_UQ);
+     *unsafe = (int)(near | wide);
+     return seeds;
+ }
+
+ __attribute__((target("avx512f")))
+ static void fpsr_qs_stream_batch_avx512(const float* args, const int* levels, int* seeds, size_t n)
+ {
+     size_t i = 0;
+     for (; i + 16 <= n; i += 16) {
+         __m512 a = _mm512_loadu_ps(args + i);
+         __m512i l = _mm512_loadu_si512((const void*)(levels + i));
+         int u0, u1;
+         __m256i s0 = fpsr_avx512_qs_seeds(_mm512_castps512_ps256(a), _mm512_castsi512_si256(l), &u0);
+         __m256i s1 = fpsr_avx512_qs_seeds(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)),
+                                           _mm512_extracti64x4_epi64(l, 1), &u1);
+         _mm256_storeu_si256((__m256i*)(seeds + i), s0);
+         _mm256_storeu_si256((__m256i*)(seeds + i + 8), s1);
+
+         int unsafe = u0 | (u1 << 8);
+         while (unsafe) {
+             int lane = __builtin_ctz(unsafe);
+             seeds[i + lane] = fpsr_qs_stream_seed(args[i + lane], levels[i + lane]);
+             unsafe &= unsafe - 1;
+         }
+     }
+     fpsr_qs_stream_batch_scalar(args + i, levels + i, seeds + i, n - i);
+ }
+
+ #endif // FPSR_SIMD_X86
+
+
+ /******************************************************************************/
+ /* AArch64: NEON (8 seeds per iteration)                                      */
+ /******************************************************************************/
+
+ #if defined(FPSR_SIMD_NEON)
+
+ // NEON counterpart of fpsr_avx2_sin() for 2 doubles.
+ static inline float64x2_t fpsr_neon_sin(float64x2_t x, int accurate)
+ {
+     float64x2_t k = vrndnq_f64(vmulq_n_f64(x, FPSR_INVPIO2));
+     float64x2_t r = vfmsq_f64(x, k, vdupq_n_f64(FPSR_PIO2_1));
+     r = vfmsq_f64(r, k, vdupq_n_f64(FPSR_PIO2_2));
+     if (accurate) { r = vfmsq_f64(r, k, vdupq_n_f64(FPSR_PIO2_3)); }
+     float64x2_t z = vmulq_f64(r, r);
+
+     float64x2_t ps, pc;
+     if (accurate) {
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S5), z, vdupq_n_f64(FPSR_S6));
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S4), z, ps);
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S3), z, ps);
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S2), z, ps);
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C5), z, vdupq_n_f64(FPSR_C6));
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C4), z, pc);
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C3), z, pc);
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C2), z, pc);
+     } else {
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S3), z, vdupq_n_f64(FPSR_S4));
+         ps = vfmaq_f64(vdupq_n_f64(FPSR_S2), z, ps);
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C3), z, vdupq_n_f64(FPSR_C4));
+         pc = vfmaq_f64(vdupq_n_f64(FPSR_C2), z, pc);
+     }
+     ps = vfmaq_f64(vdupq_n_f64(FPSR_S1), z, ps);
+     pc = vfmaq_f64(vdupq_n_f64(FPSR_C1), z, pc);
+     float64x2_t s = vfmaq_f64(r, vmulq_f64(r, z), ps);
+     float64x2_t c = vfmaq_f64(vfmaq_f64(vdupq_n_f64(1.0), z, vdupq_n_f64(-0.5)), vmulq_f64(z, z), pc);
+
+     float64x2_t q = vsubq_f64(k, vmulq_n_f64(vrndmq_f64(vmulq_n_f64(k, 0.25)), 4.0));
+     uint64x2_t odd = vorrq_u64(vceqq_f64(q, vdupq_n_f64(1.0)), vceqq_f64(q, vdupq_n_f64(3.0)));
+     uint64x2_t neg = vcgeq_f64(q, vdupq_n_f64(2.0));
+     float64x2_t v = vbslq_f64(odd, c, s);
+     return vbslq_f64(neg, vnegq_f64(v), v);
+ }
+
+ // NEON counterpart of fpsr_avx2_product() for 2 doubles.
+ static inline float64x2_t fpsr_neon_product(float64x2_t x, int accurate)
+ {
+     return vmulq_n_f64(fpsr_neon_sin(x, accurate), FPSR_RAND_AMP);
+ }
+
+ // Returns a 2-bit mask of lanes whose product is too close to a float rounding boundary.
+ static inline int fpsr_neon_unsafe(float64x2_t p)
+ {
+     float64x2_t g = vfmaq_f64(vdupq_n_f64(FPSR_EXACT_GUARD_ABS), vabsq_f64(p), vdupq_n_f64(FPSR_EXACT_GUARD_REL));
+     float32x2_t lo = vcvt_f32_f64(vsubq_f64(p, g));
+     float32x2_t hi = vcvt_f32_f64(vaddq_f64(p, g));
+     uint32x2_t same = vceq_f32(lo, hi);
+     return (vget_lane_u32(same, 0) ? 0 : 1) | (vget_lane_u32(same, 1) ? 0 : 2);
+ }
+
+ static void fpsr_rand_batch_neon(const int* seeds, float* out, size_t n, fpsr_rand_mode mode)
+ {
+     const int accurate = (mode == FPSR_RAND_EXACT);
+     size_t i = 0;
+     for (; i + 8 <= n; i += 8) {
+         for (size_t j = 0; j < 8; j += 4) {
+             float32x4_t seedf = vcvtq_f32_s32(vld1q_s32(seeds + i + j));
+             float64x2_t p0 = fpsr_neon_product(vmulq_n_f64(vcvt_f64_f32(vget_low_f32(seedf)), FPSR_RAND_SCALE), accurate);
+             float64x2_t p1 = fpsr_neon_product(vmulq_n_f64(vcvt_high_f64_f32(seedf), FPSR_RAND_SCALE), accurate);
+             float32x4_t result = vcvt_high_f32_f64(vcvt_f32_f64(p0), p1);
+             vst1q_f32(out + i + j, vsubq_f32(result, vrndmq_f32(result)));
+
+             if (accurate) {
+                 int unsafe = fpsr_neon_unsafe(p0) | (fpsr_neon_unsafe(p1) << 2);
+                 while (unsafe) {
+                     int lane = __builtin_ctz(unsafe);
+                     out[i + j + lane] = portable_rand(seeds[i + j + lane]);
+                     unsafe &= unsafe - 1;
+                 }
+             }
+         }
+     }
+     fpsr_rand_batch_scalar(seeds + i, out + i, n - i, mode);
+ }
+
+ // NEON counterpart of fpsr_avx2_qs_seeds() for 2 lanes.
+ static inline int32x2_t fpsr_neon_qs_seeds(float32x2_t arg, int32x2_t level, int* unsafe)
+ {
+     float64x2_t x = vcvt_f64_f32(arg);
+     float64x2_t lv = vcvtq_f64_s64(vmovl_s32(level));
+     float64x2_t y = vmulq_f64(fpsr_neon_sin(x, 1), lv);
+     float64x2_t active = vcvt_f64_f32(vcvt_f32_f64(vdivq_f64(vrndmq_f64(y), lv)));
+     int32x2_t seeds = vmovn_s64(vcvtq_s64_f64(vmulq_n_f64(active, 100000.0)));
+
+     float64x2_t dist = vabsq_f64(vsubq_f64(y, vrndnq_f64(y)));
+     uint64x2_t near = vcleq_f64(dist, vmulq_n_f64(lv, FPSR_QS_GUARD_REL));
+     uint64x2_t wide = veorq_u64(vcaltq_f64(x, vdupq_n_f64(FPSR_SIMD_SIN_LIMIT)), vdupq_n_u64(~0ull));
+     uint64x2_t bad = vorrq_u64(near, wide);
+     *unsafe = (vgetq_lane_u64(bad, 0) ? 1 : 0) | (vgetq_lane_u64(bad, 1) ? 2 : 0);
+     return seeds;
+ }
+
+ static void fpsr_qs_stream_batch_neon(const float* args, const int* levels, int* seeds, size_t n)
+ {
+     size_t i = 0;
+     for (; i + 4 <= n; i += 4) {
+         float32x4_t a = vld1q_f32(args + i);
+         int32x4_t l = vld1q_s32(levels + i);
+         int u0, u1;
+         int32x2_t s0 = fpsr_neon_qs_seeds(vget_low_f32(a), vget_low_s32(l), &u0);
+         int32x2_t s1 = fpsr_neon_qs_seeds(vget_high_f32(a), vget_high_s32(l), &u1);
+         vst1q_s32(seeds + i, vcombine_s32(s0, s1));
+
+         int unsafe = u0 | (u1 << 2);
+         while (unsafe) {
+             int lane = __builtin_ctz(unsafe);
+             seeds[i + lane] = fpsr_qs_stream_seed(args[i + lane], levels[i + lane]);
+             unsafe &= unsafe - 1;
+         }
+     }
+     fpsr_qs_stream_batch_scalar(args + i, levels + i, seeds + i, n - i);
+ }
+
+ #endif // FPSR_SIMD_NEON
+
+
+ /******************************************************************************/
+ /* Runtime dispatch                                                           */
+ /******************************************************************************/
+
+ typedef void (*fpsr_rand_batch_fn)(const int*, float*, size_t, fpsr_rand_mode);
+ typedef void (*fpsr_qs_stream_batch_fn)(const float*, const int*, int*, size_t);
+
+ // The ISA used by the batched kernels; resolved on first use. Concurrent first
+ // calls may all resolve it, but they always store the same value. Relaxed
+ // ordering is enough: the value is the only state it publishes.
+ static _Atomic int fpsr_simd_isa_selected = -1;
+
+ /**
+  * @brief Reports whether this build and CPU can run the given ISA.
+  * @param isa One of the fpsr_simd_isa values.
+  * @return Non-zero when the kernels for that ISA can be used.
+  */
+ int fpsr_simd_isa_supported(fpsr_simd_isa isa)
+ {
+     switch (isa) {
+     case FPSR_ISA_SCALAR:
+         return 1;
+ #if defined(FPSR_SIMD_X86)
+     case FPSR_ISA_AVX2:
+         return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+     case FPSR_ISA_AVX512:
+         return __builtin_cpu_supports("avx512f");
+ #endif
+ #if defined(FPSR_SIMD_NEON)
+     case FPSR_ISA_NEON:
+         return 1;
+ #endif
+     default:
+         return 0;
+     }
+ }
+
+ /**
+  * @brief Returns the ISA that the batched kernels currently dispatch to.
+  * @details On first use the widest supported ISA is selected.
+  */
+ fpsr_simd_isa fpsr_simd_active_isa(void)
+ {
+     int selected = atomic_load_explicit(&fpsr_simd_isa_selected, memory_order_relaxed);
+     if (selected < 0) {
+         fpsr_simd_isa best = FPSR_ISA_SCALAR;
+         if (fpsr_simd_isa_supported(FPSR_ISA_NEON)) { best = FPSR_ISA_NEON; }
+         if (fpsr_simd_isa_supported(FPSR_ISA_AVX2)) { best = FPSR_ISA_AVX2; }
+         if (fpsr_simd_isa_supported(FPSR_ISA_AVX512)) { best = FPSR_ISA_AVX512; }
+         selected = (int)best;
+         atomic_store_explicit(&fpsr_simd_isa_selected, selected, memory_order_relaxed);
+     }
+     return (fpsr_simd_isa)selected;
+ }
+
+ /**
+  * @brief Forces the batched kernels onto a specific ISA, e.g. to benchmark or validate each backend.
+  * @param isa The requested ISA. Unsupported requests fall back to FPSR_ISA_SCALAR.
+  * @return The ISA that is now active.
+  */
+ fpsr_simd_isa fpsr_simd_set_isa(fpsr_simd_isa isa)
+ {
+     int selected = fpsr_simd_isa_supported(isa) ? (int)isa : (int)FPSR_ISA_SCALAR;
+     atomic_store_explicit(&fpsr_simd_isa_selected, selected, memory_order_relaxed);
+     return (fpsr_simd_isa)selected;
+ }
+
+ static fpsr_rand_batch_fn fpsr_rand_batch_resolve(void)
+ {
+     switch (fpsr_simd_active_isa()) {
+ #if defined(FPSR_SIMD_X86)
+     case FPSR_ISA_AVX2: return fpsr_rand_batch_avx2;
+     case FPSR_ISA_AVX512: return fpsr_rand_batch_avx512;
+ #endif
+ #if defined(FPSR_SIMD_NEON)
+     case FPSR_ISA_NEON: return fpsr_rand_batch_neon;
+ #endif
+     default: return fpsr_rand_batch_scalar;
+     }
+ }
+
+ static fpsr_qs_stream_batch_fn fpsr_qs_stream_batch_resolve(void)
+ {
+     switch (fpsr_simd_active_isa()) {
+ #if defined(FPSR_SIMD_X86)
+     case FPSR_ISA_AVX2: return fpsr_qs_stream_batch_avx2;
+     case FPSR_ISA_AVX512: return fpsr_qs_stream_batch_avx512;
+ #endif
+ #if defined(FPSR_SIMD_NEON)
+     case FPSR_ISA_NEON: return fpsr_qs_stream_batch_neon;
+ #endif
+     default: return fpsr_qs_stream_batch_scalar;
+     }
+ }
+
+ /**
+  * @brief Evaluates portable_rand() for an array of seeds using the widest available SIMD ISA.
+  * @details In FPSR_RAND_EXACT mode out[i] == portable_rand(seeds[i]) bit for bit.
+  * In FPSR_RAND_APPROX mode the result is within 2^-7 (circular distance on [0, 1))
+  * of portable_rand(), and identical on every ISA. See the file header for details.
+  *
+  * @param seeds An array of n integer seeds.
+  * @param out A caller-owned array that receives n values in [0, 1).
+  * @param n The number of seeds.
+  * @param mode FPSR_RAND_EXACT or FPSR_RAND_APPROX.
+  */
+ void portable_rand_batch(const int* seeds, float* out, size_t n, fpsr_rand_mode mode)
+ {
+     if (seeds == NULL || out == NULL) { return; }
+     fpsr_rand_batch_resolve()(seeds, out, n, mode);
+ }
+
+
+ /******************************************************************************/
+ /* Structure-of-arrays kernels                                                */
+ /******************************************************************************/
+
+ // Lanes per block: the integer stages write seeds into a block, which is then hashed by portable_rand_batch().
+ #define FPSR_SOA_BLOCK 64
+
+ /**
+  * @brief Evaluates fpsr_sm at one frame for many instances stored as structure-of-arrays.
+  * @details out[i] = fpsr_sm(frame, minHold[i], maxHold[i], reseedInterval[i],
+  * seedInner[i], seedOuter[i]). Each parameter is read with unit stride, and
+  * both hashing stages run through the SIMD portable_rand_batch() a block at a time.
+  *
+  * @param params Pointers to `count` contiguous values per parameter.
+  * @param count The number of instances.
+  * @param frame The current frame or time input.
+  * @param out A caller-owned array that receives `count` values.
+  * @param mode FPSR_RAND_EXACT to match fpsr_sm() bit for bit, or FPSR_RAND_APPROX.
+  */
+ void fpsr_sm_eval_soa(const fpsr_sm_soa* params, size_t count, int frame, float* out, fpsr_rand_mode mode)
+ {
+     if (params == NULL || out == NULL) { return; }
+
+     int seeds[FPSR_SOA_BLOCK];
+     float rand_for_duration[FPSR_SOA_BLOCK];
+     for (size_t b = 0; b < count; b += FPSR_SOA_BLOCK) {
+         size_t m = (count - b < FPSR_SOA_BLOCK) ? count - b : FPSR_SOA_BLOCK;
+         const int* reseedInterval = params->reseedInterval + b;
+         const int* seedInner = params->seedInner + b;
+         const int* seedOuter = params->seedOuter + b;
+         const int* minHold = params->minHold + b;
+         const int* maxHold = params->maxHold + b;
+
+         // --- 1. Seeds for the random hold duration ---
+         for (size_t i = 0; i < m; ++i) {
+             int r = (reseedInterval[i] < 1) ? 1 : reseedInterval[i]; // Prevent division by zero.
+             seeds[i] = fpsr_wrap_add(seedInner[i], frame - (frame % r));
+         }
+         portable_rand_batch(seeds, rand_for_duration, m, mode);
+
+         // --- 2. Held integer states ---
+         for (size_t i = 0; i < m; ++i) {
+             int holdDuration = (int)floor(minHold[i] + rand_for_duration[i] * (maxHold[i] - minHold[i]));
+             if (holdDuration < 1) { holdDuration = 1; } // Prevent division by zero.
+             seeds[i] = fpsr_wrap_add(seedOuter[i], frame) - (fpsr_wrap_add(seedOuter[i], frame) % holdDuration);
+         }
+
+         // --- 3. Final values ---
+         portable_rand_batch(seeds, out + b, m, mode);
+     }
+ }
+
+ /**
+  * @brief Resolves the default durations and multipliers of a QS structure-of-arrays.
+  * @details Applies step 1 of fpsr_qs() and the stream2FreqMult default for
+  * every instance, writing into caller-owned arrays. Point a fpsr_qs_soa at the
+  * results to keep the defaulting branches of fpsr_qs_eval_soa() cold.
+  *
+  * @param params The raw parameters.
+  * @param count The number of instances.
+  * @param streamSwitchDur, stream1QuantDur, stream2QuantDur Receive `count` resolved durations (>= 1).
+  * @param stream2FreqMult Receives `count` resolved multipliers.
+  */
+ void fpsr_qs_soa_resolve(
+     const fpsr_qs_soa* params, size_t count,
+     int* streamSwitchDur, int* stream1QuantDur, int* stream2QuantDur, float* stream2FreqMult)
+ {
+     if (params == NULL || streamSwitchDur == NULL || stream1QuantDur == NULL ||
+         stream2QuantDur == NULL || stream2FreqMult == NULL) { return; }
+
+     for (size_t i = 0; i < count; ++i) {
+         int q[2] = { params->quantLevelMin[i], params->quantLevelMax[i] };
+         int o[2] = { params->stream1Offset[i], params->stream2Offset[i] };
+         fpsr_qs_plan plan;
+         fpsr_qs_plan_init(
+             &plan, params->baseWaveFreq[i], params->stream2FreqMult[i], q, o,
+             params->streamSwitchDur[i], params->stream1QuantDur[i], params->stream2QuantDur[i]);
+         streamSwitchDur[i] = plan.streamSwitchDur;
+         stream1QuantDur[i] = plan.stream1QuantDur;
+         stream2QuantDur[i] = plan.stream2QuantDur;
+         stream2FreqMult[i] = plan.stream2FreqMult;
+     }
+ }
+
+ // a % d for d >= 1. The double quotient truncates to the exact integer one
+ // (|a| < 2^53), and unlike an integer division it pipelines and vectorises.
+ static inline int fpsr_soa_mod(int a, int d)
+ {
+     return a - (int)((double)a / (double)d) * d;
+ }
+
+ /**
+  * @brief Evaluates fpsr_qs at one frame for many instances stored as structure-of-arrays.
+  * @details out[i] = fpsr_qs(frame, baseWaveFreq[i], stream2FreqMult[i],
+  * {quantLevelMin[i], quantLevelMax[i]}, {stream1Offset[i], stream2Offset[i]},
+  * streamSwitchDur[i], stream1QuantDur[i], stream2QuantDur[i]).
+  * The active stream and both quantisation levels are chosen with selects
+  * rather than branches, so instances with different offsets do not cost
+  * mispredictions; only the active stream's sine is evaluated. The sine,
+  * quantisation and seed run in the vector kernels above (lanes near a floor()
+  * boundary are redone with libm, so the seeds are always exact), and the
+  * final hash runs through portable_rand_batch().
+  *
+  * @param params Pointers to `count` contiguous values per parameter.
+  * @param count The number of instances.
+  * @param frame The current frame or time input.
+  * @param out A caller-owned array that receives `count` values.
+  * @param mode Applies to the final hash: FPSR_RAND_EXACT to match fpsr_qs() bit for bit, or FPSR_RAND_APPROX.
+  */
+ void fpsr_qs_eval_soa(const fpsr_qs_soa* params, size_t count, int frame, float* out, fpsr_rand_mode mode)
+ {
+     if (params == NULL || out == NULL) { return; }
+
+     const float STREAM2_QUANT_RATIO_MIN = 1.24;
+     const float STREAM2_QUANT_RATIO_MAX = 0.66;
+     fpsr_qs_stream_batch_fn stream_batch = fpsr_qs_stream_batch_resolve();
+     float args[FPSR_SOA_BLOCK];
+     int levels[FPSR_SOA_BLOCK];
+     int seeds[FPSR_SOA_BLOCK];
+     for (size_t b = 0; b < count; b += FPSR_SOA_BLOCK) {
+         size_t m = (count - b < FPSR_SOA_BLOCK) ? count - b : FPSR_SOA_BLOCK;
+
+         for (size_t j = 0; j < m; ++j) {
+             size_t i = b + j;
+             float baseWaveFreq = params->baseWaveFreq[i];
+
+             // --- 1. Defaults (not taken when the arrays come from fpsr_qs_soa_resolve()) ---
+             int streamSwitchDur = params->streamSwitchDur[i];
+             int stream1QuantDur = params->stream1QuantDur[i];
+             int stream2QuantDur = params->stream2QuantDur[i];
+             float stream2FreqMult = params->stream2FreqMult[i];
+             if (streamSwitchDur < 1) { streamSwitchDur = (int)floor((1.0 / baseWaveFreq) * 0.76); }
+             if (stream1QuantDur < 1) { stream1QuantDur = (int)floor((1.0 / baseWaveFreq) * 1.2); }
+             if (stream2QuantDur < 1) { stream2QuantDur = (int)floor((1.0 / baseWaveFreq) * 0.9); }
+             if (streamSwitchDur < 1) { streamSwitchDur = 1; }
+             if (stream1QuantDur < 1) { stream1QuantDur = 1; }
+             if (stream2QuantDur < 1) { stream2QuantDur = 1; }
+             if (stream2FreqMult < 0) { stream2FreqMult = 3.7; } // Default multiplier.
+
+             // --- 2. Active stream and its quantisation level, as selects ---
+             int use_stream1 = fpsr_soa_mod(frame, streamSwitchDur) < streamSwitchDur / 2;
+             int t = fpsr_wrap_add(use_stream1 ? params->stream1Offset[i] : params->stream2Offset[i], frame);
+             int dur = use_stream1 ? stream1QuantDur : stream2QuantDur;
+             int first_half = fpsr_soa_mod(t, dur) < dur / 2;
+             int qmin = params->quantLevelMin[i];
+             int qmax = params->quantLevelMax[i];
+             // Truncation equals the floor() of fpsr_qs() here: negative products clamp to 1 either way.
+             int s2_level = first_half ? (int)(qmin * STREAM2_QUANT_RATIO_MIN) : (int)(qmax * STREAM2_QUANT_RATIO_MAX);
+             int level = use_stream1 ? (first_half ? qmin : qmax) : s2_level;
+             levels[j] = (level < 1) ? 1 : level;
+             float arg = (float)t * baseWaveFreq;
+             args[j] = use_stream1 ? arg : arg * stream2FreqMult;
+         }
+
+         // --- 3. Quantised stream values and their seeds ---
+         stream_batch(args, levels, seeds, m);
+
+         // --- 4. Hash the selected stream values ---
+         portable_rand_batch(seeds, out + b, m, mode);
+     }
+ }
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_vex.c
+ * @brief A C transcription of FPS-R as the Houdini point wrangles compute it.
+ * @details The wrangles in resources/code/houdini/h_fpsr_code_v001_01.hip are
+ * not the C reference. They run as 32-bit VEX, the precision "auto" chooses
+ * for float32 geometry, so every float is single precision and sin() is the
+ * single-precision sine. Their QS also predates the C port in several places:
+ *  - the stream sine takes (offset + frame) / 24 in integer division;
+ *  - the level and stream switches compare against duration * 0.5;
+ *  - the active stream value is mapped to outVal * 2 - 1 before hashing;
+ *  - stream 2's second-half level is floor((max + 0.999) * 0.66).
+ * The functions here are a transcription of those snippets, operation by
+ * operation. Their only intended deviation is that QS levels below 1 are
+ * clamped to 1, as in the C core; the snippet divides by zero there.
+ *
+ * Ints wrap as VEX's do (the sums are done unsigned) and `%` and `/` truncate
+ * as in C. sinf() stands in for VEX's sin(). So far these functions only match
+ * a transcription of the snippets under sinf(): they have not been compared
+ * with values from Houdini, and VEX's single-precision sine may round
+ * differently. Build this file without -ffast-math.
+ *
+ * The batch entry points take per-point parameters as structure-of-arrays and
+ * also produce the snippets' `@changed` (value at frame differs from the value
+ * at prevFrame) at much less than the cost of a second evaluation:
+ *  - SM reuses the hold duration when both frames share a reseed window, and
+ *    the value when both share a hold.
+ *  - QS evaluates only the stream that is active (the snippet computes both),
+ *    and hashes once when both frames step to the same value.
+ */
+
+ #include <math.h> // For sinf() and floorf()
+ #include "fpsr_algorithms.h"
+
+ // Constants of the snippets, as the 32-bit float literals VEX compiles them to.
+ #define FPSR_VEX_RAND_SCALE 12.9898f
+ #define FPSR_VEX_RAND_AMP 43758.5453f
+ #define FPSR_VEX_STREAM2_RATIO_MIN 1.24f
+ #define FPSR_VEX_STREAM2_RATIO_MAX 0.66f
+ #define FPSR_VEX_STREAM2_FREQ_MULT 3.7f
+
+ // a + b with VEX's wrapping 32-bit ints.
+ static inline int fpsr_vex_add(int a, int b)
+ {
+     return (int)((unsigned)a + (unsigned)b);
+ }
+
+ /**
+  * @brief The snippets' portable_rand(): frac(sin(float(seed) * 12.9898) * 43758.5453) in 32-bit floats.
+  * @details Differs from the C portable_rand(), which hashes in double precision.
+  */
+ float fpsr_vex_rand(int seed)
+ {
+     float hashed = sinf((float)seed * FPSR_VEX_RAND_SCALE) * FPSR_VEX_RAND_AMP;
+     return hashed - floorf(hashed);
+ }
+
+ /******************************************************************************/
+ /* Stacked Modulo                                                             */
+ /******************************************************************************/
+
+ // Step 1 of the snippet's fpsr_sm(): the hold duration of the reseed window `frame` is in.
+ static inline int fpsr_vex_sm_hold(int frame, int minHold, int maxHold, int reseedInterval, int offsetInner)
+ {
+     float rand_for_duration = fpsr_vex_rand((int)((unsigned)fpsr_vex_add(offsetInner, frame) - (unsigned)(frame % reseedInterval)));
+     int holdDuration = (int)floorf(minHold + rand_for_duration * (maxHold - minHold));
+     return (holdDuration < 1) ? 1 : holdDuration;
+ }
+
+ // Step 2: the stable integer state of the hold `frame` is in.
+ static inline int fpsr_vex_sm_state(int frame, int holdDuration, int offsetOuter)
+ {
+     int shifted = fpsr_vex_add(offsetOuter, frame);
+     return (int)((unsigned)shifted - (unsigned)(shifted % holdDuration));
+ }
+
+ /**
+  * @brief The wrangle's fpsr_sm(), as transcribed (see the file comment).
+  * @param frame The frame, int(@Frame) in the snippet.
+  * @param offsetInner, offsetOuter The snippet's names for seedInner and seedOuter.
+  * @return A value in [0, 1] that holds for a random duration.
+  */
+ float fpsr_vex_sm(
+     int frame, int minHold, int maxHold,
+     int reseedInterval, int offsetInner, int offsetOuter)
+ {
+     if (reseedInterval < 1) { reseedInterval = 1; }
+     int holdDuration = fpsr_vex_sm_hold(frame, minHold, maxHold, reseedInterval, offsetInner);
+     return fpsr_vex_rand(fpsr_vex_sm_state(frame, holdDuration, offsetOuter));
+ }
+
+ /**
+  * @brief fpsr_vex_sm() for `count` points, plus the snippet's `@changed`.
+  * @param params Per-point parameters; seedInner / seedOuter are offsetInner / offsetOuter.
+  * @param count The number of points.
+  * @param frame The frame to evaluate.
+  * @param prevFrame The frame `changed` compares against; the snippet uses int(@Frame - 1).
+  * @param out Receives `count` values.
+  * @param changed Receives 1 where the value at `frame` differs from the value at
+  * `prevFrame`, else 0. May be NULL.
+  */
+ void fpsr_vex_sm_soa(const fpsr_sm_soa* params, size_t count, int frame, int prevFrame, float* out, int* changed)
+ {
+     for (size_t i = 0; i < count; ++i) {
+         int minHold = params->minHold[i], maxHold = params->maxHold[i];
+         int reseedInterval = (params->reseedInterval[i] < 1) ? 1 : params->reseedInterval[i];
+         int offsetInner = params->seedInner[i], offsetOuter = params->seedOuter[i];
+
+         int holdDuration = fpsr_vex_sm_hold(frame, minHold, maxHold, reseedInterval, offsetInner);
+         int state = fpsr_vex_sm_state(frame, holdDuration, offsetOuter);
+         float value = fpsr_vex_rand(state);
+         out[i] = value;
+         if (changed == NULL) { continue; }
+
+         // Frames of one reseed window share the hold duration; frames of one hold share the value.
+         int prevHold = holdDuration;
+         if (prevFrame - prevFrame % reseedInterval != frame - frame % reseedInterval) {
+             prevHold = fpsr_vex_sm_hold(prevFrame, minHold, maxHold, reseedInterval, offsetInner);
+         }
+         int prevState = fpsr_vex_sm_state(prevFrame, prevHold, offsetOuter);
+         changed[i] = (prevState != state) && fpsr_vex_rand(prevState) != value;
+     }
+ }
+
+ /******************************************************************************/
+ /* Quantised Switching                                                        */
+ /******************************************************************************/
+
+ // The snippet's fpsr_qs() parameters after its defaults are applied.
+ typedef struct fpsr_vex_qs_resolved {
+     float baseWaveFreq, stream2FreqMult;
+     int levels[2], offsets[2];
+     int streamSwitchDur, stream1QuantDur, stream2QuantDur;
+ } fpsr_vex_qs_resolved;
+
+ // A duration left below 1 becomes floor((1 / baseWaveFreq) * ratio), at least 1.
+ static inline int fpsr_vex_qs_duration(int duration, float baseWaveFreq, float ratio)
+ {
+     if (duration >= 1) { return duration; }
+     duration = (int)floorf((1.0f / baseWaveFreq) * ratio);
+     return (duration < 1) ? 1 : duration;
+ }
+
+ static inline void fpsr_vex_qs_resolve(
+     fpsr_vex_qs_resolved* r, float baseWaveFreq, float stream2FreqMult, int levelMin, int levelMax,
+     int offset1, int offset2, int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     r->baseWaveFreq = baseWaveFreq;
+     r->stream2FreqMult = (stream2FreqMult < 0) ? FPSR_VEX_STREAM2_FREQ_MULT : stream2FreqMult;
+     r->levels[0] = levelMin;
+     r->levels[1] = levelMax;
+     r->offsets[0] = offset1;
+     r->offsets[1] = offset2;
+     r->streamSwitchDur = fpsr_vex_qs_duration(streamSwitchDur, baseWaveFreq, 0.76f);
+     r->stream1QuantDur = fpsr_vex_qs_duration(stream1QuantDur, baseWaveFreq, 1.2f);
+     r->stream2QuantDur = fpsr_vex_qs_duration(stream2QuantDur, baseWaveFreq, 0.9f);
+ }
+
+ // The integer the snippet hashes at `frame`: int((stream * 2 - 1) * 100000), computing only the active stream.
+ static inline int fpsr_vex_qs_seed(const fpsr_vex_qs_resolved* r, int frame)
+ {
+     int stream = ((frame % r->streamSwitchDur) < r->streamSwitchDur * 0.5f) ? 0 : 1;
+     int position = fpsr_vex_add(r->offsets[stream], frame);
+     float level, arg;
+     if (stream == 0) {
+         level = (float)((position % r->stream1QuantDur < r->stream1QuantDur * 0.5f) ? r->levels[0] : r->levels[1]);
+         arg = (float)(position / 24) * r->baseWaveFreq;
+     } else if (position % r->stream2QuantDur < r->stream2QuantDur * 0.5f) {
+         level = floorf((float)r->levels[0] * FPSR_VEX_STREAM2_RATIO_MIN);
+         arg = (float)(position / 24) * r->baseWaveFreq * r->stream2FreqMult;
+     } else {
+         level = floorf(((float)r->levels[1] + 0.999f) * FPSR_VEX_STREAM2_RATIO_MAX);
+         arg = (float)(position / 24) * r->baseWaveFreq * r->stream2FreqMult;
+     }
+     if (level < 1.0f) { level = 1.0f; } // The snippet divides by zero here.
+
+     float outVal = floorf(sinf(arg) * level) / level;
+     outVal = outVal * 2.0f - 1.0f;
+     return (int)(outVal * 100000.0f);
+ }
+
+ /**
+  * @brief The wrangle's fpsr_qs(), as transcribed under sinf().
+  * @details Parameters as for fpsr_qs(); durations below 1 take the snippet's defaults.
+  */
+ float fpsr_vex_qs(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     fpsr_vex_qs_resolved r;
+     fpsr_vex_qs_resolve(&r, baseWaveFreq, stream2FreqMult, quantLevelsMinMax[0], quantLevelsMinMax[1],
+         streamsOffset[0], streamsOffset[1], streamSwitchDur, stream1QuantDur, stream2QuantDur);
+     return fpsr_vex_rand(fpsr_vex_qs_seed(&r, frame));
+ }
+
+ /**
+  * @brief fpsr_vex_qs() for `count` points, plus the snippet's `@changed`.
+  * @details Arguments as for fpsr_vex_sm_soa().
+  */
+ void fpsr_vex_qs_soa(const fpsr_qs_soa* params, size_t count, int frame, int prevFrame, float* out, int* changed)
+ {
+     for (size_t i = 0; i < count; ++i) {
+         fpsr_vex_qs_resolved r;
+         fpsr_vex_qs_resolve(&r, params->baseWaveFreq[i], params->stream2FreqMult[i],
+             params->quantLevelMin[i], params->quantLevelMax[i], params->stream1Offset[i], params->stream2Offset[i],
+             params->streamSwitchDur[i], params->stream1QuantDur[i], params->stream2QuantDur[i]);
+
+         int seed = fpsr_vex_qs_seed(&r, frame);
+         float value = fpsr_vex_rand(seed);
+         out[i] = value;
+         if (changed == NULL) { continue; }
+         int prevSeed = fpsr_vex_qs_seed(&r, prevFrame);
+         changed[i] = (prevSeed != seed) && fpsr_vex_rand(prevSeed) != value;
+     }
+ }
@@ -0,0 +1,348 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_algorithms.hpp
+ * @brief Header-only C++ implementation of FPS-R algorithms: Stacked Modulo (SM) and Quantised Switching (QS).
+ * @details A C++17 port of resources/code/c/fpsr_algorithms.c that produces the same
+ * bits as the C reference. Two flavours are provided:
+ *  - Compile-time configurations (fpsr::StackedModulo<...>, fpsr::QuantisedSwitching<...>),
+ *    where the durations are template arguments. Every `%` by a constant becomes a
+ *    multiply-shift, the clamps are resolved by the compiler, and SM's hold
+ *    duration (which is only known at run time) is dispatched to a constant
+ *    modulo through a small compare tree. This is intended for targets where
+ *    integer division dominates, such as microcontrollers.
+ *  - Runtime configurations (fpsr::sm(), fpsr::qs(), fpsr::StackedModuloRuntime,
+ *    fpsr::QuantisedSwitchingRuntime) that take the same parameters as the C functions.
+ */
+
+ #ifndef FPSR_ALGORITHMS_HPP
+ #define FPSR_ALGORITHMS_HPP
+
+ #include <cmath> // For std::sin() and std::floor()
+ #include <cstdint> // For std::uint32_t
+
+ namespace fpsr {
+
+ /**
+  * A simple, portable pseudo-random number generator.
+  * @brief Generates a deterministic float between 0.0 and 1.0 from an integer seed.
+  * @param seed An integer used to generate the random number.
+  * @return The same value as the C portable_rand(seed).
+  */
+ inline float portable_rand(int seed)
+ {
+     // Evaluated in double, exactly like the C reference (12.9898 is a double literal).
+     float result = static_cast<float>(std::sin(static_cast<double>(static_cast<float>(seed)) * 12.9898) * 43758.5453);
+     return result - std::floor(result);
+ }
+
+ /**
+  * @brief Integer-hash alternative to portable_rand(); the same bits as the C portable_rand_hash().
+  * @param seed An integer used to generate the random number.
+  * @return A pseudo-random float in [0.0, 1.0), a multiple of 2^-24.
+  */
+ inline float portable_rand_hash(int seed)
+ {
+     std::uint32_t x = static_cast<std::uint32_t>(seed) + 0x9E3779B9u;
+     x ^= x >> 16;
+     x *= 0x7FEB352Du;
+     x ^= x >> 15;
+     x *= 0x846CA68Bu;
+     x ^= x >> 16;
+     return static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+ }
+
+ namespace detail {
+
+ // Largest hold duration span that is dispatched to constant modulos.
+ constexpr int kMaxModDispatchSpan = 64;
+
+ constexpr int clamp_min1(int v) { return v < 1 ? 1 : v; }
+ constexpr int min_int(int a, int b) { return a < b ? a : b; }
+ constexpr int max_int(int a, int b) { return a < b ? b : a; }
+
+ // a + b with 32-bit wraparound, as the C reference sums seeds and offsets with frames.
+ constexpr int wrap_add(int a, int b) { return static_cast<int>(static_cast<std::uint32_t>(a) + static_cast<std::uint32_t>(b)); }
+
+ /**
+  * @brief Computes x % d where d is known to lie in [Lo, Hi].
+  * @details Narrows d with a binary compare tree and then uses a constant
+  * divisor, which compilers lower to a multiply-shift. Values of d outside the
+  * range fall back to a runtime modulo.
+  */
+ template <int Lo, int Hi>
+ struct ModDispatch {
+     static inline int mod(int x, int d)
+     {
+         if constexpr (Lo == Hi) {
+             return (d == Lo) ? x % Lo : x % d;
+         } else {
+             constexpr int Mid = Lo + (Hi - Lo) / 2;
+             return (d <= Mid) ? ModDispatch<Lo, Mid>::mod(x, d) : ModDispatch<Mid + 1, Hi>::mod(x, d);
+         }
+     }
+ };
+
+ // Hold duration from the reseed window base; identical arithmetic to fpsr_sm().
+ inline int sm_hold_duration(int reseed_base, int minHold, int maxHold, int seedInner)
+ {
+     float rand_for_duration = portable_rand(wrap_add(seedInner, reseed_base));
+     int holdDuration = static_cast<int>(std::floor(minHold + rand_for_duration * (maxHold - minHold)));
+     return clamp_min1(holdDuration); // Prevent division by zero.
+ }
+
+ // Quantised sine for one stream; identical arithmetic to step 3 of fpsr_qs().
+ inline float qs_stream(int t, float freq, int level)
+ {
+     // sin() is taken in double, as the C reference promotes its float argument.
+     return static_cast<float>(std::floor(std::sin(static_cast<double>(static_cast<float>(t) * freq)) * level) / level);
+ }
+
+ inline float qs_stream(int t, float freq, float mult, int level)
+ {
+     // Two float multiplies, in the same order as fpsr_qs(), keep the argument bit-identical.
+     return static_cast<float>(std::floor(std::sin(static_cast<double>(static_cast<float>(t) * freq * mult)) * level) / level);
+ }
+
+ // Magic numbers are used to create more variation in the second stream's character.
+ constexpr float kStream2QuantRatioMin = 1.24;
+ constexpr float kStream2QuantRatioMax = 0.66;
+
+ // (int)floor(level * ratio) clamped to >= 1. Truncation equals floor here because
+ // every negative product clamps to 1 either way.
+ constexpr int qs_stream2_level(int level, float ratio)
+ {
+     return clamp_min1(static_cast<int>(level * ratio));
+ }
+
+ } // namespace detail
+
+
+ /******************************************************************************/
+ /* FPS-R: Stacked Modulo (SM)                            */
+ /******************************************************************************/
+
+ /**
+  * @brief Same as the C fpsr_sm().
+  * @param frame The current frame or time input.
+  * @param minHold The minimum duration (in frames) for a value to hold.
+  * @param maxHold The maximum duration (in frames) for a value to hold.
+  * @param reseedInterval The fixed interval at which a new hold duration is calculated.
+  * @param seedInner An offset for the random duration calculation to create unique sequences.
+  * @param seedOuter An offset for the final value calculation to create unique sequences.
+  * @return A float value between 0.0 and 1.0 that remains constant for the hold duration.
+  */
+ inline float sm(int frame, int minHold, int maxHold, int reseedInterval, int seedInner, int seedOuter)
+ {
+     reseedInterval = detail::clamp_min1(reseedInterval); // Prevent division by zero.
+     int holdDuration = detail::sm_hold_duration(frame - (frame % reseedInterval), minHold, maxHold, seedInner);
+     int held_integer_state = detail::wrap_add(seedOuter, frame) - (detail::wrap_add(seedOuter, frame) % holdDuration);
+     return portable_rand(held_integer_state);
+ }
+
+ /**
+  * @brief Stacked Modulo with the hold range and reseed interval fixed at compile time.
+  * @details The reseed modulo uses a constant divisor, and the hold modulo is
+  * dispatched over the (small) set of hold durations the configuration can
+  * produce. The seeds stay runtime values so one configuration can drive many
+  * instances.
+  *
+  * @tparam MinHold The minimum duration (in frames) for a value to hold.
+  * @tparam MaxHold The maximum duration (in frames) for a value to hold.
+  * @tparam ReseedInterval The fixed interval at which a new hold duration is calculated.
+  */
+ template <int MinHold, int MaxHold, int ReseedInterval>
+ class StackedModulo {
+ public:
+     static constexpr int kReseedInterval = detail::clamp_min1(ReseedInterval);
+     // Every hold duration the float arithmetic in fpsr_sm() can produce lies in [kHoldLo, kHoldHi].
+     static constexpr int kHoldLo = detail::clamp_min1(detail::min_int(MinHold, MaxHold));
+     static constexpr int kHoldHi = detail::clamp_min1(detail::max_int(MinHold, MaxHold));
+
+     constexpr StackedModulo(int seedInner = 0, int seedOuter = 0)
+         : seedInner_(seedInner), seedOuter_(seedOuter) {}
+
+     /**
+      * @param frame The current frame or time input.
+      * @return The same value as fpsr_sm(frame, MinHold, MaxHold, ReseedInterval, seedInner, seedOuter).
+      */
+     inline float operator()(int frame) const
+     {
+         int holdDuration = detail::sm_hold_duration(frame - (frame % kReseedInterval), MinHold, MaxHold, seedInner_);
+         int s = detail::wrap_add(seedOuter_, frame);
+         int held_integer_state = s - hold_mod(s, holdDuration);
+         return portable_rand(held_integer_state);
+     }
+
+     constexpr int seedInner() const { return seedInner_; }
+     constexpr int seedOuter() const { return seedOuter_; }
+
+ private:
+     static inline int hold_mod(int x, int holdDuration)
+     {
+         if constexpr (kHoldHi - kHoldLo <= detail::kMaxModDispatchSpan) {
+             return detail::ModDispatch<kHoldLo, kHoldHi>::mod(x, holdDuration);
+         } else {
+             return x % holdDuration;
+         }
+     }
+
+     int seedInner_;
+     int seedOuter_;
+ };
+
+ /**
+  * @brief Stacked Modulo with all parameters supplied at run time.
+  */
+ class StackedModuloRuntime {
+ public:
+     StackedModuloRuntime(int minHold, int maxHold, int reseedInterval, int seedInner = 0, int seedOuter = 0)
+         : minHold_(minHold), maxHold_(maxHold), reseedInterval_(detail::clamp_min1(reseedInterval)),
+           seedInner_(seedInner), seedOuter_(seedOuter) {}
+
+     // The same value as fpsr_sm(frame, ...) for the stored parameters.
+     inline float operator()(int frame) const
+     {
+         return sm(frame, minHold_, maxHold_, reseedInterval_, seedInner_, seedOuter_);
+     }
+
+ private:
+     int minHold_, maxHold_, reseedInterval_, seedInner_, seedOuter_;
+ };
+
+
+ /******************************************************************************/
+ /* FPS-R: Quantised Switching (QS)                         */
+ /******************************************************************************/
+
+ /**
+  * @brief Quantised Switching with all parameters supplied at run time.
+  * @details Mirrors fpsr_qs_plan from the C implementation: defaults and clamps
+  * are resolved once in the constructor.
+  */
+ class QuantisedSwitchingRuntime {
+ public:
+     /**
+      * @param baseWaveFreq ... stream2QuantDur As for the C fpsr_qs().
+      */
+     QuantisedSwitchingRuntime(
+         float baseWaveFreq, float stream2FreqMult,
+         const int quantLevelsMinMax[2], const int streamsOffset[2],
+         int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+     {
+         // Default durations derived from the base frequency, then clamped to at least 1 frame.
+         if (streamSwitchDur < 1) { streamSwitchDur = static_cast<int>(std::floor((1.0 / baseWaveFreq) * 0.76)); }
+         if (stream1QuantDur < 1) { stream1QuantDur = static_cast<int>(std::floor((1.0 / baseWaveFreq) * 1.2)); }
+         if (stream2QuantDur < 1) { stream2QuantDur = static_cast<int>(std::floor((1.0 / baseWaveFreq) * 0.9)); }
+         switchDur_ = detail::clamp_min1(streamSwitchDur);
+         quantDur_[0] = detail::clamp_min1(stream1QuantDur);
+         quantDur_[1] = detail::clamp_min1(stream2QuantDur);
+
+         s1Levels_[0] = detail::clamp_min1(quantLevelsMinMax[0]);
+         s1Levels_[1] = detail::clamp_min1(quantLevelsMinMax[1]);
+         s2Levels_[0] = detail::clamp_min1(static_cast<int>(std::floor(quantLevelsMinMax[0] * detail::kStream2QuantRatioMin)));
+         s2Levels_[1] = detail::clamp_min1(static_cast<int>(std::floor(quantLevelsMinMax[1] * detail::kStream2QuantRatioMax)));
+
+         baseWaveFreq_ = baseWaveFreq;
+         stream2FreqMult_ = (stream2FreqMult < 0) ? static_cast<float>(3.7) : stream2FreqMult; // Default multiplier.
+         offset_[0] = streamsOffset[0];
+         offset_[1] = streamsOffset[1];
+     }
+
+     // The same value as fpsr_qs(frame, ...) for the stored parameters.
+     inline float operator()(int frame) const
+     {
+         float active_stream_val;
+         if ((frame % switchDur_) < switchDur_ / 2) {
+             int t = detail::wrap_add(offset_[0], frame);
+             int level = s1Levels_[(t % quantDur_[0]) >= quantDur_[0] / 2];
+             active_stream_val = detail::qs_stream(t, baseWaveFreq_, level);
+         } else {
+             int t = detail::wrap_add(offset_[1], frame);
+             int level = s2Levels_[(t % quantDur_[1]) >= quantDur_[1] / 2];
+             active_stream_val = detail::qs_stream(t, baseWaveFreq_, stream2FreqMult_, level);
+         }
+         return portable_rand(static_cast<int>(active_stream_val * 100000.0));
+     }
+
+ private:
+     float baseWaveFreq_;
+     float stream2FreqMult_;
+     int offset_[2];
+     int switchDur_;
+     int quantDur_[2];
+     int s1Levels_[2];
+     int s2Levels_[2];
+ };
+
+ /**
+  * @brief Same as the C fpsr_qs().
+  */
+ inline float qs(
+     int frame, float baseWaveFreq, float stream2FreqMult,
+     const int quantLevelsMinMax[2], const int streamsOffset[2],
+     int streamSwitchDur, int stream1QuantDur, int stream2QuantDur)
+ {
+     return QuantisedSwitchingRuntime(
+         baseWaveFreq, stream2FreqMult, quantLevelsMinMax, streamsOffset,
+         streamSwitchDur, stream1QuantDur, stream2QuantDur)(frame);
+ }
+
+ /**
+  * @brief Quantised Switching with the durations and quantisation levels fixed at compile time.
+  * @details All three cycle modulos use constant divisors and the four
+  * quantisation levels are constants. The durations must be explicit (>= 1);
+  * configurations that rely on defaults derived from baseWaveFreq should use
+  * QuantisedSwitchingRuntime.
+  *
+  * @tparam StreamSwitchDur The number of frames after which the streams switch.
+  * @tparam Stream1QuantDur The duration for stream 1's quantisation switch.
+  * @tparam Stream2QuantDur The duration for stream 2's quantisation switch.
+  * @tparam QuantLevelMin, QuantLevelMax The min and max quantisation levels.
+  */
+ template <int StreamSwitchDur, int Stream1QuantDur, int Stream2QuantDur, int QuantLevelMin, int QuantLevelMax>
+ class QuantisedSwitching {
+     static_assert(StreamSwitchDur >= 1 && Stream1QuantDur >= 1 && Stream2QuantDur >= 1,
+                   "Compile-time durations must be explicit; use QuantisedSwitchingRuntime for derived defaults.");
+
+ public:
+     static constexpr int kS1LevelLo = detail::clamp_min1(QuantLevelMin);
+     static constexpr int kS1LevelHi = detail::clamp_min1(QuantLevelMax);
+     static constexpr int kS2LevelLo = detail::qs_stream2_level(QuantLevelMin, detail::kStream2QuantRatioMin);
+     static constexpr int kS2LevelHi = detail::qs_stream2_level(QuantLevelMax, detail::kStream2QuantRatioMax);
+
+     /**
+      * @param baseWaveFreq The base frequency for the modulation wave of stream 1.
+      * @param stream2FreqMult A multiplier for the second stream's frequency. If < 0, a default is used.
+      * @param stream1Offset, stream2Offset The frame offsets of each stream.
+      */
+     QuantisedSwitching(float baseWaveFreq, float stream2FreqMult, int stream1Offset = 0, int stream2Offset = 0)
+         : baseWaveFreq_(baseWaveFreq), stream2FreqMult_((stream2FreqMult < 0) ? static_cast<float>(3.7) : stream2FreqMult),
+           offset1_(stream1Offset), offset2_(stream2Offset) {}
+
+     // The same value as fpsr_qs(frame, ...) for the configured parameters.
+     inline float operator()(int frame) const
+     {
+         float active_stream_val;
+         if ((frame % StreamSwitchDur) < StreamSwitchDur / 2) {
+             int t = detail::wrap_add(offset1_, frame);
+             int level = ((t % Stream1QuantDur) < Stream1QuantDur / 2) ? kS1LevelLo : kS1LevelHi;
+             active_stream_val = detail::qs_stream(t, baseWaveFreq_, level);
+         } else {
+             int t = detail::wrap_add(offset2_, frame);
+             int level = ((t % Stream2QuantDur) < Stream2QuantDur / 2) ? kS2LevelLo : kS2LevelHi;
+             active_stream_val = detail::qs_stream(t, baseWaveFreq_, stream2FreqMult_, level);
+         }
+         return portable_rand(static_cast<int>(active_stream_val * 100000.0));
+     }
+
+ private:
+     float baseWaveFreq_;
+     float stream2FreqMult_;
+     int offset1_;
+     int offset2_;
+ };
+
+ } // namespace fpsr
+
+ #endif // FPSR_ALGORITHMS_HPP
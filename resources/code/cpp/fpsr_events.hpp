@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_events.hpp
+ * @brief C++20 coroutine streams of FPS-R value changes.
+ * @details Instead of evaluating a channel every tick and diffing against
+ * frame - 1, these generators jump straight from one change point to the next
+ * with fpsr_sm_next_change() / fpsr_qs_plan_next_change() and yield
+ * (frame, newValue) only where the value actually changes.
+ *  - fpsr::changes() streams one channel over a frame range.
+ *  - fpsr::ChangeScheduler keeps many channels on a hierarchical timer wheel,
+ *    so channels that are holding their value cost nothing until their next
+ *    change comes due; advance() yields the changes of all channels in frame order.
+ *
+ * Requires C++20 and linking with resources/code/c/fpsr_algorithms.c.
+ */
+
+ #ifndef FPSR_EVENTS_HPP
+ #define FPSR_EVENTS_HPP
+
+ #include <bit> // For std::countl_zero() and std::countr_zero()
+ #include <cassert> // For assert()
+ #include <climits> // For INT_MAX
+ #include <coroutine> // For std::coroutine_handle and std::suspend_always
+ #include <cstdint> // For std::uint32_t and std::uint64_t
+ #include <exception> // For std::exception_ptr
+ #include <iterator> // For std::default_sentinel_t
+ #include <memory> // For std::addressof()
+ #include <utility> // For std::exchange()
+ #include <vector>
+
+ #include "../c/fpsr_algorithms.h"
+
+ namespace fpsr {
+
+ /**
+  * @brief A minimal lazy generator (std::generator is C++23) usable in range-for.
+  * @details Each yielded value is only valid until the generator is resumed.
+  * Destroying the generator before it finishes destroys the coroutine frame,
+  * running the destructors of its locals.
+  */
+ template <typename T>
+ class Generator {
+ public:
+     struct promise_type {
+         const T* value = nullptr;
+         std::exception_ptr error;
+
+         Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+         std::suspend_always initial_suspend() noexcept { return {}; }
+         std::suspend_always final_suspend() noexcept { return {}; }
+         std::suspend_always yield_value(const T& v) noexcept { value = std::addressof(v); return {}; }
+         void return_void() noexcept {}
+         void unhandled_exception() { error = std::current_exception(); }
+         void await_transform() = delete; // Generators do not co_await.
+     };
+
+     class iterator {
+     public:
+         using value_type = T;
+         using difference_type = std::ptrdiff_t;
+
+         iterator() = default;
+         explicit iterator(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+         const T& operator*() const { return *handle_.promise().value; }
+         const T* operator->() const { return handle_.promise().value; }
+         iterator& operator++() { resume(handle_); return *this; }
+         void operator++(int) { ++*this; }
+         bool operator==(std::default_sentinel_t) const { return !handle_ || handle_.done(); }
+
+     private:
+         std::coroutine_handle<promise_type> handle_;
+     };
+
+     Generator(Generator&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+     Generator& operator=(Generator&& other) noexcept
+     {
+         if (this != &other) {
+             if (handle_) { handle_.destroy(); }
+             handle_ = std::exchange(other.handle_, {});
+         }
+         return *this;
+     }
+     Generator(const Generator&) = delete;
+     Generator& operator=(const Generator&) = delete;
+     ~Generator() { if (handle_) { handle_.destroy(); } }
+
+     iterator begin() { resume(handle_); return iterator(handle_); }
+     std::default_sentinel_t end() const { return {}; }
+
+ private:
+     explicit Generator(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+     static void resume(std::coroutine_handle<promise_type> h)
+     {
+         if (!h || h.done()) { return; }
+         h.resume();
+         if (h.promise().error) { std::rethrow_exception(std::exchange(h.promise().error, {})); }
+     }
+
+     std::coroutine_handle<promise_type> handle_;
+ };
+
+ // A change point of one channel: the value at `frame` differs from the value at frame - 1.
+ struct Change {
+     int frame;
+     float value;
+ };
+
+ // A change point of one ChangeScheduler channel.
+ struct ChannelChange {
+     std::uint32_t channel;
+     int frame;
+     float value;
+ };
+
+ namespace detail {
+
+ // An SM or QS channel behind one interface: its value and its next change point.
+ struct ChangeSource {
+     enum class Kind : unsigned char { SM, QS };
+
+     Kind kind;
+     union {
+         fpsr_sm_params sm;
+         fpsr_qs_plan qs;
+     };
+
+     explicit ChangeSource(const fpsr_sm_params& p) : kind(Kind::SM), sm(p) {}
+     explicit ChangeSource(const fpsr_qs_plan& p) : kind(Kind::QS), qs(p) {}
+
+     float eval(int frame) const
+     {
+         if (kind == Kind::SM) {
+             return fpsr_sm(frame, sm.minHold, sm.maxHold, sm.reseedInterval, sm.seedInner, sm.seedOuter);
+         }
+         return fpsr_qs_eval(&qs, frame);
+     }
+
+     // First candidate change frame after `frame`. QS candidates may be
+     // horizon caps rather than real changes, so callers compare values.
+     int next(int frame) const
+     {
+         if (kind == Kind::SM) {
+             return fpsr_sm_next_change(frame, sm.minHold, sm.maxHold, sm.reseedInterval, sm.seedInner, sm.seedOuter);
+         }
+         return fpsr_qs_plan_next_change(&qs, frame);
+     }
+ };
+
+ inline Generator<Change> source_changes(ChangeSource source, int first, int last)
+ {
+     if (first > last) { co_return; }
+
+     float value = source.eval(first);
+     co_yield Change{first, value};
+
+     int frame = first;
+     while (frame < last) {
+         frame = source.next(frame);
+         if (frame > last) { co_return; }
+         float v = source.eval(frame);
+         if (v != value) { // Skips candidates that were only look-ahead caps.
+             value = v;
+             co_yield Change{frame, v};
+         }
+     }
+ }
+
+ } // namespace detail
+
+
+ /******************************************************************************/
+ /* Single-channel streams                                                     */
+ /******************************************************************************/
+
+ /**
+  * @brief Streams the change points of fpsr_sm() over [first, last].
+  * @details Yields the value at `first`, then every frame in (first, last]
+  * whose value differs from the frame before.
+  */
+ inline Generator<Change> changes(const fpsr_sm_params& params, int first, int last)
+ {
+     return detail::source_changes(detail::ChangeSource(params), first, last);
+ }
+
+ // As above for fpsr_qs_eval() with a copy of `plan`.
+ inline Generator<Change> changes(const fpsr_qs_plan& plan, int first, int last)
+ {
+     return detail::source_changes(detail::ChangeSource(plan), first, last);
+ }
+
+
+ /******************************************************************************/
+ /* Multi-channel scheduler                                                    */
+ /******************************************************************************/
+
+ /**
+  * @brief Schedules the change points of many channels on a shared timer wheel.
+  * @details Each channel sits in the wheel at its next change frame. The wheel
+  * has four levels of 256 slots, one per byte of the (unsigned-mapped) frame,
+  * with an occupancy bitmap per level: advance() finds the next due slot with
+  * a few bit scans, cascades coarse slots down as the clock reaches them, and
+  * touches a channel only when its change comes due. Holding channels cost
+  * nothing between events, whatever the gap.
+  *
+  * Channels join at the current frame(); value() reads their current value.
+  * Channels may be added and removed while an advance() generator is
+  * suspended, but only one advance() may be in flight at a time.
+  */
+ class ChangeScheduler {
+ public:
+     using ChannelId = std::uint32_t;
+
+     explicit ChangeScheduler(int frame = 0) : now_(key(frame))
+     {
+         for (auto& level : heads_) {
+             for (auto& head : level) { head = kNone; }
+         }
+     }
+
+     ChangeScheduler(const ChangeScheduler&) = delete;
+     ChangeScheduler& operator=(const ChangeScheduler&) = delete;
+
+     // Subscribes a channel at frame(); returns its id.
+     ChannelId add(const fpsr_sm_params& params) { return add(detail::ChangeSource(params)); }
+     ChannelId add(const fpsr_qs_plan& plan) { return add(detail::ChangeSource(plan)); }
+
+     // Unsubscribes a channel. Its id may be reused by a later add().
+     void remove(ChannelId id)
+     {
+         Channel& ch = channels_[id];
+         if (ch.state == State::Free) { return; }
+         if (ch.state == State::Linked) { unlink(id); }
+         ch.state = State::Free;
+         free_.push_back(id);
+         --live_;
+     }
+
+     // The value of a channel at frame() (or at the change being yielded).
+     float value(ChannelId id) const { return channels_[id].value; }
+
+     // The frame the scheduler has advanced to.
+     int frame() const { return to_frame(now_); }
+
+     // Number of subscribed channels.
+     std::size_t size() const { return live_; }
+
+     /**
+      * @brief Advances to `frame`, yielding every change in (frame(), frame].
+      * @details Changes come in frame order; several changes at the same frame
+      * come in no particular order. A frame before frame() yields nothing.
+      * Destroying the generator early leaves the scheduler at the last frame
+      * it yielded, with the rest of that frame's changes still pending.
+      */
+     Generator<ChannelChange> advance(int frame)
+     {
+         assert(!advancing_ && "only one ChangeScheduler::advance() may be in flight");
+         const std::uint32_t target = key(frame);
+         if (target < now_) { co_return; }
+
+         AdvanceGuard guard{*this};
+         int level, slot;
+         std::uint32_t start;
+         while (next_slot(level, slot, start) && start <= target) {
+             now_ = start;
+             if (level > 0) {
+                 cascade(level, slot);
+                 continue;
+             }
+
+             // Every channel in a level-0 slot changes exactly at now_.
+             detach(0, slot, State::Due);
+             const int f = to_frame(now_);
+             while (guard.pos < due_.size()) {
+                 ChannelId id = due_[guard.pos++];
+                 Channel& ch = channels_[id];
+                 if (ch.state != State::Due) { continue; } // Removed (or removed and reused) while suspended.
+                 ch.state = State::Idle;
+
+                 float v = ch.source.eval(f);
+                 if (f < INT_MAX) {
+                     int next = ch.source.next(f);
+                     if (next > f) { link(id, key(next)); }
+                 }
+                 if (v != ch.value) { // Skips candidates that were only look-ahead caps.
+                     ch.value = v;
+                     co_yield ChannelChange{id, f, v};
+                 }
+             }
+             due_.clear();
+             guard.pos = 0;
+         }
+         now_ = target;
+     }
+
+ private:
+     static constexpr int kLevels = 4;
+     static constexpr int kSlotBits = 8;
+     static constexpr int kSlots = 1 << kSlotBits;
+     static constexpr int kWords = kSlots / 64;
+     static constexpr std::uint32_t kNone = 0xFFFFFFFFu;
+
+     enum class State : unsigned char { Linked, Due, Idle, Free };
+
+     struct Channel {
+         detail::ChangeSource source;
+         float value;
+         std::uint32_t time;       // Wheel time of the next change while Linked.
+         std::uint32_t prev, next; // Slot list links.
+         std::uint16_t bucket;     // level * kSlots + slot while Linked.
+         State state;
+     };
+
+     // Re-links the rest of a frame's due channels if the generator is destroyed mid-frame.
+     struct AdvanceGuard {
+         ChangeScheduler& s;
+         std::size_t pos = 0;
+
+         explicit AdvanceGuard(ChangeScheduler& sched) : s(sched) { s.advancing_ = true; }
+         ~AdvanceGuard()
+         {
+             for (; pos < s.due_.size(); ++pos) {
+                 ChannelId id = s.due_[pos];
+                 if (s.channels_[id].state == State::Due) { s.link(id, s.now_); }
+             }
+             s.due_.clear();
+             s.advancing_ = false;
+         }
+     };
+
+     // Maps frames to unsigned wheel times, preserving order over the whole int range.
+     static std::uint32_t key(int frame) { return static_cast<std::uint32_t>(frame) ^ 0x80000000u; }
+     static int to_frame(std::uint32_t time) { return static_cast<int>(time ^ 0x80000000u); }
+
+     ChannelId add(const detail::ChangeSource& source)
+     {
+         ChannelId id;
+         if (!free_.empty()) {
+             id = free_.back();
+             free_.pop_back();
+             channels_[id].source = source;
+         } else {
+             id = static_cast<ChannelId>(channels_.size());
+             channels_.push_back(Channel{source, 0.0f, 0, kNone, kNone, 0, State::Idle});
+         }
+         ++live_;
+
+         Channel& ch = channels_[id];
+         const int f = to_frame(now_);
+         ch.value = source.eval(f);
+         ch.state = State::Idle;
+         if (f < INT_MAX) {
+             int next = source.next(f);
+             if (next > f) { link(id, key(next)); }
+         }
+         return id;
+     }
+
+     // Files a channel under the highest byte in which `time` differs from now_.
+     void link(ChannelId id, std::uint32_t time)
+     {
+         std::uint32_t diff = time ^ now_;
+         int level = diff ? (31 - std::countl_zero(diff)) / kSlotBits : 0;
+         int slot = static_cast<int>((time >> (level * kSlotBits)) & (kSlots - 1));
+
+         Channel& ch = channels_[id];
+         ch.time = time;
+         ch.bucket = static_cast<std::uint16_t>(level * kSlots + slot);
+         ch.state = State::Linked;
+         ch.prev = kNone;
+         ch.next = heads_[level][slot];
+         if (ch.next != kNone) { channels_[ch.next].prev = id; }
+         heads_[level][slot] = id;
+         occupied_[level][slot / 64] |= std::uint64_t(1) << (slot % 64);
+     }
+
+     void unlink(ChannelId id)
+     {
+         Channel& ch = channels_[id];
+         int level = ch.bucket / kSlots, slot = ch.bucket % kSlots;
+         if (ch.prev != kNone) { channels_[ch.prev].next = ch.next; } else { heads_[level][slot] = ch.next; }
+         if (ch.next != kNone) { channels_[ch.next].prev = ch.prev; }
+         if (heads_[level][slot] == kNone) { occupied_[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64)); }
+         ch.state = State::Idle;
+     }
+
+     // Moves a slot's whole list into due_, marking each channel `state`.
+     void detach(int level, int slot, State state)
+     {
+         for (std::uint32_t id = heads_[level][slot]; id != kNone; id = channels_[id].next) {
+             channels_[id].state = state;
+             due_.push_back(id);
+         }
+         heads_[level][slot] = kNone;
+         occupied_[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+     }
+
+     // Re-files a coarse slot now that now_ has reached its start.
+     void cascade(int level, int slot)
+     {
+         std::size_t base = due_.size();
+         detach(level, slot, State::Idle);
+         for (std::size_t i = base; i < due_.size(); ++i) { link(due_[i], channels_[due_[i]].time); }
+         due_.resize(base);
+     }
+
+     // Lowest occupied slot >= from at `level`, or -1.
+     int first_occupied(int level, int from) const
+     {
+         for (int w = from / 64; w < kWords; ++w) {
+             std::uint64_t bits = occupied_[level][w];
+             if (w == from / 64) { bits &= ~std::uint64_t(0) << (from % 64); }
+             if (bits) { return w * 64 + std::countr_zero(bits); }
+         }
+         return -1;
+     }
+
+     // The next slot to visit and the wheel time it starts at. Level-0 slots
+     // at or after now_ hold channels due exactly then; coarser levels only
+     // hold slots strictly ahead of now_ in their byte.
+     bool next_slot(int& level, int& slot, std::uint32_t& start) const
+     {
+         for (level = 0; level < kLevels; ++level) {
+             int shift = level * kSlotBits;
+             int from = static_cast<int>((now_ >> shift) & (kSlots - 1)) + (level > 0 ? 1 : 0);
+             if (from >= kSlots || (slot = first_occupied(level, from)) < 0) { continue; }
+             std::uint32_t high = (shift + kSlotBits < 32) ? (now_ >> (shift + kSlotBits)) << (shift + kSlotBits) : 0;
+             start = high | (static_cast<std::uint32_t>(slot) << shift);
+             return true;
+         }
+         return false;
+     }
+
+     std::vector<Channel> channels_;
+     std::vector<ChannelId> free_;
+     std::vector<ChannelId> due_;
+     std::uint32_t heads_[kLevels][kSlots];
+     std::uint64_t occupied_[kLevels][kWords] = {};
+     std::uint32_t now_;
+     std::size_t live_ = 0;
+     bool advancing_ = false;
+ };
+
+ } // namespace fpsr
+
+ #endif // FPSR_EVENTS_HPP
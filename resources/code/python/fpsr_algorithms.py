@@ -7,6 +7,9 @@ details:
     This file contains two stateless, frame-persistent randomization algorithms.
     
     It uses a custom portable_rand() function to ensure deterministic and consistent results across any platform.
+
+    To evaluate whole arrays of frames or instances, build the fpsr_native extension (setup.py),
+    which runs the C implementation over NumPy arrays or any other buffer in place.
 '''
 
 import math
@@ -23,6 +26,24 @@ def portable_rand(seed):
     return result - math.floor(result)
 
 
+def portable_rand_hash(seed):
+    """
+    An integer-hash alternative to portable_rand().
+    Generates a deterministic float between 0.0 and 1.0 using only 32-bit integer operations,
+    so it matches the C portable_rand_hash() bit for bit on every platform.
+    
+    :param seed: An integer used to generate the random number.
+    :return: A pseudo-random float in [0.0, 1.0), a multiple of 2^-24.
+    """
+    x = (seed + 0x9E3779B9) & 0xFFFFFFFF
+    x ^= x >> 16
+    x = (x * 0x7FEB352D) & 0xFFFFFFFF
+    x ^= x >> 15
+    x = (x * 0x846CA68B) & 0xFFFFFFFF
+    x ^= x >> 16
+    return (x >> 8) / 16777216.0
+
+
 """
 --------------------------
 FPS-R: Stacked Modulo (SM)
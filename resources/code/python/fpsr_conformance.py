@@ -0,0 +1,122 @@
+# SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+'''
+file: fpsr_conformance.py
+brief: Checks the fpsr_native extension against the golden corpus (../c/conformance/fpsr_golden.txt).
+details:
+    Rebuilds every corpus row through each of fpsr_native's dispatch paths (one instance over a
+    frames buffer, many instances at one frame, and buffers for everything) and compares the
+    CRC-32 of the float32 values with the corpus. Only the sin backend is checked; fpsr_native
+    does not expose the hash backend. The C runner (../c/conformance/fpsr_conformance.cpp)
+    covers the C, SIMD and fixed-point paths.
+
+    The pure-Python fpsr_algorithms.py computes in float64 and is not expected to match.
+
+    python setup.py build_ext --inplace
+    python fpsr_conformance.py [--golden FILE] [--quick]
+'''
+
+import argparse
+import array
+import struct
+import sys
+import zlib
+
+import fpsr_native
+
+GROUP_SIZE = 32  # Consecutive rows sharing a start frame.
+
+
+def read_corpus(path):
+    sm, qs = [], []
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if not fields or fields[0].startswith('#'):
+                continue
+            if fields[0] == 'sm':
+                sm.append(dict(
+                    start=int(fields[2]), frames=int(fields[3]),
+                    params=[int(v) for v in fields[4:9]],
+                    crc=int(fields[9], 16)))
+            elif fields[0] == 'qs':
+                bits = lambda v: struct.unpack('<f', struct.pack('<I', int(v, 16)))[0]
+                qs.append(dict(
+                    start=int(fields[2]), frames=int(fields[3]),
+                    params=[bits(fields[4]), bits(fields[5])] + [int(v) for v in fields[6:13]],
+                    crc=int(fields[13], 16)))
+            else:
+                raise ValueError('unexpected corpus line: ' + line.strip())
+    return sm, qs
+
+
+def crc_of(values):
+    return zlib.crc32(values.tobytes() if sys.byteorder == 'little' else _swapped(values))
+
+
+def _swapped(values):
+    copy = array.array('f', values)
+    copy.byteswap()
+    return copy.tobytes()
+
+
+def param_buffers(rows, repeat):
+    # One buffer per parameter, each row's value repeated `repeat` times; floats for QS's first two.
+    columns = []
+    for k in range(len(rows[0]['params'])):
+        kind = 'f' if isinstance(rows[0]['params'][k], float) else 'i'
+        columns.append(array.array(kind, (r['params'][k] for r in rows for _ in range(repeat))))
+    return columns
+
+
+def check(name, rows, fn, groups):
+    '''Returns the number of (path, row) checks that differ from the corpus.'''
+    failures = 0
+    for g in range(groups):
+        group = rows[g * GROUP_SIZE:(g + 1) * GROUP_SIZE]
+        start, frames = group[0]['start'], group[0]['frames']
+        frame_buffer = array.array('i', range(start, start + frames))
+        results = {}
+
+        # --- 1. One instance over a frames buffer ---
+        results['frames buffer'] = [fn(frame_buffer, *r['params']) for r in group]
+
+        # --- 2. Many instances at one frame ---
+        columns = param_buffers(group, 1)
+        out = array.array('f', bytes(4 * len(group)))
+        per_row = [array.array('f', bytes(4 * frames)) for _ in group]
+        for f in range(frames):
+            fn(start + f, *columns, out=out)
+            for i, v in enumerate(out):
+                per_row[i][f] = v
+        results['parameter buffers'] = per_row
+
+        # --- 3. Buffers for everything ---
+        all_frames = array.array('i', (start + f for _ in group for f in range(frames)))
+        values = fn(all_frames, *param_buffers(group, frames))
+        results['all buffers'] = [values[i * frames:(i + 1) * frames] for i in range(len(group))]
+
+        for path, per_case in results.items():
+            for i, values in enumerate(per_case):
+                if crc_of(values) != group[i]['crc']:
+                    failures += 1
+                    print('FAIL %s/sin fpsr_native (%s): case %d' % (name, path, g * GROUP_SIZE + i))
+    print('%s %s/sin fpsr_native: %d cases x 3 paths' % ('PASS' if failures == 0 else 'FAIL', name, groups * GROUP_SIZE))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Checks fpsr_native against the FPS-R golden corpus.')
+    parser.add_argument('--golden', default='../c/conformance/fpsr_golden.txt')
+    parser.add_argument('--quick', action='store_true', help='one group of each start-frame class')
+    args = parser.parse_args()
+
+    sm, qs = read_corpus(args.golden)
+    groups = 8 if args.quick else len(sm) // GROUP_SIZE
+    failures = check('sm', sm, fpsr_native.sm, groups) + check('qs', qs, fpsr_native.qs, groups)
+    print('conformant' if failures == 0 else 'NOT conformant: %d failed checks' % failures)
+    return 0 if failures == 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
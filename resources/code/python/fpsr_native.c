@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+/**
+ * @file fpsr_native.c
+ * @brief CPython extension exposing the C FPS-R kernels to whole arrays at a time.
+ * @details fpsr_algorithms.py evaluates one frame per Python call; this module
+ * evaluates whole arrays in C. Every argument is either a scalar or a
+ * C-contiguous buffer (NumPy array, array.array, memoryview, ...) of int32 or
+ * float32 values; buffers are read in place and results are written straight
+ * into the caller's float32 `out` buffer, so nothing is copied. Integer
+ * arguments also take int64 buffers, NumPy's default on most platforms; they
+ * are range-checked and converted to int32 once per call. Scalars include
+ * 0-d buffers (NumPy scalars) of any numeric type. All buffers
+ * must have the same number of elements, and element i of the result uses
+ * element i of every buffer argument (scalars apply to every element).
+ * The GIL is released while the kernels run, so threads bake in parallel.
+ *
+ * The values are those of the C reference (float arithmetic), which can differ
+ * in the last bits from the float64 pure-Python port.
+ *
+ * Build in place with:  python setup.py build_ext --inplace
+ */
+
+ #define PY_SSIZE_T_CLEAN
+ #include <Python.h>
+ #include <limits.h> // For INT_MIN and INT_MAX
+ #include <stdint.h> // For int64_t
+ #include <string.h> // For strchr() and memset()
+ #include "fpsr_algorithms.h"
+
+ // One argument: a scalar, or a buffer of int32 ('i') or float32 ('f') values.
+ typedef struct fpsr_py_arg {
+     Py_buffer view;
+     int isBuffer;
+     const void* data;
+     int* converted; // int32 copy of an int64 buffer, owned; data points at it.
+     Py_ssize_t count;
+     int i;   // Scalar value for 'i' arguments.
+     float f; // Scalar value for 'f' arguments.
+ } fpsr_py_arg;
+
+ // Reports whether a buffer format string describes a native value of `kind`:
+ // a 4-byte float for 'f', a 4- or 8-byte signed integer for 'i'.
+ static int fpsr_py_format_ok(const char* format, Py_ssize_t itemsize, char kind)
+ {
+     if (format == NULL) { return 0; }
+     if (*format == '@' || *format == '=') { ++format; }
+     if (format[0] == '\0' || format[1] != '\0') { return 0; }
+     if (kind == 'f') { return itemsize == 4 && format[0] == 'f'; }
+     return (itemsize == 4 || itemsize == 8) && strchr("ilq", format[0]) != NULL;
+ }
+
+ // Replaces an int64 buffer argument by an int32 copy. Returns 0, or -1 with an exception set.
+ static int fpsr_py_arg_narrow(fpsr_py_arg* arg, const char* name)
+ {
+     const int64_t* src = (const int64_t*)arg->view.buf;
+     arg->converted = (int*)PyMem_Malloc(sizeof(int) * (size_t)(arg->count ? arg->count : 1));
+     if (arg->converted == NULL) { PyErr_NoMemory(); return -1; }
+     for (Py_ssize_t k = 0; k < arg->count; ++k) {
+         if (src[k] < INT_MIN || src[k] > INT_MAX) {
+             PyErr_Format(PyExc_OverflowError, "%s[%zd] is out of the int32 range", name, k);
+             return -1;
+         }
+         arg->converted[k] = (int)src[k];
+     }
+     arg->data = arg->converted;
+     return 0;
+ }
+
+ // Reads a Python number as a scalar argument: an int via __index__ for 'i', __float__ for 'f'.
+ static int fpsr_py_arg_scalar(PyObject* obj, char kind, const char* name, fpsr_py_arg* arg)
+ {
+     if (kind == 'f') {
+         double v = PyFloat_AsDouble(obj);
+         if (v == -1.0 && PyErr_Occurred()) { return -1; }
+         arg->f = (float)v;
+         return 0;
+     }
+     PyObject* index = PyNumber_Index(obj);
+     if (index == NULL) { return -1; }
+     long v = PyLong_AsLong(index);
+     Py_DECREF(index);
+     if (v == -1 && PyErr_Occurred()) { return -1; }
+     if (v < INT_MIN || v > INT_MAX) {
+         PyErr_Format(PyExc_OverflowError, "%s is out of the int32 range", name);
+         return -1;
+     }
+     arg->i = (int)v;
+     return 0;
+ }
+
+ /**
+  * @brief Reads one argument as a scalar or a contiguous buffer.
+  * @return 0, or -1 with a Python exception set.
+  */
+ static int fpsr_py_arg_parse(PyObject* obj, char kind, const char* name, int writable, fpsr_py_arg* arg)
+ {
+     memset(arg, 0, sizeof(*arg));
+     if (PyObject_CheckBuffer(obj)) {
+         int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+         if (PyObject_GetBuffer(obj, &arg->view, flags) < 0) { return -1; }
+         if (arg->view.ndim == 0 && !writable) {
+             // NumPy scalars are 0-d buffers, of any width; read them through a Python number.
+             PyBuffer_Release(&arg->view);
+             memset(&arg->view, 0, sizeof(arg->view));
+             PyObject* view = PyMemoryView_FromObject(obj);
+             PyObject* item = (view != NULL) ? PyObject_CallMethod(view, "tolist", NULL) : NULL;
+             Py_XDECREF(view);
+             if (item == NULL) { return -1; }
+             int rc = fpsr_py_arg_scalar(item, kind, name, arg);
+             Py_DECREF(item);
+             return rc;
+         }
+         if (!fpsr_py_format_ok(arg->view.format, arg->view.itemsize, kind)) {
+             PyErr_Format(PyExc_TypeError, "%s must hold %s values (got format '%s')",
+                          name, (kind == 'f') ? "float32" : "int32 or int64", arg->view.format ? arg->view.format : "B");
+             PyBuffer_Release(&arg->view);
+             return -1;
+         }
+         arg->isBuffer = 1;
+         arg->data = arg->view.buf;
+         arg->count = arg->view.len / arg->view.itemsize;
+         if (arg->view.itemsize == 8 && fpsr_py_arg_narrow(arg, name) < 0) {
+             PyMem_Free(arg->converted);
+             PyBuffer_Release(&arg->view);
+             return -1;
+         }
+         return 0;
+     }
+     if (writable) {
+         PyErr_Format(PyExc_TypeError, "%s must be a writable float32 buffer", name);
+         return -1;
+     }
+     return fpsr_py_arg_scalar(obj, kind, name, arg);
+ }
+
+ static void fpsr_py_args_release(fpsr_py_arg* args, int count)
+ {
+     for (int k = 0; k < count; ++k) {
+         if (args[k].isBuffer) {
+             PyMem_Free(args[k].converted);
+             PyBuffer_Release(&args[k].view);
+         }
+     }
+ }
+
+ // Value k of an 'i' or 'f' argument.
+ #define FPSR_PY_I(a, k) ((a).isBuffer ? ((const int*)(a).data)[k] : (a).i)
+ #define FPSR_PY_F(a, k) ((a).isBuffer ? ((const float*)(a).data)[k] : (a).f)
+
+ /**
+  * @brief Parses every argument, agrees on the element count and prepares `out`.
+  * @details When `outObj` is None a new array.array('f') is allocated (or, if
+  * every argument is a scalar, a single value is computed into outScalar).
+  * @return The object to return (new reference) with *n set, or NULL with an exception set.
+  */
+ static PyObject* fpsr_py_prepare(
+     PyObject* const* objs, const char* kinds, const char* const* names, int count,
+     fpsr_py_arg* args, PyObject* outObj, fpsr_py_arg* out, float* outScalar, Py_ssize_t* n)
+ {
+     *n = -1;
+     for (int k = 0; k < count; ++k) {
+         if (fpsr_py_arg_parse(objs[k], kinds[k], names[k], 0, &args[k]) < 0) {
+             fpsr_py_args_release(args, k);
+             return NULL;
+         }
+         if (args[k].isBuffer) {
+             if (*n >= 0 && args[k].count != *n) {
+                 PyErr_Format(PyExc_ValueError, "%s has %zd elements, expected %zd", names[k], args[k].count, *n);
+                 fpsr_py_args_release(args, k + 1);
+                 return NULL;
+             }
+             *n = args[k].count;
+         }
+     }
+
+     PyObject* result;
+     if (outObj == NULL || outObj == Py_None) {
+         if (*n < 0) { // All scalars: one value, returned as a float.
+             *n = 1;
+             memset(out, 0, sizeof(*out));
+             out->data = outScalar;
+             out->count = 1;
+             Py_INCREF(Py_None);
+             return Py_None;
+         }
+         PyObject* arrayModule = PyImport_ImportModule("array");
+         if (arrayModule == NULL) { fpsr_py_args_release(args, count); return NULL; }
+         PyObject* one = PyObject_CallMethod(arrayModule, "array", "s[d]", "f", 0.0);
+         Py_DECREF(arrayModule);
+         result = (one != NULL) ? PySequence_Repeat(one, *n) : NULL;
+         Py_XDECREF(one);
+         if (result == NULL) { fpsr_py_args_release(args, count); return NULL; }
+     } else {
+         result = outObj;
+         Py_INCREF(result);
+     }
+
+     if (fpsr_py_arg_parse(result, 'f', "out", 1, out) < 0) {
+         Py_DECREF(result);
+         fpsr_py_args_release(args, count);
+         return NULL;
+     }
+     if (*n < 0) { *n = out->count; } // Scalar arguments broadcast over `out`.
+     if (out->count != *n) {
+         PyErr_Format(PyExc_ValueError, "out has %zd elements, expected %zd", out->count, *n);
+         PyBuffer_Release(&out->view);
+         Py_DECREF(result);
+         fpsr_py_args_release(args, count);
+         return NULL;
+     }
+     return result;
+ }
+
+ // Releases everything fpsr_py_prepare() acquired; returns `result`, or a float for the all-scalar case.
+ static PyObject* fpsr_py_finish(fpsr_py_arg* args, int count, fpsr_py_arg* out, PyObject* result, float outScalar)
+ {
+     fpsr_py_args_release(args, count);
+     if (out->isBuffer) { PyBuffer_Release(&out->view); }
+     if (result == Py_None) {
+         Py_DECREF(result);
+         return PyFloat_FromDouble(outScalar);
+     }
+     return result;
+ }
+
+
+ /******************************************************************************/
+ /* FPS-R: Stacked Modulo (SM)                                                 */
+ /******************************************************************************/
+
+ PyDoc_STRVAR(fpsr_py_sm_doc,
+ "sm(frames, minHold, maxHold, reseedInterval, seedInner, seedOuter, out=None)\n"
+ "--\n\n"
+ "fpsr_sm() element-wise. Each argument is an int or an int32 buffer (int64\n"
+ "buffers are accepted when every value fits in int32); out is a float32\n"
+ "buffer of the same length, filled in place and returned. Without out a new\n"
+ "array.array('f') is returned, or a float when every argument is a scalar.");
+
+ static PyObject* fpsr_py_sm(PyObject* self, PyObject* pyargs, PyObject* kwargs)
+ {
+     (void)self;
+     static char* kwlist[] = { "frames", "minHold", "maxHold", "reseedInterval", "seedInner", "seedOuter", "out", NULL };
+     static const char* const names[] = { "frames", "minHold", "maxHold", "reseedInterval", "seedInner", "seedOuter" };
+     PyObject* objs[6];
+     PyObject* outObj = NULL;
+     if (!PyArg_ParseTupleAndKeywords(pyargs, kwargs, "OOOOOO|O:sm", kwlist,
+                                      &objs[0], &objs[1], &objs[2], &objs[3], &objs[4], &objs[5], &outObj)) {
+         return NULL;
+     }
+
+     fpsr_py_arg a[6], out;
+     float outScalar = 0.0f;
+     Py_ssize_t n;
+     PyObject* result = fpsr_py_prepare(objs, "iiiiii", names, 6, a, outObj, &out, &outScalar, &n);
+     if (result == NULL) { return NULL; }
+
+     float* dst = (float*)out.data;
+     int paramsScalar = !a[1].isBuffer && !a[2].isBuffer && !a[3].isBuffer && !a[4].isBuffer && !a[5].isBuffer;
+     int paramsBuffers = a[1].isBuffer && a[2].isBuffer && a[3].isBuffer && a[4].isBuffer && a[5].isBuffer;
+
+     Py_BEGIN_ALLOW_THREADS
+     if (paramsScalar && a[0].isBuffer) {
+         // --- One instance at many frames ---
+         fpsr_sm_batch((const int*)a[0].data, dst, (size_t)n, a[1].i, a[2].i, a[3].i, a[4].i, a[5].i);
+     } else if (paramsBuffers && !a[0].isBuffer) {
+         // --- Many instances at one frame ---
+         fpsr_sm_soa soa = { (const int*)a[1].data, (const int*)a[2].data, (const int*)a[3].data,
+                             (const int*)a[4].data, (const int*)a[5].data };
+         fpsr_sm_eval_soa(&soa, (size_t)n, a[0].i, dst, FPSR_RAND_EXACT);
+     } else {
+         for (Py_ssize_t k = 0; k < n; ++k) {
+             dst[k] = fpsr_sm(FPSR_PY_I(a[0], k), FPSR_PY_I(a[1], k), FPSR_PY_I(a[2], k),
+                              FPSR_PY_I(a[3], k), FPSR_PY_I(a[4], k), FPSR_PY_I(a[5], k));
+         }
+     }
+     Py_END_ALLOW_THREADS
+
+     return fpsr_py_finish(a, 6, &out, result, outScalar);
+ }
+
+
+ /******************************************************************************/
+ /* FPS-R: Quantised Switching (QS)                                            */
+ /******************************************************************************/
+
+ PyDoc_STRVAR(fpsr_py_qs_doc,
+ "qs(frames, baseWaveFreq, stream2FreqMult, quantLevelMin, quantLevelMax,\n"
+ "   stream1Offset, stream2Offset, streamSwitchDur, stream1QuantDur, stream2QuantDur, out=None)\n"
+ "--\n\n"
+ "fpsr_qs() element-wise, with quantLevelsMinMax and streamsOffset split into\n"
+ "their two components. Frequencies are floats or float32 buffers, everything\n"
+ "else ints or int32 buffers (int64 as in sm()); out works as in sm().");
+
+ static PyObject* fpsr_py_qs(PyObject* self, PyObject* pyargs, PyObject* kwargs)
+ {
+     (void)self;
+     static char* kwlist[] = { "frames", "baseWaveFreq", "stream2FreqMult", "quantLevelMin", "quantLevelMax",
+                               "stream1Offset", "stream2Offset", "streamSwitchDur", "stream1QuantDur",
+                               "stream2QuantDur", "out", NULL };
+     static const char* const names[] = { "frames", "baseWaveFreq", "stream2FreqMult", "quantLevelMin", "quantLevelMax",
+                                          "stream1Offset", "stream2Offset", "streamSwitchDur", "stream1QuantDur",
+                                          "stream2QuantDur" };
+     PyObject* objs[10];
+     PyObject* outObj = NULL;
+     if (!PyArg_ParseTupleAndKeywords(pyargs, kwargs, "OOOOOOOOOO|O:qs", kwlist,
+                                      &objs[0], &objs[1], &objs[2], &objs[3], &objs[4], &objs[5],
+                                      &objs[6], &objs[7], &objs[8], &objs[9], &outObj)) {
+         return NULL;
+     }
+
+     fpsr_py_arg a[10], out;
+     float outScalar = 0.0f;
+     Py_ssize_t n;
+     PyObject* result = fpsr_py_prepare(objs, "iffiiiiiii", names, 10, a, outObj, &out, &outScalar, &n);
+     if (result == NULL) { return NULL; }
+
+     float* dst = (float*)out.data;
+     int paramsScalar = 1, paramsBuffers = 1;
+     for (int k = 1; k < 10; ++k) {
+         paramsScalar &= !a[k].isBuffer;
+         paramsBuffers &= a[k].isBuffer;
+     }
+
+     Py_BEGIN_ALLOW_THREADS
+     if (paramsScalar) {
+         // --- One instance: resolve the parameters once ---
+         int q[2] = { a[3].i, a[4].i };
+         int o[2] = { a[5].i, a[6].i };
+         fpsr_qs_plan plan;
+         fpsr_qs_plan_init(&plan, a[1].f, a[2].f, q, o, a[7].i, a[8].i, a[9].i);
+         for (Py_ssize_t k = 0; k < n; ++k) { dst[k] = fpsr_qs_eval(&plan, FPSR_PY_I(a[0], k)); }
+     } else if (paramsBuffers && !a[0].isBuffer) {
+         // --- Many instances at one frame ---
+         fpsr_qs_soa soa = { (const float*)a[1].data, (const float*)a[2].data,
+                             (const int*)a[3].data, (const int*)a[4].data,
+                             (const int*)a[5].data, (const int*)a[6].data,
+                             (const int*)a[7].data, (const int*)a[8].data, (const int*)a[9].data };
+         fpsr_qs_eval_soa(&soa, (size_t)n, a[0].i, dst, FPSR_RAND_EXACT);
+     } else {
+         for (Py_ssize_t k = 0; k < n; ++k) {
+             int q[2] = { FPSR_PY_I(a[3], k), FPSR_PY_I(a[4], k) };
+             int o[2] = { FPSR_PY_I(a[5], k), FPSR_PY_I(a[6], k) };
+             dst[k] = fpsr_qs(FPSR_PY_I(a[0], k), FPSR_PY_F(a[1], k), FPSR_PY_F(a[2], k), q, o,
+                              FPSR_PY_I(a[7], k), FPSR_PY_I(a[8], k), FPSR_PY_I(a[9], k));
+         }
+     }
+     Py_END_ALLOW_THREADS
+
+     return fpsr_py_finish(a, 10, &out, result, outScalar);
+ }
+
+
+ /******************************************************************************/
+ /* portable_rand                                                              */
+ /******************************************************************************/
+
+ PyDoc_STRVAR(fpsr_py_portable_rand_doc,
+ "portable_rand(seeds, out=None)\n"
+ "--\n\n"
+ "portable_rand() element-wise over an int or int32 buffer of seeds (int64 as in\n"
+ "sm()); out works as in sm().");
+
+ static PyObject* fpsr_py_portable_rand(PyObject* self, PyObject* pyargs, PyObject* kwargs)
+ {
+     (void)self;
+     static char* kwlist[] = { "seeds", "out", NULL };
+     static const char* const names[] = { "seeds" };
+     PyObject* objs[1];
+     PyObject* outObj = NULL;
+     if (!PyArg_ParseTupleAndKeywords(pyargs, kwargs, "O|O:portable_rand", kwlist, &objs[0], &outObj)) {
+         return NULL;
+     }
+
+     fpsr_py_arg a[1], out;
+     float outScalar = 0.0f;
+     Py_ssize_t n;
+     PyObject* result = fpsr_py_prepare(objs, "i", names, 1, a, outObj, &out, &outScalar, &n);
+     if (result == NULL) { return NULL; }
+
+     float* dst = (float*)out.data;
+     Py_BEGIN_ALLOW_THREADS
+     if (a[0].isBuffer) {
+         portable_rand_batch((const int*)a[0].data, dst, (size_t)n, FPSR_RAND_EXACT);
+     } else {
+         for (Py_ssize_t k = 0; k < n; ++k) { dst[k] = portable_rand(a[0].i); }
+     }
+     Py_END_ALLOW_THREADS
+
+     return fpsr_py_finish(a, 1, &out, result, outScalar);
+ }
+
+
+ /******************************************************************************/
+ /* Module                                                                     */
+ /******************************************************************************/
+
+ static PyMethodDef fpsr_py_methods[] = {
+     { "sm", (PyCFunction)(void (*)(void))fpsr_py_sm, METH_VARARGS | METH_KEYWORDS, fpsr_py_sm_doc },
+     { "qs", (PyCFunction)(void (*)(void))fpsr_py_qs, METH_VARARGS | METH_KEYWORDS, fpsr_py_qs_doc },
+     { "portable_rand", (PyCFunction)(void (*)(void))fpsr_py_portable_rand, METH_VARARGS | METH_KEYWORDS,
+       fpsr_py_portable_rand_doc },
+     { NULL, NULL, 0, NULL }
+ };
+
+ static struct PyModuleDef fpsr_py_module = {
+     PyModuleDef_HEAD_INIT,
+     "fpsr_native",
+     "FPS-R (Stacked Modulo and Quantised Switching) evaluated over whole arrays by the C kernels.",
+     -1,
+     fpsr_py_methods,
+     NULL, NULL, NULL, NULL
+ };
+
+ PyMODINIT_FUNC PyInit_fpsr_native(void)
+ {
+     return PyModule_Create(&fpsr_py_module);
+ }
@@ -0,0 +1,25 @@
+# SPDX-License-Identifier: MIT — See LICENSE for full terms
+
+'''
+file: setup.py
+brief: Builds the fpsr_native extension module over the C implementation in ../c.
+details:
+    python setup.py build_ext --inplace
+'''
+
+from setuptools import Extension, setup
+
+C_DIR = '../c'
+
+setup(
+    name='fpsr_native',
+    version='0.1.0',
+    description='FPS-R evaluated over whole arrays by the C kernels',
+    ext_modules=[
+        Extension(
+            'fpsr_native',
+            sources=['fpsr_native.c', f'{C_DIR}/fpsr_algorithms.c', f'{C_DIR}/fpsr_simd.c'],
+            include_dirs=[C_DIR],
+        ),
+    ],
+)